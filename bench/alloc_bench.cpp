@@ -0,0 +1,123 @@
+#include "bench.h"
+
+#include "../net/address_bitmap.h"
+#include <random>
+#include <set>
+
+// Address allocation: a /8 virtual subnet where the 64K host numbers around
+// a joiner's probe hash are all taken, plus a sparse scatter elsewhere.
+// Next-free lookups start at random points inside the taken block, first
+// with the std::set walk IpNegotiator used to do (one count() per host),
+// then with AddressBitmap, and must agree. The churn figures are the cost of
+// marking an address used and unused again.
+
+namespace {
+constexpr uint32_t kHostMask = 0x00FFFFFF; // 255.0.0.0
+constexpr uint32_t kProbeHash = 0x5A5A5A;
+constexpr uint32_t kDenseHosts = 1u << 16;
+constexpr int kSparseHosts = 4096;
+constexpr int kSetLookups = 256;
+constexpr int kBitmapLookups = 1 << 16;
+constexpr int kChurn = 1 << 16;
+
+uint32_t setWalk(const std::set<uint32_t> &used, uint32_t host) {
+  uint32_t attempts = 0;
+  while (used.count(host) && attempts < kHostMask - 1) {
+    if (++host >= kHostMask) {
+      host = 1;
+    }
+    ++attempts;
+  }
+  return host;
+}
+
+uint32_t bitmapFind(const AddressBitmap &used, uint32_t host) {
+  const uint32_t found = used.nextClear(host);
+  return found < kHostMask ? found : used.nextClear(1);
+}
+
+double nanosPer(uint64_t startNs, int count) {
+  return static_cast<double>(nowNanos() - startNs) / count;
+}
+} // namespace
+
+BenchResult runAllocBench(const BenchOptions &options) {
+  BenchResult result;
+  result.scenario = "alloc";
+
+  std::mt19937 rng(options.seed);
+  std::uniform_int_distribution<uint32_t> anyHost(1, kHostMask - 1);
+  std::uniform_int_distribution<uint32_t> inBlock(0, kDenseHosts - 1);
+  const uint32_t blockStart = kProbeHash - kDenseHosts / 2;
+
+  std::set<uint32_t> usedSet;
+  AddressBitmap usedBitmap;
+  usedBitmap.resize(static_cast<uint64_t>(kHostMask) + 1);
+  for (uint32_t i = 0; i < kDenseHosts; ++i) {
+    usedSet.insert(blockStart + i);
+    usedBitmap.set(blockStart + i);
+  }
+  for (int i = 0; i < kSparseHosts; ++i) {
+    const uint32_t host = anyHost(rng);
+    usedSet.insert(host);
+    usedBitmap.set(host);
+  }
+
+  std::vector<uint32_t> starts(kBitmapLookups);
+  for (auto &start : starts) {
+    start = blockStart + inBlock(rng);
+  }
+
+  const ResourceSample begin = ResourceSample::now();
+  uint64_t startNs = nowNanos();
+  std::vector<uint32_t> expected(kSetLookups);
+  for (int i = 0; i < kSetLookups; ++i) {
+    expected[i] = setWalk(usedSet, starts[i]);
+  }
+  const double setNs = nanosPer(startNs, kSetLookups);
+
+  startNs = nowNanos();
+  std::vector<uint32_t> found(kBitmapLookups);
+  for (int i = 0; i < kBitmapLookups; ++i) {
+    found[i] = bitmapFind(usedBitmap, starts[i]);
+  }
+  const double bitmapNs = nanosPer(startNs, kBitmapLookups);
+
+  for (int i = 0; i < kBitmapLookups; ++i) {
+    if ((i < kSetLookups && found[i] != expected[i]) ||
+        usedSet.count(found[i])) {
+      result.error = "bitmap lookup " + std::to_string(i) + " is wrong";
+      return result;
+    }
+  }
+
+  std::vector<uint32_t> churn(kChurn);
+  for (auto &host : churn) {
+    do {
+      host = anyHost(rng);
+    } while (usedSet.count(host));
+  }
+  startNs = nowNanos();
+  for (uint32_t host : churn) {
+    usedSet.insert(host);
+    usedSet.erase(host);
+  }
+  const double setChurnNs = nanosPer(startNs, kChurn);
+  startNs = nowNanos();
+  for (uint32_t host : churn) {
+    usedBitmap.set(host);
+    usedBitmap.reset(host);
+  }
+  const double bitmapChurnNs = nanosPer(startNs, kChurn);
+  const ResourceSample end = ResourceSample::now();
+
+  applyResources(result, begin, end);
+  result.packets = kSetLookups + kBitmapLookups;
+  result.extra.emplace_back("used_hosts", static_cast<double>(usedSet.size()));
+  result.extra.emplace_back("set_ns_per_lookup", setNs);
+  result.extra.emplace_back("bitmap_ns_per_lookup", bitmapNs);
+  result.extra.emplace_back("set_ns_per_churn", setChurnNs);
+  result.extra.emplace_back("bitmap_ns_per_churn", bitmapChurnNs);
+  result.ok = true;
+  return result;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "../net/egress_queue.h"
+#include "../net/loopback_transport.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct BenchOptions {
+  double durationSeconds = 5.0;
+  double latencyMs = 10.0; // one-way
+  double lossRate = 0.0;
+  double burstLossRate = 0.0; // average extra loss arriving in bursts
+  double burstLength = 4.0;   // mean datagrams per burst
+  double bandwidthMBps = 0.0; // 0 = unlimited
+  std::size_t payloadBytes = 1024;
+  double packetRate = 0.0; // tun injections per second, 0 = saturate
+  int pingSamples = 500;
+  int tcpPort = 38881;
+  uint32_t seed = 1;
+  bool compression = true;  // tunnel LZ4 negotiation in the tcp scenario
+  bool udpTransport = false; // tcp scenario over UdpTransport, not loopback
+  bool fec = false;         // FEC on the bridges in the tun scenario
+  EgressQueue::Policy queuePolicy = EgressQueue::Policy::FqCoDel;
+  double gameRate = 0.0; // small-flow packets/s alongside the tun load phase
+  std::string trafficClasses; // tun port rules, as CONNECTTOOL_VPN_CLASSES
+  std::string corpusDir;    // compress scenario input; empty = synthetic
+  bool verbose = false;
+
+  LinkConditions link() const;
+};
+
+struct LatencySummary {
+  double p50Us = 0.0;
+  double p99Us = 0.0;
+  double p999Us = 0.0;
+  std::size_t samples = 0;
+};
+
+struct BenchResult {
+  std::string scenario;
+  uint64_t bytes = 0;   // bytes that completed the round trip
+  uint64_t packets = 0; // messages/packets that completed the round trip
+  uint64_t lostPackets = 0;
+  double seconds = 0.0;
+  double cpuSeconds = 0.0;
+  uint64_t allocations = 0;
+  LatencySummary idleLatency;   // one message in flight
+  LatencySummary loadedLatency; // during the throughput phase
+  // Scenario-specific figures, written as extra keys of the result object.
+  std::vector<std::pair<std::string, double>> extra;
+  bool ok = false;
+  std::string error;
+};
+
+// Thread-safe round-trip time collector.
+class LatencyRecorder {
+public:
+  void record(std::chrono::nanoseconds rtt);
+  LatencySummary summarize() const;
+  void clear();
+
+private:
+  mutable std::mutex mutex_;
+  std::vector<int64_t> samples_;
+};
+
+// Snapshot of process-wide CPU time and heap allocations, taken around the
+// measured phase of a scenario.
+struct ResourceSample {
+  double cpuSeconds = 0.0;
+  uint64_t allocations = 0;
+  std::chrono::steady_clock::time_point wall;
+
+  static ResourceSample now();
+};
+
+void applyResources(BenchResult &result, const ResourceSample &begin,
+                    const ResourceSample &end);
+
+uint64_t nowNanos();
+const char *queuePolicyName(EgressQueue::Policy policy);
+bool parseQueuePolicy(const std::string &name, EgressQueue::Policy &policy);
+void writeJson(std::ostream &out, const BenchOptions &options,
+               const std::vector<BenchResult> &results);
+
+BenchResult runTcpBench(const BenchOptions &options);
+BenchResult runTunBench(const BenchOptions &options);
+BenchResult runRateBench(const BenchOptions &options);
+BenchResult runCompressBench(const BenchOptions &options);
+BenchResult runFecBench(const BenchOptions &options);
+BenchResult runFqBench(const BenchOptions &options);
+BenchResult runChatBench(const BenchOptions &options);
+BenchResult runMembersBench(const BenchOptions &options);
+BenchResult runFriendsBench(const BenchOptions &options);
+BenchResult runTelemetryBench(const BenchOptions &options);
+BenchResult runLeaseBench(const BenchOptions &options);
+BenchResult runAllocBench(const BenchOptions &options);
+BenchResult runRouteBench(const BenchOptions &options);
+BenchResult runNodeIdBench(const BenchOptions &options);
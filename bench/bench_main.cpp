@@ -0,0 +1,202 @@
+#include "bench.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+
+namespace {
+struct Scenario {
+  const char *name;
+  std::function<BenchResult(const BenchOptions &)> run;
+};
+
+const std::vector<Scenario> &scenarios() {
+  static const std::vector<Scenario> all = {
+      {"tcp", runTcpBench},
+      {"tun", runTunBench},
+      {"rate", runRateBench},
+      {"compress", runCompressBench},
+      {"fec", runFecBench},
+      {"fq", runFqBench},
+      {"chat", runChatBench},
+      {"members", runMembersBench},
+      {"friends", runFriendsBench},
+      {"telemetry", runTelemetryBench},
+      {"lease", runLeaseBench},
+      {"alloc", runAllocBench},
+      {"routes", runRouteBench},
+      {"nodeid", runNodeIdBench},
+  };
+  return all;
+}
+
+class NullBuffer : public std::streambuf {
+protected:
+  int overflow(int c) override { return c; }
+};
+
+void printUsage() {
+  std::cerr
+      << "usage: connecttool-bench [options]\n"
+         "  --scenario NAME[,NAME]  scenarios to run (default: all)\n"
+         "  --duration SECONDS      throughput phase length (default 5)\n"
+         "  --latency-ms MS         one-way link latency (default 10)\n"
+         "  --loss RATE             datagram loss rate 0..1 (default 0)\n"
+         "  --burst-loss RATE       extra loss arriving in bursts (default 0)\n"
+         "  --burst-length N        mean datagrams per loss burst (default 4)\n"
+         "  --bandwidth MBPS        bottleneck rate in MB/s, 0 = unlimited\n"
+         "  --payload BYTES         message/packet payload size (default 1024)\n"
+         "  --packet-rate N         tun packets per second, 0 = saturate\n"
+         "  --samples N             idle round trips measured (default 500)\n"
+         "  --port PORT             local TCPServer port for tcp (default "
+         "38881)\n"
+         "  --seed N                link loss RNG seed\n"
+         "  --no-compression        disable tunnel compression (tcp)\n"
+         "  --transport NAME        tcp link: loopback (default) or udp\n"
+         "  --fec                   enable TUN forward error correction (tun)\n"
+         "  --queue POLICY          TUN egress queue: fq_codel (default), "
+         "codel, taildrop\n"
+         "  --game-rate N           game-like flow packets/s during tun load\n"
+         "  --classes SPEC          tun traffic class port rules, e.g. "
+         "udp/27015=interactive\n"
+         "  --corpus DIR            files streamed by compress (default: "
+         "synthetic)\n"
+         "  --out FILE              write JSON to FILE instead of stdout\n"
+         "  --verbose               keep the data path's own logging\n"
+         "scenarios:";
+  for (const auto &scenario : scenarios()) {
+    std::cerr << ' ' << scenario.name;
+  }
+  std::cerr << std::endl;
+}
+
+bool wanted(const std::string &selection, const std::string &name) {
+  if (selection == "all") {
+    return true;
+  }
+  std::stringstream list(selection);
+  std::string item;
+  while (std::getline(list, item, ',')) {
+    if (item == name) {
+      return true;
+    }
+  }
+  return false;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  BenchOptions options;
+  std::string selection = "all";
+  std::string outPath;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    auto value = [&]() -> const char * {
+      if (i + 1 >= argc) {
+        std::cerr << "missing value for " << arg << std::endl;
+        std::exit(2);
+      }
+      return argv[++i];
+    };
+    if (arg == "--scenario") {
+      selection = value();
+    } else if (arg == "--duration") {
+      options.durationSeconds = std::atof(value());
+    } else if (arg == "--latency-ms") {
+      options.latencyMs = std::atof(value());
+    } else if (arg == "--loss") {
+      options.lossRate = std::atof(value());
+    } else if (arg == "--burst-loss") {
+      options.burstLossRate = std::atof(value());
+    } else if (arg == "--burst-length") {
+      options.burstLength = std::atof(value());
+    } else if (arg == "--bandwidth") {
+      options.bandwidthMBps = std::atof(value());
+    } else if (arg == "--payload") {
+      options.payloadBytes = static_cast<std::size_t>(std::atol(value()));
+    } else if (arg == "--packet-rate") {
+      options.packetRate = std::atof(value());
+    } else if (arg == "--samples") {
+      options.pingSamples = std::atoi(value());
+    } else if (arg == "--port") {
+      options.tcpPort = std::atoi(value());
+    } else if (arg == "--seed") {
+      options.seed = static_cast<uint32_t>(std::strtoul(value(), nullptr, 10));
+    } else if (arg == "--no-compression") {
+      options.compression = false;
+    } else if (arg == "--transport") {
+      const std::string name = value();
+      if (name != "loopback" && name != "udp") {
+        printUsage();
+        return 2;
+      }
+      options.udpTransport = name == "udp";
+    } else if (arg == "--fec") {
+      options.fec = true;
+    } else if (arg == "--queue") {
+      if (!parseQueuePolicy(value(), options.queuePolicy)) {
+        printUsage();
+        return 2;
+      }
+    } else if (arg == "--game-rate") {
+      options.gameRate = std::atof(value());
+    } else if (arg == "--classes") {
+      options.trafficClasses = value();
+    } else if (arg == "--corpus") {
+      options.corpusDir = value();
+    } else if (arg == "--out") {
+      outPath = value();
+    } else if (arg == "--verbose") {
+      options.verbose = true;
+    } else {
+      printUsage();
+      return arg == "--help" || arg == "-h" ? 0 : 2;
+    }
+  }
+
+  // The data path logs to std::cout; keep stdout clean for the JSON report.
+  NullBuffer nullBuffer;
+  std::streambuf *stdoutBuffer = std::cout.rdbuf();
+  if (!options.verbose) {
+    std::cout.rdbuf(&nullBuffer);
+  }
+
+  std::vector<BenchResult> results;
+  for (const auto &scenario : scenarios()) {
+    if (!wanted(selection, scenario.name)) {
+      continue;
+    }
+    std::cerr << "running " << scenario.name << "..." << std::endl;
+    results.push_back(scenario.run(options));
+    if (!results.back().ok) {
+      std::cerr << scenario.name << " failed: " << results.back().error
+                << std::endl;
+    }
+  }
+  std::cout.rdbuf(stdoutBuffer);
+
+  if (results.empty()) {
+    std::cerr << "no scenario matches '" << selection << "'" << std::endl;
+    return 2;
+  }
+  if (!outPath.empty()) {
+    std::ofstream out(outPath);
+    if (!out) {
+      std::cerr << "cannot write " << outPath << std::endl;
+      return 1;
+    }
+    writeJson(out, options, results);
+  } else {
+    writeJson(std::cout, options, results);
+  }
+  for (const auto &result : results) {
+    if (!result.ok) {
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,227 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <initializer_list>
+#include <iomanip>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+std::atomic<uint64_t> gAllocations{0};
+
+double processCpuSeconds() {
+#ifdef _WIN32
+  FILETIME created, exited, kernel, user;
+  if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel,
+                       &user)) {
+    return 0.0;
+  }
+  auto toSeconds = [](const FILETIME &ft) {
+    ULARGE_INTEGER value;
+    value.LowPart = ft.dwLowDateTime;
+    value.HighPart = ft.dwHighDateTime;
+    return static_cast<double>(value.QuadPart) / 1e7;
+  };
+  return toSeconds(kernel) + toSeconds(user);
+#else
+  rusage usage{};
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0.0;
+  }
+  auto toSeconds = [](const timeval &tv) {
+    return static_cast<double>(tv.tv_sec) +
+           static_cast<double>(tv.tv_usec) / 1e6;
+  };
+  return toSeconds(usage.ru_utime) + toSeconds(usage.ru_stime);
+#endif
+}
+
+double percentile(const std::vector<int64_t> &sorted, double p) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  const double rank = p * static_cast<double>(sorted.size() - 1);
+  const std::size_t index = static_cast<std::size_t>(std::ceil(rank));
+  return static_cast<double>(sorted[std::min(index, sorted.size() - 1)]) /
+         1000.0;
+}
+
+void writeLatency(std::ostream &out, const LatencySummary &latency) {
+  out << "{\"p50\": " << latency.p50Us << ", \"p99\": " << latency.p99Us
+      << ", \"p999\": " << latency.p999Us
+      << ", \"samples\": " << latency.samples << "}";
+}
+
+std::string escapeJson(const std::string &value) {
+  std::string escaped;
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      escaped.push_back('\\');
+    }
+    escaped.push_back(c);
+  }
+  return escaped;
+}
+} // namespace
+
+// Every heap allocation in the process goes through here so scenarios can
+// report allocations per packet.
+void *operator new(std::size_t size) {
+  gAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+LinkConditions BenchOptions::link() const {
+  LinkConditions conditions;
+  conditions.latency = std::chrono::microseconds(
+      static_cast<int64_t>(latencyMs * 1000.0));
+  conditions.lossRate = lossRate;
+  if (burstLossRate > 0.0 && burstLossRate < 1.0 && burstLength >= 1.0) {
+    // Bursts average burstLength datagrams and cover burstLossRate of them.
+    conditions.burstExitRate = 1.0 / burstLength;
+    conditions.burstEnterRate =
+        burstLossRate * conditions.burstExitRate / (1.0 - burstLossRate);
+    conditions.burstLossRate = 1.0;
+  }
+  // The sender is paced by RateController, so the configured bandwidth is a
+  // router bottleneck it has to discover, with ~100 ms of buffering.
+  conditions.bottleneckBytesPerSec =
+      static_cast<uint64_t>(bandwidthMBps * 1024.0 * 1024.0);
+  conditions.bottleneckBufferBytes = std::max<std::size_t>(
+      64 * 1024, static_cast<std::size_t>(conditions.bottleneckBytesPerSec / 10));
+  return conditions;
+}
+
+void LatencyRecorder::record(std::chrono::nanoseconds rtt) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  samples_.push_back(rtt.count());
+}
+
+LatencySummary LatencyRecorder::summarize() const {
+  std::vector<int64_t> sorted;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sorted = samples_;
+  }
+  std::sort(sorted.begin(), sorted.end());
+  LatencySummary summary;
+  summary.samples = sorted.size();
+  summary.p50Us = percentile(sorted, 0.50);
+  summary.p99Us = percentile(sorted, 0.99);
+  summary.p999Us = percentile(sorted, 0.999);
+  return summary;
+}
+
+void LatencyRecorder::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  samples_.clear();
+}
+
+ResourceSample ResourceSample::now() {
+  ResourceSample sample;
+  sample.cpuSeconds = processCpuSeconds();
+  sample.allocations = gAllocations.load(std::memory_order_relaxed);
+  sample.wall = std::chrono::steady_clock::now();
+  return sample;
+}
+
+void applyResources(BenchResult &result, const ResourceSample &begin,
+                    const ResourceSample &end) {
+  result.seconds =
+      std::chrono::duration<double>(end.wall - begin.wall).count();
+  result.cpuSeconds = end.cpuSeconds - begin.cpuSeconds;
+  result.allocations = end.allocations - begin.allocations;
+}
+
+uint64_t nowNanos() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+const char *queuePolicyName(EgressQueue::Policy policy) {
+  switch (policy) {
+  case EgressQueue::Policy::TailDrop:
+    return "taildrop";
+  case EgressQueue::Policy::CoDel:
+    return "codel";
+  default:
+    return "fq_codel";
+  }
+}
+
+bool parseQueuePolicy(const std::string &name, EgressQueue::Policy &policy) {
+  for (auto candidate :
+       {EgressQueue::Policy::FqCoDel, EgressQueue::Policy::CoDel,
+        EgressQueue::Policy::TailDrop}) {
+    if (name == queuePolicyName(candidate)) {
+      policy = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+void writeJson(std::ostream &out, const BenchOptions &options,
+               const std::vector<BenchResult> &results) {
+  out << std::fixed << std::setprecision(3);
+  out << "{\n  \"link\": {\"latency_ms\": " << options.latencyMs
+      << ", \"loss\": " << options.lossRate
+      << ", \"burst_loss\": " << options.burstLossRate
+      << ", \"bandwidth_mbps\": " << options.bandwidthMBps
+      << "},\n  \"payload_bytes\": " << options.payloadBytes
+      << ",\n  \"compression\": " << (options.compression ? "true" : "false")
+      << ",\n  \"transport\": \""
+      << (options.udpTransport ? "udp" : "loopback") << "\""
+      << ",\n  \"fec\": " << (options.fec ? "true" : "false")
+      << ",\n  \"egress_queue\": \""
+      << queuePolicyName(options.queuePolicy) << "\""
+      << ",\n  \"results\": [";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const BenchResult &r = results[i];
+    const double mb = static_cast<double>(r.bytes) / (1024.0 * 1024.0);
+    const double seconds = r.seconds > 0.0 ? r.seconds : 1.0;
+    out << (i ? "," : "") << "\n    {\"scenario\": \"" << escapeJson(r.scenario)
+        << "\", \"ok\": " << (r.ok ? "true" : "false");
+    if (!r.ok) {
+      out << ", \"error\": \"" << escapeJson(r.error) << "\"}";
+      continue;
+    }
+    out << ", \"seconds\": " << r.seconds << ", \"bytes\": " << r.bytes
+        << ", \"packets\": " << r.packets
+        << ", \"lost_packets\": " << r.lostPackets
+        << ", \"mb_per_sec\": " << mb / seconds
+        << ", \"packets_per_sec\": "
+        << static_cast<double>(r.packets) / seconds
+        << ", \"cpu_ms_per_mb\": "
+        << (mb > 0.0 ? r.cpuSeconds * 1000.0 / mb : 0.0)
+        << ", \"allocs_per_packet\": "
+        << (r.packets ? static_cast<double>(r.allocations) /
+                            static_cast<double>(r.packets)
+                      : 0.0)
+        << ", \"latency_us\": ";
+    writeLatency(out, r.idleLatency);
+    out << ", \"loaded_latency_us\": ";
+    writeLatency(out, r.loadedLatency);
+    for (const auto &entry : r.extra) {
+      out << ", \"" << escapeJson(entry.first) << "\": " << entry.second;
+    }
+    out << "}";
+  }
+  out << "\n  ]\n}\n";
+}
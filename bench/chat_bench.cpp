@@ -0,0 +1,213 @@
+#include "bench.h"
+
+#include "chat_model.h"
+#include <QDateTime>
+#include <QString>
+#include <cstdlib>
+
+// Chat model: appends a stream of lobby chat to ChatModel the way a busy
+// lobby does, with a pinned message whose text the host keeps repeating (as
+// the ping broadcasts do), so the pin moves and its row scrolls out of the
+// buffer. A first pass checks, while the buffer wraps, that the rows views
+// rebuild from the model's signals hold the newest messages in order and
+// that the pin sits on the loaded message closest to the pinned one. The
+// timed pass builds its messages before the timer starts; the figures are
+// the model's own cost per append and how many rows it told views about.
+
+namespace {
+constexpr int kMessages = 100000;
+constexpr int kRows = 200; // ChatModel keeps the last 200 messages
+constexpr int kSenders = 8;
+constexpr int kRepeatEvery = 50; // every Nth message repeats the pinned text
+constexpr qint64 kMessageSpacingMs = 10;
+constexpr int kCheckEvery = 97; // appends between full checks
+
+// The row a view should show the pin on after messages [first, last) were
+// appended: the closest match to the pinned message, the older one on ties.
+int expectedPinnedRow(const std::vector<ChatModel::Entry> &messages,
+                      std::size_t first, std::size_t last,
+                      const ChatModel::Entry &pinned) {
+  int best = -1;
+  qint64 bestDistance = 0;
+  for (std::size_t i = first; i < last; ++i) {
+    const auto &entry = messages[i];
+    if (entry.steamId != pinned.steamId || entry.message != pinned.message) {
+      continue;
+    }
+    const qint64 distance =
+        std::llabs(pinned.timestamp.msecsTo(entry.timestamp));
+    if (best < 0 || distance < bestDistance) {
+      best = static_cast<int>(i - first);
+      bestDistance = distance;
+    }
+  }
+  return best;
+}
+
+// Row timestamps a view holds after replaying the model's row signals;
+// every message in the stream has its own timestamp.
+class RowMirror {
+public:
+  explicit RowMirror(ChatModel &model) : model_(model) {
+    QObject::connect(&model, &QAbstractItemModel::rowsInserted,
+                     [this](const QModelIndex &, int first, int last) {
+                       for (int row = first; row <= last; ++row) {
+                         rows_.insert(rows_.begin() + row, timestamp(row));
+                       }
+                     });
+    QObject::connect(&model, &QAbstractItemModel::rowsRemoved,
+                     [this](const QModelIndex &, int first, int last) {
+                       rows_.erase(rows_.begin() + first,
+                                   rows_.begin() + last + 1);
+                     });
+  }
+
+  // Checks rows, pin and mirror against messages [first, last).
+  bool matches(const std::vector<ChatModel::Entry> &messages,
+               std::size_t first, std::size_t last,
+               const ChatModel::Entry &pinned, std::string &error) const {
+    const std::size_t rows = last - first;
+    if (model_.rowCount() != static_cast<int>(rows) || rows_.size() != rows) {
+      error = "row count differs";
+      return false;
+    }
+    const int pinnedRow = expectedPinnedRow(messages, first, last, pinned);
+    for (std::size_t row = 0; row < rows; ++row) {
+      const auto &expected = messages[first + row];
+      const QModelIndex index = model_.index(static_cast<int>(row), 0);
+      if (model_.data(index, ChatModel::MessageRole).toString() !=
+              expected.message ||
+          model_.data(index, ChatModel::SteamIdRole).toString() !=
+              expected.steamId ||
+          timestamp(static_cast<int>(row)) !=
+              expected.timestamp.toMSecsSinceEpoch() ||
+          rows_[row] != expected.timestamp.toMSecsSinceEpoch()) {
+        error = "row " + std::to_string(row) + " holds the wrong message";
+        return false;
+      }
+      if (model_.data(index, ChatModel::IsPinnedRole).toBool() !=
+          (static_cast<int>(row) == pinnedRow)) {
+        error = "pin is not on row " + std::to_string(pinnedRow);
+        return false;
+      }
+    }
+    if (!model_.hasPinned() ||
+        model_.pinnedMessage().value(QStringLiteral("message")).toString() !=
+            pinned.message) {
+      error = "pinned message lost";
+      return false;
+    }
+    return true;
+  }
+
+private:
+  qint64 timestamp(int row) const {
+    return model_.data(model_.index(row, 0), ChatModel::TimestampRole)
+        .toDateTime()
+        .toMSecsSinceEpoch();
+  }
+
+  ChatModel &model_;
+  std::vector<qint64> rows_;
+};
+
+// Appends messages one by one and checks the model every kCheckEvery
+// appends, and after each append while the pinned message's own row and the
+// repeats closest to it scroll out.
+bool checkAppends(const std::vector<ChatModel::Entry> &messages,
+                  const ChatModel::Entry &pinned, std::string &error) {
+  ChatModel model;
+  model.setPinnedMessage(pinned);
+  RowMirror mirror(model);
+  const std::size_t pinnedAt = kMessages / 2;
+  for (std::size_t i = 0; i < messages.size(); ++i) {
+    model.appendMessage(messages[i]);
+    const std::size_t last = i + 1;
+    const bool nearPin =
+        last > pinnedAt && last <= pinnedAt + 2 * kRows + kRepeatEvery;
+    if (!nearPin && last % kCheckEvery != 0 && last != messages.size()) {
+      continue;
+    }
+    const std::size_t first = last > kRows ? last - kRows : 0;
+    if (!mirror.matches(messages, first, last, pinned, error)) {
+      error += " after " + std::to_string(last) + " messages";
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace
+
+BenchResult runChatBench(const BenchOptions &) {
+  BenchResult result;
+  result.scenario = "chat";
+
+  const qint64 baseMs = QDateTime::currentMSecsSinceEpoch();
+  const QString hostId = QStringLiteral("76561197960265741");
+  const QString pinnedText = QStringLiteral("ping 30ms via relay");
+
+  std::vector<ChatModel::Entry> messages;
+  messages.reserve(kMessages);
+  for (int i = 0; i < kMessages; ++i) {
+    ChatModel::Entry entry;
+    const bool repeat = i % kRepeatEvery == 0;
+    entry.steamId =
+        repeat ? hostId : QString::number(76561197960265742ULL + i % kSenders);
+    entry.displayName = QStringLiteral("player %1").arg(i % kSenders);
+    entry.message = repeat ? pinnedText : QStringLiteral("message %1").arg(i);
+    entry.timestamp =
+        QDateTime::fromMSecsSinceEpoch(baseMs + i * kMessageSpacingMs);
+    messages.push_back(std::move(entry));
+  }
+
+  ChatModel::Entry pinned;
+  pinned.steamId = hostId;
+  pinned.message = pinnedText;
+  pinned.timestamp = QDateTime::fromMSecsSinceEpoch(
+      baseMs + kMessages / 2 * kMessageSpacingMs);
+  if (!checkAppends(messages, pinned, result.error)) {
+    return result;
+  }
+
+  ChatModel model;
+  model.setPinnedMessage(pinned);
+
+  uint64_t insertedRows = 0;
+  uint64_t removedRows = 0;
+  uint64_t changedRows = 0;
+  QObject::connect(&model, &QAbstractItemModel::rowsInserted,
+                   [&](const QModelIndex &, int first, int last) {
+                     insertedRows += static_cast<uint64_t>(last - first + 1);
+                   });
+  QObject::connect(&model, &QAbstractItemModel::rowsRemoved,
+                   [&](const QModelIndex &, int first, int last) {
+                     removedRows += static_cast<uint64_t>(last - first + 1);
+                   });
+  QObject::connect(&model, &QAbstractItemModel::dataChanged,
+                   [&](const QModelIndex &top, const QModelIndex &bottom) {
+                     changedRows +=
+                         static_cast<uint64_t>(bottom.row() - top.row() + 1);
+                   });
+
+  const ResourceSample begin = ResourceSample::now();
+  for (auto &entry : messages) {
+    model.appendMessage(std::move(entry));
+  }
+  const ResourceSample end = ResourceSample::now();
+
+  applyResources(result, begin, end);
+  result.packets = kMessages;
+  result.extra.emplace_back("ns_per_append",
+                            result.seconds * 1e9 / kMessages);
+  result.extra.emplace_back("rows", model.count());
+  result.extra.emplace_back("rows_inserted",
+                            static_cast<double>(insertedRows));
+  result.extra.emplace_back("rows_removed", static_cast<double>(removedRows));
+  result.extra.emplace_back("rows_changed", static_cast<double>(changedRows));
+  result.ok = insertedRows == static_cast<uint64_t>(kMessages) &&
+              removedRows == static_cast<uint64_t>(kMessages - kRows);
+  if (!result.ok) {
+    result.error = "model reported other row counts than appended";
+  }
+  return result;
+}
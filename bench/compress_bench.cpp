@@ -0,0 +1,200 @@
+#include "bench.h"
+
+#include "../net/metrics.h"
+#include "../net/tunnel_compressor.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+
+// Tunnel compression: every corpus entry is streamed (repeatedly, up to 32 MB)
+// through one TunnelCompressor in 64 KB reads, the way MultiplexManager sees
+// a TCP client, with the link treated as the bottleneck. Each compressed block
+// is decoded again and checked. Per entry the scenario reports the wire/raw
+// ratio, the share of bytes that went out compressed (the rest was left raw
+// by the ratio check) and the encode+decode CPU cost per raw MB. --corpus DIR
+// replaces the built-in synthetic corpus with captured traffic, one file per
+// stream.
+
+namespace {
+constexpr std::size_t kReadBytes = 64 * 1024;
+constexpr std::size_t kSyntheticBytes = 4 * 1024 * 1024;
+// Each entry is streamed until this much has passed, so the ratio check gets
+// several windows (and a backoff) even on small captures.
+constexpr uint64_t kStreamBytes = 32 * 1024 * 1024;
+
+struct CorpusEntry {
+  std::string name;
+  std::vector<char> data;
+};
+
+std::vector<char> toBytes(const std::string &text) {
+  return std::vector<char>(text.begin(), text.end());
+}
+
+std::vector<CorpusEntry> syntheticCorpus(uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::vector<CorpusEntry> corpus;
+  const auto target = static_cast<std::streamoff>(kSyntheticBytes);
+
+  std::ostringstream json;
+  for (int tick = 0; json.tellp() < target; ++tick) {
+    json << "{\"tick\":" << tick << ",\"entities\":[";
+    for (int i = 0; i < 8; ++i) {
+      json << (i ? "," : "") << "{\"id\":" << i << ",\"x\":" << rng() % 4096
+           << ",\"y\":" << rng() % 4096 << ",\"hp\":" << rng() % 100
+           << ",\"state\":\"" << (rng() % 2 ? "idle" : "moving") << "\"}";
+    }
+    json << "]}\n";
+  }
+  corpus.push_back({"json", toBytes(json.str())});
+
+  static const char *const kWords[] = {"player", "joined", "left", "lobby",
+                                       "ready",  "map",    "mod",  "sync",
+                                       "chunk",  "ok",     "error", "retry"};
+  std::ostringstream text;
+  for (int line = 0; text.tellp() < target; ++line) {
+    text << "PRIVMSG #game :" << kWords[rng() % 12] << ' ' << kWords[rng() % 12]
+         << ' ' << line << "\r\n";
+  }
+  corpus.push_back({"text", toBytes(text.str())});
+
+  // Uncompressed RGBA texture: smooth gradients with a little noise.
+  std::vector<char> asset(kSyntheticBytes);
+  for (std::size_t i = 0; i + 4 <= asset.size(); i += 4) {
+    const std::size_t pixel = i / 4;
+    asset[i] = static_cast<char>(pixel % 1024 / 4);
+    asset[i + 1] = static_cast<char>(pixel / 1024 % 256);
+    asset[i + 2] = static_cast<char>(128 + rng() % 4);
+    asset[i + 3] = static_cast<char>(255);
+  }
+  corpus.push_back({"asset", std::move(asset)});
+
+  // Already compressed or encrypted payloads.
+  std::vector<char> random(kSyntheticBytes);
+  for (auto &byte : random) {
+    byte = static_cast<char>(rng());
+  }
+  corpus.push_back({"random", std::move(random)});
+  return corpus;
+}
+
+bool loadCorpus(const std::string &dir, std::vector<CorpusEntry> &corpus,
+                std::string &error) {
+  std::error_code ec;
+  for (const auto &entry : std::filesystem::directory_iterator(dir, ec)) {
+    if (!entry.is_regular_file()) {
+      continue;
+    }
+    std::ifstream file(entry.path(), std::ios::binary);
+    CorpusEntry item;
+    item.name = entry.path().filename().string();
+    item.data.assign(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+    if (!item.data.empty()) {
+      corpus.push_back(std::move(item));
+    }
+  }
+  if (ec) {
+    error = "cannot read corpus " + dir + ": " + ec.message();
+    return false;
+  }
+  if (corpus.empty()) {
+    error = "corpus " + dir + " has no files";
+    return false;
+  }
+  std::sort(corpus.begin(), corpus.end(),
+            [](const CorpusEntry &a, const CorpusEntry &b) {
+              return a.name < b.name;
+            });
+  return true;
+}
+
+std::string metricName(const std::string &name) {
+  std::string out;
+  for (const char c : name) {
+    out.push_back(std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+  }
+  return out;
+}
+} // namespace
+
+BenchResult runCompressBench(const BenchOptions &options) {
+  BenchResult result;
+  result.scenario = "compress";
+
+  std::vector<CorpusEntry> corpus;
+  if (options.corpusDir.empty()) {
+    corpus = syntheticCorpus(options.seed);
+  } else if (!loadCorpus(options.corpusDir, corpus, result.error)) {
+    return result;
+  }
+
+  const ResourceSample begin = ResourceSample::now();
+  uint64_t wireBytes = 0;
+  std::vector<char> encoded;
+  std::vector<char> decoded;
+
+  for (const auto &entry : corpus) {
+    TunnelCompressor compressor;
+    metrics::StreamMetrics encodeStats;
+    metrics::StreamMetrics decodeStats;
+    uint64_t raw = 0;
+    uint64_t wire = 0;
+    do {
+      for (std::size_t read = 0; read < entry.data.size(); read += kReadBytes) {
+        const std::size_t readEnd =
+            std::min(entry.data.size(), read + kReadBytes);
+        for (std::size_t offset = read; offset < readEnd;
+             offset += TunnelCompressor::kBlockBytes) {
+          const char *block = entry.data.data() + offset;
+          const std::size_t len =
+              std::min(TunnelCompressor::kBlockBytes, readEnd - offset);
+          raw += len;
+          result.packets++;
+          if (!compressor.encode(block, len, true, encoded, &encodeStats)) {
+            wire += len;
+            continue;
+          }
+          wire += encoded.size();
+          if (!TunnelCompressor::decode(encoded.data(), encoded.size(),
+                                        decoded, &decodeStats) ||
+              decoded.size() != len ||
+              std::memcmp(decoded.data(), block, len) != 0) {
+            result.error = "round trip mismatch in " + entry.name;
+            return result;
+          }
+        }
+      }
+    } while (raw < kStreamBytes);
+
+    result.bytes += raw;
+    wireBytes += wire;
+    const double mb = static_cast<double>(raw) / (1024.0 * 1024.0);
+    const double compressedMb =
+        static_cast<double>(encodeStats.compressedBytes.value()) /
+        (1024.0 * 1024.0);
+    const double cpuMs =
+        static_cast<double>(encodeStats.compressionNanos.value() +
+                            decodeStats.compressionNanos.value()) /
+        1e6;
+    const std::string key = metricName(entry.name);
+    result.extra.emplace_back(key + "_ratio",
+                              static_cast<double>(wire) /
+                                  static_cast<double>(raw));
+    result.extra.emplace_back(key + "_compressed_share", compressedMb / mb);
+    result.extra.emplace_back(key + "_cpu_ms_per_mb", cpuMs / mb);
+  }
+  const ResourceSample end = ResourceSample::now();
+
+  applyResources(result, begin, end);
+  result.extra.emplace_back("total_ratio",
+                            static_cast<double>(wireBytes) /
+                                static_cast<double>(result.bytes));
+  result.ok = result.bytes > 0;
+  return result;
+}
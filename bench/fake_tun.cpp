@@ -0,0 +1,104 @@
+#include "fake_tun.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+bool FakeTun::open(const std::string &deviceName, int mtu) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  name_ = deviceName;
+  mtu_ = mtu;
+  open_ = true;
+  return true;
+}
+
+void FakeTun::close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  open_ = false;
+  inbound_.clear();
+}
+
+bool FakeTun::is_open() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return open_;
+}
+
+int FakeTun::read(uint8_t *buffer, size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!open_) {
+    return -1;
+  }
+  if (inbound_.empty()) {
+    return 0;
+  }
+  std::vector<uint8_t> packet = std::move(inbound_.front());
+  inbound_.pop_front();
+  const size_t copied = std::min(size, packet.size());
+  std::memcpy(buffer, packet.data(), copied);
+  return static_cast<int>(copied);
+}
+
+int FakeTun::write(const uint8_t *buffer, size_t size) {
+  WriteHandler handler;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_) {
+      return -1;
+    }
+    handler = writeHandler_;
+  }
+  if (handler) {
+    handler(buffer, size);
+  }
+  return static_cast<int>(size);
+}
+
+size_t FakeTun::write_batch(const tun::PacketView *packets, size_t count) {
+  WriteHandler handler;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_) {
+      return 0;
+    }
+    handler = writeHandler_;
+  }
+  if (handler) {
+    for (size_t i = 0; i < count; ++i) {
+      handler(packets[i].data, packets[i].size);
+    }
+  }
+  return count;
+}
+
+bool FakeTun::set_ip(const std::string &ip, const std::string &) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ip_ = ip;
+  return true;
+}
+
+bool FakeTun::set_mtu(int mtu) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  mtu_ = mtu;
+  return true;
+}
+
+void FakeTun::inject(const uint8_t *data, size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (open_ && size <= static_cast<size_t>(mtu_)) {
+    inbound_.emplace_back(data, data + size);
+  }
+}
+
+std::size_t FakeTun::queuedPackets() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return inbound_.size();
+}
+
+void FakeTun::setWriteHandler(WriteHandler handler) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  writeHandler_ = std::move(handler);
+}
+
+std::string FakeTun::ip() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return ip_;
+}
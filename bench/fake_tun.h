@@ -0,0 +1,49 @@
+#pragma once
+
+#include "../tun/tun_interface.h"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// In-memory TUN device. inject() plays the OS handing a packet to the
+// device; whatever the bridge writes back is passed to the write handler.
+class FakeTun : public tun::TunInterface {
+public:
+  using WriteHandler = std::function<void(const uint8_t *data, size_t size)>;
+
+  bool open(const std::string &deviceName, int mtu) override;
+  void close() override;
+  bool is_open() const override;
+
+  int read(uint8_t *buffer, size_t size) override;
+  int write(const uint8_t *buffer, size_t size) override;
+  size_t write_batch(const tun::PacketView *packets, size_t count) override;
+
+  std::string get_device_name() const override { return name_; }
+  bool set_ip(const std::string &ip, const std::string &netmask) override;
+  bool add_route(const std::string &, const std::string &) override {
+    return true;
+  }
+  bool set_ipv6(const std::string &, int) override { return true; }
+  bool set_mtu(int mtu) override;
+  bool set_up(bool) override { return true; }
+  bool set_non_blocking(bool) override { return true; }
+  std::string get_last_error() const override { return {}; }
+
+  void inject(const uint8_t *data, size_t size);
+  std::size_t queuedPackets() const;
+  void setWriteHandler(WriteHandler handler);
+  std::string ip() const;
+
+private:
+  mutable std::mutex mutex_;
+  std::deque<std::vector<uint8_t>> inbound_;
+  WriteHandler writeHandler_;
+  std::string name_;
+  std::string ip_;
+  int mtu_ = 1500;
+  bool open_ = false;
+};
@@ -0,0 +1,86 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <string>
+
+// TUN forward error correction: the tun scenario is run with FEC off and on
+// over a link with random loss and over one whose loss arrives in bursts
+// (Gilbert-Elliott), and the round-trip delivery rates are compared. --loss
+// and --burst-loss override the defaults below; the reported figures are
+// per-condition delivery, packets rebuilt from parity and parity overhead,
+// while the result itself is the FEC run over random loss.
+
+namespace {
+constexpr double kDefaultLoss = 0.03;
+constexpr double kDefaultBurstLoss = 0.03;
+constexpr double kDefaultBurstLength = 3.0;
+constexpr int kMaxPingSamples = 100;
+// Paced like game traffic: a saturated link drops far more in its own queues
+// than the configured loss, and parity cannot help with that.
+constexpr double kDefaultPacketRate = 2000.0;
+
+double delivery(const BenchResult &result) {
+  const uint64_t sent = result.packets + result.lostPackets;
+  return sent > 0 ? static_cast<double>(result.packets) / sent : 0.0;
+}
+
+double extraValue(const BenchResult &result, const std::string &key) {
+  for (const auto &kv : result.extra) {
+    if (kv.first == key) {
+      return kv.second;
+    }
+  }
+  return 0.0;
+}
+} // namespace
+
+BenchResult runFecBench(const BenchOptions &options) {
+  BenchOptions base = options;
+  base.pingSamples = std::min(options.pingSamples, kMaxPingSamples);
+  if (base.packetRate <= 0.0) {
+    base.packetRate = kDefaultPacketRate;
+  }
+
+  BenchOptions random = base;
+  random.lossRate = options.lossRate > 0.0 ? options.lossRate : kDefaultLoss;
+  random.burstLossRate = 0.0;
+
+  BenchOptions burst = base;
+  burst.lossRate = 0.0;
+  burst.burstLossRate = options.burstLossRate > 0.0 ? options.burstLossRate
+                                                    : kDefaultBurstLoss;
+  if (options.burstLossRate <= 0.0) {
+    burst.burstLength = kDefaultBurstLength;
+  }
+
+  BenchResult result;
+  std::vector<std::pair<std::string, double>> extra;
+  const std::pair<const char *, BenchOptions *> conditions[] = {
+      {"random", &random}, {"burst", &burst}};
+  for (const auto &condition : conditions) {
+    const std::string name = condition.first;
+    BenchOptions plainOptions = *condition.second;
+    plainOptions.fec = false;
+    BenchOptions fecOptions = *condition.second;
+    fecOptions.fec = true;
+
+    const BenchResult plain = runTunBench(plainOptions);
+    const BenchResult protectedRun = runTunBench(fecOptions);
+    if (!plain.ok || !protectedRun.ok) {
+      result.error = name + ": " + (plain.ok ? protectedRun : plain).error;
+      return result;
+    }
+    extra.emplace_back(name + "_plain_delivery", delivery(plain));
+    extra.emplace_back(name + "_fec_delivery", delivery(protectedRun));
+    extra.emplace_back(name + "_recovered_packets",
+                       extraValue(protectedRun, "fec_recovered_packets"));
+    extra.emplace_back(name + "_overhead",
+                       extraValue(protectedRun, "fec_overhead"));
+    if (name == "random") {
+      result = protectedRun;
+    }
+  }
+  result.scenario = "fec";
+  result.extra = std::move(extra);
+  return result;
+}
@@ -0,0 +1,90 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+// Flow queuing: the tun scenario saturates a bottleneck with one bulk flow
+// while a paced game-like flow shares the same peer, once per egress queue
+// policy, and once more with the game port in the interactive traffic class
+// under plain CoDel ("codel_classes"): FQ-CoDel already isolates a sparse
+// flow, while a shared queue needs the class's lane to keep the game ahead.
+// The reported figures are the game flow's round trips and the bulk
+// throughput of each run; the result itself is the plain FQ-CoDel run.
+// --bandwidth and --game-rate override the defaults below.
+
+namespace {
+constexpr double kDefaultBandwidthMBps = 5.0;
+constexpr double kDefaultGameRate = 60.0;
+constexpr int kMaxPingSamples = 50;
+constexpr const char *kGameClassRule = "udp/27015=interactive";
+
+struct Run {
+  std::string name;
+  EgressQueue::Policy policy;
+  bool classes;
+};
+
+double extraValue(const BenchResult &result, const std::string &key) {
+  for (const auto &kv : result.extra) {
+    if (kv.first == key) {
+      return kv.second;
+    }
+  }
+  return 0.0;
+}
+} // namespace
+
+BenchResult runFqBench(const BenchOptions &options) {
+  BenchOptions base = options;
+  base.pingSamples = std::min(options.pingSamples, kMaxPingSamples);
+  if (base.bandwidthMBps <= 0.0) {
+    base.bandwidthMBps = kDefaultBandwidthMBps;
+  }
+  if (base.gameRate <= 0.0) {
+    base.gameRate = kDefaultGameRate;
+  }
+
+  BenchResult result;
+  std::vector<std::pair<std::string, double>> extra;
+  const Run runs[] = {
+      {queuePolicyName(EgressQueue::Policy::FqCoDel),
+       EgressQueue::Policy::FqCoDel, false},
+      {queuePolicyName(EgressQueue::Policy::CoDel),
+       EgressQueue::Policy::CoDel, false},
+      {queuePolicyName(EgressQueue::Policy::TailDrop),
+       EgressQueue::Policy::TailDrop, false},
+      {"codel_classes", EgressQueue::Policy::CoDel, true},
+  };
+  for (const Run &spec : runs) {
+    BenchOptions run = base;
+    run.queuePolicy = spec.policy;
+    if (spec.classes) {
+      run.trafficClasses = kGameClassRule;
+    }
+    const std::string &name = spec.name;
+    const BenchResult measured = runTunBench(run);
+    if (!measured.ok) {
+      result.error = name + ": " + measured.error;
+      return result;
+    }
+    extra.emplace_back(name + "_game_p50_us",
+                       extraValue(measured, "game_latency_p50_us"));
+    extra.emplace_back(name + "_game_p99_us",
+                       extraValue(measured, "game_latency_p99_us"));
+    extra.emplace_back(name + "_game_loss",
+                       extraValue(measured, "game_loss"));
+    extra.emplace_back(
+        name + "_bulk_mb_per_sec",
+        measured.seconds > 0.0
+            ? static_cast<double>(measured.bytes) / (1024.0 * 1024.0) /
+                  measured.seconds
+            : 0.0);
+    if (spec.policy == EgressQueue::Policy::FqCoDel) {
+      result = measured;
+    }
+  }
+  result.scenario = "fq";
+  result.extra = std::move(extra);
+  return result;
+}
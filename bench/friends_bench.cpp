@@ -0,0 +1,168 @@
+#include "bench.h"
+
+#include "friends_model.h"
+#include <QString>
+#include <QVariantList>
+#include <QVariantMap>
+#include <chrono>
+#include <random>
+
+// Friends model: feeds the same stream of persona changes to FriendsModel
+// the way the backend used to and the way it does now. The old schedule
+// rebuilt the list every 15 s: a QVariantList of every friend for the
+// friends property, compared with the previous one, then setFriends() over
+// the whole list. Now each changed friend reaches updateFriend(), with a
+// full setFriends() resync every 10 minutes. Each friend goes online or
+// offline once every 10 minutes. The Steam API calls that fetch friend info
+// are left out; the old schedule made them for every friend on each pass.
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr int kFriendCounts[] = {100, 500, 2000};
+constexpr int kPasses = 40; // 15 s rebuilds replayed per size
+constexpr double kRebuildsPerMinute = 4;   // every 15 s
+constexpr double kResyncsPerMinute = 0.1;  // every 10 minutes
+constexpr int kChangeEveryPasses = 40;     // 10 minutes of 15 s passes
+
+FriendsModel::Entry friendEntry(int n, bool online) {
+  FriendsModel::Entry entry;
+  entry.steamId = QString::number(76561197960265728ULL + n);
+  entry.displayName = QStringLiteral("friend %1").arg(n);
+  entry.online = online;
+  entry.status = online ? QStringLiteral("online") : QStringLiteral("offline");
+  entry.presenceRank = online ? 0 : 2;
+  return entry;
+}
+
+// The friends property the old rebuild compared on every pass.
+QVariantList variantList(const std::vector<FriendsModel::Entry> &list) {
+  QVariantList out;
+  out.reserve(static_cast<int>(list.size()));
+  for (const auto &entry : list) {
+    QVariantMap map;
+    map.insert(QStringLiteral("id"), entry.steamId);
+    map.insert(QStringLiteral("name"), entry.displayName);
+    map.insert(QStringLiteral("status"), entry.status);
+    map.insert(QStringLiteral("online"), entry.online);
+    map.insert(QStringLiteral("cooldown"), entry.inviteCooldown);
+    out.push_back(map);
+  }
+  return out;
+}
+
+double nsSince(Clock::time_point started, int ops) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - started)
+             .count() /
+         ops;
+}
+
+bool sameRows(const FriendsModel &a, const FriendsModel &b) {
+  if (a.rowCount() != b.rowCount()) {
+    return false;
+  }
+  for (int row = 0; row < a.rowCount(); ++row) {
+    if (a.data(a.index(row, 0), FriendsModel::SteamIdRole).toString() !=
+            b.data(b.index(row, 0), FriendsModel::SteamIdRole).toString() ||
+        a.data(a.index(row, 0), FriendsModel::OnlineRole).toBool() !=
+            b.data(b.index(row, 0), FriendsModel::OnlineRole).toBool()) {
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace
+
+BenchResult runFriendsBench(const BenchOptions &options) {
+  BenchResult result;
+  result.scenario = "friends";
+  std::mt19937 rng(options.seed);
+  result.ok = true;
+
+  const ResourceSample begin = ResourceSample::now();
+  for (const int friends : kFriendCounts) {
+    std::vector<FriendsModel::Entry> current;
+    for (int n = 0; n < friends; ++n) {
+      current.push_back(friendEntry(n, rng() % 3 == 0));
+    }
+    const std::vector<FriendsModel::Entry> initial = current;
+    const int changesPerPass = std::max(1, friends / kChangeEveryPasses);
+    std::vector<std::vector<FriendsModel::Entry>> passes;
+    std::vector<FriendsModel::Entry> updates;
+    for (int pass = 0; pass < kPasses; ++pass) {
+      for (int i = 0; i < changesPerPass; ++i) {
+        const int n = static_cast<int>(rng() % current.size());
+        current[n] = friendEntry(n, !current[n].online);
+        updates.push_back(current[n]);
+      }
+      passes.push_back(current);
+    }
+    std::vector<std::vector<FriendsModel::Entry>> resyncs(kPasses, current);
+
+    FriendsModel rebuilt;
+    rebuilt.setFriends(initial);
+    QVariantList property = variantList(initial);
+    auto started = Clock::now();
+    for (auto &list : passes) {
+      QVariantList updated = variantList(list);
+      if (updated != property) {
+        property = std::move(updated);
+      }
+      rebuilt.setFriends(std::move(list));
+    }
+    const double rebuildNs = nsSince(started, kPasses);
+
+    FriendsModel incremental;
+    incremental.setFriends(initial);
+    uint64_t rowsTouched = 0;
+    QObject::connect(&incremental, &QAbstractItemModel::dataChanged,
+                     [&](const QModelIndex &top, const QModelIndex &bottom) {
+                       rowsTouched += static_cast<uint64_t>(bottom.row() -
+                                                            top.row() + 1);
+                     });
+    QObject::connect(&incremental, &QAbstractItemModel::rowsMoved,
+                     [&](const QModelIndex &, int first, int last,
+                         const QModelIndex &, int) {
+                       rowsTouched += static_cast<uint64_t>(last - first + 1);
+                     });
+    started = Clock::now();
+    for (const auto &entry : updates) {
+      incremental.updateFriend(entry);
+    }
+    const double updateNs = nsSince(started, static_cast<int>(updates.size()));
+    const double rowsPerUpdate = static_cast<double>(rowsTouched) /
+                                 static_cast<double>(updates.size());
+    if (!sameRows(incremental, rebuilt)) {
+      result.ok = false;
+      result.error = "incremental rows differ from a rebuild with " +
+                     std::to_string(friends) + " friends";
+    }
+
+    started = Clock::now();
+    for (auto &list : resyncs) {
+      incremental.setFriends(std::move(list));
+    }
+    const double resyncNs = nsSince(started, kPasses);
+
+    const double updatesPerMinute =
+        static_cast<double>(changesPerPass) * kRebuildsPerMinute;
+    const std::string key = std::to_string(friends);
+    result.extra.emplace_back("ns_per_rebuild_" + key, rebuildNs);
+    result.extra.emplace_back("ns_per_update_" + key, updateNs);
+    result.extra.emplace_back("ns_per_resync_" + key, resyncNs);
+    result.extra.emplace_back("old_gui_ms_per_minute_" + key,
+                              rebuildNs * kRebuildsPerMinute / 1e6);
+    result.extra.emplace_back(
+        "new_gui_ms_per_minute_" + key,
+        (updateNs * updatesPerMinute + resyncNs * kResyncsPerMinute) / 1e6);
+    result.extra.emplace_back("old_rows_per_minute_" + key,
+                              friends * kRebuildsPerMinute);
+    result.extra.emplace_back("new_rows_per_minute_" + key,
+                              rowsPerUpdate * updatesPerMinute +
+                                  friends * kResyncsPerMinute);
+    result.packets += updates.size();
+  }
+  const ResourceSample end = ResourceSample::now();
+  applyResources(result, begin, end);
+  return result;
+}
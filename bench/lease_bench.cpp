@@ -0,0 +1,364 @@
+#include "bench.h"
+
+#include "../net/ip_negotiator.h"
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <set>
+#include <thread>
+
+// IP negotiation: a room with one settled member, which N peers join at
+// once. The IpNegotiators talk through an in-memory network with the
+// configured one-way latency; a joiner sends the settled member a packet as
+// soon as it has an address, and the time from joining to that packet
+// arriving is its time to first packet. Each room size runs twice: with the
+// probe alone (the settled member drops its lease offers, as an older build
+// would) and with lease offers. First, a settled member that has offered an
+// address must answer another node's probe for it as if it were taken.
+
+namespace {
+constexpr uint64_t kFirstSteamId = 76561197960265728ULL;
+constexpr uint32_t kBaseIP = 0x0A000000;     // 10.0.0.0, the bridge default
+constexpr uint32_t kSubnetMask = 0xFF000000; // 255.0.0.0
+constexpr int kJoinerCounts[] = {2, 8, 32};
+constexpr auto kRoomTimeout = std::chrono::seconds(30);
+constexpr auto kTick = std::chrono::milliseconds(1);
+
+using Clock = std::chrono::steady_clock;
+
+struct Message {
+  Clock::time_point due;
+  std::size_t from;
+  std::size_t to;
+  VpnMessageType type;
+  std::vector<uint8_t> payload;
+};
+
+struct Node {
+  CSteamID steamId;
+  IpNegotiator negotiator;
+  bool inRoom = false;
+  int claims = 0;
+  Clock::time_point joinedAt;
+  Clock::time_point firstPacketAt;
+  bool arrived = false;
+};
+
+class Room {
+public:
+  Room(std::size_t joiners, Clock::duration latency, bool offers)
+      : latency_(latency), offers_(offers) {
+    for (std::size_t i = 0; i <= joiners; ++i) {
+      auto node = std::make_unique<Node>();
+      node->steamId = CSteamID(static_cast<uint64>(kFirstSteamId + 1 + i));
+      node->negotiator.initialize(node->steamId, kBaseIP, kSubnetMask);
+      node->negotiator.setSendCallback(
+          [this, i](VpnMessageType type, const uint8_t *payload, size_t len,
+                    CSteamID target, bool) {
+            send(i, indexOf(target), type, payload, len);
+          },
+          [this, i](VpnMessageType type, const uint8_t *payload, size_t len,
+                    bool) {
+            for (std::size_t to = 0; to < nodes_.size(); ++to) {
+              if (to != i && nodes_[to]->inRoom) {
+                send(i, to, type, payload, len);
+              }
+            }
+          });
+      node->negotiator.setSuccessCallback([this, i](uint32_t, const NodeID &) {
+        // The first packet goes to the settled member.
+        if (nodes_[i]->claims++ == 0 && i != 0) {
+          send(i, 0, VpnMessageType::IP_PACKET, nullptr, 0);
+        }
+      });
+      nodes_.push_back(std::move(node));
+    }
+  }
+
+  // The settled member negotiates alone before anyone joins.
+  bool settle() {
+    nodes_[0]->inRoom = true;
+    nodes_[0]->negotiator.startNegotiation();
+    return run([this] { return nodes_[0]->claims > 0; });
+  }
+
+  bool join() {
+    const auto now = Clock::now();
+    for (std::size_t i = 1; i < nodes_.size(); ++i) {
+      nodes_[i]->inRoom = true;
+      nodes_[i]->joinedAt = now;
+    }
+    // What SteamVpnBridge::onUserJoined does on the settled member.
+    for (std::size_t i = 1; i < nodes_.size(); ++i) {
+      nodes_[0]->negotiator.sendAddressAnnounceTo(nodes_[i]->steamId);
+      nodes_[0]->negotiator.offerLeaseTo(nodes_[i]->steamId);
+    }
+    for (std::size_t i = 1; i < nodes_.size(); ++i) {
+      nodes_[i]->negotiator.startNegotiation();
+    }
+    return run([this] {
+      for (std::size_t i = 1; i < nodes_.size(); ++i) {
+        if (!nodes_[i]->arrived || nodes_[i]->negotiator.getState() !=
+                                       NegotiationState::STABLE) {
+          return false;
+        }
+      }
+      return inFlight_.empty();
+    });
+  }
+
+  // Milliseconds from joining to the first packet, one per joiner.
+  std::vector<double> firstPacketMs() const {
+    std::vector<double> times;
+    for (std::size_t i = 1; i < nodes_.size(); ++i) {
+      times.push_back(std::chrono::duration<double, std::milli>(
+                          nodes_[i]->firstPacketAt - nodes_[i]->joinedAt)
+                          .count());
+    }
+    return times;
+  }
+
+  // Addresses a joiner gave up after a conflict.
+  int reclaims() const {
+    int count = 0;
+    for (std::size_t i = 1; i < nodes_.size(); ++i) {
+      count += std::max(0, nodes_[i]->claims - 1);
+    }
+    return count;
+  }
+
+  bool distinctAddresses() const {
+    std::set<uint32_t> addresses;
+    for (const auto &node : nodes_) {
+      if (!addresses.insert(node->negotiator.getLocalIP()).second) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  std::size_t indexOf(CSteamID steamId) const {
+    return static_cast<std::size_t>(steamId.ConvertToUint64() -
+                                    kFirstSteamId - 1);
+  }
+
+  void send(std::size_t from, std::size_t to, VpnMessageType type,
+            const uint8_t *payload, size_t len) {
+    if (to >= nodes_.size() ||
+        (type == VpnMessageType::LEASE_OFFER && !offers_)) {
+      return;
+    }
+    Message message{Clock::now() + latency_, from, to, type, {}};
+    if (payload) {
+      message.payload.assign(payload, payload + len);
+    }
+    inFlight_.push_back(std::move(message));
+  }
+
+  template <typename T> static bool read(const Message &message, T &out) {
+    if (message.payload.size() < sizeof(T)) {
+      return false;
+    }
+    std::memcpy(&out, message.payload.data(), sizeof(T));
+    return true;
+  }
+
+  void deliver(const Message &message) {
+    Node &node = *nodes_[message.to];
+    const CSteamID sender = nodes_[message.from]->steamId;
+    switch (message.type) {
+    case VpnMessageType::PROBE_REQUEST: {
+      ProbeRequestPayload request{};
+      if (read(message, request)) {
+        node.negotiator.handleProbeRequest(request, sender);
+      }
+      break;
+    }
+    case VpnMessageType::PROBE_RESPONSE: {
+      ProbeResponsePayload response{};
+      if (read(message, response)) {
+        node.negotiator.handleProbeResponse(response, sender);
+      }
+      break;
+    }
+    case VpnMessageType::ADDRESS_ANNOUNCE: {
+      AddressAnnouncePayload announce{};
+      if (read(message, announce)) {
+        node.negotiator.handleAddressAnnounce(announce, sender, "");
+      }
+      break;
+    }
+    case VpnMessageType::FORCED_RELEASE: {
+      ForcedReleasePayload release{};
+      if (read(message, release)) {
+        node.negotiator.handleForcedRelease(release, sender);
+      }
+      break;
+    }
+    case VpnMessageType::LEASE_OFFER: {
+      LeaseOfferPayload offer{};
+      if (read(message, offer)) {
+        node.negotiator.handleLeaseOffer(offer, sender);
+      }
+      break;
+    }
+    case VpnMessageType::IP_PACKET: {
+      Node &origin = *nodes_[message.from];
+      if (!origin.arrived) {
+        origin.arrived = true;
+        origin.firstPacketAt = Clock::now();
+      }
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  template <typename Done> bool run(Done done) {
+    const auto deadline = Clock::now() + kRoomTimeout;
+    while (!done()) {
+      const auto now = Clock::now();
+      if (now >= deadline) {
+        return false;
+      }
+      // Every message has the same latency, so the queue is in due order.
+      while (!inFlight_.empty() && inFlight_.front().due <= now) {
+        const Message message = std::move(inFlight_.front());
+        inFlight_.pop_front();
+        deliver(message);
+      }
+      for (auto &node : nodes_) {
+        if (node->inRoom) {
+          node->negotiator.checkTimeout();
+        }
+      }
+      std::this_thread::sleep_for(kTick);
+    }
+    return true;
+  }
+
+  Clock::duration latency_;
+  bool offers_;
+  std::vector<std::unique_ptr<Node>> nodes_;
+  std::deque<Message> inFlight_;
+};
+
+bool checkReservedProbe(std::string &error) {
+  IpNegotiator settled;
+  settled.initialize(CSteamID(static_cast<uint64>(kFirstSteamId + 1)), kBaseIP,
+                     kSubnetMask);
+  std::vector<std::pair<VpnMessageType, std::vector<uint8_t>>> sent;
+  settled.setSendCallback(
+      [&sent](VpnMessageType type, const uint8_t *payload, size_t len,
+              CSteamID, bool) {
+        sent.emplace_back(type, std::vector<uint8_t>(payload, payload + len));
+      },
+      [](VpnMessageType, const uint8_t *, size_t, bool) {});
+  settled.startNegotiation();
+  const auto deadline = Clock::now() + kRoomTimeout;
+  while (settled.getState() != NegotiationState::STABLE) {
+    if (Clock::now() >= deadline) {
+      error = "reserved: settled member never got an address";
+      return false;
+    }
+    std::this_thread::sleep_for(kTick);
+    settled.checkTimeout();
+  }
+
+  const CSteamID offeree(static_cast<uint64>(kFirstSteamId + 2));
+  const CSteamID prober(static_cast<uint64>(kFirstSteamId + 3));
+  settled.offerLeaseTo(offeree);
+  LeaseOfferPayload offer{};
+  if (sent.empty() || sent.back().first != VpnMessageType::LEASE_OFFER) {
+    error = "reserved: no lease offer";
+    return false;
+  }
+  std::memcpy(&offer, sent.back().second.data(), sizeof(offer));
+
+  // Answered on the offeree's behalf when another node probes the address,
+  // not when the offeree probes it itself.
+  auto answered = [&](CSteamID from, NodeID &owner) {
+    sent.clear();
+    ProbeRequestPayload request{};
+    request.ipAddress = offer.ipAddress;
+    request.nodeId = NodeIdentity::generate(from);
+    settled.handleProbeRequest(request, from);
+    for (const auto &message : sent) {
+      ProbeResponsePayload response{};
+      if (message.first == VpnMessageType::PROBE_RESPONSE &&
+          message.second.size() >= sizeof(response)) {
+        std::memcpy(&response, message.second.data(), sizeof(response));
+        owner = response.nodeId;
+        return response.ipAddress == offer.ipAddress;
+      }
+    }
+    return false;
+  };
+  NodeID owner{};
+  if (!answered(prober, owner) ||
+      NodeIdentity::compare(owner, NodeIdentity::generate(offeree)) != 0) {
+    error = "reserved: probe for an offered address went unanswered";
+    return false;
+  }
+  if (answered(offeree, owner)) {
+    error = "reserved: offeree's own probe was answered";
+    return false;
+  }
+  return true;
+}
+
+double percentile(std::vector<double> values, double fraction) {
+  if (values.empty()) {
+    return 0.0;
+  }
+  std::sort(values.begin(), values.end());
+  const std::size_t index = std::min(
+      values.size() - 1, static_cast<std::size_t>(fraction * values.size()));
+  return values[index];
+}
+} // namespace
+
+BenchResult runLeaseBench(const BenchOptions &options) {
+  BenchResult result;
+  result.scenario = "lease";
+  const auto latency = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double, std::milli>(options.latencyMs));
+
+  if (!checkReservedProbe(result.error)) {
+    return result;
+  }
+
+  const ResourceSample begin = ResourceSample::now();
+  for (const bool offers : {false, true}) {
+    for (const int joiners : kJoinerCounts) {
+      const std::string key =
+          std::string(offers ? "lease_" : "probe_") + std::to_string(joiners);
+      Room room(static_cast<std::size_t>(joiners), latency, offers);
+      if (!room.settle()) {
+        result.error = key + ": settled member never got an address";
+        return result;
+      }
+      if (!room.join()) {
+        result.error = key + ": joiners did not settle in time";
+        return result;
+      }
+      if (!room.distinctAddresses()) {
+        result.error = key + ": two members share an address";
+        return result;
+      }
+      const std::vector<double> times = room.firstPacketMs();
+      result.packets += times.size();
+      result.extra.emplace_back(key + "_p50_ms", percentile(times, 0.5));
+      result.extra.emplace_back(key + "_max_ms", percentile(times, 1.0));
+      result.extra.emplace_back(key + "_reclaims", room.reclaims());
+    }
+  }
+  const ResourceSample end = ResourceSample::now();
+
+  applyResources(result, begin, end);
+  result.ok = true;
+  return result;
+}
@@ -0,0 +1,192 @@
+#include "bench.h"
+
+#include "members_model.h"
+#include <QString>
+#include <algorithm>
+#include <random>
+
+// Members model: first replays a few member lists through
+// MembersModel::setMembers, duplicate Steam IDs among them, and checks that
+// the rows views rebuild from the insert/remove/move signals match the
+// list. Then times the refresh a 64-member lobby sees every
+// kMembersUpdateInterval: pings jitter, traffic rates change, and now and
+// then someone leaves and someone else joins. Lists are built before the
+// timer starts, so the figures are the model's own cost.
+
+namespace {
+constexpr int kMembers = 64;
+constexpr int kRefreshes = 20000;
+constexpr int kChurnEvery = 100; // refreshes between a leave and a join
+constexpr int kRefreshesPerMinute = 120; // one per 500 ms
+
+QString memberId(int n) { return QString::number(76561197960265728ULL + n); }
+
+MembersModel::Entry member(int n) {
+  MembersModel::Entry entry;
+  entry.steamId = memberId(n);
+  entry.displayName = QStringLiteral("player %1").arg(n);
+  entry.relay = QStringLiteral("P2P");
+  entry.ping = 20 + n % 40;
+  return entry;
+}
+
+std::vector<MembersModel::Entry> members(std::initializer_list<int> ids) {
+  std::vector<MembersModel::Entry> list;
+  for (int n : ids) {
+    list.push_back(member(n));
+  }
+  return list;
+}
+
+// The row keys a view holds after replaying the model's row signals.
+class RowMirror {
+public:
+  explicit RowMirror(MembersModel &model) : model_(model) {
+    QObject::connect(&model, &QAbstractItemModel::rowsInserted,
+                     [this](const QModelIndex &, int first, int last) {
+                       for (int row = first; row <= last; ++row) {
+                         rows_.insert(rows_.begin() + row, key(row));
+                       }
+                     });
+    QObject::connect(&model, &QAbstractItemModel::rowsRemoved,
+                     [this](const QModelIndex &, int first, int last) {
+                       rows_.erase(rows_.begin() + first,
+                                   rows_.begin() + last + 1);
+                     });
+    QObject::connect(&model, &QAbstractItemModel::rowsMoved,
+                     [this](const QModelIndex &, int first, int last,
+                            const QModelIndex &, int destination) {
+                       std::vector<QString> moved(rows_.begin() + first,
+                                                  rows_.begin() + last + 1);
+                       rows_.erase(rows_.begin() + first,
+                                   rows_.begin() + last + 1);
+                       if (destination > last) {
+                         destination -= last - first + 1;
+                       }
+                       rows_.insert(rows_.begin() + destination,
+                                    moved.begin(), moved.end());
+                     });
+    QObject::connect(&model, &QAbstractItemModel::modelReset, [this]() {
+      rows_.clear();
+      for (int row = 0; row < model_.rowCount(); ++row) {
+        rows_.push_back(key(row));
+      }
+    });
+  }
+
+  // True when both the model and the mirrored rows list exactly `expected`.
+  bool matches(const std::vector<MembersModel::Entry> &expected) const {
+    if (model_.rowCount() != static_cast<int>(expected.size()) ||
+        rows_.size() != expected.size()) {
+      return false;
+    }
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+      if (key(static_cast<int>(i)) != expected[i].steamId ||
+          rows_[i] != expected[i].steamId) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  QString key(int row) const {
+    return model_.data(model_.index(row, 0), MembersModel::SteamIdRole)
+        .toString();
+  }
+
+  MembersModel &model_;
+  std::vector<QString> rows_;
+};
+
+// Lists with duplicate Steam IDs on either side of the diff, as a lobby
+// member list can briefly report while Steam catches up.
+bool checkDuplicateKeys(std::string &error) {
+  const std::vector<std::vector<MembersModel::Entry>> steps = {
+      members({1, 2, 3}),
+      members({1, 2, 1}),
+      members({1, 2}),
+      members({2, 2, 2, 1}),
+      members({1}),
+      members({3, 1, 3, 2}),
+      members({2, 3, 1}),
+      members({}),
+  };
+  MembersModel model;
+  RowMirror mirror(model);
+  for (std::size_t i = 0; i < steps.size(); ++i) {
+    model.setMembers(steps[i]);
+    if (!mirror.matches(steps[i])) {
+      error = "rows differ from the member list after step " +
+              std::to_string(i + 1);
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace
+
+BenchResult runMembersBench(const BenchOptions &options) {
+  BenchResult result;
+  result.scenario = "members";
+  if (!checkDuplicateKeys(result.error)) {
+    return result;
+  }
+
+  std::mt19937 rng(options.seed);
+  std::vector<std::vector<MembersModel::Entry>> refreshes;
+  refreshes.reserve(kRefreshes);
+  std::vector<MembersModel::Entry> current;
+  for (int n = 0; n < kMembers; ++n) {
+    current.push_back(member(n));
+  }
+  int nextMember = kMembers;
+  for (int i = 0; i < kRefreshes; ++i) {
+    if (i > 0 && i % kChurnEvery == 0) {
+      current.erase(current.begin() +
+                    static_cast<std::ptrdiff_t>(rng() % current.size()));
+      current.insert(current.begin() +
+                         static_cast<std::ptrdiff_t>(rng() % current.size()),
+                     member(nextMember++));
+    }
+    for (auto &entry : current) {
+      if (rng() % 4 == 0) {
+        entry.ping = 20 + static_cast<int>(rng() % 40);
+      }
+      entry.txRate = static_cast<qint64>(rng() % 200000);
+      entry.rxRate = static_cast<qint64>(rng() % 200000);
+    }
+    refreshes.push_back(current);
+  }
+
+  MembersModel model;
+  RowMirror mirror(model);
+  uint64_t changedRows = 0;
+  QObject::connect(&model, &QAbstractItemModel::dataChanged,
+                   [&](const QModelIndex &top, const QModelIndex &bottom) {
+                     changedRows +=
+                         static_cast<uint64_t>(bottom.row() - top.row() + 1);
+                   });
+
+  const std::vector<MembersModel::Entry> last = refreshes.back();
+  const ResourceSample begin = ResourceSample::now();
+  for (auto &list : refreshes) {
+    model.setMembers(std::move(list));
+  }
+  const ResourceSample end = ResourceSample::now();
+
+  applyResources(result, begin, end);
+  result.packets = kRefreshes;
+  const double nsPerRefresh = result.seconds * 1e9 / kRefreshes;
+  result.extra.emplace_back("members", kMembers);
+  result.extra.emplace_back("ns_per_refresh", nsPerRefresh);
+  result.extra.emplace_back("gui_ms_per_minute",
+                            nsPerRefresh * kRefreshesPerMinute / 1e6);
+  result.extra.emplace_back("rows_changed_per_refresh",
+                            static_cast<double>(changedRows) / kRefreshes);
+  result.ok = mirror.matches(last);
+  if (!result.ok) {
+    result.error = "rows differ from the last member list";
+  }
+  return result;
+}
@@ -0,0 +1,94 @@
+#include "bench.h"
+
+#include "../net/node_identity.h"
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+// Node IDs: what a ROUTE_UPDATE entry or a log line used to cost, per call.
+// derive is the SHA-256 a Steam ID not seen before pays; generate is the
+// cached lookup every later call gets; the hex figures compare toHex with
+// the ostringstream formatting it replaced, including heap allocations.
+
+namespace {
+constexpr int kSteamIds = 64;
+constexpr int kCalls = 1 << 18;
+constexpr uint64_t kFirstSteamId = 76561197960265728ULL;
+
+std::string streamHex(const NodeID &nodeId) {
+  std::ostringstream oss;
+  oss << std::hex << std::setfill('0');
+  for (std::size_t i = 0; i < 8; ++i) {
+    oss << std::setw(2) << static_cast<int>(nodeId[i]);
+  }
+  oss << "...";
+  return oss.str();
+}
+
+struct Timing {
+  double nsPerCall = 0.0;
+  double allocsPerCall = 0.0;
+};
+
+template <typename Fn> Timing measure(Fn fn) {
+  const ResourceSample begin = ResourceSample::now();
+  for (int i = 0; i < kCalls; ++i) {
+    fn(i);
+  }
+  const ResourceSample end = ResourceSample::now();
+  Timing timing;
+  timing.nsPerCall =
+      std::chrono::duration<double, std::nano>(end.wall - begin.wall).count() /
+      kCalls;
+  timing.allocsPerCall =
+      static_cast<double>(end.allocations - begin.allocations) / kCalls;
+  return timing;
+}
+} // namespace
+
+BenchResult runNodeIdBench(const BenchOptions &) {
+  BenchResult result;
+  result.scenario = "nodeid";
+
+  volatile uint8_t sink = 0;
+  const ResourceSample begin = ResourceSample::now();
+  const Timing derive = measure([&](int i) {
+    const uint64_t steamId = kFirstSteamId + static_cast<uint64_t>(i);
+    sink = NodeIdentity::derive(&steamId, sizeof(steamId))[0];
+  });
+  const Timing generate = measure([&](int i) {
+    const CSteamID steamId(
+        static_cast<uint64>(kFirstSteamId + i % kSteamIds));
+    sink = NodeIdentity::generate(steamId)[0];
+  });
+
+  const NodeID nodeId =
+      NodeIdentity::generate(CSteamID(static_cast<uint64>(kFirstSteamId)));
+  const std::string expected = streamHex(nodeId);
+  const std::string actual = NodeIdentity::toHex(nodeId).c_str();
+  if (actual != expected) {
+    result.error = "toHex gives " + actual + ", expected " + expected;
+    return result;
+  }
+  const uint64_t steamId64 = kFirstSteamId;
+  if (NodeIdentity::generate(CSteamID(static_cast<uint64>(kFirstSteamId))) !=
+      NodeIdentity::derive(&steamId64, sizeof(steamId64))) {
+    result.error = "cached node ID differs from a fresh one";
+    return result;
+  }
+  const Timing hex =
+      measure([&](int) { sink = NodeIdentity::toHex(nodeId).text[0]; });
+  const Timing stream = measure([&](int) { sink = streamHex(nodeId)[0]; });
+  const ResourceSample end = ResourceSample::now();
+
+  applyResources(result, begin, end);
+  result.packets = static_cast<uint64_t>(kCalls) * 4;
+  result.extra.emplace_back("derive_ns", derive.nsPerCall);
+  result.extra.emplace_back("generate_cached_ns", generate.nsPerCall);
+  result.extra.emplace_back("to_hex_ns", hex.nsPerCall);
+  result.extra.emplace_back("to_hex_allocs", hex.allocsPerCall);
+  result.extra.emplace_back("ostringstream_hex_ns", stream.nsPerCall);
+  result.extra.emplace_back("ostringstream_hex_allocs", stream.allocsPerCall);
+  result.ok = true;
+  return result;
+}
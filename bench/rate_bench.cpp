@@ -0,0 +1,151 @@
+#include "bench.h"
+
+#include "../net/rate_controller.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+// Rate control: one loopback connection whose router bottleneck changes
+// speed mid-run (base, base/4, base*2). A saturating sender is paced by
+// RateController exactly as SteamMessageHandler does; the scenario reports
+// how much of each phase's bottleneck it used, what got tail-dropped, and the
+// one-way delay (loaded_latency_us), which grows with the router queue.
+// Delivered bytes count towards the phase they were sent in: the router
+// serves what it already queued at the rate it had when the message entered,
+// so counting by arrival would credit the start of a slower phase with the
+// previous phase's queue.
+
+namespace {
+constexpr uint64_t kSenderSteamID = 76561197960265741ULL;
+constexpr uint64_t kReceiverSteamID = 76561197960265742ULL;
+constexpr double kDefaultBottleneckMBps = 8.0;
+constexpr double kPhaseScale[] = {1.0, 0.25, 2.0};
+constexpr std::size_t kPhaseCount = sizeof(kPhaseScale) / sizeof(kPhaseScale[0]);
+// Keep our own send queue short, like MultiplexManager's high-water mark, so
+// delay measured at the receiver is dominated by the router queue.
+constexpr int kSenderBacklogBytes = 64 * 1024;
+constexpr auto kDrainTime = std::chrono::milliseconds(500);
+
+LinkConditions phaseConditions(const BenchOptions &options,
+                               double bottleneckBytesPerSec) {
+  BenchOptions phase = options;
+  phase.bandwidthMBps = bottleneckBytesPerSec / (1024.0 * 1024.0);
+  return phase.link();
+}
+} // namespace
+
+BenchResult runRateBench(const BenchOptions &options) {
+  BenchResult result;
+  result.scenario = "rate";
+
+  LoopbackNetwork network;
+  network.setSeed(options.seed);
+  auto sender = network.createEndpoint(CSteamID(kSenderSteamID));
+  auto receiver = network.createEndpoint(CSteamID(kReceiverSteamID));
+  const auto conns = network.connect(*sender, *receiver);
+
+  const double baseBytesPerSec =
+      (options.bandwidthMBps > 0.0 ? options.bandwidthMBps
+                                   : kDefaultBottleneckMBps) *
+      1024.0 * 1024.0;
+  const auto phaseLength = std::chrono::duration_cast<
+      std::chrono::steady_clock::duration>(std::chrono::duration<double>(
+      options.durationSeconds / static_cast<double>(kPhaseCount)));
+  const std::size_t payloadBytes =
+      std::max(options.payloadBytes, sizeof(uint64_t));
+  std::vector<uint8_t> payload(payloadBytes, 0);
+
+  RateController controller;
+  sender->setConnectionSendRate(conns.first, controller.rate());
+
+  LatencyRecorder oneWay;
+  uint64_t sent = 0;
+  uint64_t phaseBytes[kPhaseCount] = {};
+  uint64_t phaseStarts[kPhaseCount] = {};
+  std::size_t phase = 0;
+  SteamNetworkingMessage_t *messages[256];
+
+  auto receive = [&]() {
+    const int count =
+        receiver->receiveMessagesOnConnection(conns.second, messages, 256);
+    const uint64_t now = nowNanos();
+    for (int i = 0; i < count; ++i) {
+      uint64_t stamp = 0;
+      std::memcpy(&stamp, messages[i]->m_pData, sizeof(stamp));
+      oneWay.record(std::chrono::nanoseconds(now - stamp));
+      result.bytes += static_cast<uint64_t>(messages[i]->m_cbSize);
+      result.packets++;
+      std::size_t sentIn = phase;
+      while (sentIn > 0 && stamp < phaseStarts[sentIn]) {
+        --sentIn;
+      }
+      phaseBytes[sentIn] += static_cast<uint64_t>(messages[i]->m_cbSize);
+      messages[i]->Release();
+    }
+  };
+
+  network.setConditions(CSteamID(kSenderSteamID), CSteamID(kReceiverSteamID),
+                        phaseConditions(options, baseBytesPerSec));
+  const ResourceSample begin = ResourceSample::now();
+  auto phaseEnd = begin.wall + phaseLength;
+  while (true) {
+    const auto now = std::chrono::steady_clock::now();
+    if (now >= phaseEnd) {
+      if (++phase == kPhaseCount) {
+        phase = kPhaseCount - 1;
+        break;
+      }
+      phaseEnd += phaseLength;
+      phaseStarts[phase] = nowNanos();
+      network.setConditions(
+          CSteamID(kSenderSteamID), CSteamID(kReceiverSteamID),
+          phaseConditions(options, baseBytesPerSec * kPhaseScale[phase]));
+    }
+
+    SteamNetConnectionRealTimeStatus_t status{};
+    sender->getConnectionRealTimeStatus(conns.first, &status);
+    int pending = status.m_cbPendingUnreliable;
+    while (pending < kSenderBacklogBytes) {
+      const uint64_t stamp = nowNanos();
+      std::memcpy(payload.data(), &stamp, sizeof(stamp));
+      if (sender->sendMessageToConnection(
+              conns.first, payload.data(),
+              static_cast<uint32>(payload.size()),
+              k_nSteamNetworkingSend_Unreliable, nullptr) != k_EResultOK) {
+        break;
+      }
+      pending += static_cast<int>(payload.size());
+      ++sent;
+    }
+    if (controller.update(status, now)) {
+      sender->setConnectionSendRate(conns.first, controller.rate());
+    }
+    receive();
+    std::this_thread::sleep_for(std::chrono::microseconds(500));
+  }
+  const auto drainUntil = std::chrono::steady_clock::now() + kDrainTime;
+  while (std::chrono::steady_clock::now() < drainUntil) {
+    receive();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  const ResourceSample end = ResourceSample::now();
+
+  applyResources(result, begin, end);
+  result.lostPackets = sent > result.packets ? sent - result.packets : 0;
+  result.loadedLatency = oneWay.summarize();
+  const double phaseSeconds =
+      std::chrono::duration<double>(phaseLength).count();
+  for (std::size_t i = 0; i < kPhaseCount; ++i) {
+    const double capacity = baseBytesPerSec * kPhaseScale[i] * phaseSeconds;
+    result.extra.emplace_back("phase" + std::to_string(i + 1) +
+                                  "_utilization",
+                              static_cast<double>(phaseBytes[i]) / capacity);
+  }
+  result.extra.emplace_back("final_rate_mbps",
+                            controller.rate() / (1024.0 * 1024.0));
+  result.ok = result.packets > 0;
+  if (!result.ok) {
+    result.error = "no messages crossed the link";
+  }
+  return result;
+}
@@ -0,0 +1,155 @@
+#include "bench.h"
+
+#include "../net/route_sync.h"
+#include <memory>
+
+// Route exchange: TUN peers join a room one at a time. Each join plays out
+// with RouteSync as SteamVpnBridge uses it: every settled peer announces
+// itself to the joiner and sends it a ROUTE_SYNC; the joiner and the settled
+// peers record the announces they hear, and everyone flushes its ROUTE_DELTA
+// once. After every join each peer's table must list the whole room. Next
+// to it are the ROUTE_UPDATE messages the old code sent for the same join:
+// the joiner and every settled peer broadcast the whole table for each new
+// route they heard of. Byte counts include the message header and leave out
+// the announces themselves, which both send.
+
+namespace {
+constexpr int kRoomSizes[] = {2, 8, 32, 64, 128};
+constexpr uint64_t kFirstSteamId = 76561197960265728ULL;
+constexpr uint32_t kFirstIP = 0x0A000001; // 10.0.0.1
+constexpr std::size_t kLegacyEntryBytes = 12;
+
+struct Traffic {
+  uint64_t messages = 0;
+  uint64_t bytes = 0;
+  uint64_t syncRequests = 0;
+
+  void add(std::size_t payloadBytes, uint64_t copies = 1) {
+    messages += copies;
+    bytes += copies * (sizeof(VpnMessageHeader) + payloadBytes);
+  }
+};
+
+struct Peer {
+  CSteamID steamId;
+  uint32_t ip = 0;
+  std::map<uint32_t, uint64_t> table; // stands in for routingTable_
+  RouteSync sync;
+
+  void updateRoute(uint64_t steamId, uint32_t ipAddress, bool share) {
+    table[ipAddress] = steamId;
+    sync.add(steamId, ipAddress, share);
+  }
+
+  void apply(const std::vector<RouteSync::Change> &changes) {
+    for (const auto &change : changes) {
+      if (change.removed) {
+        table.erase(change.ipAddress);
+        sync.remove(change.ipAddress, false);
+      } else if (!table.count(change.ipAddress)) {
+        updateRoute(change.steamId, change.ipAddress, false);
+      }
+    }
+  }
+};
+
+void sendSync(Peer &from, Peer &to, Traffic &traffic) {
+  for (const auto &part : from.sync.buildSync()) {
+    traffic.add(part.size());
+    std::vector<RouteSync::Change> changes;
+    to.sync.applySync(from.steamId, part.data(), part.size(), changes);
+    to.apply(changes);
+  }
+}
+
+void flush(std::vector<std::unique_ptr<Peer>> &room, Traffic &traffic) {
+  for (auto &from : room) {
+    for (const auto &delta : from->sync.takeDeltas()) {
+      for (auto &to : room) {
+        if (to == from) {
+          continue;
+        }
+        traffic.add(delta.size());
+        std::vector<RouteSync::Change> changes;
+        if (to->sync.applyDelta(from->steamId, delta.data(), delta.size(),
+                                changes) == RouteSync::Result::NeedSync) {
+          traffic.add(0);
+          ++traffic.syncRequests;
+          sendSync(*from, *to, traffic);
+        }
+        to->apply(changes);
+      }
+    }
+  }
+}
+
+// settled peers each know settled routes when the next peer joins.
+void legacyJoin(uint64_t settled, Traffic &traffic) {
+  // onUserJoined: each settled peer sends the joiner its table.
+  traffic.add(settled * kLegacyEntryBytes, settled);
+  // The joiner hears each settled peer's announce as a new route.
+  for (uint64_t known = 1; known <= settled; ++known) {
+    traffic.add(known * kLegacyEntryBytes, settled);
+  }
+  // The joiner gets its address, then every settled peer hears about it.
+  traffic.add((settled + 1) * kLegacyEntryBytes, settled);
+  traffic.add((settled + 1) * kLegacyEntryBytes, settled * settled);
+}
+} // namespace
+
+BenchResult runRouteBench(const BenchOptions &) {
+  BenchResult result;
+  result.scenario = "routes";
+
+  const ResourceSample begin = ResourceSample::now();
+  for (const int size : kRoomSizes) {
+    Traffic legacy;
+    Traffic versioned;
+    std::vector<std::unique_ptr<Peer>> room;
+    for (int j = 0; j < size; ++j) {
+      legacyJoin(static_cast<uint64_t>(j), legacy);
+
+      auto joiner = std::make_unique<Peer>();
+      joiner->steamId = CSteamID(static_cast<uint64>(kFirstSteamId + j));
+      joiner->ip = kFirstIP + static_cast<uint32_t>(j);
+      for (auto &peer : room) {
+        joiner->updateRoute(peer->steamId.ConvertToUint64(), peer->ip, true);
+        sendSync(*peer, *joiner, versioned);
+      }
+      joiner->updateRoute(joiner->steamId.ConvertToUint64(), joiner->ip, true);
+      for (auto &peer : room) {
+        peer->updateRoute(joiner->steamId.ConvertToUint64(), joiner->ip, true);
+      }
+      room.push_back(std::move(joiner));
+      flush(room, versioned);
+
+      for (const auto &peer : room) {
+        if (peer->table.size() != room.size() ||
+            peer->sync.size() != room.size()) {
+          result.error = "room of " + std::to_string(size) + ": peer " +
+                         std::to_string(peer->steamId.ConvertToUint64()) +
+                         " is missing routes";
+          return result;
+        }
+      }
+    }
+    const std::string key = std::to_string(size);
+    result.packets += versioned.messages;
+    result.bytes += versioned.bytes;
+    result.extra.emplace_back("legacy_bytes_" + key,
+                              static_cast<double>(legacy.bytes));
+    result.extra.emplace_back("delta_bytes_" + key,
+                              static_cast<double>(versioned.bytes));
+    result.extra.emplace_back("legacy_messages_" + key,
+                              static_cast<double>(legacy.messages));
+    result.extra.emplace_back("delta_messages_" + key,
+                              static_cast<double>(versioned.messages));
+    result.extra.emplace_back("sync_requests_" + key,
+                              static_cast<double>(versioned.syncRequests));
+  }
+  const ResourceSample end = ResourceSample::now();
+
+  applyResources(result, begin, end);
+  result.ok = true;
+  return result;
+}
@@ -0,0 +1,504 @@
+#include "bench.h"
+
+#include "../net/tcp_server.h"
+#include "../net/udp_transport.h"
+#include "../steam/steam_message_handler.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+
+// TCP mode: bench client -> TCPServer -> MultiplexManager -> loopback link ->
+// MultiplexManager (host) -> local echo server, and all the way back. With
+// --transport udp the link is a pair of UdpTransports on 127.0.0.1 whose
+// datagrams pass through a relay that applies the configured latency and
+// loss, so their retransmissions are exercised too.
+
+namespace {
+constexpr uint64_t kClientSteamID = 76561197960265729ULL;
+constexpr uint64_t kHostSteamID = 76561197960265730ULL;
+constexpr std::size_t kStampBytes = sizeof(uint64_t);
+// Stamp, then a sequence number; the rest is a pattern derived from it.
+constexpr std::size_t kHeaderBytes = kStampBytes + sizeof(uint64_t);
+// The writer stops this far ahead of the echo. TCPServer reads local clients
+// without backpressure, so on a slow link an unbounded writer would only
+// grow the tunnel queue and the time it takes to drain.
+constexpr std::size_t kMaxInFlightBytes = 16 * 1024 * 1024;
+
+// The client advertises telemetry on its tunnel, so host frames reach it
+// and the host counts no client as needing the lobby chat report.
+bool telemetryDelivered(SteamMessageHandler &host,
+                        SteamMessageHandler &client) {
+  telemetry::Member probe;
+  probe.steamId = kClientSteamID;
+  probe.pingMs = 42;
+  for (int attempt = 0; attempt < 100; ++attempt) {
+    host.broadcastTelemetry({probe});
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const auto latest = client.latestTelemetry();
+    if (latest && telemetry::find(*latest, kClientSteamID)) {
+      return host.legacyTelemetryPeers() == 0;
+    }
+  }
+  return false;
+}
+
+class EchoServer {
+public:
+  EchoServer() : acceptor_(io_) {
+    tcp::endpoint endpoint(boost::asio::ip::make_address("127.0.0.1"), 0);
+    acceptor_.open(endpoint.protocol());
+    acceptor_.bind(endpoint);
+    acceptor_.listen();
+    accept();
+    thread_ = std::thread([this]() { io_.run(); });
+  }
+
+  ~EchoServer() {
+    io_.stop();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  int port() const { return acceptor_.local_endpoint().port(); }
+
+private:
+  void accept() {
+    auto socket = std::make_shared<tcp::socket>(io_);
+    acceptor_.async_accept(*socket,
+                           [this, socket](const boost::system::error_code &ec) {
+                             if (!ec) {
+                               boost::system::error_code ignored;
+                               socket->set_option(tcp::no_delay(true), ignored);
+                               echo(socket,
+                                    std::make_shared<std::vector<char>>(65536));
+                             }
+                             accept();
+                           });
+  }
+
+  void echo(std::shared_ptr<tcp::socket> socket,
+            std::shared_ptr<std::vector<char>> buffer) {
+    socket->async_read_some(
+        boost::asio::buffer(*buffer),
+        [this, socket, buffer](const boost::system::error_code &ec,
+                               std::size_t n) {
+          if (ec) {
+            return;
+          }
+          boost::asio::async_write(
+              *socket, boost::asio::buffer(buffer->data(), n),
+              [this, socket, buffer](const boost::system::error_code &writeEc,
+                                     std::size_t) {
+                if (!writeEc) {
+                  echo(socket, buffer);
+                }
+              });
+        });
+  }
+
+  boost::asio::io_context io_;
+  tcp::acceptor acceptor_;
+  std::thread thread_;
+};
+
+// Runs an io_context on its own thread until destroyed.
+class IoThread {
+public:
+  IoThread() : work_(boost::asio::make_work_guard(io_)) {
+    thread_ = std::thread([this]() { io_.run(); });
+  }
+  ~IoThread() { stop(); }
+
+  void stop() {
+    io_.stop();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  boost::asio::io_context &context() { return io_; }
+
+private:
+  boost::asio::io_context io_;
+  boost::asio::executor_work_guard<boost::asio::io_context::executor_type>
+      work_;
+  std::thread thread_;
+};
+
+// Forwards UDP datagrams between local ports with the latency and random or
+// burst loss of a LinkConditions; bandwidth is not modelled. Like a NAT, each
+// side sees the other at the one relay port it sends to.
+class LossyRelay {
+public:
+  LossyRelay(const LinkConditions &link, uint32_t seed)
+      : link_(link), rng_(seed) {}
+  ~LossyRelay() { io_.stop(); }
+
+  // Links two ports on 127.0.0.1; returns the relay ports a sends to to
+  // reach b and b sends to to reach a.
+  std::pair<uint16_t, uint16_t> connect(uint16_t a, uint16_t b) {
+    Pipe *toB = open(b);
+    Pipe *toA = open(a);
+    toB->out = toA;
+    toA->out = toB;
+    return {toB->socket.local_endpoint().port(),
+            toA->socket.local_endpoint().port()};
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Pipe {
+    explicit Pipe(boost::asio::io_context &io)
+        : socket(io), timer(io), buffer(65536) {}
+    boost::asio::ip::udp::socket socket;
+    boost::asio::ip::udp::endpoint target;
+    boost::asio::ip::udp::endpoint sender;
+    boost::asio::steady_timer timer;
+    std::vector<uint8_t> buffer;
+    std::deque<std::pair<Clock::time_point, std::vector<uint8_t>>> queue;
+    bool bursting = false;
+    Pipe *out = nullptr; // sends what this pipe receives
+  };
+
+  // Opens a port on 127.0.0.1 whose datagrams go on to targetPort.
+  Pipe *open(uint16_t targetPort) {
+    using boost::asio::ip::udp;
+    const auto loopback = boost::asio::ip::make_address("127.0.0.1");
+    auto pipe = std::make_unique<Pipe>(io_.context());
+    pipe->socket.open(udp::v4());
+    pipe->socket.bind(udp::endpoint(loopback, 0));
+    pipe->target = udp::endpoint(loopback, targetPort);
+    Pipe *raw = pipe.get();
+    pipes_.push_back(std::move(pipe));
+    boost::asio::post(io_.context(), [this, raw]() { receive(*raw); });
+    return raw;
+  }
+
+  bool drop(Pipe &pipe) {
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    if (pipe.bursting) {
+      pipe.bursting = uniform(rng_) >= link_.burstExitRate;
+    } else {
+      pipe.bursting = uniform(rng_) < link_.burstEnterRate;
+    }
+    return (pipe.bursting && uniform(rng_) < link_.burstLossRate) ||
+           uniform(rng_) < link_.lossRate;
+  }
+
+  void receive(Pipe &pipe) {
+    pipe.socket.async_receive_from(
+        boost::asio::buffer(pipe.buffer), pipe.sender,
+        [this, &pipe](const boost::system::error_code &ec, std::size_t n) {
+          if (ec == boost::asio::error::operation_aborted) {
+            return;
+          }
+          if (!ec && !drop(pipe)) {
+            pipe.queue.emplace_back(
+                Clock::now() + link_.latency,
+                std::vector<uint8_t>(pipe.buffer.begin(),
+                                     pipe.buffer.begin() + n));
+            if (pipe.queue.size() == 1) {
+              schedule(pipe);
+            }
+          }
+          receive(pipe);
+        });
+  }
+
+  // The latency is fixed, so the queue is in due order.
+  void schedule(Pipe &pipe) {
+    pipe.timer.expires_at(pipe.queue.front().first);
+    pipe.timer.async_wait([this, &pipe](const boost::system::error_code &ec) {
+      if (ec) {
+        return;
+      }
+      const auto now = Clock::now();
+      while (!pipe.queue.empty() && pipe.queue.front().first <= now) {
+        boost::system::error_code ignored;
+        pipe.out->socket.send_to(
+            boost::asio::buffer(pipe.queue.front().second), pipe.target, 0,
+            ignored);
+        pipe.queue.pop_front();
+      }
+      if (!pipe.queue.empty()) {
+        schedule(pipe);
+      }
+    });
+  }
+
+  IoThread io_; // outlives the pipes' sockets; stopped in the destructor
+  LinkConditions link_;
+  std::mt19937 rng_;
+  std::vector<std::unique_ptr<Pipe>> pipes_;
+};
+
+bool readMessage(tcp::socket &socket, std::vector<char> &buffer) {
+  boost::system::error_code ec;
+  boost::asio::read(socket, boost::asio::buffer(buffer), ec);
+  return !ec;
+}
+
+void stamp(std::vector<char> &message) {
+  const uint64_t now = nowNanos();
+  std::memcpy(message.data(), &now, kStampBytes);
+}
+
+char patternByte(uint64_t sequence, std::size_t offset) {
+  // Runs of 64 equal bytes keep the stream compressible, and every tunnel
+  // chunk of a message differs from its neighbours.
+  return static_cast<char>('a' + (sequence + offset / 64) % 26);
+}
+
+void fill(std::vector<char> &message, uint64_t sequence) {
+  std::memcpy(message.data() + kStampBytes, &sequence, sizeof(sequence));
+  for (std::size_t i = kHeaderBytes; i < message.size(); ++i) {
+    message[i] = patternByte(sequence, i);
+  }
+}
+
+// True when an echoed message is the one sent as sequence, byte for byte.
+bool intact(const char *message, std::size_t size, uint64_t sequence) {
+  uint64_t echoed = 0;
+  std::memcpy(&echoed, message + kStampBytes, sizeof(echoed));
+  if (echoed != sequence) {
+    return false;
+  }
+  for (std::size_t i = kHeaderBytes; i < size; ++i) {
+    if (message[i] != patternByte(sequence, i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::chrono::nanoseconds age(const std::vector<char> &message) {
+  uint64_t sent = 0;
+  std::memcpy(&sent, message.data(), kStampBytes);
+  return std::chrono::nanoseconds(static_cast<int64_t>(nowNanos() - sent));
+}
+} // namespace
+
+BenchResult runTcpBench(const BenchOptions &options) {
+  BenchResult result;
+  result.scenario = "tcp";
+
+  LoopbackNetwork network;
+  std::unique_ptr<Transport> clientTransport;
+  std::unique_ptr<Transport> hostTransport;
+  std::unique_ptr<LossyRelay> relay;
+  UdpTransport *udpClient = nullptr;
+  UdpTransport *udpHost = nullptr;
+  std::pair<HSteamNetConnection, HSteamNetConnection> conns;
+  if (options.udpTransport) {
+    auto client = std::make_unique<UdpTransport>(CSteamID(kClientSteamID));
+    auto host = std::make_unique<UdpTransport>(CSteamID(kHostSteamID));
+    if (!client->open(0, "127.0.0.1") || !host->open(0, "127.0.0.1")) {
+      result.error = "failed to open UDP transports";
+      return result;
+    }
+    relay = std::make_unique<LossyRelay>(options.link(), options.seed);
+    const auto ports = relay->connect(client->localPort(), host->localPort());
+    conns.first =
+        client->addPeer(CSteamID(kHostSteamID), "127.0.0.1", ports.first);
+    conns.second =
+        host->addPeer(CSteamID(kClientSteamID), "127.0.0.1", ports.second);
+    udpClient = client.get();
+    udpHost = host.get();
+    clientTransport = std::move(client);
+    hostTransport = std::move(host);
+  } else {
+    network.setSeed(options.seed);
+    network.setDefaultConditions(options.link());
+    auto client = network.createEndpoint(CSteamID(kClientSteamID));
+    auto host = network.createEndpoint(CSteamID(kHostSteamID));
+    conns = network.connect(*client, *host);
+    clientTransport = std::move(client);
+    hostTransport = std::move(host);
+  }
+
+  EchoServer echo;
+  std::vector<HSteamNetConnection> clientConns{conns.first};
+  std::vector<HSteamNetConnection> hostConns{conns.second};
+  std::mutex clientConnsMutex;
+  std::mutex hostConnsMutex;
+  bool clientIsHost = false;
+  bool hostIsHost = true;
+  int clientLocalPort = 0;
+  int hostLocalPort = echo.port();
+
+  MultiplexManager::setCompressionEnabled(options.compression);
+  IoThread clientIo;
+  IoThread hostIo;
+  // Outlives the handlers: the client multiplexer's sockets live on the
+  // server's io_context, so the server must drop the last reference to it.
+  std::unique_ptr<TCPServer> server;
+  SteamMessageHandler clientHandler(clientIo.context(), clientTransport.get(),
+                                    clientConns, clientConnsMutex,
+                                    clientIsHost, clientLocalPort);
+  SteamMessageHandler hostHandler(hostIo.context(), hostTransport.get(),
+                                  hostConns, hostConnsMutex, hostIsHost,
+                                  hostLocalPort);
+  // Create the client-side multiplexer up front; the handler's map is not
+  // meant to be touched from the TCPServer thread.
+  auto clientMux = clientHandler.getMultiplexManager(conns.first);
+  struct StopIo {
+    IoThread &client;
+    IoThread &host;
+    ~StopIo() {
+      client.stop();
+      host.stop();
+    }
+  } stopIo{clientIo, hostIo};
+  boost::asio::post(clientIo.context(), [&]() { clientHandler.start(); });
+  boost::asio::post(hostIo.context(), [&]() { hostHandler.start(); });
+
+  server = std::make_unique<TCPServer>(options.tcpPort,
+                                       [clientMux]() { return clientMux; });
+  if (!server->start()) {
+    result.error = "failed to listen on port " + std::to_string(options.tcpPort);
+    return result;
+  }
+
+  boost::asio::io_context io;
+  tcp::socket socket(io);
+  boost::system::error_code ec;
+  socket.connect(tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"),
+                               static_cast<unsigned short>(options.tcpPort)),
+                 ec);
+  if (ec) {
+    result.error = "connect failed: " + ec.message();
+    return result;
+  }
+  socket.set_option(tcp::no_delay(true), ec);
+
+  const std::size_t messageSize = std::max(options.payloadBytes, kHeaderBytes);
+  std::vector<char> message(messageSize);
+  std::vector<char> reply(messageSize);
+
+  LatencyRecorder idle;
+  for (int i = 0; i < options.pingSamples; ++i) {
+    fill(message, static_cast<uint64_t>(i));
+    stamp(message);
+    boost::asio::write(socket, boost::asio::buffer(message), ec);
+    if (ec || !readMessage(socket, reply)) {
+      result.error = "echo failed during ping phase";
+      return result;
+    }
+    if (!intact(reply.data(), messageSize, static_cast<uint64_t>(i))) {
+      result.error = "ping " + std::to_string(i) + " came back corrupted";
+      return result;
+    }
+    idle.record(age(reply));
+  }
+  result.idleLatency = idle.summarize();
+
+  LatencyRecorder loaded;
+  std::atomic<bool> writing{true};
+  std::atomic<uint64_t> sent{0};
+  std::atomic<uint64_t> received{0};
+  const ResourceSample begin = ResourceSample::now();
+  std::thread writer([&]() {
+    std::vector<char> out(messageSize);
+    const auto deadline =
+        std::chrono::steady_clock::now() +
+        std::chrono::duration<double>(options.durationSeconds);
+    boost::system::error_code writeEc;
+    const uint64_t maxInFlight =
+        std::max<uint64_t>(1, kMaxInFlightBytes / messageSize);
+    while (std::chrono::steady_clock::now() < deadline) {
+      if (sent.load(std::memory_order_relaxed) -
+              received.load(std::memory_order_relaxed) >=
+          maxInFlight) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        continue;
+      }
+      fill(out, sent.load(std::memory_order_relaxed));
+      stamp(out);
+      boost::asio::write(socket, boost::asio::buffer(out), writeEc);
+      if (writeEc) {
+        break;
+      }
+      sent.fetch_add(1, std::memory_order_relaxed);
+    }
+    writing = false;
+  });
+
+  // Drain whatever has arrived instead of waiting for whole messages: small
+  // segments left unread keep the receive window shut.
+  std::vector<char> pending;
+  std::vector<char> chunk(64 * 1024);
+  const auto drainTimeout = std::chrono::seconds(10);
+  auto lastProgress = std::chrono::steady_clock::now();
+  bool corrupted = false;
+  while (!corrupted &&
+         (writing || received < sent.load(std::memory_order_relaxed))) {
+    const std::size_t available = socket.available(ec);
+    if (ec) {
+      break;
+    }
+    if (available == 0) {
+      if (std::chrono::steady_clock::now() - lastProgress > drainTimeout) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+      continue;
+    }
+    const std::size_t n = socket.read_some(
+        boost::asio::buffer(chunk.data(), std::min(available, chunk.size())),
+        ec);
+    if (ec) {
+      break;
+    }
+    pending.insert(pending.end(), chunk.begin(), chunk.begin() + n);
+    std::size_t offset = 0;
+    for (; pending.size() - offset >= messageSize; offset += messageSize) {
+      if (!intact(pending.data() + offset, messageSize, received)) {
+        corrupted = true;
+        break;
+      }
+      std::memcpy(reply.data(), pending.data() + offset, messageSize);
+      loaded.record(age(reply));
+      ++received;
+    }
+    pending.erase(pending.begin(), pending.begin() + offset);
+    lastProgress = std::chrono::steady_clock::now();
+  }
+  const ResourceSample end = ResourceSample::now();
+  if (writing) {
+    // The echo stalled or broke; unblock the writer's pending write.
+    socket.shutdown(tcp::socket::shutdown_both, ec);
+  }
+  writer.join();
+
+  applyResources(result, begin, end);
+  result.packets = received;
+  result.bytes = received * messageSize;
+  result.lostPackets = sent.load() - received;
+  result.loadedLatency = loaded.summarize();
+  if (udpClient && udpHost) {
+    result.extra.emplace_back(
+        "udp_retransmits",
+        static_cast<double>(udpClient->retransmits() + udpHost->retransmits()));
+  }
+  result.ok = received > 0 && !corrupted;
+  if (corrupted) {
+    result.error = "echoed message " + std::to_string(received.load()) +
+                   " is corrupted or out of order";
+  } else if (!result.ok) {
+    result.error = "no data echoed during throughput phase";
+  } else if (!telemetryDelivered(hostHandler, clientHandler)) {
+    result.ok = false;
+    result.error = "telemetry never reached the client";
+  }
+
+  socket.close(ec);
+  server->stop();
+  return result;
+}
@@ -0,0 +1,126 @@
+#include "bench.h"
+
+#include "../net/telemetry.h"
+#include <random>
+#include <string>
+
+// Member telemetry: a host with kMembers connections reports on them every
+// 2 s for kFrames frames. Pings drift by a few milliseconds, quality and
+// rates now and then, and members occasionally leave and rejoin. Every frame
+// is decoded and checked against what was sent. Reports the frame sizes next
+// to the "PING|id:ping:relay;..." lobby chat text the host used to send.
+
+namespace {
+constexpr int kMembers = 64;
+constexpr int kFrames = 150;
+constexpr uint64_t kFirstSteamId = 76561197960265728ULL;
+
+std::string legacyText(const telemetry::Snapshot &members) {
+  std::string text = "PING|";
+  for (const auto &member : members) {
+    if (text.size() > 5) {
+      text.push_back(';');
+    }
+    text += std::to_string(member.steamId) + ':' +
+            std::to_string(member.pingMs) + ':' +
+            (member.transport == telemetry::Transport::Relayed ? "中继"
+                                                               : "P2P");
+  }
+  return text;
+}
+} // namespace
+
+BenchResult runTelemetryBench(const BenchOptions &options) {
+  BenchResult result;
+  result.scenario = "telemetry";
+
+  std::mt19937 rng(options.seed);
+  std::uniform_int_distribution<int> percent(0, 99);
+  std::uniform_int_distribution<int> jitter(-3, 3);
+
+  telemetry::Snapshot members;
+  for (int i = 0; i < kMembers; ++i) {
+    telemetry::Member member;
+    member.steamId = kFirstSteamId + 1000 + static_cast<uint64_t>(i) * 7919;
+    member.pingMs = 20 + percent(rng);
+    member.quality = 90 + percent(rng) % 11;
+    member.transport = percent(rng) < 30 ? telemetry::Transport::Relayed
+                                         : telemetry::Transport::Direct;
+    member.txRate = static_cast<uint64_t>(percent(rng)) * 20 * 1024;
+    member.rxRate = static_cast<uint64_t>(percent(rng)) * 5 * 1024;
+    members.push_back(member);
+  }
+
+  telemetry::Encoder encoder;
+  telemetry::Decoder decoder;
+  uint64_t binaryBytes = 0;
+  uint64_t legacyBytes = 0;
+  uint64_t keyframeBytes = 0;
+  uint64_t keyframes = 0;
+  telemetry::Snapshot away;
+
+  const ResourceSample begin = ResourceSample::now();
+  for (int frame = 0; frame < kFrames; ++frame) {
+    for (auto &member : members) {
+      member.pingMs = std::max(1, member.pingMs + jitter(rng));
+      if (percent(rng) < 10) {
+        member.quality = 80 + percent(rng) % 21;
+      }
+      if (percent(rng) < 25) {
+        member.txRate = static_cast<uint64_t>(percent(rng)) * 20 * 1024;
+        member.rxRate = static_cast<uint64_t>(percent(rng)) * 5 * 1024;
+      }
+    }
+    if (percent(rng) < 10 && !members.empty()) {
+      away.push_back(members.back());
+      members.pop_back();
+    } else if (percent(rng) < 10 && !away.empty()) {
+      members.push_back(away.back());
+      away.pop_back();
+    }
+
+    const std::vector<uint8_t> bytes = encoder.encode(members);
+    binaryBytes += bytes.size();
+    legacyBytes += legacyText(members).size();
+    if (frame % telemetry::Encoder::kKeyframeInterval == 0) {
+      keyframeBytes += bytes.size();
+      ++keyframes;
+    }
+    if (!decoder.apply(bytes.data(), bytes.size())) {
+      result.error = "frame " + std::to_string(frame) + " did not decode";
+      return result;
+    }
+    for (const auto &member : members) {
+      const telemetry::Member *decoded =
+          telemetry::find(decoder.members(), member.steamId);
+      if (!decoded || decoded->pingMs != member.pingMs ||
+          decoded->quality != member.quality ||
+          decoded->transport != member.transport ||
+          decoded->txRate != member.txRate ||
+          decoded->rxRate != member.rxRate) {
+        result.error = "frame " + std::to_string(frame) + " decoded wrong";
+        return result;
+      }
+    }
+    if (decoder.members().size() != members.size()) {
+      result.error = "frame " + std::to_string(frame) + " kept departed members";
+      return result;
+    }
+    result.packets++;
+  }
+  const ResourceSample end = ResourceSample::now();
+
+  applyResources(result, begin, end);
+  result.bytes = binaryBytes;
+  result.extra.emplace_back("members", kMembers);
+  result.extra.emplace_back("bytes_per_frame",
+                            static_cast<double>(binaryBytes) / kFrames);
+  result.extra.emplace_back("keyframe_bytes",
+                            keyframes ? static_cast<double>(keyframeBytes) /
+                                            static_cast<double>(keyframes)
+                                      : 0.0);
+  result.extra.emplace_back("legacy_text_bytes_per_frame",
+                            static_cast<double>(legacyBytes) / kFrames);
+  result.ok = true;
+  return result;
+}
@@ -0,0 +1,355 @@
+#include "bench.h"
+
+#include "../steam/steam_vpn_bridge.h"
+#include "../steam/steam_vpn_networking_manager.h"
+#include "fake_tun.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+// TUN mode: packets injected into node A's fake TUN travel through its
+// SteamVpnBridge and the loopback link to node B, whose fake TUN reflects
+// them (source/destination swapped) back to A. With --game-rate a second,
+// paced flow of small packets on its own port runs next to the load and its
+// round trips are reported separately.
+
+namespace {
+constexpr uint64_t kNodeASteamID = 76561197960265731ULL;
+constexpr uint64_t kNodeBSteamID = 76561197960265732ULL;
+constexpr int kMtu = 1400;
+constexpr std::size_t kHeaderBytes = 20 + 8; // IPv4 + UDP
+constexpr std::size_t kStampOffset = kHeaderBytes;
+constexpr std::size_t kMaxQueuedInjections = 256;
+constexpr uint16_t kBulkPort = 9;
+constexpr uint16_t kGamePort = 27015;
+constexpr std::size_t kGamePayloadBytes = 480;
+constexpr auto kSetupTimeout = std::chrono::seconds(10);
+// Quiet period after the idle round trips, to see what an idle tunnel costs.
+constexpr auto kIdleWindow = std::chrono::seconds(1);
+
+uint32_t parseIp(const std::string &ip) {
+  in_addr addr{};
+  if (inet_pton(AF_INET, ip.c_str(), &addr) != 1) {
+    return 0;
+  }
+  return addr.s_addr; // network order, copied into headers as-is
+}
+
+std::vector<uint8_t> buildPacket(uint32_t src, uint32_t dst,
+                                 std::size_t payloadBytes, uint16_t port) {
+  std::vector<uint8_t> packet(kHeaderBytes + payloadBytes, 0);
+  const uint16_t totalLength = htons(static_cast<uint16_t>(packet.size()));
+  packet[0] = 0x45;
+  std::memcpy(&packet[2], &totalLength, 2);
+  packet[8] = 64;
+  packet[9] = 17;
+  std::memcpy(&packet[12], &src, 4);
+  std::memcpy(&packet[16], &dst, 4);
+  const uint16_t networkPort = htons(port);
+  std::memcpy(&packet[20], &networkPort, 2);
+  std::memcpy(&packet[22], &networkPort, 2);
+  const uint16_t udpLength = htons(static_cast<uint16_t>(8 + payloadBytes));
+  std::memcpy(&packet[24], &udpLength, 2);
+  return packet;
+}
+
+void stamp(std::vector<uint8_t> &packet) {
+  const uint64_t now = nowNanos();
+  std::memcpy(&packet[kStampOffset], &now, sizeof(now));
+}
+
+uint16_t destinationPort(const uint8_t *packet) {
+  uint16_t port = 0;
+  std::memcpy(&port, packet + 22, 2);
+  return ntohs(port);
+}
+
+std::chrono::nanoseconds age(const uint8_t *packet) {
+  uint64_t sent = 0;
+  std::memcpy(&sent, packet + kStampOffset, sizeof(sent));
+  return std::chrono::nanoseconds(static_cast<int64_t>(nowNanos() - sent));
+}
+
+struct Node {
+  explicit Node(SteamVpnNetworkingManager &manager) : bridge(&manager) {
+    bridge.setTunFactory([this]() {
+      auto device = std::make_unique<FakeTun>();
+      tun = device.get();
+      return device;
+    });
+  }
+
+  SteamVpnBridge bridge;
+  FakeTun *tun = nullptr;
+};
+
+bool waitForRoutes(const SteamVpnBridge &a, const SteamVpnBridge &b) {
+  const auto deadline = std::chrono::steady_clock::now() + kSetupTimeout;
+  while (std::chrono::steady_clock::now() < deadline) {
+    if (!a.getLocalIP().empty() && !b.getLocalIP().empty() &&
+        a.getRoutingTable().size() >= 2 && b.getRoutingTable().size() >= 2) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  return false;
+}
+} // namespace
+
+BenchResult runTunBench(const BenchOptions &options) {
+  BenchResult result;
+  result.scenario = "tun";
+
+  LoopbackNetwork network;
+  network.setSeed(options.seed);
+  network.setDefaultConditions(options.link());
+
+  SteamVpnNetworkingManager managerA;
+  SteamVpnNetworkingManager managerB;
+  managerA.initialize(network.createEndpoint(CSteamID(kNodeASteamID)));
+  managerB.initialize(network.createEndpoint(CSteamID(kNodeBSteamID)));
+  Node nodeA(managerA);
+  Node nodeB(managerB);
+  managerA.setVpnBridge(&nodeA.bridge);
+  managerB.setVpnBridge(&nodeB.bridge);
+  struct StopAll {
+    SteamVpnNetworkingManager &a;
+    SteamVpnNetworkingManager &b;
+    Node &nodeA;
+    Node &nodeB;
+    ~StopAll() {
+      a.stopMessageHandler();
+      b.stopMessageHandler();
+      nodeA.bridge.stop();
+      nodeB.bridge.stop();
+    }
+  } stopAll{managerA, managerB, nodeA, nodeB};
+
+  EgressQueue::Config egress;
+  egress.policy = options.queuePolicy;
+  managerA.setEgressQueueConfig(egress);
+  managerB.setEgressQueueConfig(egress);
+  nodeA.bridge.setFecEnabled(options.fec);
+  nodeB.bridge.setFecEnabled(options.fec);
+  TrafficClassifier classifier;
+  if (!classifier.addPortRules(options.trafficClasses)) {
+    result.error = "malformed --classes";
+    return result;
+  }
+  nodeA.bridge.setTrafficClassifier(classifier);
+  nodeB.bridge.setTrafficClassifier(classifier);
+  managerA.startMessageHandler();
+  managerB.startMessageHandler();
+  managerA.addPeer(CSteamID(kNodeBSteamID));
+  managerB.addPeer(CSteamID(kNodeASteamID));
+  if (!nodeA.bridge.start("bench-a", "10.0.0.0", "255.0.0.0", kMtu) ||
+      !nodeB.bridge.start("bench-b", "10.0.0.0", "255.0.0.0", kMtu)) {
+    result.error = "bridge failed to start";
+    return result;
+  }
+  if (!waitForRoutes(nodeA.bridge, nodeB.bridge)) {
+    result.error = "address negotiation did not converge";
+    return result;
+  }
+
+  FakeTun *tunA = nodeA.tun;
+  FakeTun *tunB = nodeB.tun;
+  tunB->setWriteHandler([tunB](const uint8_t *data, size_t size) {
+    if (size < kHeaderBytes) {
+      return;
+    }
+    std::vector<uint8_t> reflected(data, data + size);
+    std::swap_ranges(reflected.begin() + 12, reflected.begin() + 16,
+                     reflected.begin() + 16);
+    tunB->inject(reflected.data(), reflected.size());
+  });
+
+  std::mutex replyMutex;
+  std::condition_variable replyCv;
+  uint64_t replies = 0;
+  uint64_t replyBytes = 0;
+  LatencyRecorder idle;
+  LatencyRecorder loaded;
+  LatencyRecorder game;
+  std::atomic<uint64_t> gameReplies{0};
+  std::atomic<bool> loadPhase{false};
+  tunA->setWriteHandler([&](const uint8_t *data, size_t size) {
+    if (size < kStampOffset + sizeof(uint64_t)) {
+      return;
+    }
+    if (destinationPort(data) == kGamePort) {
+      game.record(age(data));
+      ++gameReplies;
+      return;
+    }
+    (loadPhase ? loaded : idle).record(age(data));
+    {
+      std::lock_guard<std::mutex> lock(replyMutex);
+      ++replies;
+      replyBytes += size;
+    }
+    replyCv.notify_all();
+  });
+
+  const std::size_t payloadBytes =
+      std::clamp(options.payloadBytes, sizeof(uint64_t),
+                 static_cast<std::size_t>(kMtu) - kHeaderBytes);
+  const uint32_t ipA = parseIp(nodeA.bridge.getLocalIP());
+  const uint32_t ipB = parseIp(nodeB.bridge.getLocalIP());
+  std::vector<uint8_t> packet = buildPacket(ipA, ipB, payloadBytes, kBulkPort);
+
+  const auto replyTimeout =
+      std::chrono::milliseconds(500) +
+      std::chrono::milliseconds(static_cast<int64_t>(options.latencyMs * 4));
+  for (int i = 0; i < options.pingSamples; ++i) {
+    uint64_t before = 0;
+    {
+      std::lock_guard<std::mutex> lock(replyMutex);
+      before = replies;
+    }
+    stamp(packet);
+    tunA->inject(packet.data(), packet.size());
+    std::unique_lock<std::mutex> lock(replyMutex);
+    replyCv.wait_for(lock, replyTimeout, [&]() { return replies > before; });
+  }
+  result.idleLatency = idle.summarize();
+
+  const ResourceSample idleBegin = ResourceSample::now();
+  std::this_thread::sleep_for(kIdleWindow);
+  const ResourceSample idleEnd = ResourceSample::now();
+  result.extra.emplace_back(
+      "idle_cpu_percent",
+      100.0 * (idleEnd.cpuSeconds - idleBegin.cpuSeconds) /
+          std::chrono::duration<double>(idleEnd.wall - idleBegin.wall)
+              .count());
+
+  {
+    std::lock_guard<std::mutex> lock(replyMutex);
+    replies = 0;
+    replyBytes = 0;
+  }
+  loadPhase = true;
+  uint64_t sent = 0;
+  const uint64_t recoveredBefore =
+      nodeA.bridge.getStatistics().packetsRecovered +
+      nodeB.bridge.getStatistics().packetsRecovered;
+  const uint64_t parityBefore = metrics::registry().fecParityPackets.value();
+  const auto peerB = metrics::registry().peer(kNodeBSteamID);
+  const auto queueDrops = [&peerB]() {
+    return peerB->drops[static_cast<std::size_t>(
+                            metrics::DropReason::QueueFull)]
+               .value() +
+           peerB->drops[static_cast<std::size_t>(
+                            metrics::DropReason::QueueDelay)]
+               .value();
+  };
+  const uint64_t queueDropsBefore = queueDrops();
+  const ResourceSample begin = ResourceSample::now();
+  const auto deadline = begin.wall + std::chrono::duration<double>(
+                                         options.durationSeconds);
+  const auto interval =
+      options.packetRate > 0.0
+          ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(1.0 / options.packetRate))
+          : std::chrono::steady_clock::duration::zero();
+  std::thread gameThread;
+  uint64_t gameSent = 0;
+  if (options.gameRate > 0.0) {
+    gameThread = std::thread([&]() {
+      std::vector<uint8_t> gamePacket =
+          buildPacket(ipA, ipB, kGamePayloadBytes, kGamePort);
+      const auto gameInterval =
+          std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+              std::chrono::duration<double>(1.0 / options.gameRate));
+      for (auto next = begin.wall; next < deadline; next += gameInterval) {
+        std::this_thread::sleep_until(next);
+        stamp(gamePacket);
+        tunA->inject(gamePacket.data(), gamePacket.size());
+        ++gameSent;
+      }
+    });
+  }
+  auto nextSend = begin.wall;
+  while (std::chrono::steady_clock::now() < deadline) {
+    if (tunA->queuedPackets() >= kMaxQueuedInjections) {
+      std::this_thread::sleep_for(std::chrono::microseconds(20));
+      continue;
+    }
+    if (interval.count() > 0) {
+      std::this_thread::sleep_until(nextSend);
+      nextSend += interval;
+    }
+    stamp(packet);
+    tunA->inject(packet.data(), packet.size());
+    ++sent;
+  }
+  if (gameThread.joinable()) {
+    gameThread.join();
+  }
+  {
+    std::unique_lock<std::mutex> lock(replyMutex);
+    replyCv.wait_for(lock, replyTimeout, [&]() { return replies >= sent; });
+  }
+  const ResourceSample end = ResourceSample::now();
+
+  applyResources(result, begin, end);
+  if (options.fec) {
+    const uint64_t recovered = nodeA.bridge.getStatistics().packetsRecovered +
+                               nodeB.bridge.getStatistics().packetsRecovered -
+                               recoveredBefore;
+    const uint64_t parity =
+        metrics::registry().fecParityPackets.value() - parityBefore;
+    result.extra.emplace_back("fec_recovered_packets",
+                              static_cast<double>(recovered));
+    // Parity packets per data packet over both directions.
+    result.extra.emplace_back(
+        "fec_overhead",
+        sent > 0 ? static_cast<double>(parity) / (2.0 * sent) : 0.0);
+  }
+  {
+    std::lock_guard<std::mutex> lock(replyMutex);
+    result.packets = replies;
+    result.bytes = replyBytes;
+  }
+  result.lostPackets = sent > result.packets ? sent - result.packets : 0;
+  result.loadedLatency = loaded.summarize();
+  // How long received messages sat in the transport before the VPN receiver
+  // took them, over the whole run; the price of parking instead of spinning.
+  const auto pickup = metrics::registry().pickupDelay.snapshot();
+  result.extra.emplace_back("rx_pickup_p50_us",
+                            static_cast<double>(pickup.percentile(0.5)));
+  result.extra.emplace_back("rx_pickup_p99_us",
+                            static_cast<double>(pickup.percentile(0.99)));
+  if (options.gameRate > 0.0) {
+    const LatencySummary gameLatency = game.summarize();
+    result.extra.emplace_back("game_latency_p50_us", gameLatency.p50Us);
+    result.extra.emplace_back("game_latency_p99_us", gameLatency.p99Us);
+    result.extra.emplace_back(
+        "game_loss", gameSent > 0 ? 1.0 - static_cast<double>(gameReplies) /
+                                              static_cast<double>(gameSent)
+                                  : 0.0);
+  }
+  // Node A's queue towards B, which the load phase fills.
+  const auto sojourn = peerB->egressSojourn.snapshot();
+  result.extra.emplace_back("egress_sojourn_p50_us",
+                            static_cast<double>(sojourn.percentile(0.5)));
+  result.extra.emplace_back("egress_sojourn_p99_us",
+                            static_cast<double>(sojourn.percentile(0.99)));
+  result.extra.emplace_back(
+      "egress_queue_drops",
+      static_cast<double>(queueDrops() - queueDropsBefore));
+  result.ok = result.packets > 0;
+  if (!result.ok) {
+    result.error = "no packets reflected during throughput phase";
+  }
+  return result;
+}
@@ -0,0 +1,158 @@
+#include "address_bitmap.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+constexpr uint64_t kAllSet = ~0ULL;
+
+// Index of the lowest set bit; bits must not be zero.
+uint32_t lowestBit(uint64_t bits) {
+#ifdef _MSC_VER
+  unsigned long index = 0;
+  _BitScanForward64(&index, bits);
+  return static_cast<uint32_t>(index);
+#else
+  return static_cast<uint32_t>(__builtin_ctzll(bits));
+#endif
+}
+
+// Bits at and above position `from` of a 64-bit word.
+uint64_t fromBit(uint32_t from) { return from >= 64 ? 0 : kAllSet << from; }
+} // namespace
+
+void AddressBitmap::resize(uint64_t size) {
+  size_ = size < kNone ? size : kNone;
+  leafCount_ = static_cast<uint32_t>((size_ + kLeafBits - 1) / kLeafBits);
+  leaves_.clear();
+  fullLeaves_.assign((leafCount_ + 63) / 64, 0);
+}
+
+void AddressBitmap::clear() {
+  leaves_.clear();
+  fullLeaves_.assign(fullLeaves_.size(), 0);
+}
+
+bool AddressBitmap::test(uint32_t index) const {
+  if (index >= size_) {
+    return false;
+  }
+  auto it = leaves_.find(index / kLeafBits);
+  if (it == leaves_.end()) {
+    return false;
+  }
+  const uint32_t bit = index % kLeafBits;
+  return (it->second.words[bit / 64] >> (bit % 64)) & 1;
+}
+
+void AddressBitmap::set(uint32_t index) {
+  if (index >= size_) {
+    return;
+  }
+  const uint32_t leafIndex = index / kLeafBits;
+  const uint32_t bit = index % kLeafBits;
+  Leaf &leaf = leaves_[leafIndex];
+  uint64_t &word = leaf.words[bit / 64];
+  const uint64_t mask = 1ULL << (bit % 64);
+  if (word & mask) {
+    return;
+  }
+  word |= mask;
+  ++leaf.count;
+  if (word == kAllSet) {
+    leaf.fullWords |= 1ULL << (bit / 64);
+  }
+  if (leaf.count == kLeafBits) {
+    fullLeaves_[leafIndex / 64] |= 1ULL << (leafIndex % 64);
+  }
+}
+
+void AddressBitmap::reset(uint32_t index) {
+  auto it = leaves_.find(index / kLeafBits);
+  if (index >= size_ || it == leaves_.end()) {
+    return;
+  }
+  const uint32_t leafIndex = it->first;
+  const uint32_t bit = index % kLeafBits;
+  Leaf &leaf = it->second;
+  uint64_t &word = leaf.words[bit / 64];
+  const uint64_t mask = 1ULL << (bit % 64);
+  if (!(word & mask)) {
+    return;
+  }
+  word &= ~mask;
+  leaf.fullWords &= ~(1ULL << (bit / 64));
+  fullLeaves_[leafIndex / 64] &= ~(1ULL << (leafIndex % 64));
+  if (--leaf.count == 0) {
+    leaves_.erase(it);
+  }
+}
+
+uint32_t AddressBitmap::nextClear(uint32_t from) const {
+  if (from >= size_) {
+    return kNone;
+  }
+  uint32_t leafIndex = from / kLeafBits;
+  auto it = leaves_.find(leafIndex);
+  if (it == leaves_.end()) {
+    return from;
+  }
+  const uint32_t bit = clearInLeaf(it->second, from % kLeafBits);
+  if (bit != kNone) {
+    return within(static_cast<uint64_t>(leafIndex) * kLeafBits + bit);
+  }
+  leafIndex = nextOpenLeaf(leafIndex + 1);
+  if (leafIndex == kNone) {
+    return kNone;
+  }
+  const uint64_t base = static_cast<uint64_t>(leafIndex) * kLeafBits;
+  it = leaves_.find(leafIndex);
+  // A leaf that is not full always has a clear bit.
+  return within(it == leaves_.end() ? base
+                                    : base + clearInLeaf(it->second, 0));
+}
+
+uint32_t AddressBitmap::firstSet() const {
+  if (leaves_.empty()) {
+    return kNone;
+  }
+  const auto &first = *leaves_.begin();
+  for (uint32_t w = 0; w < kLeafWords; ++w) {
+    if (first.second.words[w] != 0) {
+      return first.first * kLeafBits + w * 64 +
+             lowestBit(first.second.words[w]);
+    }
+  }
+  return kNone;
+}
+
+uint32_t AddressBitmap::clearInLeaf(const Leaf &leaf, uint32_t bit) {
+  uint32_t word = bit / 64;
+  const uint64_t open = ~leaf.words[word] & fromBit(bit % 64);
+  if (open != 0) {
+    return word * 64 + lowestBit(open);
+  }
+  const uint64_t openWords = ~leaf.fullWords & fromBit(word + 1);
+  if (openWords == 0) {
+    return kNone;
+  }
+  word = lowestBit(openWords);
+  return word * 64 + lowestBit(~leaf.words[word]);
+}
+
+uint32_t AddressBitmap::nextOpenLeaf(uint32_t from) const {
+  for (uint32_t word = from / 64; word < fullLeaves_.size(); ++word) {
+    const uint64_t open =
+        ~fullLeaves_[word] & (word == from / 64 ? fromBit(from % 64) : kAllSet);
+    if (open != 0) {
+      const uint32_t leafIndex = word * 64 + lowestBit(open);
+      return leafIndex < leafCount_ ? leafIndex : kNone;
+    }
+  }
+  return kNone;
+}
+
+uint32_t AddressBitmap::within(uint64_t index) const {
+  return index < size_ ? static_cast<uint32_t>(index) : kNone;
+}
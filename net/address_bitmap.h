@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Set of host numbers in [0, size) with cheap "next free" lookups, for
+// subnets as large as a /8. Bits live in leaves of 4096 that are allocated
+// on first use and dropped once they empty again; each leaf keeps a bit per
+// word that is full, and the bitmap a bit per leaf that is full, so a search
+// steps over a full word, leaf or run of 64 leaves at a time.
+class AddressBitmap {
+public:
+  static constexpr uint32_t kNone = UINT32_MAX;
+
+  // Empties the set; sizes above kNone are clamped.
+  void resize(uint64_t size);
+  void clear();
+  uint64_t size() const { return size_; }
+  bool empty() const { return leaves_.empty(); }
+
+  bool test(uint32_t index) const;
+  void set(uint32_t index);
+  void reset(uint32_t index);
+
+  // First index >= from that is not set, or kNone.
+  uint32_t nextClear(uint32_t from) const;
+  // Lowest index that is set, or kNone.
+  uint32_t firstSet() const;
+
+private:
+  static constexpr uint32_t kLeafBits = 4096;
+  static constexpr uint32_t kLeafWords = kLeafBits / 64;
+
+  struct Leaf {
+    uint64_t words[kLeafWords] = {};
+    uint64_t fullWords = 0;
+    uint32_t count = 0;
+  };
+
+  static uint32_t clearInLeaf(const Leaf &leaf, uint32_t bit);
+  uint32_t nextOpenLeaf(uint32_t from) const;
+  uint32_t within(uint64_t index) const;
+
+  uint64_t size_ = 0;
+  uint32_t leafCount_ = 0;
+  std::map<uint32_t, Leaf> leaves_;
+  std::vector<uint64_t> fullLeaves_;
+};
@@ -0,0 +1,56 @@
+#include "codel.h"
+#include <cmath>
+
+bool CoDel::shouldDrop(Clock::duration sojourn, std::size_t backlogBytes,
+                       Clock::time_point now) {
+  const bool okToDrop = aboveTarget(sojourn, backlogBytes, now);
+  if (dropping_) {
+    if (!okToDrop) {
+      dropping_ = false;
+      return false;
+    }
+    if (now < dropNext_) {
+      return false;
+    }
+    ++count_;
+    dropNext_ = controlLaw(dropNext_);
+    return true;
+  }
+  if (!okToDrop) {
+    return false;
+  }
+  // Coming back soon after the last dropping state means the drop rate that
+  // ended it was about right; resume near it instead of starting over.
+  dropping_ = true;
+  const uint32_t delta = count_ - lastCount_;
+  count_ = delta > 1 && now - dropNext_ < 16 * config_.interval ? delta : 1;
+  dropNext_ = controlLaw(now);
+  lastCount_ = count_;
+  return true;
+}
+
+void CoDel::reset() {
+  firstAboveTime_ = Clock::time_point{};
+  dropNext_ = Clock::time_point{};
+  count_ = 0;
+  lastCount_ = 0;
+  dropping_ = false;
+}
+
+bool CoDel::aboveTarget(Clock::duration sojourn, std::size_t backlogBytes,
+                        Clock::time_point now) {
+  if (sojourn < config_.target || backlogBytes <= config_.minBacklogBytes) {
+    firstAboveTime_ = Clock::time_point{};
+    return false;
+  }
+  if (firstAboveTime_ == Clock::time_point{}) {
+    firstAboveTime_ = now + config_.interval;
+    return false;
+  }
+  return now >= firstAboveTime_;
+}
+
+CoDel::Clock::time_point CoDel::controlLaw(Clock::time_point from) const {
+  return from + std::chrono::duration_cast<Clock::duration>(
+                    config_.interval / std::sqrt(static_cast<double>(count_)));
+}
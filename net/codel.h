@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// CoDel active queue management (RFC 8289) for one queue. It watches how long
+// packets waited rather than how many are queued: once every packet leaving
+// the queue has waited longer than target for a whole interval, it drops one
+// and then drops again at intervals shrinking with 1/sqrt(count) until the
+// delay is back under target. Short bursts pass untouched, a standing queue
+// is drained to about target.
+class CoDel {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Config {
+    Clock::duration target = std::chrono::milliseconds(5);
+    Clock::duration interval = std::chrono::milliseconds(100);
+    // A queue holding no more than this is never drained further.
+    std::size_t minBacklogBytes = 1500;
+  };
+
+  CoDel() = default;
+  explicit CoDel(const Config &config) : config_(config) {}
+
+  // Call for every packet taken off the queue, with how long it waited and
+  // the bytes left behind it; true means drop it and look at the next one.
+  bool shouldDrop(Clock::duration sojourn, std::size_t backlogBytes,
+                  Clock::time_point now);
+  void reset();
+
+  bool dropping() const { return dropping_; }
+
+private:
+  bool aboveTarget(Clock::duration sojourn, std::size_t backlogBytes,
+                   Clock::time_point now);
+  Clock::time_point controlLaw(Clock::time_point from) const;
+
+  Config config_;
+  Clock::time_point firstAboveTime_{};
+  Clock::time_point dropNext_{};
+  uint32_t count_ = 0;
+  uint32_t lastCount_ = 0;
+  bool dropping_ = false;
+};
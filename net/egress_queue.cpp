@@ -0,0 +1,256 @@
+#include "egress_queue.h"
+#include <algorithm>
+#include <initializer_list>
+
+EgressQueue::EgressQueue(const Config &config) : config_(config) {
+  const std::size_t count = std::max<std::size_t>(config.lanes.size(), 1);
+  lanes_.resize(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    Lane &lane = lanes_[i];
+    if (i < config.lanes.size()) {
+      lane.config = config.lanes[i];
+      lane.config.weight = std::max(lane.config.weight, 1);
+    }
+    lane.priority.codel = CoDel(config.codel);
+    lane.bulk.codel = CoDel(config.codel);
+    if (config.policy == Policy::FqCoDel) {
+      lane.flows = std::make_unique<FlowQueue>(config.codel);
+    }
+    order_.push_back(i);
+  }
+  std::stable_sort(order_.begin(), order_.end(),
+                   [this](std::size_t a, std::size_t b) {
+                     return lanes_[a].config.priority <
+                            lanes_[b].config.priority;
+                   });
+}
+
+bool EgressQueue::full(std::size_t extra) const {
+  return packets_ + (extra ? 1 : 0) > config_.maxPackets ||
+         bytes_ + extra > config_.maxBytes;
+}
+
+EgressQueue::Lane *EgressQueue::victim(int priority) {
+  for (auto it = order_.rbegin(); it != order_.rend(); ++it) {
+    Lane &lane = lanes_[*it];
+    if (lane.config.priority <= priority) {
+      break;
+    }
+    if (lane.packets > 0) {
+      return &lane;
+    }
+  }
+  return nullptr;
+}
+
+void EgressQueue::dropOldest(Lane &lane) {
+  if (lane.flows) {
+    lane.flows->dropFattest();
+    settle(lane);
+  } else {
+    Band &band = lane.bulk.packets.empty() ? lane.priority : lane.bulk;
+    if (band.packets.empty()) {
+      return;
+    }
+    const std::size_t size = band.packets.front().data.size();
+    if (lane.current == &band) {
+      lane.current = nullptr;
+    }
+    band.packets.pop_front();
+    band.bytes -= size;
+    --lane.packets;
+    lane.bytes -= size;
+    --packets_;
+    bytes_ -= size;
+  }
+  ++lane.tailDrops;
+}
+
+void EgressQueue::settle(Lane &lane) {
+  packets_ = packets_ - lane.packets + lane.flows->packets();
+  bytes_ = bytes_ - lane.bytes + lane.flows->bytes();
+  lane.packets = lane.flows->packets();
+  lane.bytes = lane.flows->bytes();
+  lane.aqmDrops = lane.flows->aqmDrops();
+}
+
+bool EgressQueue::push(const void *data, std::size_t size, int flags,
+                       Clock::time_point now, uint32_t flowHash,
+                       std::size_t lane) {
+  haveCurrent_ = false;
+  Lane &target = lanes_[std::min(lane, lanes_.size() - 1)];
+  while (full(size)) {
+    Lane *other = victim(target.config.priority);
+    if (!other) {
+      break;
+    }
+    dropOldest(*other);
+  }
+
+  if (target.flows) {
+    target.flows->push(flowHash, data, size, flags, now);
+    settle(target);
+    while (full(0) && target.packets > 0) {
+      dropOldest(target);
+    }
+    return true;
+  }
+  if (full(size)) {
+    ++target.tailDrops;
+    return false;
+  }
+  Band &band = size <= config_.priorityBytes ? target.priority : target.bulk;
+  band.packets.push_back(Packet{PacketBuffer(data, size), flags, now});
+  band.bytes += size;
+  ++target.packets;
+  target.bytes += size;
+  ++packets_;
+  bytes_ += size;
+  return true;
+}
+
+EgressQueue::Lane *EgressQueue::nextLane() {
+  auto begin = std::find_if(order_.begin(), order_.end(),
+                            [this](std::size_t i) {
+                              return lanes_[i].packets > 0;
+                            });
+  if (begin == order_.end()) {
+    return nullptr;
+  }
+  const int priority = lanes_[*begin].config.priority;
+  auto end = std::find_if(begin, order_.end(), [&](std::size_t i) {
+    return lanes_[i].config.priority != priority;
+  });
+  if (end - begin == 1) {
+    return &lanes_[*begin];
+  }
+
+  // Deficit round robin among the busy lanes of this priority: each sends
+  // until its deficit runs out, then all are topped up by their quantum.
+  for (int round = 0; round < 2; ++round) {
+    for (auto it = begin; it != end; ++it) {
+      Lane &lane = lanes_[*it];
+      if (lane.packets == 0) {
+        lane.deficit = 0;
+      } else if (lane.deficit > 0) {
+        return &lane;
+      }
+    }
+    for (auto it = begin; it != end; ++it) {
+      Lane &lane = lanes_[*it];
+      if (lane.packets > 0) {
+        lane.deficit += FlowQueue::kQuantum * lane.config.weight;
+      }
+    }
+  }
+  return &lanes_[*begin];
+}
+
+EgressQueue::Packet *EgressQueue::laneFront(Lane &lane,
+                                            Clock::time_point now) {
+  if (lane.flows) {
+    Packet *packet = lane.flows->front(now, config_.codel.interval);
+    settle(lane);
+    return packet;
+  }
+  for (;;) {
+    Band *band = !lane.priority.packets.empty() ? &lane.priority
+                 : !lane.bulk.packets.empty()   ? &lane.bulk
+                                                : nullptr;
+    if (!band) {
+      lane.current = nullptr;
+      return nullptr;
+    }
+    Packet &packet = band->packets.front();
+    const std::size_t size = packet.data.size();
+    const Clock::duration waited = now - packet.enqueued;
+    // CoDel alone never catches up with traffic that ignores drops; past one
+    // interval a packet is late enough that sending it helps nobody.
+    if (config_.policy != Policy::CoDel ||
+        (!band->codel.shouldDrop(waited, band->bytes - size, now) &&
+         waited <= config_.codel.interval)) {
+      lane.current = band;
+      return &packet;
+    }
+    band->packets.pop_front();
+    band->bytes -= size;
+    --lane.packets;
+    lane.bytes -= size;
+    --packets_;
+    bytes_ -= size;
+    ++lane.aqmDrops;
+  }
+}
+
+EgressQueue::Packet *EgressQueue::front(Clock::time_point now) {
+  haveCurrent_ = false;
+  while (Lane *lane = nextLane()) {
+    if (Packet *packet = laneFront(*lane, now)) {
+      current_ = static_cast<std::size_t>(lane - lanes_.data());
+      haveCurrent_ = true;
+      return packet;
+    }
+  }
+  return nullptr;
+}
+
+void EgressQueue::pop() {
+  if (!haveCurrent_) {
+    return;
+  }
+  haveCurrent_ = false;
+  Lane &lane = lanes_[current_];
+  if (lane.flows) {
+    const std::size_t bytes = lane.bytes;
+    lane.flows->pop();
+    settle(lane);
+    lane.deficit -= static_cast<int>(bytes - lane.bytes);
+    return;
+  }
+  Band *band = lane.current;
+  if (!band || band->packets.empty()) {
+    return;
+  }
+  const std::size_t size = band->packets.front().data.size();
+  band->packets.pop_front();
+  band->bytes -= size;
+  --lane.packets;
+  lane.bytes -= size;
+  --packets_;
+  bytes_ -= size;
+  lane.deficit -= static_cast<int>(size);
+  lane.current = nullptr;
+}
+
+EgressQueue::Clock::duration
+EgressQueue::sojourn(Clock::time_point now) const {
+  Clock::duration oldest = Clock::duration::zero();
+  for (const Lane &lane : lanes_) {
+    if (lane.flows) {
+      oldest = std::max(oldest, lane.flows->sojourn(now));
+      continue;
+    }
+    for (const Band *band : {&lane.priority, &lane.bulk}) {
+      if (!band->packets.empty()) {
+        oldest = std::max(oldest, now - band->packets.front().enqueued);
+      }
+    }
+  }
+  return oldest;
+}
+
+uint64_t EgressQueue::tailDrops() const {
+  uint64_t total = 0;
+  for (const Lane &lane : lanes_) {
+    total += lane.tailDrops;
+  }
+  return total;
+}
+
+uint64_t EgressQueue::aqmDrops() const {
+  uint64_t total = 0;
+  for (const Lane &lane : lanes_) {
+    total += lane.aqmDrops;
+  }
+  return total;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "codel.h"
+#include "flow_queue.h"
+#include "packet_pool.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+// Bounded send queue for one peer's unreliable TUN traffic, holding what the
+// transport is not ready to take yet. It is split into lanes, one per traffic
+// class: a lane is served only when every lane of a lower priority value is
+// empty, and lanes sharing a priority split the link by weight with deficit
+// round robin. Within a lane, Policy::FqCoDel, the default, hands messages to
+// a FlowQueue. Otherwise messages no larger than Config::priorityBytes (game
+// state, ACKs, DNS) go to a band that is always served first, so they never
+// wait behind full-sized bulk packets; with Policy::CoDel each band also
+// drops at its head to keep its standing delay near the CoDel target, and
+// anything that waited longer than the CoDel interval. When the queue is full
+// a less important lane gives up its oldest message first.
+class EgressQueue {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  enum class Policy { TailDrop, CoDel, FqCoDel };
+
+  struct LaneConfig {
+    int priority = 0; // lower is served first
+    int weight = 1;   // share among lanes of the same priority
+  };
+
+  struct Config {
+    Policy policy = Policy::FqCoDel;
+    std::size_t maxPackets = 1024;
+    std::size_t maxBytes = 256 * 1024;
+    std::size_t priorityBytes = 256; // CoDel/TailDrop; 0 means one band
+    CoDel::Config codel;
+    std::vector<LaneConfig> lanes; // empty means a single lane
+  };
+
+  using Packet = FlowQueue::Packet;
+
+  EgressQueue() : EgressQueue(Config()) {}
+  explicit EgressQueue(const Config &config);
+
+  // False when the queue was full and the message was dropped. flowHash
+  // picks the FQ-CoDel flow and is ignored by the other policies; under
+  // FQ-CoDel the new message is always taken and older ones of the fattest
+  // flow make room, counted in tailDrops(). Lanes past the configured ones
+  // fall into the last.
+  bool push(const void *data, std::size_t size, int flags,
+            Clock::time_point now, uint32_t flowHash = 0,
+            std::size_t lane = 0);
+  // Next message to send, after any CoDel drops; nullptr when empty. It stays
+  // queued until pop(), so a send the transport refuses can be retried.
+  Packet *front(Clock::time_point now);
+  // Lane of the message front() last returned.
+  std::size_t frontLane() const { return current_; }
+  void pop();
+
+  bool empty() const { return packets_ == 0; }
+  std::size_t packets() const { return packets_; }
+  std::size_t bytes() const { return bytes_; }
+  // Age of the oldest queued message.
+  Clock::duration sojourn(Clock::time_point now) const;
+
+  std::size_t laneCount() const { return lanes_.size(); }
+  uint64_t tailDrops() const;
+  uint64_t aqmDrops() const;
+  uint64_t tailDrops(std::size_t lane) const { return lanes_[lane].tailDrops; }
+  uint64_t aqmDrops(std::size_t lane) const { return lanes_[lane].aqmDrops; }
+
+private:
+  struct Band {
+    std::deque<Packet> packets;
+    std::size_t bytes = 0;
+    CoDel codel;
+  };
+
+  struct Lane {
+    LaneConfig config;
+    int deficit = 0;
+    std::unique_ptr<FlowQueue> flows; // FqCoDel only
+    Band priority;
+    Band bulk;
+    Band *current = nullptr; // band laneFront() last returned from
+    std::size_t packets = 0;
+    std::size_t bytes = 0;
+    uint64_t tailDrops = 0;
+    uint64_t aqmDrops = 0;
+  };
+
+  bool full(std::size_t extra) const;
+  Lane *victim(int priority);
+  void dropOldest(Lane &lane);
+  Lane *nextLane();
+  Packet *laneFront(Lane &lane, Clock::time_point now);
+  void settle(Lane &lane);
+
+  Config config_;
+  std::vector<Lane> lanes_;
+  std::vector<std::size_t> order_; // lane indices by priority
+  std::size_t current_ = 0;
+  bool haveCurrent_ = false;
+  std::size_t packets_ = 0;
+  std::size_t bytes_ = 0;
+};
@@ -0,0 +1,166 @@
+#include "fec.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+namespace {
+constexpr double kMinProtectedLoss = 0.005;
+// Aim for about this many expected losses per group (data plus parity).
+constexpr double kLossesPerGroup = 0.2;
+
+void xorInto(std::vector<uint8_t> &bytes, const uint8_t *payload,
+             size_t length) {
+  if (bytes.size() < length) {
+    bytes.resize(length, 0);
+  }
+  for (size_t i = 0; i < length; ++i) {
+    bytes[i] ^= payload[i];
+  }
+}
+} // namespace
+
+int FecEncoder::groupSizeForLoss(double lossRate) {
+  if (!(lossRate >= kMinProtectedLoss)) {
+    return 0;
+  }
+  const int packets = static_cast<int>(kLossesPerGroup / lossRate) - 1;
+  return std::clamp(packets, 1, kMaxGroupSize);
+}
+
+void FecEncoder::setGroupSize(int packets) {
+  groupSize_ = std::clamp(packets, 0, kMaxGroupSize);
+}
+
+FecHeader FecEncoder::addData(const uint8_t *payload, size_t length) {
+  OpenGroup &slot = slots_[nextSlot_];
+  nextSlot_ = (nextSlot_ + 1) % slots_.size();
+  if (slot.index != 0 && slot.index >= slot.count) {
+    // Its parity takes this turn, next to the new group's first packet.
+    due_.push_back(std::move(slot));
+    slot.index = 0;
+  }
+  if (slot.index == 0) {
+    slot.id = nextGroup_++;
+    slot.count = static_cast<uint8_t>(std::max(groupSize_, 1));
+    slot.lengthXor = 0;
+    slot.parity.clear();
+    slot.opened = std::chrono::steady_clock::now();
+  }
+  FecHeader header{};
+  header.group = htons(slot.id);
+  header.index = slot.index++;
+  header.count = slot.count;
+  slot.lengthXor ^= static_cast<uint16_t>(length);
+  xorInto(slot.parity, payload, length);
+  return header;
+}
+
+bool FecEncoder::takeParity(std::chrono::steady_clock::time_point now,
+                            std::vector<uint8_t> &out) {
+  if (!due_.empty()) {
+    writeParity(due_.front(), out);
+    due_.pop_front();
+    return true;
+  }
+  for (OpenGroup &slot : slots_) {
+    if (slot.index == 0 || now - slot.opened < kMaxGroupDelay) {
+      continue;
+    }
+    writeParity(slot, out);
+    slot.index = 0;
+    return true;
+  }
+  return false;
+}
+
+void FecEncoder::writeParity(const OpenGroup &group,
+                             std::vector<uint8_t> &out) {
+  FecHeader header{};
+  header.group = htons(group.id);
+  header.index = group.index;
+  header.count = group.index;
+  const uint16_t lengthXor = htons(group.lengthXor);
+  out.resize(sizeof(FecHeader) + sizeof(lengthXor) + group.parity.size());
+  std::memcpy(out.data(), &header, sizeof(FecHeader));
+  std::memcpy(out.data() + sizeof(FecHeader), &lengthXor, sizeof(lengthXor));
+  if (!group.parity.empty()) {
+    std::memcpy(out.data() + sizeof(FecHeader) + sizeof(lengthXor),
+                group.parity.data(), group.parity.size());
+  }
+}
+
+bool FecDecoder::onData(const FecHeader &header, const uint8_t *payload,
+                        size_t length, std::vector<uint8_t> &recovered) {
+  recovered.clear();
+  Group &g = group(ntohs(header.group));
+  if (g.done || g.received.test(header.index)) {
+    return false;
+  }
+  g.received.set(header.index);
+  ++g.receivedCount;
+  g.lengthXor ^= static_cast<uint16_t>(length);
+  xorInto(g.bytes, payload, length);
+  tryRecover(g, recovered);
+  return true;
+}
+
+void FecDecoder::onParity(const FecHeader &header, const uint8_t *payload,
+                          size_t length, std::vector<uint8_t> &recovered) {
+  recovered.clear();
+  uint16_t lengthXor = 0;
+  if (length < sizeof(lengthXor) || header.count == 0) {
+    return;
+  }
+  Group &g = group(ntohs(header.group));
+  if (g.done || g.count != 0) {
+    return;
+  }
+  std::memcpy(&lengthXor, payload, sizeof(lengthXor));
+  g.count = header.count;
+  g.lengthXor ^= ntohs(lengthXor);
+  xorInto(g.bytes, payload + sizeof(lengthXor), length - sizeof(lengthXor));
+  tryRecover(g, recovered);
+}
+
+FecDecoder::Group &FecDecoder::group(uint16_t id) {
+  auto it = groups_.find(id);
+  if (it != groups_.end()) {
+    return it->second;
+  }
+  std::vector<uint8_t> bytes;
+  if (order_.size() >= kMaxGroups) {
+    auto oldest = groups_.find(order_.front());
+    bytes = std::move(oldest->second.bytes); // reuse the allocation
+    groups_.erase(oldest);
+    order_.pop_front();
+  }
+  order_.push_back(id);
+  Group &g = groups_[id];
+  g.bytes = std::move(bytes);
+  g.bytes.clear();
+  return g;
+}
+
+void FecDecoder::tryRecover(Group &group, std::vector<uint8_t> &recovered) {
+  if (group.count == 0) {
+    return;
+  }
+  if (group.receivedCount >= group.count) {
+    group.done = true;
+    return;
+  }
+  if (group.receivedCount + 1 < group.count) {
+    return; // two or more missing, not recoverable yet
+  }
+  group.done = true;
+  const size_t length = group.lengthXor;
+  if (length == 0 || length > group.bytes.size()) {
+    return; // inconsistent group
+  }
+  recovered.assign(group.bytes.begin(), group.bytes.begin() + length);
+}
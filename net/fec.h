@@ -0,0 +1,97 @@
+#pragma once
+
+#include "vpn_protocol.h"
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+
+// XOR forward error correction for unreliable TUN traffic. Every group of up
+// to groupSize() data packets is followed by one parity packet from which the
+// receiver rebuilds any single packet of the group that went missing, without
+// waiting for a retransmission the IP layer above may never make.
+//
+// Consecutive packets go to kInterleave different groups in turn, and a full
+// group's parity goes out on the group's next turn rather than right after
+// its last packet, so a burst of up to kInterleave losses still costs each
+// group at most one packet, parity included. Data packets are delivered as
+// soon as they arrive; only a lost one waits, at most until its group's
+// parity. A group that is slow to fill is closed after kMaxGroupDelay so a
+// trickle of packets is protected just as quickly.
+class FecEncoder {
+public:
+  static constexpr int kMaxGroupSize = 16;
+  static constexpr int kInterleave = 8;
+  static constexpr std::chrono::milliseconds kMaxGroupDelay{20};
+  // Used from the moment a peer appears until its path has been measured.
+  static constexpr int kInitialGroupSize = 8;
+
+  // Packets per parity for a path losing this fraction of datagrams, chosen
+  // so a group rarely loses two; 0 when the path is clean enough to go
+  // without. Ten percent loss and above duplicates every packet.
+  static int groupSizeForLoss(double lossRate);
+
+  // Takes effect from the next group; 0 disables.
+  void setGroupSize(int packets);
+  int groupSize() const { return groupSize_; }
+
+  // Adds a payload to the open group and returns the header to send with it.
+  FecHeader addData(const uint8_t *payload, size_t length);
+  // Fills the FEC_PARITY payload for one group whose turn came round again
+  // or that has waited kMaxGroupDelay and closes it; call until it returns
+  // false.
+  bool takeParity(std::chrono::steady_clock::time_point now,
+                  std::vector<uint8_t> &out);
+
+private:
+  struct OpenGroup {
+    uint16_t id = 0;
+    uint8_t count = 0; // fixed when the group opens
+    uint8_t index = 0; // 0 while closed
+    uint16_t lengthXor = 0;
+    std::vector<uint8_t> parity;
+    std::chrono::steady_clock::time_point opened;
+  };
+
+  static void writeParity(const OpenGroup &group, std::vector<uint8_t> &out);
+
+  int groupSize_ = 0;
+  uint16_t nextGroup_ = 0;
+  size_t nextSlot_ = 0;
+  std::array<OpenGroup, kInterleave> slots_;
+  std::deque<OpenGroup> due_; // full groups whose turn came round
+};
+
+class FecDecoder {
+public:
+  // Both return whether the packet should be delivered (false for a data
+  // packet that was already rebuilt) and leave a rebuilt payload in
+  // recovered when this packet completed its group; recovered is cleared
+  // otherwise.
+  bool onData(const FecHeader &header, const uint8_t *payload, size_t length,
+              std::vector<uint8_t> &recovered);
+  void onParity(const FecHeader &header, const uint8_t *payload,
+                size_t length, std::vector<uint8_t> &recovered);
+
+private:
+  static constexpr size_t kMaxGroups = 64;
+
+  struct Group {
+    std::bitset<256> received;
+    int receivedCount = 0;
+    int count = 0; // known once the parity arrived
+    bool done = false;
+    uint16_t lengthXor = 0;
+    std::vector<uint8_t> bytes; // XOR of everything received so far
+  };
+
+  Group &group(uint16_t id);
+  static void tryRecover(Group &group, std::vector<uint8_t> &recovered);
+
+  std::map<uint16_t, Group> groups_;
+  std::deque<uint16_t> order_;
+};
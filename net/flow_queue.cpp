@@ -0,0 +1,117 @@
+#include "flow_queue.h"
+#include <algorithm>
+
+FlowQueue::FlowQueue(const CoDel::Config &codel) : codel_(codel) {}
+
+void FlowQueue::push(uint32_t flowHash, const void *data, std::size_t size,
+                     int flags, Clock::time_point now) {
+  const std::size_t bucket = flowHash % kFlows;
+  auto it = flows_.find(bucket);
+  if (it == flows_.end()) {
+    it = flows_.emplace(bucket, Flow()).first;
+    it->second.codel = CoDel(codel_);
+    it->second.bucket = bucket;
+  }
+  Flow &flow = it->second;
+  flow.packets.push_back(Packet{PacketBuffer(data, size), flags, now});
+  flow.bytes += size;
+  ++packets_;
+  bytes_ += size;
+  if (flow.list == List::None) {
+    flow.list = List::New;
+    flow.deficit = kQuantum;
+    newFlows_.push_back(&flow);
+  }
+}
+
+void FlowQueue::dropFattest() {
+  Flow *flow = fattest();
+  if (flow && !flow->packets.empty()) {
+    dropHead(*flow);
+  }
+}
+
+FlowQueue::Packet *FlowQueue::front(Clock::time_point now,
+                                    Clock::duration maxSojourn) {
+  current_ = nullptr;
+  while (true) {
+    const bool fromNew = !newFlows_.empty();
+    std::deque<Flow *> &list = fromNew ? newFlows_ : oldFlows_;
+    if (list.empty()) {
+      return nullptr;
+    }
+    Flow &flow = *list.front();
+    if (flow.deficit <= 0) {
+      flow.deficit += kQuantum;
+      list.pop_front();
+      flow.list = List::Old;
+      oldFlows_.push_back(&flow);
+      continue;
+    }
+    while (!flow.packets.empty()) {
+      Packet &packet = flow.packets.front();
+      const Clock::duration waited = now - packet.enqueued;
+      if (!flow.codel.shouldDrop(waited, flow.bytes - packet.data.size(),
+                                 now) &&
+          waited <= maxSojourn) {
+        current_ = &flow;
+        return &packet;
+      }
+      dropHead(flow);
+      ++aqmDrops_;
+    }
+    // A new flow that ran dry takes one more turn on the old list, so it
+    // cannot come straight back as new and starve the others.
+    list.pop_front();
+    if (fromNew) {
+      flow.list = List::Old;
+      oldFlows_.push_back(&flow);
+    } else {
+      flows_.erase(flow.bucket);
+    }
+  }
+}
+
+void FlowQueue::pop() {
+  if (!current_ || current_->packets.empty()) {
+    return;
+  }
+  const std::size_t size = current_->packets.front().data.size();
+  current_->packets.pop_front();
+  current_->bytes -= size;
+  current_->deficit -= static_cast<int>(size);
+  --packets_;
+  bytes_ -= size;
+  current_ = nullptr;
+}
+
+FlowQueue::Clock::duration FlowQueue::sojourn(Clock::time_point now) const {
+  Clock::duration oldest = Clock::duration::zero();
+  for (const auto &kv : flows_) {
+    if (!kv.second.packets.empty()) {
+      oldest = std::max(oldest, now - kv.second.packets.front().enqueued);
+    }
+  }
+  return oldest;
+}
+
+void FlowQueue::dropHead(Flow &flow) {
+  const std::size_t size = flow.packets.front().data.size();
+  flow.packets.pop_front();
+  flow.bytes -= size;
+  --packets_;
+  bytes_ -= size;
+  if (current_ == &flow) {
+    current_ = nullptr;
+  }
+}
+
+FlowQueue::Flow *FlowQueue::fattest() {
+  Flow *fattest = nullptr;
+  for (auto &kv : flows_) {
+    if (!fattest || kv.second.bytes > fattest->bytes) {
+      fattest = &kv.second;
+    }
+  }
+  return fattest;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "codel.h"
+#include "packet_pool.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+
+// FQ-CoDel (RFC 8290). Messages are hashed by flow into kFlows queues, each
+// with its own CoDel, and served by deficit round robin one quantum at a
+// time. A flow that just became active goes on the new-flows list, which is
+// served before the old one, so a sparse flow such as a game's state updates
+// is sent ahead of a bulk transfer sharing the peer, and only the flows that
+// build a queue see CoDel drops. Limits are the owner's business; to make
+// room it should take from the fattest flow, as dropFattest() does.
+class FlowQueue {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr std::size_t kFlows = 1024;
+  static constexpr int kQuantum = 1514;
+
+  struct Packet {
+    PacketBuffer data;
+    int flags = 0;
+    Clock::time_point enqueued;
+  };
+
+  explicit FlowQueue(const CoDel::Config &codel);
+
+  void push(uint32_t flowHash, const void *data, std::size_t size, int flags,
+            Clock::time_point now);
+  Packet *front(Clock::time_point now, Clock::duration maxSojourn);
+  void pop();
+  // Drops the oldest message of the flow holding the most bytes.
+  void dropFattest();
+
+  bool empty() const { return packets_ == 0; }
+  std::size_t packets() const { return packets_; }
+  std::size_t bytes() const { return bytes_; }
+  Clock::duration sojourn(Clock::time_point now) const;
+  uint64_t aqmDrops() const { return aqmDrops_; }
+
+private:
+  enum class List { None, New, Old };
+
+  struct Flow {
+    std::deque<Packet> packets;
+    std::size_t bytes = 0;
+    int deficit = 0;
+    List list = List::None;
+    CoDel codel;
+    std::size_t bucket = 0;
+  };
+
+  void dropHead(Flow &flow);
+  Flow *fattest();
+
+  CoDel::Config codel_;
+  // Only flows with something queued, or still on a list, are kept.
+  std::unordered_map<std::size_t, Flow> flows_;
+  std::deque<Flow *> newFlows_;
+  std::deque<Flow *> oldFlows_;
+  Flow *current_ = nullptr; // flow front() last returned from
+  std::size_t packets_ = 0;
+  std::size_t bytes_ = 0;
+  uint64_t aqmDrops_ = 0;
+};
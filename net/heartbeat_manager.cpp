@@ -104,7 +104,7 @@ void HeartbeatManager::checkExpiredLeases() {
     std::lock_guard<std::mutex> lock(nodeTableMutex_);
     for (auto it = nodeTable_.begin(); it != nodeTable_.end();) {
       if (!it->second.isLocal && it->second.isLeaseExpired()) {
-        std::cout << "Node " << NodeIdentity::toString(it->first)
+        std::cout << "Node " << NodeIdentity::toHex(it->first)
                   << " lease expired" << std::endl;
         expiredNodes.emplace_back(it->first, it->second.ipAddress);
         ipToNodeId_.erase(it->second.ipAddress);
@@ -10,7 +10,7 @@
 
 IpNegotiator::IpNegotiator()
     : localIP_(0), baseIP_(0), subnetMask_(0), state_(NegotiationState::IDLE),
-      candidateIP_(0), probeOffset_(0) {
+      candidateIP_(0), probeOffset_(0), probeOnly_(false) {
   localNodeId_.fill(0);
 }
 
@@ -19,15 +19,43 @@ void IpNegotiator::initialize(CSteamID localSteamID, uint32_t baseIP,
   localSteamID_ = localSteamID;
   baseIP_ = baseIP;
   subnetMask_ = subnetMask;
+  {
+    std::lock_guard<std::mutex> lock(usedIPsMutex_);
+    usedHosts_.resize(static_cast<uint64_t>(~subnetMask) + 1);
+  }
   localNodeId_ = NodeIdentity::generate(localSteamID);
-  std::cout << "Generated Node ID: " << NodeIdentity::toString(localNodeId_)
+  std::cout << "Generated Node ID: " << NodeIdentity::toHex(localNodeId_)
             << std::endl;
+
+  // RFC 4193 wants a random global ID; ours is hashed from the subnet so the
+  // whole mesh lands on the same one. Subnet ID 0.
+  const uint32_t subnet[2] = {htonl(baseIP & subnetMask), htonl(subnetMask)};
+  const NodeID globalId = NodeIdentity::derive(subnet, sizeof(subnet));
+  ipv6Prefix_.fill(0);
+  ipv6Prefix_[0] = 0xFD;
+  std::memcpy(ipv6Prefix_.data() + 1, globalId.data(), 5);
+  localIPv6_ = ipv6For(localNodeId_);
+}
+
+Ipv6Address IpNegotiator::ipv6For(const NodeID &nodeId) const {
+  Ipv6Address address = ipv6Prefix_;
+  std::memcpy(address.data() + 8, nodeId.data(), 8);
+  return address;
+}
+
+uint64_t IpNegotiator::interfaceIdFor(const NodeID &nodeId) {
+  uint64_t id = 0;
+  for (std::size_t i = 0; i < 8; ++i) {
+    id = (id << 8) | nodeId[i];
+  }
+  return id;
 }
 
 void IpNegotiator::reset() {
   {
     std::lock_guard<std::mutex> lock(usedIPsMutex_);
-    usedIPs_.clear();
+    usedHosts_.clear();
+    reservations_.clear();
   }
   {
     std::lock_guard<std::mutex> lock(conflictsMutex_);
@@ -36,6 +64,7 @@ void IpNegotiator::reset() {
   state_ = NegotiationState::IDLE;
   candidateIP_ = 0;
   probeOffset_ = 0;
+  probeOnly_ = false;
   localIP_ = 0;
 }
 
@@ -55,7 +84,7 @@ void IpNegotiator::startNegotiation() {
     collectedConflicts_.clear();
   }
 
-  candidateIP_ = generateCandidateIP(probeOffset_);
+  candidateIP_ = generateCandidateIP(localNodeId_, probeOffset_);
   candidateIP_ = findNextAvailableIP(candidateIP_);
   state_ = NegotiationState::PROBING;
 
@@ -68,11 +97,11 @@ void IpNegotiator::startNegotiation() {
   probeStartTime_ = std::chrono::steady_clock::now();
 }
 
-uint32_t IpNegotiator::generateCandidateIP(uint32_t offset) {
-  uint32_t hash = (static_cast<uint32_t>(localNodeId_[NODE_ID_SIZE - 1]) |
-                   (static_cast<uint32_t>(localNodeId_[NODE_ID_SIZE - 2]) << 8) |
-                   (static_cast<uint32_t>(localNodeId_[NODE_ID_SIZE - 3])
-                    << 16));
+uint32_t IpNegotiator::generateCandidateIP(const NodeID &nodeId,
+                                          uint32_t offset) {
+  uint32_t hash = (static_cast<uint32_t>(nodeId[NODE_ID_SIZE - 1]) |
+                   (static_cast<uint32_t>(nodeId[NODE_ID_SIZE - 2]) << 8) |
+                   (static_cast<uint32_t>(nodeId[NODE_ID_SIZE - 3]) << 16));
 
   hash = (hash + offset) & 0x00FFFFFF;
 
@@ -91,27 +120,42 @@ uint32_t IpNegotiator::findNextAvailableIP(uint32_t startIP) {
   std::lock_guard<std::mutex> lock(usedIPsMutex_);
 
   const uint32_t hostMask = ~subnetMask_;
-  uint32_t maxHosts = hostMask - 1;
-  if (maxHosts == 0) {
-    maxHosts = 1;
-  }
-
   uint32_t hostPart = startIP & hostMask;
   if (hostPart == 0 || hostPart >= hostMask) {
     hostPart = 1;
   }
 
-  uint32_t potentialIP = (baseIP_ & subnetMask_) | hostPart;
-  uint32_t attempts = 0;
-  while (usedIPs_.count(potentialIP) && attempts < maxHosts) {
-    hostPart++;
-    if (hostPart >= hostMask) {
-      hostPart = 1;
+  // Reservations are few, so stepping past them one at a time is cheap.
+  uint32_t host = hostPart;
+  for (std::size_t skipped = 0; skipped <= reservations_.size(); ++skipped) {
+    host = nextFreeHost(host);
+    if (host == AddressBitmap::kNone) {
+      break;
     }
-    potentialIP = (baseIP_ & subnetMask_) | hostPart;
-    attempts++;
+    const uint32_t ip = (baseIP_ & subnetMask_) | host;
+    if (!reservations_.count(ip)) {
+      return ip;
+    }
+    ++host;
   }
-  return potentialIP;
+  return (baseIP_ & subnetMask_) | hostPart;
+}
+
+// Caller holds usedIPsMutex_. Host numbers run from 1 to hostMask - 1 and
+// wrap around; kNone when all of them are taken.
+uint32_t IpNegotiator::nextFreeHost(uint32_t from) const {
+  const uint32_t hostMask = ~subnetMask_;
+  const uint32_t host =
+      from < hostMask ? usedHosts_.nextClear(from) : AddressBitmap::kNone;
+  if (host < hostMask) {
+    return host;
+  }
+  const uint32_t wrapped = usedHosts_.nextClear(1);
+  return wrapped < hostMask ? wrapped : AddressBitmap::kNone;
+}
+
+bool IpNegotiator::inSubnet(uint32_t ip) const {
+  return (ip & subnetMask_) == (baseIP_ & subnetMask_);
 }
 
 void IpNegotiator::sendProbeRequest() {
@@ -172,20 +216,7 @@ void IpNegotiator::checkTimeout() {
     for (auto steamID : nodesToForceRelease) {
       sendForcedRelease(candidateIP_, steamID);
     }
-
-    std::cout << "IP negotiation success. Local IP: "
-              << ((candidateIP_ >> 24) & 0xFF) << "."
-              << ((candidateIP_ >> 16) & 0xFF) << "."
-              << ((candidateIP_ >> 8) & 0xFF) << "." << (candidateIP_ & 0xFF)
-              << std::endl;
-
-    state_ = NegotiationState::STABLE;
-    localIP_ = candidateIP_;
-    sendAddressAnnounce();
-
-    if (successCallback_) {
-      successCallback_(localIP_, localNodeId_);
-    }
+    claim(candidateIP_);
   } else {
     std::cout << "Lost IP arbitration, reselecting with new offset..."
               << std::endl;
@@ -194,13 +225,40 @@ void IpNegotiator::checkTimeout() {
   }
 }
 
+void IpNegotiator::claim(uint32_t ip) {
+  std::cout << "IP negotiation success. Local IP: " << ((ip >> 24) & 0xFF)
+            << "." << ((ip >> 16) & 0xFF) << "." << ((ip >> 8) & 0xFF) << "."
+            << (ip & 0xFF) << std::endl;
+
+  state_ = NegotiationState::STABLE;
+  localIP_ = ip;
+  markIPUsed(ip);
+  sendAddressAnnounce();
+
+  if (successCallback_) {
+    successCallback_(localIP_, localNodeId_);
+  }
+}
+
 void IpNegotiator::handleProbeRequest(const ProbeRequestPayload &request,
                                       CSteamID senderSteamID) {
   const uint32_t requestedIP = ntohl(request.ipAddress);
+  const auto now = std::chrono::steady_clock::now();
   bool shouldRespond = false;
+  NodeID owner = localNodeId_;
 
   if (state_ == NegotiationState::STABLE && requestedIP == localIP_) {
     shouldRespond = true;
+  } else if (state_ == NegotiationState::STABLE) {
+    // An address we offered is in use until the offer lapses; answer for
+    // the node it is held for.
+    std::lock_guard<std::mutex> lock(usedIPsMutex_);
+    auto it = reservations_.find(requestedIP);
+    if (it != reservations_.end() && it->second.expires > now &&
+        NodeIdentity::compare(it->second.nodeId, request.nodeId) != 0) {
+      shouldRespond = true;
+      owner = it->second.nodeId;
+    }
   } else if (state_ == NegotiationState::PROBING &&
              requestedIP == candidateIP_) {
     if (NodeIdentity::hasPriority(localNodeId_, request.nodeId)) {
@@ -216,8 +274,7 @@ void IpNegotiator::handleProbeRequest(const ProbeRequestPayload &request,
   if (shouldRespond && sendCallback_) {
     ProbeResponsePayload response;
     response.ipAddress = htonl(requestedIP);
-    response.nodeId = localNodeId_;
-    const auto now = std::chrono::steady_clock::now();
+    response.nodeId = owner;
     response.lastHeartbeatMs = std::chrono::duration_cast<std::chrono::milliseconds>(
                                    now.time_since_epoch())
                                    .count();
@@ -227,6 +284,7 @@ void IpNegotiator::handleProbeRequest(const ProbeRequestPayload &request,
                   sizeof(response), senderSteamID, true);
     std::cout << "Sent conflict response for IP" << std::endl;
   }
+  sendLeaseOffer(request.nodeId, senderSteamID);
 }
 
 void IpNegotiator::handleProbeResponse(const ProbeResponsePayload &response,
@@ -245,7 +303,7 @@ void IpNegotiator::handleProbeResponse(const ProbeResponsePayload &response,
   info.senderSteamID = senderSteamID;
   collectedConflicts_.push_back(info);
   std::cout << "Received conflict response from node "
-            << NodeIdentity::toString(response.nodeId) << std::endl;
+            << NodeIdentity::toHex(response.nodeId) << std::endl;
 }
 
 void IpNegotiator::handleAddressAnnounce(
@@ -255,13 +313,14 @@ void IpNegotiator::handleAddressAnnounce(
   std::cout << "Received address announce: " << ((announcedIP >> 24) & 0xFF)
             << "." << ((announcedIP >> 16) & 0xFF) << "."
             << ((announcedIP >> 8) & 0xFF) << "." << (announcedIP & 0xFF)
-            << " from node " << NodeIdentity::toString(announce.nodeId)
+            << " from node " << NodeIdentity::toHex(announce.nodeId)
             << std::endl;
 
   if (announcedIP == localIP_ && state_ == NegotiationState::STABLE) {
     if (!NodeIdentity::hasPriority(localNodeId_, announce.nodeId)) {
       std::cout << "Address conflict detected, reselecting..." << std::endl;
       probeOffset_++;
+      probeOnly_ = true;
       startNegotiation();
       return;
     }
@@ -269,6 +328,12 @@ void IpNegotiator::handleAddressAnnounce(
     return;
   }
 
+  if (interfaceIdFor(announce.nodeId) == interfaceIdFor(localNodeId_) &&
+      NodeIdentity::compare(announce.nodeId, localNodeId_) != 0) {
+    std::cerr << "IPv6 interface ID shared with node "
+              << NodeIdentity::toHex(announce.nodeId)
+              << "; IPv6 to either of us is unreliable" << std::endl;
+  }
   markIPUsed(announcedIP);
 }
 
@@ -285,16 +350,94 @@ void IpNegotiator::handleForcedRelease(const ForcedReleasePayload &release,
     if (!NodeIdentity::hasPriority(localNodeId_, release.winnerNodeId)) {
       shouldRelease = true;
     }
+  } else if (state_ == NegotiationState::STABLE) {
+    // The prober beat the node we were holding releasedIP for.
+    std::lock_guard<std::mutex> lock(usedIPsMutex_);
+    auto it = reservations_.find(releasedIP);
+    if (it != reservations_.end() &&
+        !NodeIdentity::hasPriority(it->second.nodeId, release.winnerNodeId)) {
+      reservations_.erase(it);
+    }
   }
 
   if (shouldRelease) {
     std::cout << "Received forced release, reselecting..." << std::endl;
     probeOffset_++;
+    probeOnly_ = true;
     state_ = NegotiationState::IDLE;
     startNegotiation();
   }
 }
 
+void IpNegotiator::handleLeaseOffer(const LeaseOfferPayload &offer,
+                                    CSteamID senderSteamID) {
+  if (state_ != NegotiationState::PROBING || probeOnly_ ||
+      NodeIdentity::compare(offer.nodeId, localNodeId_) != 0) {
+    return;
+  }
+  const uint32_t offeredIP = ntohl(offer.ipAddress);
+  const uint32_t hostPart = offeredIP & ~subnetMask_;
+  if (!inSubnet(offeredIP) || hostPart == 0 || hostPart == ~subnetMask_) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(usedIPsMutex_);
+    if (usedHosts_.test(hostPart)) {
+      return;
+    }
+  }
+  std::cout << "Accepting lease offer from " << senderSteamID.ConvertToUint64()
+            << std::endl;
+  claim(offeredIP);
+}
+
+void IpNegotiator::offerLeaseTo(CSteamID targetSteamID) {
+  sendLeaseOffer(NodeIdentity::generate(targetSteamID), targetSteamID);
+}
+
+void IpNegotiator::sendLeaseOffer(const NodeID &nodeId,
+                                  CSteamID targetSteamID) {
+  if (!sendCallback_ || state_ != NegotiationState::STABLE || localIP_ == 0 ||
+      NodeIdentity::compare(nodeId, localNodeId_) == 0) {
+    return;
+  }
+  const auto now = std::chrono::steady_clock::now();
+  uint32_t offeredIP = 0;
+  {
+    std::lock_guard<std::mutex> lock(usedIPsMutex_);
+    if (usedHosts_.firstSet() != (localIP_ & ~subnetMask_)) {
+      return;
+    }
+    for (auto it = reservations_.begin(); it != reservations_.end();) {
+      if (it->second.expires <= now) {
+        it = reservations_.erase(it);
+      } else {
+        if (NodeIdentity::compare(it->second.nodeId, nodeId) == 0) {
+          offeredIP = it->first;
+        }
+        ++it;
+      }
+    }
+  }
+  if (offeredIP == 0) {
+    offeredIP = findNextAvailableIP(generateCandidateIP(nodeId, 0));
+    std::lock_guard<std::mutex> lock(usedIPsMutex_);
+    if (usedHosts_.test(offeredIP & ~subnetMask_) ||
+        reservations_.count(offeredIP)) {
+      return; // subnet full
+    }
+    reservations_[offeredIP] = {
+        nodeId, now + std::chrono::milliseconds(LEASE_OFFER_HOLD_MS)};
+  }
+
+  LeaseOfferPayload payload;
+  payload.ipAddress = htonl(offeredIP);
+  payload.nodeId = nodeId;
+  sendCallback_(VpnMessageType::LEASE_OFFER,
+                reinterpret_cast<const uint8_t *>(&payload), sizeof(payload),
+                targetSteamID, true);
+}
+
 void IpNegotiator::sendAddressAnnounce() {
   if (!broadcastCallback_) {
     return;
@@ -334,11 +477,18 @@ void IpNegotiator::sendForcedRelease(uint32_t ipAddress,
 }
 
 void IpNegotiator::markIPUsed(uint32_t ip) {
+  if (!inSubnet(ip)) {
+    return;
+  }
   std::lock_guard<std::mutex> lock(usedIPsMutex_);
-  usedIPs_.insert(ip);
+  usedHosts_.set(ip & ~subnetMask_);
+  reservations_.erase(ip);
 }
 
 void IpNegotiator::markIPUnused(uint32_t ip) {
+  if (!inSubnet(ip)) {
+    return;
+  }
   std::lock_guard<std::mutex> lock(usedIPsMutex_);
-  usedIPs_.erase(ip);
+  usedHosts_.reset(ip & ~subnetMask_);
 }
@@ -1,12 +1,12 @@
 #pragma once
 
+#include "address_bitmap.h"
 #include "node_identity.h"
 #include "vpn_protocol.h"
 #include <chrono>
 #include <functional>
 #include <map>
 #include <mutex>
-#include <set>
 #include <steam_api.h>
 #include <vector>
 
@@ -47,20 +47,47 @@ public:
                              const std::string &peerName);
   void handleForcedRelease(const ForcedReleasePayload &release,
                            CSteamID senderSteamID);
+  void handleLeaseOffer(const LeaseOfferPayload &offer,
+                        CSteamID senderSteamID);
+
+  // Lease offers: the stable node holding the lowest address in the room
+  // sets an address aside for each joiner, starting from the joiner's own
+  // candidate, and tells it straight away. A probing joiner claims the first
+  // offer it gets instead of waiting PROBE_TIMEOUT_MS; once it has lost an
+  // address to a conflict it ignores offers and only probes.
+  void offerLeaseTo(CSteamID targetSteamID);
 
   NegotiationState getState() const { return state_; }
   uint32_t getLocalIP() const { return localIP_; }
   const NodeID &getLocalNodeID() const { return localNodeId_; }
   uint32_t getCandidateIP() const { return candidateIP_; }
 
+  // IPv6 runs alongside: the mesh shares a ULA /64 derived from the virtual
+  // subnet, and every node's interface ID is the first 64 bits of its node
+  // ID. Node IDs are SHA-256 outputs, so unlike IPv4 host numbers these need
+  // no probing; any peer can work out another's address from its node ID.
+  const Ipv6Address &getIpv6Prefix() const { return ipv6Prefix_; }
+  const Ipv6Address &getLocalIPv6() const { return localIPv6_; }
+  Ipv6Address ipv6For(const NodeID &nodeId) const;
+  static uint64_t interfaceIdFor(const NodeID &nodeId);
+
   void sendAddressAnnounce();
   void sendAddressAnnounceTo(CSteamID targetSteamID);
   void markIPUsed(uint32_t ip);
   void markIPUnused(uint32_t ip);
 
 private:
-  uint32_t generateCandidateIP(uint32_t offset);
+  struct Reservation {
+    NodeID nodeId;
+    std::chrono::steady_clock::time_point expires;
+  };
+
+  uint32_t generateCandidateIP(const NodeID &nodeId, uint32_t offset);
   uint32_t findNextAvailableIP(uint32_t startIP);
+  uint32_t nextFreeHost(uint32_t from) const;
+  bool inSubnet(uint32_t ip) const;
+  void claim(uint32_t ip);
+  void sendLeaseOffer(const NodeID &nodeId, CSteamID targetSteamID);
   void sendProbeRequest();
   void sendForcedRelease(uint32_t ipAddress, CSteamID targetSteamID);
 
@@ -69,15 +96,19 @@ private:
   uint32_t localIP_;
   uint32_t baseIP_;
   uint32_t subnetMask_;
+  Ipv6Address ipv6Prefix_{};
+  Ipv6Address localIPv6_{};
 
   NegotiationState state_;
   uint32_t candidateIP_;
   uint32_t probeOffset_;
+  bool probeOnly_;
   std::chrono::steady_clock::time_point probeStartTime_;
 
   std::vector<ConflictInfo> collectedConflicts_;
   std::mutex conflictsMutex_;
-  std::set<uint32_t> usedIPs_;
+  AddressBitmap usedHosts_; // indexed by host number
+  std::map<uint32_t, Reservation> reservations_;
   std::mutex usedIPsMutex_;
 
   VpnSendMessageCallback sendCallback_;
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "vpn_protocol.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Header access shared by the IPv4 and IPv6 paths. The version nibble picks a
+// row describing where that family keeps its addresses, so neither family
+// pays for a chain of version checks. IPv4 addresses are widened to their
+// IPv4-mapped form (::ffff:a.b.c.d) when a common key is needed.
+namespace ippacket {
+
+struct Layout {
+  std::size_t minLength; // SIZE_MAX for anything that is not IPv4 or IPv6
+  std::size_t sourceOffset;
+  std::size_t addressBytes; // destination follows the source directly
+  std::size_t protocolOffset;
+};
+
+constexpr std::array<Layout, 16> makeLayouts() {
+  std::array<Layout, 16> layouts{};
+  for (auto &layout : layouts) {
+    layout = Layout{SIZE_MAX, 0, 0, 0};
+  }
+  layouts[4] = Layout{20, 12, 4, 9};
+  layouts[6] = Layout{40, 8, 16, 6};
+  return layouts;
+}
+
+constexpr std::array<Layout, 16> kLayouts = makeLayouts();
+constexpr uint8_t kNextHeaderHopByHop = 0;
+constexpr uint8_t kNextHeaderIcmpv6 = 58;
+constexpr uint8_t kProtocolTcp = 6;
+constexpr uint8_t kProtocolUdp = 17;
+
+// 4 or 6 when the packet is long enough for its header, 0 otherwise.
+inline int version(const uint8_t *packet, std::size_t length) {
+  if (length == 0) {
+    return 0;
+  }
+  const uint8_t nibble = packet[0] >> 4;
+  return length >= kLayouts[nibble].minLength ? nibble : 0;
+}
+
+// Destination of a packet version() accepted, IPv4-mapped for IPv4.
+inline Ipv6Address destination(const uint8_t *packet) {
+  const Layout &layout = kLayouts[packet[0] >> 4];
+  Ipv6Address address{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF};
+  std::memcpy(address.data() + address.size() - layout.addressBytes,
+              packet + layout.sourceOffset + layout.addressBytes,
+              layout.addressBytes);
+  return address;
+}
+
+inline Ipv6Address source(const uint8_t *packet) {
+  const Layout &layout = kLayouts[packet[0] >> 4];
+  Ipv6Address address{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF};
+  std::memcpy(address.data() + address.size() - layout.addressBytes,
+              packet + layout.sourceOffset, layout.addressBytes);
+  return address;
+}
+
+inline bool isIpv6Multicast(const Ipv6Address &address) {
+  return address[0] == 0xFF;
+}
+
+inline bool isIpv6LinkLocal(const Ipv6Address &address) {
+  return address[0] == 0xFE && (address[1] & 0xC0) == 0x80;
+}
+
+// Low 64 bits of an IPv6 address.
+inline uint64_t interfaceId(const Ipv6Address &address) {
+  uint64_t id = 0;
+  for (std::size_t i = 8; i < 16; ++i) {
+    id = (id << 8) | address[i];
+  }
+  return id;
+}
+
+// FNV-1a over the 5-tuple of a packet version() accepted: addresses,
+// protocol and, for TCP and UDP, the ports. IPv4 fragments and IPv6 packets
+// with extension headers hash without ports.
+inline uint32_t flowHash(const uint8_t *packet, std::size_t length) {
+  const Layout &layout = kLayouts[packet[0] >> 4];
+  uint32_t hash = 2166136261u;
+  const auto mix = [&hash](const uint8_t *bytes, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+      hash = (hash ^ bytes[i]) * 16777619u;
+    }
+  };
+  mix(packet + layout.sourceOffset, 2 * layout.addressBytes);
+  const uint8_t protocol = packet[layout.protocolOffset];
+  mix(&protocol, 1);
+  const bool ipv4 = layout.addressBytes == 4;
+  const std::size_t transport =
+      ipv4 ? static_cast<std::size_t>(packet[0] & 0x0F) * 4 : layout.minLength;
+  const bool fragment = ipv4 && ((packet[6] & 0x3F) | packet[7]) != 0;
+  if ((protocol == kProtocolTcp || protocol == kProtocolUdp) && !fragment &&
+      length >= transport + 4) {
+    mix(packet + transport, 4);
+  }
+  return hash;
+}
+
+// Neighbor discovery and MLD (RFC 4861, 2710, 3810). They only make sense on
+// a real link; across the mesh every peer is already a route away.
+inline bool isIpv6LinkControl(const uint8_t *packet, std::size_t length) {
+  std::size_t offset = 40;
+  uint8_t next = packet[6];
+  if (next == kNextHeaderHopByHop && length >= offset + 2) {
+    next = packet[offset];
+    offset += (static_cast<std::size_t>(packet[offset + 1]) + 1) * 8;
+  }
+  if (next != kNextHeaderIcmpv6 || length <= offset) {
+    return false;
+  }
+  const uint8_t type = packet[offset];
+  return (type >= 130 && type <= 137) || type == 143;
+}
+
+} // namespace ippacket
@@ -0,0 +1,658 @@
+#include "loopback_transport.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+constexpr std::chrono::milliseconds kMinRetransmitDelay{20};
+constexpr std::chrono::milliseconds kMeterWindow{250};
+
+std::chrono::microseconds serializationTime(uint32_t size,
+                                            uint64_t bytesPerSec) {
+  return std::chrono::microseconds(static_cast<int64_t>(size) * 1000000 /
+                                   static_cast<int64_t>(bytesPerSec));
+}
+
+SteamNetworkingIdentity identityFor(uint64_t steamID) {
+  SteamNetworkingIdentity identity;
+  identity.Clear();
+  identity.SetSteamID(CSteamID(static_cast<uint64>(steamID)));
+  return identity;
+}
+} // namespace
+
+LoopbackNetwork::LoopbackNetwork() : rng_(0x5eed) {}
+
+LoopbackNetwork::~LoopbackNetwork() = default;
+
+std::unique_ptr<LoopbackTransport>
+LoopbackNetwork::createEndpoint(CSteamID steamID) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    endpoints_[steamID.ConvertToUint64()];
+  }
+  return std::unique_ptr<LoopbackTransport>(
+      new LoopbackTransport(this, steamID));
+}
+
+std::pair<HSteamNetConnection, HSteamNetConnection>
+LoopbackNetwork::connect(const LoopbackTransport &a,
+                         const LoopbackTransport &b) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const HSteamNetConnection connA = nextConnection_++;
+  const HSteamNetConnection connB = nextConnection_++;
+  const uint64_t idA = a.localSteamID().ConvertToUint64();
+  const uint64_t idB = b.localSteamID().ConvertToUint64();
+  connections_[connA] = Connection{idA, idB, connB};
+  connections_[connB] = Connection{idB, idA, connA};
+  return {connA, connB};
+}
+
+void LoopbackNetwork::setDefaultConditions(const LinkConditions &conditions) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  defaultConditions_ = conditions;
+}
+
+void LoopbackNetwork::setConditions(CSteamID from, CSteamID to,
+                                    const LinkConditions &conditions) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  linkFor(from.ConvertToUint64(), to.ConvertToUint64()).conditions =
+      conditions;
+}
+
+void LoopbackNetwork::setSeed(uint32_t seed) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  rng_.seed(seed);
+}
+
+void LoopbackNetwork::removeEndpoint(uint64_t steamID) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  endpoints_.erase(steamID);
+  for (auto it = connections_.begin(); it != connections_.end();) {
+    if (it->second.owner == steamID || it->second.peer == steamID) {
+      it = connections_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (auto &entry : endpoints_) {
+    auto &endpoint = entry.second;
+    if (endpoint.sessions.erase(steamID) == 0) {
+      continue;
+    }
+    SteamNetConnectionInfo_t info{};
+    info.m_identityRemote = identityFor(steamID);
+    info.m_eState = k_ESteamNetworkingConnectionState_ClosedByPeer;
+    std::strncpy(info.m_szEndDebug, "Loopback peer went away",
+                 sizeof(info.m_szEndDebug) - 1);
+    endpoint.pendingFailures.push_back(info);
+  }
+  arrivals_.notify_all();
+}
+
+LoopbackNetwork::Link &LoopbackNetwork::linkFor(uint64_t from, uint64_t to) {
+  auto it = links_.find({from, to});
+  if (it == links_.end()) {
+    it = links_.emplace(std::make_pair(from, to), Link{}).first;
+    it->second.to = to;
+    it->second.conditions = defaultConditions_;
+  }
+  return it->second;
+}
+
+void LoopbackNetwork::advanceLink(Link &link, Clock::time_point now) {
+  while (!link.queued.empty() && link.queued.front().done <= now) {
+    Transmission sent = std::move(link.queued.front());
+    link.queued.pop_front();
+    const std::size_t size = sent.packet.data.size();
+    if (sent.reliable) {
+      link.pendingReliable -= size;
+    } else {
+      link.pendingUnreliable -= size;
+    }
+    transmit(link, std::move(sent));
+  }
+  while (!link.unacked.empty() && link.unacked.front().acked <= now) {
+    link.sentUnackedReliable -= link.unacked.front().size;
+    link.unacked.pop_front();
+  }
+  const auto elapsed = now - link.meterStart;
+  if (elapsed >= kMeterWindow) {
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+    link.outBytesPerSec = static_cast<float>(link.meterBytes / seconds);
+    link.outPacketsPerSec = static_cast<float>(link.meterPackets / seconds);
+    link.dropRate = link.meterPackets
+                        ? static_cast<float>(link.meterDropped) /
+                              static_cast<float>(link.meterPackets)
+                        : 0.0f;
+    link.meterBytes = 0;
+    link.meterPackets = 0;
+    link.meterDropped = 0;
+    link.meterStart = now;
+  }
+}
+
+void LoopbackNetwork::advanceLinksTo(uint64_t to, Clock::time_point now) {
+  for (auto &entry : links_) {
+    if (entry.first.second == to && !entry.second.queued.empty()) {
+      advanceLink(entry.second, now);
+    }
+  }
+}
+
+// Runs a message that just left the sender's queue through the bottleneck,
+// loss and propagation models, timed from when it left rather than from now.
+void LoopbackNetwork::transmit(Link &link, Transmission sent) {
+  const LinkConditions &conditions = link.conditions;
+  const uint32_t size = static_cast<uint32_t>(sent.packet.data.size());
+  const auto retransmitDelay =
+      std::max<Clock::duration>(kMinRetransmitDelay, conditions.latency * 2);
+
+  bool lost = false;
+  auto arrival = sent.done;
+  if (conditions.bottleneckBytesPerSec > 0) {
+    auto enterAt = sent.done;
+    auto start = std::max(enterAt, link.bottleneckBusyUntil);
+    const auto backlogBytes = static_cast<uint64_t>(
+        std::chrono::duration<double>(start - enterAt).count() *
+        static_cast<double>(conditions.bottleneckBytesPerSec));
+    if (conditions.bottleneckBufferBytes > 0 &&
+        backlogBytes + size > conditions.bottleneckBufferBytes) {
+      link.meterDropped++;
+      lost = true;
+      // A reliable message comes back one retransmit timeout later.
+      if (sent.reliable) {
+        enterAt += retransmitDelay;
+        start = std::max(enterAt, link.bottleneckBusyUntil);
+      }
+    }
+    link.lastBottleneckDelay = start - enterAt;
+    if (!lost || sent.reliable) {
+      link.bottleneckBusyUntil =
+          start + serializationTime(size, conditions.bottleneckBytesPerSec);
+      arrival = link.bottleneckBusyUntil;
+    }
+  }
+  auto deliverAt = arrival + conditions.latency;
+
+  if (!lost && (conditions.lossRate > 0.0 || conditions.burstEnterRate > 0.0)) {
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    if (conditions.burstEnterRate > 0.0) {
+      link.inBurst = link.inBurst ? dist(rng_) >= conditions.burstExitRate
+                                  : dist(rng_) < conditions.burstEnterRate;
+      lost = link.inBurst && dist(rng_) < conditions.burstLossRate;
+    }
+    lost = lost || dist(rng_) < conditions.lossRate;
+    if (lost && sent.reliable) {
+      deliverAt += retransmitDelay;
+    }
+  }
+  if (sent.reliable) {
+    lost = false;
+    deliverAt = std::max(deliverAt, link.lastReliableDelivery);
+    link.lastReliableDelivery = deliverAt;
+    link.sentUnackedReliable += size;
+    link.unacked.push_back(InFlight{deliverAt + conditions.latency, size});
+  }
+  if (lost) {
+    return;
+  }
+  auto endpointIt = endpoints_.find(link.to);
+  if (endpointIt == endpoints_.end()) {
+    return;
+  }
+  endpointIt->second.inbox.emplace(std::make_pair(deliverAt, nextSequence_++),
+                                   std::move(sent.packet));
+}
+
+EResult LoopbackNetwork::sendToUser(uint64_t from, uint64_t to,
+                                    const void *data, uint32 size, int flags,
+                                    int channel) {
+  auto fromIt = endpoints_.find(from);
+  auto toIt = endpoints_.find(to);
+  if (fromIt == endpoints_.end() || toIt == endpoints_.end()) {
+    return k_EResultNoConnection;
+  }
+  // Sending implicitly accepts our side; the receiver gets a session request
+  // the first time it hears from us.
+  fromIt->second.sessions[to].accepted = true;
+  auto &remoteSession = toIt->second.sessions[from];
+  if (!remoteSession.accepted && !remoteSession.requestPending) {
+    remoteSession.requestPending = true;
+    toIt->second.pendingRequests.push_back(identityFor(from));
+  }
+  return enqueue(from, to, k_HSteamNetConnection_Invalid, channel, data, size,
+                 flags, nullptr);
+}
+
+EResult LoopbackNetwork::enqueue(uint64_t from, uint64_t to,
+                                 HSteamNetConnection remoteConn, int channel,
+                                 const void *data, uint32 size, int flags,
+                                 int64 *outMessageNumber) {
+  if (endpoints_.find(to) == endpoints_.end()) {
+    return k_EResultNoConnection;
+  }
+  if (size > 0 && !data) {
+    return k_EResultInvalidParam;
+  }
+  Link &link = linkFor(from, to);
+  const auto now = Clock::now();
+  advanceLink(link, now);
+
+  const LinkConditions &conditions = link.conditions;
+  if (link.pendingReliable + link.pendingUnreliable + size >
+      conditions.sendBufferBytes) {
+    return k_EResultLimitExceeded;
+  }
+
+  const bool reliable = (flags & k_nSteamNetworkingSend_Reliable) != 0;
+  const uint64_t sendRate =
+      link.sendRate > 0 ? link.sendRate : conditions.bandwidthBytesPerSec;
+  auto txEnd = std::max(now, link.busyUntil);
+  if (sendRate > 0) {
+    txEnd += serializationTime(size, sendRate);
+  }
+  link.busyUntil = txEnd;
+
+  const int64 messageNumber = link.nextMessageNumber++;
+  if (outMessageNumber) {
+    *outMessageNumber = messageNumber;
+  }
+  Transmission transmission;
+  transmission.done = txEnd;
+  transmission.reliable = reliable;
+  Packet &packet = transmission.packet;
+  packet.from = from;
+  packet.conn = remoteConn;
+  packet.channel = channel;
+  packet.flags = flags;
+  packet.messageNumber = messageNumber;
+  packet.data = PacketBuffer(data, size);
+  link.queued.push_back(std::move(transmission));
+  if (reliable) {
+    link.pendingReliable += size;
+  } else {
+    link.pendingUnreliable += size;
+  }
+  link.meterBytes += size;
+  link.meterPackets++;
+  // An unpaced link puts the message on the wire right away.
+  advanceLink(link, now);
+  arrivals_.notify_all();
+  return k_EResultOK;
+}
+
+LoopbackNetwork::Clock::time_point LoopbackNetwork::nextArrival(uint64_t to,
+                                                                int channel) {
+  auto next = Clock::time_point::max();
+  auto endpointIt = endpoints_.find(to);
+  if (endpointIt == endpoints_.end()) {
+    return next;
+  }
+  const auto &endpoint = endpointIt->second;
+  if (!endpoint.pendingRequests.empty() || !endpoint.pendingFailures.empty()) {
+    return Clock::time_point::min(); // the receive call runs the callbacks
+  }
+  for (const auto &entry : endpoint.inbox) {
+    const Packet &packet = entry.second;
+    if (packet.conn != k_HSteamNetConnection_Invalid ||
+        packet.channel != channel) {
+      continue;
+    }
+    auto sessionIt = endpoint.sessions.find(packet.from);
+    if (sessionIt != endpoint.sessions.end() && sessionIt->second.accepted) {
+      next = entry.first.first; // the inbox is ordered by delivery time
+      break;
+    }
+  }
+  // Whatever is still in a send queue reaches the inbox no earlier than it
+  // leaves that queue; wake up then and look again.
+  for (const auto &entry : links_) {
+    if (entry.first.second == to && !entry.second.queued.empty()) {
+      next = std::min(next, entry.second.queued.front().done);
+    }
+  }
+  return next;
+}
+
+void LoopbackNetwork::fillStatus(uint64_t from, uint64_t to,
+                                 SteamNetConnectionRealTimeStatus_t *status) {
+  Link &link = linkFor(from, to);
+  const auto now = Clock::now();
+  advanceLink(link, now);
+  const auto queueTime =
+      link.busyUntil > now
+          ? std::chrono::duration_cast<std::chrono::microseconds>(
+                link.busyUntil - now)
+          : std::chrono::microseconds(0);
+  const auto &conditions = link.conditions;
+  // Long-run share of datagrams sent while the link is in a loss burst.
+  const double burstShare =
+      conditions.burstEnterRate > 0.0
+          ? conditions.burstEnterRate /
+                (conditions.burstEnterRate + conditions.burstExitRate)
+          : 0.0;
+  const float quality =
+      static_cast<float>((1.0 - conditions.lossRate) *
+                         (1.0 - burstShare * conditions.burstLossRate)) *
+      (1.0f - link.dropRate);
+  const uint64_t sendRate =
+      link.sendRate > 0 ? link.sendRate : conditions.bandwidthBytesPerSec;
+
+  // Like Steam, ping is the network round trip; time spent in our own send
+  // queue is reported separately as m_usecQueueTime.
+  std::memset(status, 0, sizeof(*status));
+  status->m_eState = k_ESteamNetworkingConnectionState_Connected;
+  status->m_nPing = static_cast<int>(
+      (conditions.latency * 2 + link.lastBottleneckDelay) /
+      std::chrono::milliseconds(1));
+  status->m_flConnectionQualityLocal = quality;
+  status->m_flConnectionQualityRemote = quality;
+  status->m_flOutPacketsPerSec = link.outPacketsPerSec;
+  status->m_flOutBytesPerSec = link.outBytesPerSec;
+  status->m_nSendRateBytesPerSecond =
+      static_cast<int>(std::min<uint64_t>(sendRate, 0x7fffffff));
+  status->m_cbPendingUnreliable = static_cast<int>(link.pendingUnreliable);
+  status->m_cbPendingReliable = static_cast<int>(link.pendingReliable);
+  status->m_cbSentUnackedReliable =
+      static_cast<int>(link.sentUnackedReliable);
+  status->m_usecQueueTime = queueTime.count();
+}
+
+// Messages still waiting in the send queue are re-paced at the new rate, the
+// way Steam's pacer picks up a SendRate change immediately.
+void LoopbackNetwork::setSendRate(uint64_t from, uint64_t to,
+                                  int bytesPerSec) {
+  Link &link = linkFor(from, to);
+  const auto now = Clock::now();
+  advanceLink(link, now);
+  link.sendRate = bytesPerSec > 0 ? static_cast<uint64_t>(bytesPerSec) : 0;
+  const uint64_t sendRate =
+      link.sendRate > 0 ? link.sendRate : link.conditions.bandwidthBytesPerSec;
+  auto txEnd = now;
+  for (auto &transmission : link.queued) {
+    if (sendRate > 0) {
+      txEnd += serializationTime(
+          static_cast<uint32_t>(transmission.packet.data.size()), sendRate);
+    }
+    transmission.done = txEnd;
+  }
+  if (!link.queued.empty()) {
+    link.busyUntil = txEnd;
+  }
+  advanceLink(link, now);
+}
+
+void LoopbackNetwork::fillInfo(uint64_t from, uint64_t to,
+                               SteamNetConnectionInfo_t *info) {
+  const Link &link = linkFor(from, to);
+  std::memset(info, 0, sizeof(*info));
+  info->m_identityRemote = identityFor(to);
+  info->m_eState = k_ESteamNetworkingConnectionState_Connected;
+  info->m_nFlags =
+      link.conditions.relayed ? k_nSteamNetworkConnectionInfoFlags_Relayed : 0;
+}
+
+LoopbackTransport::LoopbackTransport(LoopbackNetwork *network, CSteamID steamID)
+    : network_(network), steamID_(steamID) {}
+
+LoopbackTransport::~LoopbackTransport() {
+  network_->removeEndpoint(steamID_.ConvertToUint64());
+}
+
+void LoopbackTransport::runCallbacks() {
+  std::vector<SteamNetworkingIdentity> requests;
+  std::vector<SteamNetConnectionInfo_t> failures;
+  {
+    std::lock_guard<std::mutex> lock(network_->mutex_);
+    auto it = network_->endpoints_.find(steamID_.ConvertToUint64());
+    if (it == network_->endpoints_.end()) {
+      return;
+    }
+    requests.swap(it->second.pendingRequests);
+    failures.swap(it->second.pendingFailures);
+  }
+  for (const auto &peer : requests) {
+    notifySessionRequest(peer);
+  }
+  for (const auto &info : failures) {
+    notifySessionFailed(info);
+  }
+}
+
+EResult LoopbackTransport::sendMessageToConnection(HSteamNetConnection conn,
+                                                   const void *data,
+                                                   uint32 size, int flags,
+                                                   int64 *outMessageNumber) {
+  std::lock_guard<std::mutex> lock(network_->mutex_);
+  auto it = network_->connections_.find(conn);
+  if (it == network_->connections_.end() ||
+      it->second.owner != steamID_.ConvertToUint64()) {
+    return k_EResultNoConnection;
+  }
+  return network_->enqueue(it->second.owner, it->second.peer,
+                           it->second.remote, 0, data, size, flags,
+                           outMessageNumber);
+}
+
+int LoopbackTransport::receiveMessagesOnConnection(
+    HSteamNetConnection conn, SteamNetworkingMessage_t **messages,
+    int maxMessages) {
+  std::lock_guard<std::mutex> lock(network_->mutex_);
+  auto endpointIt = network_->endpoints_.find(steamID_.ConvertToUint64());
+  if (endpointIt == network_->endpoints_.end() || conn ==
+      k_HSteamNetConnection_Invalid) {
+    return 0;
+  }
+  auto &inbox = endpointIt->second.inbox;
+  const auto now = LoopbackNetwork::Clock::now();
+  network_->advanceLinksTo(steamID_.ConvertToUint64(), now);
+  int count = 0;
+  for (auto it = inbox.begin();
+       it != inbox.end() && count < maxMessages && it->first.first <= now;) {
+    auto &packet = it->second;
+    if (packet.conn != conn) {
+      ++it;
+      continue;
+    }
+    messages[count++] = makeTransportMessage(
+        std::move(packet.data), CSteamID(static_cast<uint64>(packet.from)),
+        conn, 0, packet.flags, packet.messageNumber);
+    it = inbox.erase(it);
+  }
+  return count;
+}
+
+EResult LoopbackTransport::getConnectionRealTimeStatus(
+    HSteamNetConnection conn, SteamNetConnectionRealTimeStatus_t *status) {
+  std::lock_guard<std::mutex> lock(network_->mutex_);
+  auto it = network_->connections_.find(conn);
+  if (it == network_->connections_.end() ||
+      it->second.owner != steamID_.ConvertToUint64()) {
+    return k_EResultNoConnection;
+  }
+  if (status) {
+    network_->fillStatus(it->second.owner, it->second.peer, status);
+  }
+  return k_EResultOK;
+}
+
+bool LoopbackTransport::getConnectionInfo(HSteamNetConnection conn,
+                                          SteamNetConnectionInfo_t *info) {
+  std::lock_guard<std::mutex> lock(network_->mutex_);
+  auto it = network_->connections_.find(conn);
+  if (it == network_->connections_.end() ||
+      it->second.owner != steamID_.ConvertToUint64()) {
+    return false;
+  }
+  if (info) {
+    network_->fillInfo(it->second.owner, it->second.peer, info);
+  }
+  return true;
+}
+
+EResult LoopbackTransport::sendMessageToUser(
+    const SteamNetworkingIdentity &peer, const void *data, uint32 size,
+    int flags, int channel) {
+  std::lock_guard<std::mutex> lock(network_->mutex_);
+  return network_->sendToUser(steamID_.ConvertToUint64(), peer.GetSteamID64(),
+                              data, size, flags, channel);
+}
+
+void LoopbackTransport::sendMessageToUsers(const SteamNetworkingIdentity *peers,
+                                           int count, const void *data,
+                                           uint32 size, int flags, int channel,
+                                           EResult *results) {
+  const uint64_t self = steamID_.ConvertToUint64();
+  std::lock_guard<std::mutex> lock(network_->mutex_);
+  for (int i = 0; i < count; ++i) {
+    results[i] = network_->sendToUser(self, peers[i].GetSteamID64(), data,
+                                      size, flags, channel);
+  }
+}
+
+int LoopbackTransport::receiveMessagesOnChannel(
+    int channel, SteamNetworkingMessage_t **messages, int maxMessages) {
+  // Let the owner accept new sessions before we look at their traffic.
+  runCallbacks();
+
+  std::lock_guard<std::mutex> lock(network_->mutex_);
+  auto endpointIt = network_->endpoints_.find(steamID_.ConvertToUint64());
+  if (endpointIt == network_->endpoints_.end()) {
+    return 0;
+  }
+  auto &endpoint = endpointIt->second;
+  const auto now = LoopbackNetwork::Clock::now();
+  network_->advanceLinksTo(steamID_.ConvertToUint64(), now);
+  int count = 0;
+  for (auto it = endpoint.inbox.begin(); it != endpoint.inbox.end() &&
+                                         count < maxMessages &&
+                                         it->first.first <= now;) {
+    auto &packet = it->second;
+    if (packet.conn != k_HSteamNetConnection_Invalid ||
+        packet.channel != channel) {
+      ++it;
+      continue;
+    }
+    auto sessionIt = endpoint.sessions.find(packet.from);
+    if (sessionIt == endpoint.sessions.end() || !sessionIt->second.accepted) {
+      ++it; // held until the session is accepted
+      continue;
+    }
+    auto *message = makeTransportMessage(
+        std::move(packet.data), CSteamID(static_cast<uint64>(packet.from)),
+        k_HSteamNetConnection_Invalid, channel, packet.flags,
+        packet.messageNumber);
+    // Stamped with its arrival, so the receiver can see how long it waited.
+    message->m_usecTimeReceived =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            it->first.first.time_since_epoch())
+            .count();
+    messages[count++] = message;
+    it = endpoint.inbox.erase(it);
+  }
+  return count;
+}
+
+bool LoopbackTransport::waitForMessages(int channel,
+                                        std::chrono::microseconds timeout) {
+  const uint64_t self = steamID_.ConvertToUint64();
+  const auto deadline = LoopbackNetwork::Clock::now() + timeout;
+  std::unique_lock<std::mutex> lock(network_->mutex_);
+  while (true) {
+    const auto now = LoopbackNetwork::Clock::now();
+    network_->advanceLinksTo(self, now);
+    const auto next = network_->nextArrival(self, channel);
+    if (next <= now) {
+      return true;
+    }
+    if (now >= deadline) {
+      return false;
+    }
+    network_->arrivals_.wait_until(lock, std::min(next, deadline));
+  }
+}
+
+bool LoopbackTransport::acceptSessionWithUser(
+    const SteamNetworkingIdentity &peer) {
+  std::lock_guard<std::mutex> lock(network_->mutex_);
+  auto it = network_->endpoints_.find(steamID_.ConvertToUint64());
+  if (it == network_->endpoints_.end()) {
+    return false;
+  }
+  auto &session = it->second.sessions[peer.GetSteamID64()];
+  session.accepted = true;
+  session.requestPending = false;
+  network_->arrivals_.notify_all();
+  return true;
+}
+
+bool LoopbackTransport::closeSessionWithUser(
+    const SteamNetworkingIdentity &peer) {
+  const uint64_t target = peer.GetSteamID64();
+  std::lock_guard<std::mutex> lock(network_->mutex_);
+  auto it = network_->endpoints_.find(steamID_.ConvertToUint64());
+  if (it == network_->endpoints_.end()) {
+    return false;
+  }
+  auto &endpoint = it->second;
+  const bool existed = endpoint.sessions.erase(target) > 0;
+  for (auto packetIt = endpoint.inbox.begin();
+       packetIt != endpoint.inbox.end();) {
+    if (packetIt->second.from == target &&
+        packetIt->second.conn == k_HSteamNetConnection_Invalid) {
+      packetIt = endpoint.inbox.erase(packetIt);
+    } else {
+      ++packetIt;
+    }
+  }
+  return existed;
+}
+
+ESteamNetworkingConnectionState LoopbackTransport::getSessionConnectionInfo(
+    const SteamNetworkingIdentity &peer, SteamNetConnectionInfo_t *info,
+    SteamNetConnectionRealTimeStatus_t *status) {
+  const uint64_t self = steamID_.ConvertToUint64();
+  const uint64_t target = peer.GetSteamID64();
+  std::lock_guard<std::mutex> lock(network_->mutex_);
+  auto selfIt = network_->endpoints_.find(self);
+  if (selfIt == network_->endpoints_.end() ||
+      network_->endpoints_.count(target) == 0) {
+    return k_ESteamNetworkingConnectionState_None;
+  }
+  auto sessionIt = selfIt->second.sessions.find(target);
+  if (sessionIt == selfIt->second.sessions.end() ||
+      !sessionIt->second.accepted) {
+    return k_ESteamNetworkingConnectionState_None;
+  }
+  if (info) {
+    network_->fillInfo(self, target, info);
+  }
+  if (status) {
+    network_->fillStatus(self, target, status);
+  }
+  return k_ESteamNetworkingConnectionState_Connected;
+}
+
+bool LoopbackTransport::setConnectionSendRate(HSteamNetConnection conn,
+                                              int bytesPerSec) {
+  std::lock_guard<std::mutex> lock(network_->mutex_);
+  auto it = network_->connections_.find(conn);
+  if (it == network_->connections_.end() ||
+      it->second.owner != steamID_.ConvertToUint64()) {
+    return false;
+  }
+  network_->setSendRate(it->second.owner, it->second.peer, bytesPerSec);
+  return true;
+}
+
+bool LoopbackTransport::setSessionSendRate(const SteamNetworkingIdentity &peer,
+                                           int bytesPerSec) {
+  std::lock_guard<std::mutex> lock(network_->mutex_);
+  if (network_->endpoints_.count(peer.GetSteamID64()) == 0) {
+    return false;
+  }
+  network_->setSendRate(steamID_.ConvertToUint64(), peer.GetSteamID64(),
+                        bytesPerSec);
+  return true;
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "transport.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Per-direction link model between two loopback endpoints.
+struct LinkConditions {
+  std::chrono::microseconds latency{0}; // one-way propagation delay
+  double lossRate = 0.0;                // 0..1, applied to every datagram
+  // Gilbert-Elliott burst loss on top of lossRate: before each datagram the
+  // link enters the bad state with burstEnterRate and leaves it with
+  // burstExitRate; datagrams sent while bad are lost at burstLossRate.
+  double burstEnterRate = 0.0;
+  double burstExitRate = 0.0;
+  double burstLossRate = 1.0;
+  uint64_t bandwidthBytesPerSec = 0;    // sender pacing rate, 0 = unlimited
+  std::size_t sendBufferBytes = 2 * 1024 * 1024;
+  bool relayed = false; // reported as a relayed (SDR) path
+  // Router behind the sender's pacer (0 = none). Datagrams that outrun it
+  // queue there, which shows up as RTT, and are tail-dropped once that queue
+  // holds bottleneckBufferBytes (0 = unbounded).
+  uint64_t bottleneckBytesPerSec = 0;
+  std::size_t bottleneckBufferBytes = 0;
+};
+
+class LoopbackTransport;
+
+// In-process network for simulations and benchmarks. Delivery times follow the
+// configured latency and bandwidth, so a sender that outruns the link builds
+// a queue and eventually sees k_EResultLimitExceeded exactly like on Steam.
+// Unreliable messages are dropped at lossRate and in loss bursts; reliable
+// ones are never lost but pay a retransmit delay and keep their ordering. A
+// send rate set through the Transport overrides bandwidthBytesPerSec, like
+// SendRateMin/Max would.
+class LoopbackNetwork {
+public:
+  LoopbackNetwork();
+  ~LoopbackNetwork();
+
+  LoopbackNetwork(const LoopbackNetwork &) = delete;
+  LoopbackNetwork &operator=(const LoopbackNetwork &) = delete;
+
+  std::unique_ptr<LoopbackTransport> createEndpoint(CSteamID steamID);
+  // Opens a connection pair; returns {handle on a, handle on b}.
+  std::pair<HSteamNetConnection, HSteamNetConnection>
+  connect(const LoopbackTransport &a, const LoopbackTransport &b);
+
+  void setDefaultConditions(const LinkConditions &conditions);
+  void setConditions(CSteamID from, CSteamID to,
+                     const LinkConditions &conditions);
+  void setSeed(uint32_t seed);
+
+private:
+  friend class LoopbackTransport;
+  using Clock = std::chrono::steady_clock;
+
+  struct Packet {
+    uint64_t from = 0;
+    HSteamNetConnection conn = k_HSteamNetConnection_Invalid;
+    int channel = 0;
+    int flags = 0;
+    int64 messageNumber = 0;
+    PacketBuffer data;
+  };
+
+  struct Transmission {
+    Clock::time_point done; // leaves our send queue
+    bool reliable = false;
+    Packet packet;
+  };
+
+  struct InFlight {
+    Clock::time_point acked; // delivery + return trip
+    uint32_t size = 0;
+  };
+
+  struct Link {
+    uint64_t to = 0;
+    LinkConditions conditions;
+    uint64_t sendRate = 0; // set through the Transport, 0 = conditions
+    Clock::time_point busyUntil;
+    Clock::time_point bottleneckBusyUntil;
+    Clock::duration lastBottleneckDelay{0};
+    Clock::time_point lastReliableDelivery;
+    bool inBurst = false;
+    std::deque<Transmission> queued;  // not yet on the wire
+    std::deque<InFlight> unacked;     // reliable, on the wire
+    std::size_t pendingReliable = 0;
+    std::size_t pendingUnreliable = 0;
+    std::size_t sentUnackedReliable = 0;
+    int64 nextMessageNumber = 1;
+    Clock::time_point meterStart;
+    uint64_t meterBytes = 0;
+    uint64_t meterPackets = 0;
+    uint64_t meterDropped = 0;
+    float outBytesPerSec = 0.0f;
+    float outPacketsPerSec = 0.0f;
+    float dropRate = 0.0f; // bottleneck tail drops over the last window
+  };
+
+  struct Connection {
+    uint64_t owner = 0;
+    uint64_t peer = 0;
+    HSteamNetConnection remote = k_HSteamNetConnection_Invalid;
+  };
+
+  struct Session {
+    bool accepted = false;
+    bool requestPending = false;
+  };
+
+  struct Endpoint {
+    std::multimap<std::pair<Clock::time_point, uint64_t>, Packet> inbox;
+    std::map<uint64_t, Session> sessions;
+    std::vector<SteamNetworkingIdentity> pendingRequests;
+    std::vector<SteamNetConnectionInfo_t> pendingFailures;
+  };
+
+  void removeEndpoint(uint64_t steamID);
+  Link &linkFor(uint64_t from, uint64_t to);
+  void advanceLink(Link &link, Clock::time_point now);
+  void advanceLinksTo(uint64_t to, Clock::time_point now);
+  void transmit(Link &link, Transmission sent);
+  EResult sendToUser(uint64_t from, uint64_t to, const void *data,
+                     uint32 size, int flags, int channel);
+  EResult enqueue(uint64_t from, uint64_t to, HSteamNetConnection remoteConn,
+                  int channel, const void *data, uint32 size, int flags,
+                  int64 *outMessageNumber);
+  void fillStatus(uint64_t from, uint64_t to,
+                  SteamNetConnectionRealTimeStatus_t *status);
+  void fillInfo(uint64_t from, uint64_t to, SteamNetConnectionInfo_t *info);
+  void setSendRate(uint64_t from, uint64_t to, int bytesPerSec);
+  // When the next message on channel becomes receivable by endpoint to, or
+  // has a chance to; Clock::time_point::max() if nothing is on its way.
+  Clock::time_point nextArrival(uint64_t to, int channel);
+
+  std::mutex mutex_;
+  std::condition_variable arrivals_; // inboxes, queues or sessions changed
+  std::map<uint64_t, Endpoint> endpoints_;
+  std::map<std::pair<uint64_t, uint64_t>, Link> links_;
+  std::map<HSteamNetConnection, Connection> connections_;
+  HSteamNetConnection nextConnection_ = 1;
+  uint64_t nextSequence_ = 0;
+  LinkConditions defaultConditions_;
+  std::mt19937 rng_;
+};
+
+class LoopbackTransport : public Transport {
+public:
+  ~LoopbackTransport() override;
+
+  CSteamID localSteamID() const override { return steamID_; }
+  void runCallbacks() override;
+
+  EResult sendMessageToConnection(HSteamNetConnection conn, const void *data,
+                                  uint32 size, int flags,
+                                  int64 *outMessageNumber) override;
+  int receiveMessagesOnConnection(HSteamNetConnection conn,
+                                  SteamNetworkingMessage_t **messages,
+                                  int maxMessages) override;
+  EResult
+  getConnectionRealTimeStatus(HSteamNetConnection conn,
+                              SteamNetConnectionRealTimeStatus_t *status) override;
+  bool getConnectionInfo(HSteamNetConnection conn,
+                         SteamNetConnectionInfo_t *info) override;
+
+  EResult sendMessageToUser(const SteamNetworkingIdentity &peer,
+                            const void *data, uint32 size, int flags,
+                            int channel) override;
+  // Takes the network lock once for the whole batch.
+  void sendMessageToUsers(const SteamNetworkingIdentity *peers, int count,
+                          const void *data, uint32 size, int flags,
+                          int channel, EResult *results) override;
+  int receiveMessagesOnChannel(int channel, SteamNetworkingMessage_t **messages,
+                               int maxMessages) override;
+  bool acceptSessionWithUser(const SteamNetworkingIdentity &peer) override;
+  bool closeSessionWithUser(const SteamNetworkingIdentity &peer) override;
+  ESteamNetworkingConnectionState
+  getSessionConnectionInfo(const SteamNetworkingIdentity &peer,
+                           SteamNetConnectionInfo_t *info,
+                           SteamNetConnectionRealTimeStatus_t *status) override;
+
+  bool setConnectionSendRate(HSteamNetConnection conn,
+                             int bytesPerSec) override;
+  bool setSessionSendRate(const SteamNetworkingIdentity &peer,
+                          int bytesPerSec) override;
+
+  bool canWaitForMessages() const override { return true; }
+  bool waitForMessages(int channel,
+                       std::chrono::microseconds timeout) override;
+
+private:
+  friend class LoopbackNetwork;
+  LoopbackTransport(LoopbackNetwork *network, CSteamID steamID);
+
+  LoopbackNetwork *network_;
+  CSteamID steamID_;
+};
@@ -0,0 +1,187 @@
+#include "lz4.h"
+#include <cstdint>
+#include <cstring>
+
+namespace lz4 {
+namespace {
+constexpr int kMinMatch = 4;
+constexpr int kLastLiterals = 5; // the block always ends with literals
+constexpr int kMatchSearchLimit = 12; // no match may start in the last 12
+constexpr int kHashLog = 12;
+constexpr std::size_t kMaxOffset = 65535;
+constexpr int kSkipTrigger = 6; // search step grows every 64 misses
+
+uint32_t read32(const uint8_t *p) {
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+uint32_t hashSequence(uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - kHashLog);
+}
+
+uint8_t *writeLength(uint8_t *op, std::size_t length) {
+  while (length >= 255) {
+    *op++ = 255;
+    length -= 255;
+  }
+  *op++ = static_cast<uint8_t>(length);
+  return op;
+}
+
+uint8_t *writeLiterals(uint8_t *op, uint8_t *&token, const uint8_t *anchor,
+                       std::size_t length) {
+  token = op++;
+  *token = static_cast<uint8_t>((length >= 15 ? 15 : length) << 4);
+  if (length >= 15) {
+    op = writeLength(op, length - 15);
+  }
+  if (length > 0) {
+    std::memcpy(op, anchor, length);
+  }
+  return op + length;
+}
+
+bool readLength(const uint8_t *&ip, const uint8_t *end, std::size_t &length) {
+  uint8_t byte = 0;
+  do {
+    if (ip >= end) {
+      return false;
+    }
+    byte = *ip++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+} // namespace
+
+int compressBound(int sourceSize) {
+  return sourceSize < 0 ? 0 : sourceSize + sourceSize / 255 + 16;
+}
+
+int compress(const char *source, int sourceSize, char *dest, int capacity) {
+  if (sourceSize < 0 || capacity < compressBound(sourceSize)) {
+    return 0;
+  }
+  const uint8_t *src = reinterpret_cast<const uint8_t *>(source);
+  const uint8_t *ip = src;
+  const uint8_t *anchor = src;
+  const uint8_t *end = src + sourceSize;
+  uint8_t *op = reinterpret_cast<uint8_t *>(dest);
+  uint8_t *token = nullptr;
+
+  if (sourceSize > kMatchSearchLimit) {
+    uint32_t table[1 << kHashLog] = {};
+    const uint8_t *searchEnd = end - kMatchSearchLimit;
+    const uint8_t *matchEnd = end - kLastLiterals;
+    unsigned misses = 1u << kSkipTrigger;
+    while (ip < searchEnd) {
+      const uint32_t sequence = read32(ip);
+      const uint32_t hash = hashSequence(sequence);
+      const uint8_t *ref = src + table[hash];
+      table[hash] = static_cast<uint32_t>(ip - src);
+      if (ref >= ip || static_cast<std::size_t>(ip - ref) > kMaxOffset ||
+          read32(ref) != sequence) {
+        ip += misses++ >> kSkipTrigger;
+        continue;
+      }
+      misses = 1u << kSkipTrigger;
+      while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+        --ip;
+        --ref;
+      }
+      const uint8_t *matchIp = ip + kMinMatch;
+      const uint8_t *matchRef = ref + kMinMatch;
+      while (matchIp < matchEnd && *matchIp == *matchRef) {
+        ++matchIp;
+        ++matchRef;
+      }
+
+      op = writeLiterals(op, token, anchor,
+                         static_cast<std::size_t>(ip - anchor));
+      const auto offset = static_cast<uint16_t>(ip - ref);
+      *op++ = static_cast<uint8_t>(offset & 0xFF);
+      *op++ = static_cast<uint8_t>(offset >> 8);
+      const auto matchLength =
+          static_cast<std::size_t>(matchIp - ip - kMinMatch);
+      *token |= static_cast<uint8_t>(matchLength >= 15 ? 15 : matchLength);
+      if (matchLength >= 15) {
+        op = writeLength(op, matchLength - 15);
+      }
+      ip = matchIp;
+      anchor = ip;
+      if (ip < searchEnd) {
+        table[hashSequence(read32(ip - 2))] =
+            static_cast<uint32_t>(ip - 2 - src);
+      }
+    }
+  }
+
+  op = writeLiterals(op, token, anchor, static_cast<std::size_t>(end - anchor));
+  return static_cast<int>(op - reinterpret_cast<uint8_t *>(dest));
+}
+
+int decompress(const char *source, int sourceSize, char *dest, int capacity) {
+  if (sourceSize <= 0 || capacity < 0) {
+    return -1;
+  }
+  const uint8_t *ip = reinterpret_cast<const uint8_t *>(source);
+  const uint8_t *end = ip + sourceSize;
+  uint8_t *const start = reinterpret_cast<uint8_t *>(dest);
+  uint8_t *op = start;
+  uint8_t *const limit = start + capacity;
+
+  while (true) {
+    const uint8_t token = *ip++;
+    std::size_t literals = token >> 4;
+    if (literals == 15 && !readLength(ip, end, literals)) {
+      return -1;
+    }
+    if (literals > static_cast<std::size_t>(end - ip) ||
+        literals > static_cast<std::size_t>(limit - op)) {
+      return -1;
+    }
+    if (literals > 0) {
+      std::memcpy(op, ip, literals);
+    }
+    op += literals;
+    ip += literals;
+    if (ip == end) {
+      break; // the last sequence carries literals only
+    }
+
+    if (end - ip < 2) {
+      return -1;
+    }
+    const std::size_t offset = ip[0] | (static_cast<std::size_t>(ip[1]) << 8);
+    ip += 2;
+    if (offset == 0 || offset > static_cast<std::size_t>(op - start)) {
+      return -1;
+    }
+    std::size_t matchLength = token & 0x0F;
+    if (matchLength == 15 && !readLength(ip, end, matchLength)) {
+      return -1;
+    }
+    matchLength += kMinMatch;
+    if (matchLength > static_cast<std::size_t>(limit - op)) {
+      return -1;
+    }
+    const uint8_t *match = op - offset;
+    if (offset >= matchLength) {
+      std::memcpy(op, match, matchLength);
+      op += matchLength;
+    } else {
+      // Overlapping copy repeats the last `offset` bytes (run-length case).
+      for (std::size_t i = 0; i < matchLength; ++i) {
+        *op++ = *match++;
+      }
+    }
+    if (ip >= end) {
+      return -1;
+    }
+  }
+  return static_cast<int>(op - start);
+}
+
+} // namespace lz4
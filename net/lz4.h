@@ -0,0 +1,18 @@
+#pragma once
+
+// Minimal LZ4 block codec (the raw block format, no frame header), enough
+// for the tunnel's per-stream compression without an external dependency.
+// Output is readable by the reference LZ4_decompress_safe and vice versa.
+namespace lz4 {
+
+// Worst-case compressed size of sourceSize bytes.
+int compressBound(int sourceSize);
+
+// Returns the compressed size, or 0 when capacity < compressBound(sourceSize).
+int compress(const char *source, int sourceSize, char *dest, int capacity);
+
+// Returns the decompressed size, or -1 when the input is malformed or would
+// not fit in capacity bytes.
+int decompress(const char *source, int sourceSize, char *dest, int capacity);
+
+} // namespace lz4
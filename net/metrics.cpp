@@ -0,0 +1,395 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+
+namespace metrics {
+
+namespace {
+constexpr uint64_t kMaxTrackedMicros = (uint64_t{1} << 40) - 1;
+
+int highestBit(uint64_t value) {
+  int bit = 0;
+  while (value >>= 1) {
+    ++bit;
+  }
+  return bit;
+}
+
+double toSeconds(uint64_t micros) { return static_cast<double>(micros) / 1e6; }
+
+void writeSummary(std::ostringstream &out, const std::string &name,
+                  const std::string &labels, const Histogram::Snapshot &snap) {
+  const std::string prefix = labels.empty() ? "{" : "{" + labels + ",";
+  for (double q : {0.5, 0.99, 0.999}) {
+    out << name << prefix << "quantile=\"" << q << "\"} "
+        << toSeconds(snap.percentile(q)) << "\n";
+  }
+  const std::string suffix = labels.empty() ? "" : "{" + labels + "}";
+  out << name << "_sum" << suffix << " " << toSeconds(snap.sumMicros) << "\n";
+  out << name << "_count" << suffix << " " << snap.count << "\n";
+}
+
+void writeHeader(std::ostringstream &out, const char *name, const char *type,
+                 const char *help) {
+  out << "# HELP " << name << " " << help << "\n";
+  out << "# TYPE " << name << " " << type << "\n";
+}
+} // namespace
+
+const char *dropReasonName(DropReason reason) {
+  switch (reason) {
+  case DropReason::NoRoute:
+    return "no_route";
+  case DropReason::SendLimitExceeded:
+    return "send_limit_exceeded";
+  case DropReason::TunWriteFailed:
+    return "tun_write_failed";
+  case DropReason::QueueFull:
+    return "queue_full";
+  case DropReason::QueueDelay:
+    return "queue_delay";
+  default:
+    return "unknown";
+  }
+}
+
+std::size_t Counter::shardIndex() {
+  static std::atomic<std::size_t> nextShard{0};
+  thread_local const std::size_t shard =
+      nextShard.fetch_add(1, std::memory_order_relaxed) % kShards;
+  return shard;
+}
+
+uint64_t Counter::value() const {
+  uint64_t total = 0;
+  for (const auto &shard : shards_) {
+    total += shard.value.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+std::size_t Histogram::bucketFor(uint64_t micros) {
+  if (micros < kSubBuckets) {
+    return static_cast<std::size_t>(micros);
+  }
+  micros = std::min(micros, kMaxTrackedMicros);
+  const int shift = highestBit(micros) - 3;
+  const std::size_t sub = static_cast<std::size_t>(micros >> shift) - 8;
+  return (static_cast<std::size_t>(shift) + 1) * kSubBuckets + sub;
+}
+
+uint64_t Histogram::bucketUpperBound(std::size_t bucket) {
+  if (bucket < kSubBuckets) {
+    return bucket;
+  }
+  const std::size_t shift = bucket / kSubBuckets - 1;
+  const uint64_t sub = bucket % kSubBuckets;
+  return ((8 + sub + 1) << shift) - 1;
+}
+
+void Histogram::record(uint64_t micros) {
+  buckets_[bucketFor(micros)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(micros, std::memory_order_relaxed);
+  uint64_t seen = max_.load(std::memory_order_relaxed);
+  while (micros > seen &&
+         !max_.compare_exchange_weak(seen, micros, std::memory_order_relaxed)) {
+  }
+}
+
+void Histogram::record(std::chrono::steady_clock::duration elapsed) {
+  const auto micros =
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+  record(static_cast<uint64_t>(std::max<int64_t>(micros, 0)));
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+  Snapshot snap;
+  for (std::size_t i = 0; i < kBucketCount; ++i) {
+    snap.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    snap.count += snap.buckets[i];
+  }
+  snap.sumMicros = sum_.load(std::memory_order_relaxed);
+  snap.maxMicros = max_.load(std::memory_order_relaxed);
+  return snap;
+}
+
+uint64_t Histogram::Snapshot::percentile(double p) const {
+  if (count == 0) {
+    return 0;
+  }
+  const uint64_t target = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(p * static_cast<double>(count))));
+  uint64_t seen = 0;
+  for (std::size_t i = 0; i < kBucketCount; ++i) {
+    seen += buckets[i];
+    if (seen >= target) {
+      return std::min(bucketUpperBound(i), maxMicros);
+    }
+  }
+  return maxMicros;
+}
+
+uint64_t PeerMetrics::totalDrops() const {
+  uint64_t total = 0;
+  for (const auto &counter : drops) {
+    total += counter.value();
+  }
+  return total;
+}
+
+Registry &Registry::instance() {
+  static Registry registry;
+  return registry;
+}
+
+std::shared_ptr<PeerMetrics> Registry::peer(uint64_t steamId) {
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = peers_.find(steamId);
+    if (it != peers_.end()) {
+      return it->second;
+    }
+  }
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  auto &entry = peers_[steamId];
+  if (!entry) {
+    entry = std::make_shared<PeerMetrics>();
+  }
+  return entry;
+}
+
+std::shared_ptr<StreamMetrics> Registry::stream(uint64_t steamId,
+                                                const std::string &streamId) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  auto &entry = streams_[{steamId, streamId}];
+  if (!entry) {
+    entry = std::make_shared<StreamMetrics>();
+  }
+  return entry;
+}
+
+void Registry::removeStream(uint64_t steamId, const std::string &streamId) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  streams_.erase({steamId, streamId});
+}
+
+void Registry::recordDrop(DropReason reason, uint64_t steamId) {
+  const auto index = static_cast<std::size_t>(reason);
+  if (index >= kDropReasonCount) {
+    return;
+  }
+  drops_[index].add();
+  if (steamId != 0) {
+    peer(steamId)->drops[index].add();
+  }
+}
+
+std::vector<PeerTotals> Registry::peerTotals() const {
+  std::vector<PeerTotals> totals;
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  totals.reserve(peers_.size());
+  for (const auto &kv : peers_) {
+    PeerTotals entry;
+    entry.steamId = kv.first;
+    entry.txPackets = kv.second->txPackets.value();
+    entry.txBytes = kv.second->txBytes.value();
+    entry.rxPackets = kv.second->rxPackets.value();
+    entry.rxBytes = kv.second->rxBytes.value();
+    entry.drops = kv.second->totalDrops();
+    totals.push_back(entry);
+  }
+  return totals;
+}
+
+std::string Registry::renderPrometheus() const {
+  std::ostringstream out;
+  out << std::setprecision(9);
+
+  std::map<uint64_t, std::shared_ptr<PeerMetrics>> peers;
+  std::map<std::pair<uint64_t, std::string>, std::shared_ptr<StreamMetrics>>
+      streams;
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    peers = peers_;
+    streams = streams_;
+  }
+
+  struct PeerCounter {
+    const char *name;
+    const char *help;
+    const Counter PeerMetrics::*counter;
+  };
+  static const PeerCounter kPeerCounters[] = {
+      {"connecttool_peer_tx_packets_total", "Packets sent to the peer.",
+       &PeerMetrics::txPackets},
+      {"connecttool_peer_tx_bytes_total", "Bytes sent to the peer.",
+       &PeerMetrics::txBytes},
+      {"connecttool_peer_rx_packets_total", "Packets received from the peer.",
+       &PeerMetrics::rxPackets},
+      {"connecttool_peer_rx_bytes_total", "Bytes received from the peer.",
+       &PeerMetrics::rxBytes},
+  };
+  for (const auto &metric : kPeerCounters) {
+    writeHeader(out, metric.name, "counter", metric.help);
+    for (const auto &kv : peers) {
+      out << metric.name << "{peer=\"" << kv.first << "\"} "
+          << ((*kv.second).*metric.counter).value() << "\n";
+    }
+  }
+
+  writeHeader(out, "connecttool_peer_drops_total", "counter",
+              "Packets to or from the peer dropped, by reason.");
+  for (const auto &kv : peers) {
+    for (std::size_t i = 0; i < kDropReasonCount; ++i) {
+      out << "connecttool_peer_drops_total{peer=\"" << kv.first
+          << "\",reason=\"" << dropReasonName(static_cast<DropReason>(i))
+          << "\"} " << kv.second->drops[i].value() << "\n";
+    }
+  }
+
+  writeHeader(out, "connecttool_peer_egress_queue_packets", "gauge",
+              "TUN packets waiting in the egress queue for the peer.");
+  for (const auto &kv : peers) {
+    out << "connecttool_peer_egress_queue_packets{peer=\"" << kv.first << "\"} "
+        << kv.second->egressQueuePackets.load(std::memory_order_relaxed)
+        << "\n";
+  }
+  writeHeader(out, "connecttool_peer_egress_queue_bytes", "gauge",
+              "Bytes waiting in the egress queue for the peer.");
+  for (const auto &kv : peers) {
+    out << "connecttool_peer_egress_queue_bytes{peer=\"" << kv.first << "\"} "
+        << kv.second->egressQueueBytes.load(std::memory_order_relaxed) << "\n";
+  }
+  writeHeader(out, "connecttool_peer_egress_sojourn_seconds", "summary",
+              "Time TUN packets to the peer waited in the egress queue.");
+  for (const auto &kv : peers) {
+    writeSummary(out, "connecttool_peer_egress_sojourn_seconds",
+                 "peer=\"" + std::to_string(kv.first) + "\"",
+                 kv.second->egressSojourn.snapshot());
+  }
+
+  writeHeader(out, "connecttool_drops_total", "counter",
+              "Packets dropped on the data path, by reason.");
+  for (std::size_t i = 0; i < kDropReasonCount; ++i) {
+    out << "connecttool_drops_total{reason=\""
+        << dropReasonName(static_cast<DropReason>(i)) << "\"} "
+        << drops_[i].value() << "\n";
+  }
+
+  struct ClassCounter {
+    const char *name;
+    const char *help;
+    const Counter ClassMetrics::*counter;
+  };
+  static const ClassCounter kClassCounters[] = {
+      {"connecttool_class_tx_packets_total",
+       "TUN packets sent, by traffic class.", &ClassMetrics::txPackets},
+      {"connecttool_class_tx_bytes_total", "TUN bytes sent, by traffic class.",
+       &ClassMetrics::txBytes},
+      {"connecttool_class_drops_total",
+       "TUN packets dropped by the egress queues, by traffic class.",
+       &ClassMetrics::drops},
+  };
+  for (const auto &metric : kClassCounters) {
+    writeHeader(out, metric.name, "counter", metric.help);
+    for (std::size_t i = 0; i < kTrafficClassCount; ++i) {
+      out << metric.name << "{class=\""
+          << trafficClassName(static_cast<TrafficClass>(i)) << "\"} "
+          << (classes_[i].*metric.counter).value() << "\n";
+    }
+  }
+  writeHeader(out, "connecttool_class_egress_sojourn_seconds", "summary",
+              "Time TUN packets waited in the egress queues, by class.");
+  for (std::size_t i = 0; i < kTrafficClassCount; ++i) {
+    writeSummary(out, "connecttool_class_egress_sojourn_seconds",
+                 std::string("class=\"") +
+                     trafficClassName(static_cast<TrafficClass>(i)) + "\"",
+                 classes_[i].egressSojourn.snapshot());
+  }
+
+  writeHeader(out, "connecttool_stream_tx_bytes_total", "counter",
+              "Bytes read from a local TCP client and tunneled.");
+  for (const auto &kv : streams) {
+    out << "connecttool_stream_tx_bytes_total{peer=\"" << kv.first.first
+        << "\",stream=\"" << kv.first.second << "\"} "
+        << kv.second->txBytes.value() << "\n";
+  }
+  writeHeader(out, "connecttool_stream_rx_bytes_total", "counter",
+              "Bytes received from the tunnel and written to a local client.");
+  for (const auto &kv : streams) {
+    out << "connecttool_stream_rx_bytes_total{peer=\"" << kv.first.first
+        << "\",stream=\"" << kv.first.second << "\"} "
+        << kv.second->rxBytes.value() << "\n";
+  }
+  writeHeader(out, "connecttool_stream_compression_saved_bytes_total",
+              "counter", "Bytes tunnel compression kept off the wire.");
+  for (const auto &kv : streams) {
+    out << "connecttool_stream_compression_saved_bytes_total{peer=\""
+        << kv.first.first << "\",stream=\"" << kv.first.second << "\"} "
+        << kv.second->compressionSavedBytes.value() << "\n";
+  }
+  writeHeader(out, "connecttool_stream_compression_cpu_seconds_total",
+              "counter", "CPU time spent compressing and decompressing.");
+  for (const auto &kv : streams) {
+    out << "connecttool_stream_compression_cpu_seconds_total{peer=\""
+        << kv.first.first << "\",stream=\"" << kv.first.second << "\"} "
+        << static_cast<double>(kv.second->compressionNanos.value()) / 1e9
+        << "\n";
+  }
+  writeHeader(out, "connecttool_stream_queue_delay_seconds", "summary",
+              "Time a stream's packets waited in the multiplexer queue.");
+  for (const auto &kv : streams) {
+    std::ostringstream labels;
+    labels << "peer=\"" << kv.first.first << "\",stream=\"" << kv.first.second
+           << "\"";
+    writeSummary(out, "connecttool_stream_queue_delay_seconds", labels.str(),
+                 kv.second->queueDelay.snapshot());
+  }
+
+  struct GlobalHistogram {
+    const char *name;
+    const char *help;
+    const Histogram &histogram;
+  };
+  const GlobalHistogram histograms[] = {
+      {"connecttool_queue_delay_seconds",
+       "Time packets waited in the multiplexer send queue.", queueDelay},
+      {"connecttool_send_to_ack_seconds",
+       "Transport queue time plus RTT seen by reliable sends.", sendToAck},
+      {"connecttool_tun_write_seconds", "Duration of TUN device writes.",
+       tunWrite},
+      {"connecttool_poll_lag_seconds",
+       "How late poll timers and parks ended relative to their schedule.",
+       pollLag},
+      {"connecttool_rx_pickup_delay_seconds",
+       "Time received VPN messages waited before the receiver took them.",
+       pickupDelay},
+      {"connecttool_backpressure_seconds",
+       "Duration of send-blocked (backpressure) episodes.", backpressure},
+  };
+  for (const auto &metric : histograms) {
+    writeHeader(out, metric.name, "summary", metric.help);
+    writeSummary(out, metric.name, "", metric.histogram.snapshot());
+  }
+
+  writeHeader(out, "connecttool_backpressure_episodes_total", "counter",
+              "Number of times a tunnel entered the send-blocked state.");
+  out << "connecttool_backpressure_episodes_total "
+      << backpressureEpisodes.value() << "\n";
+  writeHeader(out, "connecttool_fec_parity_packets_total", "counter",
+              "FEC parity packets sent for unreliable TUN traffic.");
+  out << "connecttool_fec_parity_packets_total " << fecParityPackets.value()
+      << "\n";
+  writeHeader(out, "connecttool_fec_recovered_packets_total", "counter",
+              "TUN packets rebuilt from FEC parity instead of being lost.");
+  out << "connecttool_fec_recovered_packets_total "
+      << fecRecoveredPackets.value() << "\n";
+  return out.str();
+}
+
+} // namespace metrics
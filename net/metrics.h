@@ -0,0 +1,172 @@
+#pragma once
+
+#include "traffic_classifier.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace metrics {
+
+enum class DropReason : std::size_t {
+  NoRoute = 0,
+  SendLimitExceeded,
+  TunWriteFailed,
+  QueueFull,  // a peer's egress queue had no room
+  QueueDelay, // dropped by CoDel for waiting too long in the egress queue
+  Count
+};
+
+constexpr std::size_t kDropReasonCount =
+    static_cast<std::size_t>(DropReason::Count);
+
+const char *dropReasonName(DropReason reason);
+
+// Monotonic counter split into cache-line sized shards. Each thread sticks to
+// one shard, so hot paths never contend on a shared atomic; value() sums them.
+class Counter {
+public:
+  void add(uint64_t n = 1) {
+    shards_[shardIndex()].value.fetch_add(n, std::memory_order_relaxed);
+  }
+  uint64_t value() const;
+
+private:
+  static constexpr std::size_t kShards = 8;
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> value{0};
+  };
+
+  static std::size_t shardIndex();
+
+  std::array<Shard, kShards> shards_{};
+};
+
+// Log-linear latency histogram in microseconds. Like HdrHistogram, every
+// power of two is split into 8 linear sub-buckets, so a reported percentile is
+// within 12.5% of the recorded value from 1 us up to ~12 days.
+class Histogram {
+public:
+  static constexpr std::size_t kSubBuckets = 8;
+  static constexpr std::size_t kBucketCount = 38 * kSubBuckets;
+
+  struct Snapshot {
+    uint64_t count = 0;
+    uint64_t sumMicros = 0;
+    uint64_t maxMicros = 0;
+    std::array<uint64_t, kBucketCount> buckets{};
+
+    uint64_t percentile(double p) const;
+  };
+
+  void record(uint64_t micros);
+  void record(std::chrono::steady_clock::duration elapsed);
+  void recordSince(std::chrono::steady_clock::time_point start) {
+    record(std::chrono::steady_clock::now() - start);
+  }
+  Snapshot snapshot() const;
+
+  static std::size_t bucketFor(uint64_t micros);
+  static uint64_t bucketUpperBound(std::size_t bucket);
+
+private:
+  std::array<std::atomic<uint64_t>, kBucketCount> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_{0};
+  std::atomic<uint64_t> max_{0};
+};
+
+struct PeerMetrics {
+  Counter txPackets;
+  Counter txBytes;
+  Counter rxPackets;
+  Counter rxBytes;
+  std::array<Counter, kDropReasonCount> drops;
+  // TUN traffic waiting in our egress queue for the peer, and how long each
+  // sent message waited there.
+  std::atomic<uint64_t> egressQueuePackets{0};
+  std::atomic<uint64_t> egressQueueBytes{0};
+  Histogram egressSojourn;
+
+  uint64_t totalDrops() const;
+};
+
+// TUN traffic of one class, across peers: what left for the transport, what
+// the egress queues dropped and how long the sent messages waited there.
+struct ClassMetrics {
+  Counter txPackets;
+  Counter txBytes;
+  Counter drops;
+  Histogram egressSojourn;
+};
+
+// One multiplexed TCP stream inside a peer connection (TCP mode).
+struct StreamMetrics {
+  Counter txBytes;
+  Counter rxBytes;
+  Histogram queueDelay;
+  Counter compressedBytes;       // raw bytes sent LZ4-compressed
+  Counter compressionSavedBytes; // what compression took off the wire
+  Counter compressionNanos;      // CPU time compressing and decompressing
+};
+
+struct PeerTotals {
+  uint64_t steamId = 0;
+  uint64_t txPackets = 0;
+  uint64_t txBytes = 0;
+  uint64_t rxPackets = 0;
+  uint64_t rxBytes = 0;
+  uint64_t drops = 0;
+};
+
+class Registry {
+public:
+  static Registry &instance();
+
+  // Handles are stable for the life of the process (peers) or until
+  // removeStream(); callers on hot paths should cache them.
+  std::shared_ptr<PeerMetrics> peer(uint64_t steamId);
+  std::shared_ptr<StreamMetrics> stream(uint64_t steamId,
+                                        const std::string &streamId);
+  void removeStream(uint64_t steamId, const std::string &streamId);
+
+  // steamId 0 records the drop globally only (e.g. no route to anyone).
+  void recordDrop(DropReason reason, uint64_t steamId = 0);
+  ClassMetrics &trafficClass(TrafficClass trafficClass) {
+    return classes_[static_cast<std::size_t>(trafficClass)];
+  }
+
+  std::vector<PeerTotals> peerTotals() const;
+  std::string renderPrometheus() const;
+
+  Histogram queueDelay;   // time spent in the multiplexer send queue
+  Histogram sendToAck;    // transport queue time + RTT for reliable sends
+  Histogram tunWrite;     // TunInterface::write duration
+  Histogram pollLag;      // poll timers and parks ending later than scheduled
+  Histogram pickupDelay;  // VPN messages waiting for the receiver
+  Histogram backpressure; // duration of send-blocked episodes
+  Counter backpressureEpisodes;
+  Counter fecParityPackets;    // FEC parity packets sent in TUN mode
+  Counter fecRecoveredPackets; // TUN packets rebuilt from FEC parity
+
+private:
+  Registry() = default;
+
+  mutable std::shared_mutex mutex_;
+  std::map<uint64_t, std::shared_ptr<PeerMetrics>> peers_;
+  std::map<std::pair<uint64_t, std::string>, std::shared_ptr<StreamMetrics>>
+      streams_;
+  std::array<Counter, kDropReasonCount> drops_;
+  std::array<ClassMetrics, kTrafficClassCount> classes_;
+};
+
+inline Registry &registry() { return Registry::instance(); }
+
+} // namespace metrics
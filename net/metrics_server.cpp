@@ -0,0 +1,106 @@
+#include "metrics_server.h"
+#include "metrics.h"
+#include <iostream>
+#include <string>
+
+using boost::asio::ip::tcp;
+
+namespace {
+constexpr std::size_t kMaxRequestBytes = 8192;
+
+std::string buildResponse(const std::string &status,
+                          const std::string &contentType,
+                          const std::string &body) {
+  return "HTTP/1.1 " + status + "\r\nContent-Type: " + contentType +
+         "\r\nContent-Length: " + std::to_string(body.size()) +
+         "\r\nConnection: close\r\n\r\n" + body;
+}
+} // namespace
+
+MetricsServer::MetricsServer(boost::asio::io_context &io_context, int port)
+    : io_context_(io_context), acceptor_(io_context), port_(port),
+      running_(false) {}
+
+MetricsServer::~MetricsServer() { stop(); }
+
+bool MetricsServer::start() {
+  try {
+    tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(),
+                           static_cast<unsigned short>(port_));
+    acceptor_.open(endpoint.protocol());
+    acceptor_.set_option(tcp::acceptor::reuse_address(true));
+    acceptor_.bind(endpoint);
+    acceptor_.listen();
+    port_ = acceptor_.local_endpoint().port();
+  } catch (const std::exception &e) {
+    std::cerr << "Failed to start metrics server on port " << port_ << ": "
+              << e.what() << std::endl;
+    return false;
+  }
+  running_ = true;
+  startAccept();
+  std::cout << "Metrics available at http://127.0.0.1:" << port_ << "/metrics"
+            << std::endl;
+  return true;
+}
+
+void MetricsServer::stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  // Close on the io thread so it never races the pending accept.
+  boost::asio::post(io_context_, [this]() {
+    boost::system::error_code ec;
+    acceptor_.close(ec);
+  });
+}
+
+void MetricsServer::startAccept() {
+  auto socket = std::make_shared<tcp::socket>(io_context_);
+  acceptor_.async_accept(
+      *socket, [this, socket](const boost::system::error_code &ec) {
+        if (!running_) {
+          return;
+        }
+        if (!ec) {
+          handleClient(socket);
+        }
+        startAccept();
+      });
+}
+
+void MetricsServer::handleClient(std::shared_ptr<tcp::socket> socket) {
+  auto request = std::make_shared<boost::asio::streambuf>(kMaxRequestBytes);
+  boost::asio::async_read_until(
+      *socket, *request, "\r\n\r\n",
+      [socket, request](const boost::system::error_code &ec, std::size_t) {
+        if (ec) {
+          return;
+        }
+        std::istream stream(request.get());
+        std::string method;
+        std::string path;
+        stream >> method >> path;
+
+        std::string response;
+        if (method != "GET") {
+          response = buildResponse("405 Method Not Allowed", "text/plain",
+                                   "GET only\n");
+        } else if (path == "/metrics" || path == "/") {
+          response = buildResponse("200 OK",
+                                   "text/plain; version=0.0.4; charset=utf-8",
+                                   metrics::registry().renderPrometheus());
+        } else {
+          response = buildResponse("404 Not Found", "text/plain", "not found\n");
+        }
+        auto payload = std::make_shared<std::string>(std::move(response));
+        boost::asio::async_write(
+            *socket, boost::asio::buffer(*payload),
+            [socket, payload](const boost::system::error_code &,
+                              std::size_t) {
+              boost::system::error_code ignored;
+              socket->shutdown(tcp::socket::shutdown_both, ignored);
+              socket->close(ignored);
+            });
+      });
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <memory>
+
+// Minimal HTTP endpoint on 127.0.0.1 serving metrics::Registry in the
+// Prometheus text format (GET /metrics). Handlers run on the shared
+// io_context, so destroy the server only after that context has stopped.
+class MetricsServer {
+public:
+  MetricsServer(boost::asio::io_context &io_context, int port);
+  ~MetricsServer();
+
+  bool start();
+  void stop();
+  int port() const { return port_; }
+
+private:
+  void startAccept();
+  void handleClient(std::shared_ptr<boost::asio::ip::tcp::socket> socket);
+
+  boost::asio::io_context &io_context_;
+  boost::asio::ip::tcp::acceptor acceptor_;
+  int port_;
+  std::atomic<bool> running_;
+};
@@ -0,0 +1,215 @@
+#include "multicast_snooper.h"
+
+namespace {
+constexpr uint8_t kProtocolIgmp = 2;
+constexpr uint8_t kIgmpV1Report = 0x12;
+constexpr uint8_t kIgmpV2Report = 0x16;
+constexpr uint8_t kIgmpV2Leave = 0x17;
+constexpr uint8_t kIgmpV3Report = 0x22;
+constexpr uint8_t kIgmpQuery = 0x11;
+constexpr uint32_t kAllSystems = 0xE0000001; // 224.0.0.1
+constexpr std::size_t kIgmpHeaderBytes = 8;
+constexpr std::size_t kGroupRecordBytes = 8;
+
+// IGMPv3 group record types (RFC 3376 4.2.12).
+constexpr uint8_t kModeIsInclude = 1;
+constexpr uint8_t kModeIsExclude = 2;
+constexpr uint8_t kChangeToInclude = 3;
+constexpr uint8_t kChangeToExclude = 4;
+constexpr uint8_t kAllowNewSources = 5;
+
+uint16_t get16(const uint8_t *in) {
+  return static_cast<uint16_t>((in[0] << 8) | in[1]);
+}
+
+uint32_t get32(const uint8_t *in) {
+  return (static_cast<uint32_t>(in[0]) << 24) |
+         (static_cast<uint32_t>(in[1]) << 16) |
+         (static_cast<uint32_t>(in[2]) << 8) | static_cast<uint32_t>(in[3]);
+}
+
+void put16(uint8_t *out, uint16_t value) {
+  out[0] = static_cast<uint8_t>(value >> 8);
+  out[1] = static_cast<uint8_t>(value);
+}
+
+void put32(uint8_t *out, uint32_t value) {
+  put16(out, static_cast<uint16_t>(value >> 16));
+  put16(out + 2, static_cast<uint16_t>(value));
+}
+
+uint16_t checksum(const uint8_t *data, std::size_t length) {
+  uint32_t sum = 0;
+  for (std::size_t i = 0; i + 1 < length; i += 2) {
+    sum += get16(data + i);
+  }
+  if (length % 2 != 0) {
+    sum += static_cast<uint32_t>(data[length - 1]) << 8;
+  }
+  while (sum >> 16) {
+    sum = (sum & 0xFFFF) + (sum >> 16);
+  }
+  return static_cast<uint16_t>(~sum);
+}
+
+// Length of the IPv4 header when packet carries IGMP, 0 otherwise.
+std::size_t igmpOffset(const uint8_t *packet, std::size_t length) {
+  if (length < 20 || (packet[0] >> 4) != 4 || packet[9] != kProtocolIgmp) {
+    return 0;
+  }
+  const std::size_t headerBytes =
+      static_cast<std::size_t>(packet[0] & 0x0F) * 4;
+  return headerBytes >= 20 && headerBytes + kIgmpHeaderBytes <= length
+             ? headerBytes
+             : 0;
+}
+} // namespace
+
+bool MulticastSnooper::isFlooded(const uint8_t *packet, size_t length) {
+  if (length < 20) {
+    return true;
+  }
+  const uint32_t destination = get32(packet + 16);
+  return (destination & 0xFFFFFF00u) == 0xE0000000u ||
+         packet[9] == kProtocolIgmp;
+}
+
+std::vector<uint8_t> MulticastSnooper::buildQuery(uint32_t source) {
+  // IPv4 with Router Alert (RFC 2113), which RFC 3376 4 asks queries to carry.
+  constexpr std::size_t kIpBytes = 24;
+  constexpr std::size_t kQueryBytes = 12;
+  std::vector<uint8_t> packet(kIpBytes + kQueryBytes, 0);
+  uint8_t *ip = packet.data();
+  ip[0] = 0x46;
+  ip[1] = 0xC0; // CS6, as network control
+  put16(ip + 2, static_cast<uint16_t>(packet.size()));
+  ip[8] = 1; // TTL
+  ip[9] = kProtocolIgmp;
+  put32(ip + 12, source);
+  put32(ip + 16, kAllSystems);
+  ip[20] = 0x94;
+  ip[21] = 0x04;
+  put16(ip + 10, checksum(ip, kIpBytes));
+
+  uint8_t *query = ip + kIpBytes;
+  query[0] = kIgmpQuery;
+  query[1] = static_cast<uint8_t>(kQueryResponseTime.count() / 100);
+  query[8] = 2;   // QRV: the default robustness
+  query[9] = 125; // QQIC: the default 125 s query interval
+  put16(query + 2, checksum(query, kQueryBytes));
+  return packet;
+}
+
+bool MulticastSnooper::observe(CSteamID peer, const uint8_t *packet,
+                               size_t length) {
+  const std::size_t offset = igmpOffset(packet, length);
+  if (offset == 0) {
+    return false;
+  }
+  const uint8_t *igmp = packet + offset;
+  const std::size_t igmpLength = length - offset;
+  switch (igmp[0]) {
+  case kIgmpV1Report:
+  case kIgmpV2Report:
+  case kIgmpV2Leave:
+  case kIgmpV3Report:
+    break;
+  default:
+    return false; // queries and anything newer
+  }
+  bool firstReport = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Clock::time_point now = Clock::now();
+    auto round = rounds_.find(peer);
+    if (!groups_.count(peer) &&
+        (round == rounds_.end() || now >= round->second)) {
+      // Earlier queries, if any, went unanswered.
+      rounds_[peer] = now + kQueryRound;
+      firstReport = true;
+    }
+  }
+  if (igmp[0] == kIgmpV1Report || igmp[0] == kIgmpV2Report) {
+    join(peer, get32(igmp + 4));
+    return firstReport;
+  }
+  if (igmp[0] == kIgmpV2Leave) {
+    leave(peer, get32(igmp + 4));
+    return firstReport;
+  }
+
+  const int records = get16(igmp + 6);
+  std::size_t pos = kIgmpHeaderBytes;
+  for (int i = 0; i < records && pos + kGroupRecordBytes <= igmpLength; ++i) {
+    const uint8_t type = igmp[pos];
+    const std::size_t auxBytes = static_cast<std::size_t>(igmp[pos + 1]) * 4;
+    const uint16_t sources = get16(igmp + pos + 2);
+    const uint32_t group = get32(igmp + pos + 4);
+    // Source filters are not tracked: any interest in a group joins it.
+    switch (type) {
+    case kModeIsExclude:
+    case kChangeToExclude:
+      join(peer, group);
+      break;
+    case kModeIsInclude:
+    case kChangeToInclude:
+      if (sources > 0) {
+        join(peer, group);
+      } else {
+        leave(peer, group);
+      }
+      break;
+    case kAllowNewSources:
+      if (sources > 0) {
+        join(peer, group);
+      }
+      break;
+    default:
+      break;
+    }
+    pos += kGroupRecordBytes + static_cast<std::size_t>(sources) * 4 + auxBytes;
+  }
+  return firstReport;
+}
+
+void MulticastSnooper::startQuery(CSteamID peer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  rounds_[peer] = Clock::now() + kQueryRound;
+}
+
+void MulticastSnooper::removePeer(CSteamID peer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  groups_.erase(peer);
+  rounds_.erase(peer);
+}
+
+void MulticastSnooper::reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  groups_.clear();
+  rounds_.clear();
+}
+
+bool MulticastSnooper::wants(CSteamID peer, uint32_t group) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = groups_.find(peer);
+  if (it == groups_.end() || it->second.count(group) > 0) {
+    return true;
+  }
+  auto round = rounds_.find(peer);
+  return round != rounds_.end() && Clock::now() < round->second;
+}
+
+void MulticastSnooper::join(CSteamID peer, uint32_t group) {
+  if (!isMulticast(group)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  groups_[peer].insert(group);
+}
+
+void MulticastSnooper::leave(CSteamID peer, uint32_t group) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // A peer stays known as reporting even with no groups left, so it stops
+  // receiving group traffic altogether.
+  groups_[peer].erase(group);
+}
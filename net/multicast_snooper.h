@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <steam_api.h>
+#include <vector>
+
+// IGMP snooping for TUN mode. Membership reports from a peer's host reach us
+// like any other multicast; reading them tells us which groups that peer
+// listens to, so group traffic only goes to those peers instead of all of
+// them. Peers we have never seen a report from keep getting every group, as
+// do 224.0.0.0/24 (link-local control, RFC 4541) and IGMP itself.
+//
+// A host only reports a group unsolicited when it joins it, so one report
+// says nothing about groups joined earlier. A peer therefore keeps getting
+// every group for a query round (kQueryRound) after it joins the mesh or is
+// first seen reporting; the caller sends it a general query (buildQuery) at
+// that point, and its host answers with all its groups. With no querier in
+// the mesh otherwise, a membership lasts until the peer leaves the group or
+// the mesh.
+class MulticastSnooper {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // The hosts' Max Resp Time in our queries, plus a margin for the path.
+  static constexpr std::chrono::milliseconds kQueryResponseTime{2000};
+  static constexpr std::chrono::milliseconds kQueryRound{3000};
+
+  // Addresses in host order.
+  static bool isMulticast(uint32_t ip) { return (ip >> 28) == 0xE; }
+  // Whether this IPv4 multicast packet must reach every peer.
+  static bool isFlooded(const uint8_t *packet, size_t length);
+  // An IGMPv3 general query to 224.0.0.1 from source (host order).
+  static std::vector<uint8_t> buildQuery(uint32_t source);
+
+  // Learns from an IGMP packet the peer sent; anything else is ignored.
+  // Returns true when this was the peer's first report and it should be sent
+  // a query; its round has started.
+  bool observe(CSteamID peer, const uint8_t *packet, size_t length);
+  // Floods the peer until a query sent now has been answered.
+  void startQuery(CSteamID peer);
+  void removePeer(CSteamID peer);
+  void reset();
+
+  bool wants(CSteamID peer, uint32_t group) const;
+
+private:
+  void join(CSteamID peer, uint32_t group);
+  void leave(CSteamID peer, uint32_t group);
+
+  std::map<CSteamID, std::set<uint32_t>> groups_; // peers seen reporting
+  std::map<CSteamID, Clock::time_point> rounds_;  // end of each open round
+  mutable std::mutex mutex_;
+};
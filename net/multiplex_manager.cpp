@@ -4,6 +4,7 @@
 #include <cstring>
 #include <iostream>
 #include <random>
+#include <utility>
 
 namespace {
 // Keep chunks close to path MTU to reduce Steam UDP fragmentation/lock pressure
@@ -12,6 +13,21 @@ constexpr std::size_t kTunnelChunkBytes =
 constexpr std::size_t kSendBufferBytes = 8 * 1024 * 1024;
 constexpr std::size_t kHighWaterBytes = 512 * 1024; // tighter throttling
 constexpr std::size_t kLowWaterBytes = 256 * 1024;
+// Below this much unsent data the link keeps up and compression only costs.
+constexpr std::size_t kCompressPendingBytes = 32 * 1024;
+
+// Tunnel packet types (uint32 after the stream id).
+constexpr int kPacketData = 0;
+constexpr int kPacketDisconnect = 1;
+constexpr int kPacketCompressed = 2;
+constexpr int kPacketCompressionHello = 3;
+constexpr int kPacketTelemetry = 4;
+// Sent once by a client that decodes type 4; older peers never send it.
+constexpr int kPacketTelemetryHello = 5;
+// Not a stream: generated IDs never contain '~'.
+constexpr const char *kTelemetryStreamId = "~telem";
+
+std::atomic<bool> g_compressionEnabled{true};
 
 // Simple, local ID generator to avoid pulling in the full nanoid dependency
 std::string generateId(std::size_t length = 6) {
@@ -29,13 +45,19 @@ std::string generateId(std::size_t length = 6) {
 }
 } // namespace
 
-MultiplexManager::MultiplexManager(ISteamNetworkingSockets *steamInterface,
+MultiplexManager::MultiplexManager(Transport *transport,
                                    HSteamNetConnection steamConn,
                                    boost::asio::io_context &io_context,
                                    bool &isHost, int &localPort)
-    : steamInterface_(steamInterface), steamConn_(steamConn),
-      io_context_(io_context), isHost_(isHost), localPort_(localPort) {
+    : transport_(transport), steamConn_(steamConn),
+      io_context_(io_context), isHost_(isHost), localPort_(localPort),
+      createdAt_(std::chrono::steady_clock::now()) {
   sendTimer_ = std::make_unique<boost::asio::steady_timer>(io_context_);
+  SteamNetConnectionInfo_t info{};
+  if (transport_ && transport_->getConnectionInfo(steamConn_, &info)) {
+    peerId_ = info.m_identityRemote.GetSteamID64();
+  }
+  peerMetrics_ = metrics::registry().peer(peerId_);
 }
 
 MultiplexManager::~MultiplexManager() {
@@ -45,10 +67,14 @@ MultiplexManager::~MultiplexManager() {
     pair.second->close();
   }
   clientMap_.clear();
+  for (const auto &pair : streamMetrics_) {
+    metrics::registry().removeStream(peerId_, pair.first);
+  }
 }
 
 std::string MultiplexManager::addClient(std::shared_ptr<tcp::socket> socket) {
   std::string id;
+  bool offerCompression = false;
   {
     std::lock_guard<std::mutex> lock(mapMutex_);
     do {
@@ -58,6 +84,13 @@ std::string MultiplexManager::addClient(std::shared_ptr<tcp::socket> socket) {
     clientMap_[id] = socket;
     readBuffers_[id].resize(1048576);
     missingClients_.erase(id);
+    trackStream(id);
+    offerCompression = compressionEnabled() &&
+                       compressionOffered_.insert(id).second;
+  }
+  if (offerCompression) {
+    // Goes out ahead of the stream's first data packet.
+    sendTunnelPacket(id, nullptr, 0, kPacketCompressionHello);
   }
   startAsyncRead(id);
   std::cout << "Added client with id " << id << std::endl;
@@ -74,7 +107,13 @@ bool MultiplexManager::removeClient(const std::string &id) {
     removed = true;
   }
   readBuffers_.erase(id);
+  writeQueues_.erase(id);
   missingClients_.erase(id);
+  if (streamMetrics_.erase(id) > 0) {
+    metrics::registry().removeStream(peerId_, id);
+  }
+  compressors_.erase(id);
+  compressionOffered_.erase(id);
   {
     std::lock_guard<std::mutex> lock(pausedMutex_);
     pausedReads_.erase(id);
@@ -89,7 +128,7 @@ bool MultiplexManager::removeClient(const std::string &id) {
     pendingPackets_.erase(id);
     removeFromOrder(id);
     if (pendingPackets_.empty()) {
-      sendBlocked_.store(false, std::memory_order_relaxed);
+      setSendBlocked(false);
       shouldResume = true;
     }
   }
@@ -113,7 +152,10 @@ std::vector<char> MultiplexManager::buildPacket(const std::string &id,
                                                 const char *data, size_t len,
                                                 int type) const {
   const size_t idLen = id.size() + 1;
-  const size_t payloadLen = (type == 0 ? len : 0);
+  const size_t payloadLen = (type == kPacketData || type == kPacketCompressed ||
+                             type == kPacketTelemetry)
+                                ? len
+                                : 0;
   const size_t packetSize = idLen + sizeof(uint32_t) + payloadLen;
   std::vector<char> packet(packetSize);
   std::memcpy(packet.data(), id.c_str(), idLen);
@@ -131,15 +173,17 @@ bool MultiplexManager::trySendPacket(const std::vector<char> &packet) {
   }
 
   SteamNetConnectionRealTimeStatus_t status{};
-  if (steamInterface_->GetConnectionRealTimeStatus(steamConn_, &status, 0,
-                                                   nullptr)) {
+  const bool haveStatus =
+      transport_->getConnectionRealTimeStatus(steamConn_, &status) ==
+      k_EResultOK;
+  if (haveStatus) {
     if (static_cast<std::size_t>(status.m_cbPendingReliable) >=
         kHighWaterBytes) {
       lastBlocked_ = std::chrono::steady_clock::now();
       int current = backoffMs_.load(std::memory_order_relaxed);
       int next = std::min(current * 2, 200);
       backoffMs_.store(next, std::memory_order_relaxed);
-      sendBlocked_.store(true, std::memory_order_relaxed);
+      setSendBlocked(true);
       return false;
     }
   }
@@ -147,12 +191,20 @@ bool MultiplexManager::trySendPacket(const std::vector<char> &packet) {
   if (isSendSaturated()) {
     return false;
   }
-  EResult result = steamInterface_->SendMessageToConnection(
+  EResult result = transport_->sendMessageToConnection(
       steamConn_, packet.data(), static_cast<uint32>(packet.size()),
       k_nSteamNetworkingSend_Reliable | k_nSteamNetworkingSend_NoNagle,
       nullptr);
   if (result == k_EResultOK) {
     backoffMs_.store(5, std::memory_order_relaxed);
+    peerMetrics_->txPackets.add();
+    peerMetrics_->txBytes.add(packet.size());
+    if (haveStatus && status.m_nPing >= 0) {
+      metrics::registry().sendToAck.record(
+          static_cast<uint64_t>(std::max<SteamNetworkingMicroseconds>(
+              status.m_usecQueueTime, 0)) +
+          static_cast<uint64_t>(status.m_nPing) * 1000);
+    }
     return true;
   }
   if (result == k_EResultLimitExceeded) {
@@ -160,7 +212,7 @@ bool MultiplexManager::trySendPacket(const std::vector<char> &packet) {
     int current = backoffMs_.load(std::memory_order_relaxed);
     int next = std::min(current * 2, 100);
     backoffMs_.store(next, std::memory_order_relaxed);
-    sendBlocked_.store(true, std::memory_order_relaxed);
+    setSendBlocked(true);
     return false;
   }
 
@@ -171,13 +223,19 @@ bool MultiplexManager::trySendPacket(const std::vector<char> &packet) {
   return true;
 }
 
+bool MultiplexManager::hasPendingPackets(const std::string &id) {
+  std::lock_guard<std::mutex> lock(queueMutex_);
+  auto it = pendingPackets_.find(id);
+  return it != pendingPackets_.end() && !it->second.empty();
+}
+
 void MultiplexManager::enqueuePacket(const std::string &id,
                                      std::vector<char> packet) {
   {
     std::lock_guard<std::mutex> lock(queueMutex_);
     auto &queue = pendingPackets_[id];
     const bool wasEmpty = queue.empty();
-    queue.push_back(std::move(packet));
+    queue.push_back({std::move(packet), std::chrono::steady_clock::now()});
     if (wasEmpty) {
       if (sendOrderSet_.insert(id).second) {
         sendOrder_.push_back(id);
@@ -208,12 +266,21 @@ void MultiplexManager::flushPendingPackets() {
       continue;
     }
 
-    const std::vector<char> &packet = queue.front();
+    const PendingPacket &packet = queue.front();
     lock.unlock();
-    const bool sent = trySendPacket(packet);
+    const bool sent = trySendPacket(packet.data);
+    if (sent) {
+      // Record before relocking: streamMetrics() takes mapMutex_, which
+      // removeClient() holds while it takes queueMutex_.
+      const auto waited = std::chrono::steady_clock::now() - packet.queuedAt;
+      metrics::registry().queueDelay.record(waited);
+      if (auto stream = streamMetrics(id)) {
+        stream->queueDelay.record(waited);
+      }
+    }
     lock.lock();
     if (!sent) {
-      sendBlocked_.store(true, std::memory_order_relaxed);
+      setSendBlocked(true);
       sendOrder_.push_front(id); // retry this id first when unblocked
       return;
     }
@@ -225,7 +292,7 @@ void MultiplexManager::flushPendingPackets() {
       sendOrderSet_.erase(id);
     }
   }
-  sendBlocked_.store(false, std::memory_order_relaxed);
+  setSendBlocked(false);
   lock.unlock();
   resumePausedReads();
 }
@@ -273,11 +340,13 @@ void MultiplexManager::scheduleFlush(std::chrono::milliseconds delay) {
 
 void MultiplexManager::sendTunnelPacket(const std::string &id, const char *data,
                                         size_t len, int type) {
+  std::lock_guard<std::mutex> sendLock(sendMutex_);
   bool blocked = false;
   auto pushPacket = [this, &id, &blocked](const char *ptr, size_t amount,
                                           int packetType) {
     auto packet = buildPacket(id, ptr, amount, packetType);
-    if (blocked || isSendSaturated()) {
+    // Anything still queued for this stream must go out first.
+    if (blocked || hasPendingPackets(id) || isSendSaturated()) {
       blocked = true;
       enqueuePacket(id, std::move(packet));
       return;
@@ -288,23 +357,65 @@ void MultiplexManager::sendTunnelPacket(const std::string &id, const char *data,
     }
   };
 
-  if (type == 0 && data && len > kTunnelChunkBytes) {
+  auto pushChunks = [&pushPacket](const char *ptr, size_t amount) {
     size_t offset = 0;
-    while (offset < len) {
-      const size_t chunk = std::min(kTunnelChunkBytes, len - offset);
-      pushPacket(data + offset, chunk, 0);
+    while (offset < amount) {
+      const size_t chunk = std::min(kTunnelChunkBytes, amount - offset);
+      pushPacket(ptr + offset, chunk, kPacketData);
       offset += chunk;
     }
+  };
+
+  auto codec = type == kPacketData && data ? compressor(id) : nullptr;
+  if (codec) {
+    const bool bottleneck = isLinkBottleneck();
+    auto stream = streamMetrics(id);
+    std::vector<char> encoded;
+    size_t offset = 0;
+    while (offset < len) {
+      const size_t block =
+          std::min(TunnelCompressor::kBlockBytes, len - offset);
+      if (codec->encode(data + offset, block, bottleneck, encoded,
+                        stream.get())) {
+        pushPacket(encoded.data(), encoded.size(), kPacketCompressed);
+      } else {
+        pushChunks(data + offset, block);
+      }
+      offset += block;
+    }
+  } else if (type == kPacketData && data && len > kTunnelChunkBytes) {
+    pushChunks(data, len);
   } else {
     pushPacket(data, len, type);
   }
 
   if (blocked) {
-    sendBlocked_.store(true, std::memory_order_relaxed);
+    setSendBlocked(true);
     lastBlocked_ = std::chrono::steady_clock::now();
   }
 }
 
+void MultiplexManager::sendTelemetry(const std::vector<uint8_t> &frame) {
+  sendTunnelPacket(kTelemetryStreamId,
+                   reinterpret_cast<const char *>(frame.data()), frame.size(),
+                   kPacketTelemetry);
+}
+
+void MultiplexManager::setTelemetryHandler(
+    std::function<void(const uint8_t *, size_t)> handler) {
+  telemetryHandler_ = std::move(handler);
+}
+
+void MultiplexManager::advertiseTelemetry() {
+  if (!telemetryAdvertised_.exchange(true)) {
+    sendTunnelPacket(kTelemetryStreamId, nullptr, 0, kPacketTelemetryHello);
+  }
+}
+
+bool MultiplexManager::peerTakesTelemetry() const {
+  return peerTakesTelemetry_.load(std::memory_order_relaxed);
+}
+
 void MultiplexManager::handleTunnelPacket(const char *data, size_t len) {
   size_t idLen = 7; // 6 + null
   if (len < idLen + sizeof(uint32_t)) {
@@ -313,10 +424,12 @@ void MultiplexManager::handleTunnelPacket(const char *data, size_t len) {
   }
   std::string id(data, 6);
   uint32_t type = *reinterpret_cast<const uint32_t *>(data + idLen);
-  if (type == 0) {
+  if (type == kPacketData || type == kPacketCompressed) {
     // Data packet
     size_t dataLen = len - idLen - sizeof(uint32_t);
     const char *packetData = data + idLen + sizeof(uint32_t);
+    peerMetrics_->rxPackets.add();
+    peerMetrics_->rxBytes.add(len);
     auto socket = getClient(id);
     if (!socket && isHost_ && localPort_ > 0) {
       // 如果是主持且没有对应的 TCP Client，创建一个连接到本地端口
@@ -342,6 +455,7 @@ void MultiplexManager::handleTunnelPacket(const char *data, size_t len) {
           std::lock_guard<std::mutex> lock(mapMutex_);
           clientMap_[id] = newSocket;
           readBuffers_[id].resize(1048576);
+          trackStream(id);
           socket = newSocket;
         }
         std::cout << "Successfully created TCP client for id " << id
@@ -352,40 +466,117 @@ void MultiplexManager::handleTunnelPacket(const char *data, size_t len) {
         std::cerr << "Failed to create TCP client for id " << id << ": "
                   << e.what() << std::endl;
         recentConnectFail_[id] = std::chrono::steady_clock::now();
-        sendTunnelPacket(id, nullptr, 0, 1);
+        {
+          std::lock_guard<std::mutex> lock(mapMutex_);
+          compressors_.erase(id);
+          compressionOffered_.erase(id);
+        }
+        sendTunnelPacket(id, nullptr, 0, kPacketDisconnect);
         return;
       }
     }
     if (socket) {
       missingClients_.erase(id);
-      auto payload =
-          std::make_shared<std::vector<char>>(packetData, packetData + dataLen);
-      boost::asio::async_write(
-          *socket, boost::asio::buffer(*payload),
-          [this, id, payload](const boost::system::error_code &writeEc,
-                              std::size_t) {
-            if (writeEc) {
-              std::cout << "Error writing to TCP client " << id << ": "
-                        << writeEc.message() << std::endl;
-              removeClient(id);
-            }
-          });
+      auto stream = streamMetrics(id);
+      auto payload = std::make_shared<std::vector<char>>();
+      if (type == kPacketCompressed) {
+        if (!TunnelCompressor::decode(packetData, dataLen, *payload,
+                                      stream.get())) {
+          std::cerr << "Corrupt compressed packet for id " << id
+                    << ", closing stream" << std::endl;
+          sendTunnelPacket(id, nullptr, 0, kPacketDisconnect);
+          removeClient(id);
+          return;
+        }
+      } else {
+        payload->assign(packetData, packetData + dataLen);
+      }
+      if (stream) {
+        stream->rxBytes.add(payload->size());
+      }
+      writeToClient(id, socket, std::move(payload));
     } else {
       if (missingClients_.insert(id).second) {
         std::cerr << "No client found for id " << id << std::endl;
       }
-      sendTunnelPacket(id, nullptr, 0, 1);
+      sendTunnelPacket(id, nullptr, 0, kPacketDisconnect);
     }
-  } else if (type == 1) {
+  } else if (type == kPacketDisconnect) {
     // Disconnect packet
     if (removeClient(id)) {
       std::cout << "Client " << id << " disconnected" << std::endl;
     }
+  } else if (type == kPacketTelemetry) {
+    if (telemetryHandler_) {
+      const size_t header = idLen + sizeof(uint32_t);
+      telemetryHandler_(reinterpret_cast<const uint8_t *>(data) + header,
+                        len - header);
+    }
+  } else if (type == kPacketTelemetryHello) {
+    peerTakesTelemetry_.store(true, std::memory_order_relaxed);
+  } else if (type == kPacketCompressionHello) {
+    // The peer decodes type 2 on this stream. Reply with our own hello unless
+    // we opened the stream and already sent one.
+    if (compressionEnabled()) {
+      enableCompression(id);
+    }
   } else {
     std::cerr << "Unknown packet type " << type << std::endl;
   }
 }
 
+void MultiplexManager::writeToClient(const std::string &id,
+                                     std::shared_ptr<tcp::socket> socket,
+                                     std::shared_ptr<std::vector<char>> payload) {
+  {
+    std::lock_guard<std::mutex> lock(mapMutex_);
+    auto &queue = writeQueues_[id];
+    queue.push_back(std::move(payload));
+    if (queue.size() > 1) {
+      return; // the write in flight chains to this one
+    }
+  }
+  writeNext(id, std::move(socket));
+}
+
+// One async_write per socket at a time: concurrent writes may interleave.
+void MultiplexManager::writeNext(const std::string &id,
+                                 std::shared_ptr<tcp::socket> socket) {
+  std::shared_ptr<std::vector<char>> payload;
+  {
+    std::lock_guard<std::mutex> lock(mapMutex_);
+    auto it = writeQueues_.find(id);
+    if (it == writeQueues_.end() || it->second.empty()) {
+      return;
+    }
+    payload = it->second.front();
+  }
+  boost::asio::async_write(
+      *socket, boost::asio::buffer(*payload),
+      [this, id, socket, payload](const boost::system::error_code &writeEc,
+                                  std::size_t) {
+        if (writeEc) {
+          std::cout << "Error writing to TCP client " << id << ": "
+                    << writeEc.message() << std::endl;
+          removeClient(id);
+          return;
+        }
+        {
+          std::lock_guard<std::mutex> lock(mapMutex_);
+          auto it = writeQueues_.find(id);
+          if (it == writeQueues_.end() || it->second.empty() ||
+              it->second.front() != payload) {
+            return; // the stream was removed meanwhile
+          }
+          it->second.pop_front();
+          if (it->second.empty()) {
+            return;
+          }
+        }
+        writeNext(id, socket);
+      });
+}
+
 void MultiplexManager::startAsyncRead(const std::string &id) {
   auto socket = getClient(id);
   if (!socket) {
@@ -398,6 +589,9 @@ void MultiplexManager::startAsyncRead(const std::string &id) {
                  std::size_t bytes_transferred) {
         if (!ec) {
           if (bytes_transferred > 0) {
+            if (auto stream = streamMetrics(id)) {
+              stream->txBytes.add(bytes_transferred);
+            }
             sendTunnelPacket(id, readBuffers_[id].data(), bytes_transferred, 0);
             if (sendBlocked_.load(std::memory_order_relaxed)) {
               std::lock_guard<std::mutex> lock(pausedMutex_);
@@ -436,8 +630,8 @@ bool MultiplexManager::isSendSaturated() {
   }
 
   SteamNetConnectionRealTimeStatus_t status{};
-  if (steamInterface_->GetConnectionRealTimeStatus(steamConn_, &status, 0,
-                                                   nullptr)) {
+  if (transport_->getConnectionRealTimeStatus(steamConn_, &status) ==
+      k_EResultOK) {
     const std::size_t pending =
         static_cast<std::size_t>(status.m_cbPendingReliable);
     if (pending >= kHighWaterBytes) {
@@ -445,11 +639,11 @@ bool MultiplexManager::isSendSaturated() {
       int current = backoffMs_.load(std::memory_order_relaxed);
       int next = std::min(current * 2, 200);
       backoffMs_.store(next, std::memory_order_relaxed);
-      sendBlocked_.store(true, std::memory_order_relaxed);
+      setSendBlocked(true);
       return true;
     }
     if (pending <= kLowWaterBytes) {
-      sendBlocked_.store(false, std::memory_order_relaxed);
+      setSendBlocked(false);
       backoffMs_.store(5, std::memory_order_relaxed);
       return false;
     }
@@ -463,3 +657,75 @@ void MultiplexManager::removeFromOrder(const std::string &id) {
   sendOrder_.erase(std::remove(sendOrder_.begin(), sendOrder_.end(), id),
                    sendOrder_.end());
 }
+
+void MultiplexManager::setSendBlocked(bool blocked) {
+  const bool wasBlocked =
+      sendBlocked_.exchange(blocked, std::memory_order_relaxed);
+  if (wasBlocked == blocked) {
+    return;
+  }
+  const int64_t now =
+      std::chrono::steady_clock::now().time_since_epoch().count();
+  if (blocked) {
+    blockedSinceTicks_.store(now, std::memory_order_relaxed);
+    metrics::registry().backpressureEpisodes.add();
+    return;
+  }
+  const int64_t since = blockedSinceTicks_.load(std::memory_order_relaxed);
+  if (since != 0) {
+    metrics::registry().backpressure.record(
+        std::chrono::steady_clock::duration(now - since));
+  }
+}
+
+// Caller holds mapMutex_.
+void MultiplexManager::trackStream(const std::string &id) {
+  streamMetrics_[id] = metrics::registry().stream(peerId_, id);
+}
+
+std::shared_ptr<metrics::StreamMetrics>
+MultiplexManager::streamMetrics(const std::string &id) {
+  std::lock_guard<std::mutex> lock(mapMutex_);
+  auto it = streamMetrics_.find(id);
+  return it != streamMetrics_.end() ? it->second : nullptr;
+}
+
+void MultiplexManager::setCompressionEnabled(bool enabled) {
+  g_compressionEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool MultiplexManager::compressionEnabled() {
+  return g_compressionEnabled.load(std::memory_order_relaxed);
+}
+
+std::shared_ptr<TunnelCompressor>
+MultiplexManager::compressor(const std::string &id) {
+  std::lock_guard<std::mutex> lock(mapMutex_);
+  auto it = compressors_.find(id);
+  return it != compressors_.end() ? it->second : nullptr;
+}
+
+void MultiplexManager::enableCompression(const std::string &id) {
+  bool reply = false;
+  {
+    std::lock_guard<std::mutex> lock(mapMutex_);
+    if (!compressors_.count(id)) {
+      compressors_[id] = std::make_shared<TunnelCompressor>();
+    }
+    reply = compressionOffered_.insert(id).second;
+  }
+  if (reply) {
+    sendTunnelPacket(id, nullptr, 0, kPacketCompressionHello);
+  }
+}
+
+bool MultiplexManager::isLinkBottleneck() {
+  if (sendBlocked_.load(std::memory_order_relaxed)) {
+    return true;
+  }
+  SteamNetConnectionRealTimeStatus_t status{};
+  return transport_->getConnectionRealTimeStatus(steamConn_, &status) ==
+             k_EResultOK &&
+         static_cast<std::size_t>(status.m_cbPendingReliable) >=
+             kCompressPendingBytes;
+}
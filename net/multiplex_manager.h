@@ -5,6 +5,7 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <deque>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -12,14 +13,16 @@
 #include <string>
 #include <boost/asio.hpp>
 #include <steam_api.h>
-#include <isteamnetworkingsockets.h>
 #include <steamnetworkingtypes.h>
+#include "metrics.h"
+#include "transport.h"
+#include "tunnel_compressor.h"
 
 using boost::asio::ip::tcp;
 
 class MultiplexManager {
 public:
-    MultiplexManager(ISteamNetworkingSockets* steamInterface, HSteamNetConnection steamConn, 
+    MultiplexManager(Transport* transport, HSteamNetConnection steamConn, 
                      boost::asio::io_context& io_context, bool& isHost, int& localPort);
     ~MultiplexManager();
 
@@ -31,8 +34,26 @@ public:
 
     void handleTunnelPacket(const char* data, size_t len);
 
+    // Member telemetry frames (see telemetry.h) share the tunnel connection.
+    // A client advertises that it decodes them; the host only sends frames
+    // to peers that did, since older builds reject the packet type.
+    void sendTelemetry(const std::vector<uint8_t>& frame);
+    void setTelemetryHandler(std::function<void(const uint8_t*, size_t)> handler);
+    void advertiseTelemetry();
+    bool peerTakesTelemetry() const;
+    std::chrono::steady_clock::time_point createdAt() const { return createdAt_; }
+
+    // Process-wide switch for offering LZ4 on new streams (on by default).
+    static void setCompressionEnabled(bool enabled);
+    static bool compressionEnabled();
+
 private:
-    ISteamNetworkingSockets* steamInterface_;
+    struct PendingPacket {
+        std::vector<char> data;
+        std::chrono::steady_clock::time_point queuedAt;
+    };
+
+    Transport* transport_;
     HSteamNetConnection steamConn_;
     std::unordered_map<std::string, std::shared_ptr<tcp::socket>> clientMap_;
     std::mutex mapMutex_;
@@ -41,20 +62,35 @@ private:
     int& localPort_;
     std::unordered_map<std::string, std::vector<char>> readBuffers_;
     std::unordered_set<std::string> missingClients_;
-    std::map<std::string, std::deque<std::vector<char>>> pendingPackets_;
+    // Payloads waiting for the local socket; the front one is being written.
+    std::unordered_map<std::string, std::deque<std::shared_ptr<std::vector<char>>>> writeQueues_; // guarded by mapMutex_
+    std::map<std::string, std::deque<PendingPacket>> pendingPackets_;
     std::mutex queueMutex_;
+    // Held for a whole sendTunnelPacket call: a stream's packets go out (or
+    // into pendingPackets_) in read order, and its compressor has one user.
+    std::mutex sendMutex_;
     std::unique_ptr<boost::asio::steady_timer> sendTimer_;
     bool flushScheduled_ = false;
 
     void startAsyncRead(const std::string& id);
+    void writeToClient(const std::string& id, std::shared_ptr<tcp::socket> socket,
+                       std::shared_ptr<std::vector<char>> payload);
+    void writeNext(const std::string& id, std::shared_ptr<tcp::socket> socket);
     std::vector<char> buildPacket(const std::string &id, const char *data, size_t len, int type) const;
     bool trySendPacket(const std::vector<char> &packet);
+    bool hasPendingPackets(const std::string &id);
     void enqueuePacket(const std::string &id, std::vector<char> packet);
     void flushPendingPackets();
     void scheduleFlush(std::chrono::milliseconds delay = std::chrono::milliseconds(5));
     void resumePausedReads();
     bool isSendSaturated();
     void removeFromOrder(const std::string &id);
+    void setSendBlocked(bool blocked);
+    void trackStream(const std::string &id);
+    std::shared_ptr<metrics::StreamMetrics> streamMetrics(const std::string &id);
+    std::shared_ptr<TunnelCompressor> compressor(const std::string &id);
+    void enableCompression(const std::string &id);
+    bool isLinkBottleneck();
 
     std::atomic<bool> sendBlocked_{false};
     std::atomic<int> backoffMs_{5};
@@ -64,4 +100,17 @@ private:
     std::unordered_set<std::string> sendOrderSet_;
     std::deque<std::string> sendOrder_;
     std::unordered_map<std::string, std::chrono::steady_clock::time_point> recentConnectFail_;
+    std::atomic<int64_t> blockedSinceTicks_{0};
+    std::function<void(const uint8_t*, size_t)> telemetryHandler_;
+    std::atomic<bool> telemetryAdvertised_{false};
+    std::atomic<bool> peerTakesTelemetry_{false};
+    std::chrono::steady_clock::time_point createdAt_;
+
+    uint64_t peerId_ = 0;
+    std::shared_ptr<metrics::PeerMetrics> peerMetrics_;
+    std::unordered_map<std::string, std::shared_ptr<metrics::StreamMetrics>> streamMetrics_; // guarded by mapMutex_
+    // Streams whose peer sent a compression hello, and those we offered it on.
+    // A compressor's encode state is only touched under sendMutex_.
+    std::unordered_map<std::string, std::shared_ptr<TunnelCompressor>> compressors_; // guarded by mapMutex_
+    std::unordered_set<std::string> compressionOffered_; // guarded by mapMutex_
 };
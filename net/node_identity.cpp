@@ -1,28 +1,60 @@
 #include "node_identity.h"
 
-#include <QCryptographicHash>
+#include "sha256.h"
 #include <cstring>
-#include <iomanip>
-#include <sstream>
-#include <vector>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+// Lobbies come and go, so the cache starts over rather than grow forever.
+constexpr std::size_t kCacheLimit = 4096;
+
+static_assert(Sha256::hash("abc", 3)[0] == 0xba &&
+                  Sha256::hash("abc", 3)[31] == 0xad,
+              "SHA-256 known answer");
+
+struct IdCache {
+  std::mutex mutex;
+  std::unordered_map<uint64_t, NodeID> ids;
+};
+
+IdCache &idCache() {
+  static IdCache cache;
+  return cache;
+}
+} // namespace
+
+std::ostream &operator<<(std::ostream &out, const NodeIdHex &hex) {
+  return out << hex.c_str();
+}
 
 NodeID NodeIdentity::generate(CSteamID steamID) {
-  NodeID nodeId{};
   const uint64_t steamId64 = steamID.ConvertToUint64();
-
-  std::vector<uint8_t> input;
-  input.resize(sizeof(steamId64) + std::strlen(APP_SECRET_SALT));
-  std::memcpy(input.data(), &steamId64, sizeof(steamId64));
-  std::memcpy(input.data() + sizeof(steamId64), APP_SECRET_SALT,
-              std::strlen(APP_SECRET_SALT));
-
-  const QByteArray hash = QCryptographicHash::hash(
-      QByteArray::fromRawData(reinterpret_cast<const char *>(input.data()),
-                              static_cast<int>(input.size())),
-      QCryptographicHash::Sha256);
-  if (hash.size() >= static_cast<int>(NODE_ID_SIZE)) {
-    std::memcpy(nodeId.data(), hash.constData(), NODE_ID_SIZE);
+  IdCache &cache = idCache();
+  {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto it = cache.ids.find(steamId64);
+    if (it != cache.ids.end()) {
+      return it->second;
+    }
   }
+  const NodeID nodeId = derive(&steamId64, sizeof(steamId64));
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  if (cache.ids.size() >= kCacheLimit) {
+    cache.ids.clear();
+  }
+  cache.ids.emplace(steamId64, nodeId);
+  return nodeId;
+}
+
+NodeID NodeIdentity::derive(const void *data, std::size_t size) {
+  Sha256 sha;
+  sha.update(static_cast<const uint8_t *>(data), size);
+  sha.update(APP_SECRET_SALT, std::strlen(APP_SECRET_SALT));
+  const Sha256::Digest digest = sha.finish();
+  NodeID nodeId{};
+  static_assert(sizeof(digest) == NODE_ID_SIZE, "node IDs are SHA-256");
+  std::memcpy(nodeId.data(), digest.data(), NODE_ID_SIZE);
   return nodeId;
 }
 
@@ -38,17 +70,21 @@ int NodeIdentity::compare(const NodeID &a, const NodeID &b) {
   return 0;
 }
 
-std::string NodeIdentity::toString(const NodeID &nodeId, bool full) {
-  std::ostringstream oss;
-  oss << std::hex << std::setfill('0');
+NodeIdHex NodeIdentity::toHex(const NodeID &nodeId, bool full) {
+  constexpr char kDigits[] = "0123456789abcdef";
+  NodeIdHex hex;
+  char *out = hex.text.data();
   const std::size_t len = full ? NODE_ID_SIZE : 8;
   for (std::size_t i = 0; i < len; ++i) {
-    oss << std::setw(2) << static_cast<int>(nodeId[i]);
+    *out++ = kDigits[nodeId[i] >> 4];
+    *out++ = kDigits[nodeId[i] & 0x0F];
   }
   if (!full) {
-    oss << "...";
+    std::memcpy(out, "...", 3);
+    out += 3;
   }
-  return oss.str();
+  *out = '\0';
+  return hex;
 }
 
 bool NodeIdentity::isEmpty(const NodeID &nodeId) {
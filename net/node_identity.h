@@ -1,16 +1,30 @@
 #pragma once
 
 #include "vpn_protocol.h"
+#include <array>
+#include <cstddef>
+#include <ostream>
 #include <steam_api.h>
-#include <string>
+
+// Hex digits of a node ID in a fixed buffer, so log lines need not allocate.
+struct NodeIdHex {
+  std::array<char, NODE_ID_SIZE * 2 + 4> text{}; // NUL-terminated
+  const char *c_str() const { return text.data(); }
+};
+
+std::ostream &operator<<(std::ostream &out, const NodeIdHex &hex);
 
 class NodeIdentity {
 public:
+  // Cached per Steam ID for the life of the process.
   static NodeID generate(CSteamID steamID);
+  // SHA-256 of data followed by APP_SECRET_SALT.
+  static NodeID derive(const void *data, std::size_t size);
   static int compare(const NodeID &a, const NodeID &b);
   static bool hasPriority(const NodeID &a, const NodeID &b) {
     return compare(a, b) > 0;
   }
-  static std::string toString(const NodeID &nodeId, bool full = false);
+  // The first 8 bytes and "...", or all 32 when full.
+  static NodeIdHex toHex(const NodeID &nodeId, bool full = false);
   static bool isEmpty(const NodeID &nodeId);
 };
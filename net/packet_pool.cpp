@@ -0,0 +1,131 @@
+#include "packet_pool.h"
+#include <cstring>
+#include <utility>
+
+namespace {
+constexpr std::size_t kCacheLine = 64;
+constexpr std::size_t kSlabBuffers = 64;
+constexpr std::size_t kCacheBuffers = 64;
+constexpr std::size_t kTransferBuffers = kCacheBuffers / 2;
+
+static_assert(PacketPool::kBufferBytes % kCacheLine == 0,
+              "buffers must start on a cache line");
+} // namespace
+
+// Per-thread free list. Whatever it still holds when the thread exits goes
+// back to the shared ring.
+struct PacketPoolCache {
+  uint8_t *buffers[kCacheBuffers];
+  std::size_t count = 0;
+
+  ~PacketPoolCache() {
+    PacketPool &pool = PacketPool::instance();
+    while (count > 0) {
+      pool.ring_.tryPush(buffers[--count]);
+    }
+  }
+};
+
+namespace {
+thread_local PacketPoolCache t_cache;
+} // namespace
+
+PacketPool &PacketPool::instance() {
+  static PacketPool pool;
+  return pool;
+}
+
+PacketPool::PacketPool() : ring_(kMaxBuffers) {}
+
+uint8_t *PacketPool::acquire() {
+  PacketPoolCache &cache = t_cache;
+  if (cache.count == 0) {
+    uint8_t *buffer = nullptr;
+    while (cache.count < kTransferBuffers && ring_.tryPop(buffer)) {
+      cache.buffers[cache.count++] = buffer;
+    }
+    if (cache.count == 0 && (!grow() || !ring_.tryPop(buffer))) {
+      return nullptr;
+    }
+    if (cache.count == 0) {
+      return buffer;
+    }
+  }
+  return cache.buffers[--cache.count];
+}
+
+void PacketPool::release(uint8_t *buffer) {
+  PacketPoolCache &cache = t_cache;
+  if (cache.count == kCacheBuffers) {
+    // Hand half back so a thread that only frees (the receive side) feeds
+    // the threads that only allocate.
+    for (std::size_t i = 0; i < kTransferBuffers; ++i) {
+      ring_.tryPush(cache.buffers[--cache.count]);
+    }
+  }
+  cache.buffers[cache.count++] = buffer;
+}
+
+bool PacketPool::grow() {
+  std::lock_guard<std::mutex> lock(slabMutex_);
+  if (allocated_.load(std::memory_order_relaxed) + kSlabBuffers >
+      kMaxBuffers) {
+    return false;
+  }
+  auto slab =
+      std::make_unique<uint8_t[]>(kSlabBuffers * kBufferBytes + kCacheLine);
+  auto base = reinterpret_cast<std::uintptr_t>(slab.get());
+  base = (base + kCacheLine - 1) & ~(kCacheLine - 1);
+  for (std::size_t i = 0; i < kSlabBuffers; ++i) {
+    ring_.tryPush(reinterpret_cast<uint8_t *>(base + i * kBufferBytes));
+  }
+  slabs_.push_back(std::move(slab));
+  allocated_.fetch_add(kSlabBuffers, std::memory_order_relaxed);
+  return true;
+}
+
+PacketBuffer::PacketBuffer(std::size_t size) : size_(size) {
+  if (size == 0) {
+    return;
+  }
+  if (size <= PacketPool::kBufferBytes) {
+    data_ = PacketPool::instance().acquire();
+    pooled_ = data_ != nullptr;
+  }
+  if (!data_) {
+    data_ = new uint8_t[size];
+  }
+}
+
+PacketBuffer::PacketBuffer(const void *data, std::size_t size)
+    : PacketBuffer(size) {
+  if (size > 0) {
+    std::memcpy(data_, data, size);
+  }
+}
+
+PacketBuffer::PacketBuffer(PacketBuffer &&other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)),
+      pooled_(std::exchange(other.pooled_, false)) {}
+
+PacketBuffer &PacketBuffer::operator=(PacketBuffer &&other) noexcept {
+  if (this != &other) {
+    reset();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    pooled_ = std::exchange(other.pooled_, false);
+  }
+  return *this;
+}
+
+void PacketBuffer::reset() {
+  if (pooled_) {
+    PacketPool::instance().release(data_);
+  } else {
+    delete[] data_;
+  }
+  data_ = nullptr;
+  size_ = 0;
+  pooled_ = false;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "mpmc_ring.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Recycled fixed-size buffers for the per-packet data path. Buffers are
+// cache-line aligned and carved from slabs that are never returned to the
+// heap. Each thread keeps a small cache and exchanges buffers with the shared
+// ring in batches, so a buffer freed on the receive thread is reused by the
+// TUN thread without either of them taking a lock.
+class PacketPool {
+public:
+  // Room for a TUN read plus the VPN, wrapper and FEC headers in front of it.
+  static constexpr std::size_t kBufferBytes = 2304;
+  static constexpr std::size_t kMaxBuffers = 16384;
+
+  static PacketPool &instance();
+
+  // nullptr once kMaxBuffers are in use; callers fall back to the heap.
+  uint8_t *acquire();
+  void release(uint8_t *buffer);
+
+  std::size_t buffersAllocated() const {
+    return allocated_.load(std::memory_order_relaxed);
+  }
+
+private:
+  friend struct PacketPoolCache;
+
+  PacketPool();
+  bool grow();
+
+  MpmcRing<uint8_t *> ring_;
+  std::mutex slabMutex_;
+  std::vector<std::unique_ptr<uint8_t[]>> slabs_;
+  std::atomic<std::size_t> allocated_{0};
+};
+
+// Owning handle for one packet. Sizes up to kBufferBytes come from the pool,
+// anything larger (or a pool at capacity) from the heap.
+class PacketBuffer {
+public:
+  PacketBuffer() = default;
+  explicit PacketBuffer(std::size_t size);
+  PacketBuffer(const void *data, std::size_t size);
+  ~PacketBuffer() { reset(); }
+
+  PacketBuffer(PacketBuffer &&other) noexcept;
+  PacketBuffer &operator=(PacketBuffer &&other) noexcept;
+  PacketBuffer(const PacketBuffer &) = delete;
+  PacketBuffer &operator=(const PacketBuffer &) = delete;
+
+  uint8_t *data() { return data_; }
+  const uint8_t *data() const { return data_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  void reset();
+
+private:
+  uint8_t *data_ = nullptr;
+  std::size_t size_ = 0;
+  bool pooled_ = false;
+};
@@ -0,0 +1,224 @@
+#include "path_selector.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <set>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+namespace {
+constexpr int kUnreachable = std::numeric_limits<int>::max();
+constexpr int kLossPenaltyMs = 200; // added at 100% loss, scaled linearly
+constexpr int kRelayPenaltyMs = 5;
+constexpr int kForwardPenaltyMs = 10;
+constexpr int kHysteresisMs = 15;
+constexpr double kHysteresisRatio = 0.2;
+constexpr std::chrono::seconds kMinHold{10};
+constexpr std::chrono::milliseconds kSampleExpiry{PATH_REPORT_INTERVAL_MS * 3};
+
+int sampleCost(const PathSample &sample,
+               std::chrono::steady_clock::time_point now) {
+  if (sample.pingMs < 0 || now - sample.updated > kSampleExpiry) {
+    return kUnreachable;
+  }
+  const float loss = 1.0f - std::clamp(sample.quality, 0.0f, 1.0f);
+  return sample.pingMs + static_cast<int>(loss * kLossPenaltyMs) +
+         (sample.relayed ? kRelayPenaltyMs : 0);
+}
+} // namespace
+
+void PathSelector::reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  direct_.clear();
+  reported_.clear();
+  routes_.clear();
+  localSteamID_ = CSteamID();
+}
+
+void PathSelector::setLocalSteamID(CSteamID steamID) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  localSteamID_ = steamID;
+}
+
+void PathSelector::updateDirect(CSteamID peer, const PathSample &sample) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  direct_[peer] = sample;
+}
+
+void PathSelector::removePeer(CSteamID peer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  direct_.erase(peer);
+  reported_.erase(peer);
+  routes_.erase(peer);
+  for (auto &route : routes_) {
+    if (route.second.nextHop == peer) {
+      route.second.nextHop = route.first;
+      route.second.since = std::chrono::steady_clock::now();
+    }
+  }
+}
+
+std::vector<uint8_t> PathSelector::buildReport() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<uint8_t> payload;
+  payload.reserve(direct_.size() * sizeof(PathReportEntry));
+  for (const auto &kv : direct_) {
+    if (kv.second.pingMs < 0) {
+      continue;
+    }
+    PathReportEntry entry{};
+    entry.steamID = kv.first.ConvertToUint64();
+    entry.pingMs = htons(static_cast<uint16_t>(
+        std::min(kv.second.pingMs, static_cast<int>(UINT16_MAX))));
+    entry.quality = static_cast<uint8_t>(
+        std::clamp(kv.second.quality, 0.0f, 1.0f) * 255.0f);
+    entry.relayed = kv.second.relayed ? 1 : 0;
+    const size_t offset = payload.size();
+    payload.resize(offset + sizeof(PathReportEntry));
+    std::memcpy(payload.data() + offset, &entry, sizeof(PathReportEntry));
+  }
+  return payload;
+}
+
+void PathSelector::handleReport(CSteamID reporter, const uint8_t *payload,
+                                size_t length) {
+  const auto now = std::chrono::steady_clock::now();
+  std::map<CSteamID, PathSample> paths;
+  for (size_t offset = 0; offset + sizeof(PathReportEntry) <= length;
+       offset += sizeof(PathReportEntry)) {
+    PathReportEntry entry{};
+    std::memcpy(&entry, payload + offset, sizeof(PathReportEntry));
+    const CSteamID peer(static_cast<uint64>(entry.steamID));
+    if (peer == reporter) {
+      continue;
+    }
+    PathSample sample;
+    sample.pingMs = ntohs(entry.pingMs);
+    sample.quality = entry.quality / 255.0f;
+    sample.relayed = entry.relayed != 0;
+    sample.updated = now;
+    paths[peer] = sample;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  reported_[reporter] = std::move(paths);
+}
+
+bool PathSelector::recompute(std::chrono::steady_clock::time_point now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::set<CSteamID> destinations;
+  for (const auto &kv : direct_) {
+    destinations.insert(kv.first);
+  }
+  for (const auto &reporter : reported_) {
+    for (const auto &kv : reporter.second) {
+      destinations.insert(kv.first);
+    }
+  }
+  destinations.erase(localSteamID_);
+
+  for (auto it = routes_.begin(); it != routes_.end();) {
+    if (destinations.count(it->first) == 0) {
+      it = routes_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  bool changed = false;
+  for (const auto &destination : destinations) {
+    Route &route = routes_[destination];
+    if (!route.nextHop.IsValid()) {
+      route.nextHop = destination; // free to switch as soon as we know better
+    }
+    const int current = pathCost(route.nextHop, destination, now);
+
+    CSteamID best = destination;
+    int bestCost = directCost(destination, now);
+    for (const auto &reporter : reported_) {
+      const CSteamID via = reporter.first;
+      if (via == destination || via == localSteamID_) {
+        continue;
+      }
+      const int cost = forwardedCost(via, destination, now);
+      if (cost < bestCost) {
+        best = via;
+        bestCost = cost;
+      }
+    }
+
+    bool switchPath = false;
+    if (best != route.nextHop && bestCost != kUnreachable) {
+      if (current == kUnreachable) {
+        switchPath = true;
+      } else {
+        const int margin = std::max(
+            kHysteresisMs, static_cast<int>(current * kHysteresisRatio));
+        switchPath =
+            bestCost + margin < current && now - route.since >= kMinHold;
+      }
+    }
+    if (switchPath) {
+      route.nextHop = best;
+      route.since = now;
+      changed = true;
+      std::cout << "[SteamVPN] Path to " << destination.ConvertToUint64();
+      if (best == destination) {
+        std::cout << " now direct";
+      } else {
+        std::cout << " now via " << best.ConvertToUint64();
+      }
+      std::cout << " (" << bestCost << " ms)" << std::endl;
+    }
+    const int cost = switchPath ? bestCost : current;
+    route.costMs = cost == kUnreachable ? -1 : cost;
+  }
+  return changed;
+}
+
+PathChoice PathSelector::choice(CSteamID destination) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  PathChoice result;
+  result.nextHop = destination;
+  auto it = routes_.find(destination);
+  if (it != routes_.end()) {
+    result.nextHop = it->second.nextHop;
+    result.costMs = it->second.costMs;
+  }
+  return result;
+}
+
+int PathSelector::directCost(CSteamID peer,
+                             std::chrono::steady_clock::time_point now) const {
+  auto it = direct_.find(peer);
+  return it == direct_.end() ? kUnreachable : sampleCost(it->second, now);
+}
+
+int PathSelector::forwardedCost(
+    CSteamID via, CSteamID destination,
+    std::chrono::steady_clock::time_point now) const {
+  const int firstHop = directCost(via, now);
+  auto reporter = reported_.find(via);
+  if (firstHop == kUnreachable || reporter == reported_.end()) {
+    return kUnreachable;
+  }
+  auto it = reporter->second.find(destination);
+  if (it == reporter->second.end()) {
+    return kUnreachable;
+  }
+  const int secondHop = sampleCost(it->second, now);
+  if (secondHop == kUnreachable) {
+    return kUnreachable;
+  }
+  return firstHop + secondHop + kForwardPenaltyMs;
+}
+
+int PathSelector::pathCost(CSteamID nextHop, CSteamID destination,
+                           std::chrono::steady_clock::time_point now) const {
+  return nextHop == destination ? directCost(destination, now)
+                                : forwardedCost(nextHop, destination, now);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "vpn_protocol.h"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <steam_api.h>
+#include <vector>
+
+struct PathSample {
+  int pingMs = -1;
+  float quality = 1.0f; // fraction of packets delivered, 0..1
+  bool relayed = false;
+  std::chrono::steady_clock::time_point updated;
+};
+
+struct PathChoice {
+  CSteamID nextHop; // the destination itself when direct
+  int costMs = -1;
+};
+
+// Chooses, for every peer in the mesh, between our direct session and a
+// single forwarding hop through another peer. Each peer measures its own
+// sessions and shares them in PATH_REPORT messages; a path costs its ping plus
+// penalties for loss and for Steam relays, and a forwarded path additionally
+// pays kForwardPenaltyMs. A better path has to win by a clear margin and the
+// previous choice has to have been held for a while before we switch, so two
+// similar paths do not flap. Forwarders always deliver directly, which keeps
+// every path at most two hops and loop free.
+class PathSelector {
+public:
+  void reset();
+  void setLocalSteamID(CSteamID steamID);
+
+  void updateDirect(CSteamID peer, const PathSample &sample);
+  void removePeer(CSteamID peer);
+
+  // PATH_REPORT payload describing our direct sessions.
+  std::vector<uint8_t> buildReport() const;
+  void handleReport(CSteamID reporter, const uint8_t *payload, size_t length);
+
+  // Re-evaluates every destination; returns true when a next hop changed.
+  bool recompute(std::chrono::steady_clock::time_point now);
+  PathChoice choice(CSteamID destination) const;
+
+private:
+  struct Route {
+    CSteamID nextHop;
+    int costMs = -1;
+    std::chrono::steady_clock::time_point since;
+  };
+
+  int directCost(CSteamID peer,
+                 std::chrono::steady_clock::time_point now) const;
+  int forwardedCost(CSteamID via, CSteamID destination,
+                    std::chrono::steady_clock::time_point now) const;
+  int pathCost(CSteamID nextHop, CSteamID destination,
+               std::chrono::steady_clock::time_point now) const;
+
+  CSteamID localSteamID_;
+  std::map<CSteamID, PathSample> direct_;
+  std::map<CSteamID, std::map<CSteamID, PathSample>> reported_;
+  std::map<CSteamID, Route> routes_;
+  mutable std::mutex mutex_;
+};
@@ -0,0 +1,197 @@
+#include "rate_controller.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+constexpr std::chrono::milliseconds kMinRound{100};
+constexpr std::chrono::seconds kMinRttWindow{10};
+constexpr uint64_t kBandwidthWindowRounds = 10;
+
+constexpr double kStartupGain = 2.0;
+constexpr double kDrainGain = 0.75;
+constexpr double kProbeGains[] = {1.25, 0.75, 1.0, 1.0};
+constexpr int kProbeCycleLength = sizeof(kProbeGains) / sizeof(kProbeGains[0]);
+constexpr int kCruiseCycleStart = 2;
+
+constexpr double kFullBandwidthGrowth = 1.25;
+constexpr int kFullBandwidthRounds = 3;
+constexpr int kCongestedRoundsBeforeBackoff = 2;
+constexpr int kMinQueueThresholdMs = 10;
+constexpr double kCongestiveLoss = 0.05;
+// Below this many pending bytes the sender is not keeping the pacer busy, so
+// the output rate says nothing about what the path could carry.
+constexpr int kAppLimitedPendingBytes = 16 * 1024;
+} // namespace
+
+RateController::RateController() : RateController(Config{}) {}
+
+RateController::RateController(const Config &config)
+    : config_(config),
+      rate_(std::clamp(config.initialRate, config.minRate, config.maxRate)),
+      reportedRate_(rate_) {}
+
+double RateController::bandwidthEstimate() const {
+  return bandwidth_.empty() ? 0.0 : bandwidth_.front().bytesPerSec;
+}
+
+bool RateController::update(const SteamNetConnectionRealTimeStatus_t &status,
+                            Clock::time_point now) {
+  if (status.m_eState != k_ESteamNetworkingConnectionState_Connected) {
+    return false;
+  }
+  const int ping = status.m_nPing;
+  if (ping >= 0 && (minRttMs_ < 0 || ping <= minRttMs_ ||
+                    now - minRttStamp_ > kMinRttWindow)) {
+    minRttMs_ = ping;
+    minRttStamp_ = now;
+  }
+  if (!started_) {
+    started_ = true;
+    roundStart_ = now;
+    lastPingMs_ = ping;
+    return false;
+  }
+
+  const auto roundLength =
+      std::max<Clock::duration>(kMinRound, std::chrono::milliseconds(
+                                               std::max(minRttMs_, 0)));
+  if (now - roundStart_ < roundLength) {
+    return false;
+  }
+  onRoundEnd(status, now);
+  roundStart_ = now;
+  ++round_;
+
+  if (std::abs(rate_ - reportedRate_) * 16 < reportedRate_) {
+    return false;
+  }
+  reportedRate_ = rate_;
+  return true;
+}
+
+void RateController::onRoundEnd(
+    const SteamNetConnectionRealTimeStatus_t &status, Clock::time_point now) {
+  const double elapsedMs =
+      std::chrono::duration<double, std::milli>(now - roundStart_).count();
+  const int ping = status.m_nPing;
+  double growth = 0.0;
+  if (ping >= 0 && lastPingMs_ >= 0 && elapsedMs > 0.0) {
+    growth = (ping - lastPingMs_) / elapsedMs;
+  }
+  lastPingMs_ = ping;
+
+  float quality = status.m_flConnectionQualityRemote;
+  if (quality < 0.0f) {
+    quality = status.m_flConnectionQualityLocal;
+  }
+  const double loss =
+      quality < 0.0f ? 0.0 : std::clamp(1.0 - quality, 0.0, 1.0);
+
+  // While the pacer is backlogged we are sending at exactly rate_; status
+  // byte rates are smoothed over longer than a round and would lag behind.
+  const int pending = status.m_cbPendingReliable + status.m_cbPendingUnreliable;
+  const double outRate = std::max(0.0f, status.m_flOutBytesPerSec);
+  const bool appLimited =
+      pending < kAppLimitedPendingBytes && outRate < rate_ * 0.9;
+  const double sending =
+      appLimited ? std::min<double>(outRate, rate_) : rate_;
+  const double delivered =
+      sending * (1.0 - loss) / std::max(0.5, 1.0 + growth);
+
+  if (!appLimited || delivered > bandwidthEstimate()) {
+    addBandwidthSample(delivered);
+  }
+
+  const int queueMs = (ping >= 0 && minRttMs_ >= 0) ? ping - minRttMs_ : 0;
+  const int queueLimit = std::max(kMinQueueThresholdMs, minRttMs_ / 4);
+  const bool congested = queueMs > queueLimit || loss > kCongestiveLoss;
+  const double estimate = bandwidthEstimate();
+
+  switch (mode_) {
+  case Mode::Startup:
+    if (congested) {
+      mode_ = Mode::Drain;
+      setRate(estimate * kDrainGain);
+      break;
+    }
+    if (!appLimited) {
+      if (estimate >= fullBandwidth_ * kFullBandwidthGrowth) {
+        fullBandwidth_ = estimate;
+        fullBandwidthRounds_ = 0;
+      } else if (++fullBandwidthRounds_ >= kFullBandwidthRounds) {
+        mode_ = Mode::Drain;
+        setRate(estimate * kDrainGain);
+        break;
+      }
+    }
+    setRate(std::max<double>(rate_, estimate * kStartupGain));
+    break;
+  case Mode::Drain:
+    if (queueMs <= queueLimit) {
+      mode_ = Mode::ProbeBandwidth;
+      cycleIndex_ = kCruiseCycleStart;
+      congestedRounds_ = 0;
+      setRate(estimate * kProbeGains[cycleIndex_]);
+    } else {
+      setRate(estimate * kDrainGain);
+    }
+    break;
+  case Mode::ProbeBandwidth:
+    // Queueing during the 1.25x probe is expected and drained by the next
+    // phase; a standing queue while cruising, or heavy loss at any point,
+    // means the path got slower.
+    if (loss > kCongestiveLoss ||
+        (congested && kProbeGains[cycleIndex_] == 1.0)) {
+      if (++congestedRounds_ >= kCongestedRoundsBeforeBackoff) {
+        resetBandwidth(delivered);
+        mode_ = Mode::Drain;
+        congestedRounds_ = 0;
+        setRate(bandwidthEstimate() * kDrainGain);
+        break;
+      }
+    } else {
+      congestedRounds_ = 0;
+    }
+    // The 1.25x probe went through without queueing: there is headroom, so
+    // search for it exponentially instead of 25% per cycle.
+    if (kProbeGains[cycleIndex_] > 1.0 && !congested &&
+        estimate >= probeBase_ * kFullBandwidthGrowth * 0.95) {
+      mode_ = Mode::Startup;
+      fullBandwidth_ = estimate;
+      fullBandwidthRounds_ = 0;
+      setRate(estimate * kStartupGain);
+      break;
+    }
+    cycleIndex_ = (cycleIndex_ + 1) % kProbeCycleLength;
+    if (kProbeGains[cycleIndex_] > 1.0) {
+      probeBase_ = estimate;
+    }
+    setRate(estimate * kProbeGains[cycleIndex_]);
+    break;
+  }
+}
+
+void RateController::addBandwidthSample(double bytesPerSec) {
+  while (!bandwidth_.empty() && bandwidth_.back().bytesPerSec <= bytesPerSec) {
+    bandwidth_.pop_back();
+  }
+  bandwidth_.push_back(BandwidthSample{round_, bytesPerSec});
+  while (bandwidth_.front().round + kBandwidthWindowRounds <= round_) {
+    bandwidth_.pop_front();
+  }
+}
+
+void RateController::resetBandwidth(double bytesPerSec) {
+  bandwidth_.clear();
+  bandwidth_.push_back(BandwidthSample{
+      round_, std::max<double>(bytesPerSec, config_.minRate)});
+}
+
+void RateController::setRate(double bytesPerSec) {
+  if (bytesPerSec <= 0.0) {
+    return;
+  }
+  rate_ = static_cast<int>(std::clamp<double>(bytesPerSec, config_.minRate,
+                                              config_.maxRate));
+}
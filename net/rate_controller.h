@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <steamnetworkingtypes.h>
+
+// Send rates applied to new connections before a controller has measured
+// anything, and the bounds every controller stays within (bytes per second).
+constexpr int kInitialSendRate = 1024 * 1024;
+constexpr int kMinSendRate = 64 * 1024;
+constexpr int kMaxSendRate = 256 * 1024 * 1024;
+
+// BBR-style pacing rate for one connection or session, driven purely by
+// GetConnectionRealTimeStatus. It keeps a windowed max of the delivery rate
+// and a windowed min of the RTT; delivery is inferred from our own output rate
+// discounted by loss and by how fast the RTT grew, since a growing queue means
+// the bottleneck drains slower than we fill it. Startup doubles the rate each
+// round until delivery stops growing, Drain empties the queue that built up,
+// and ProbeBandwidth cycles 1.25x/0.75x/1x around the estimate so a slower
+// path is noticed within a few rounds; a probe that finds headroom goes back
+// to Startup to find the rest of it quickly.
+class RateController {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  enum class Mode { Startup, Drain, ProbeBandwidth };
+
+  struct Config {
+    int initialRate = kInitialSendRate;
+    int minRate = kMinSendRate;
+    int maxRate = kMaxSendRate;
+  };
+
+  RateController();
+  explicit RateController(const Config &config);
+
+  // Feeds one status sample. Returns true when rate() moved far enough from
+  // the last reported value that it should be pushed to the transport.
+  bool update(const SteamNetConnectionRealTimeStatus_t &status,
+              Clock::time_point now);
+
+  int rate() const { return rate_; }
+  Mode mode() const { return mode_; }
+  double bandwidthEstimate() const;
+  int minRttMs() const { return minRttMs_; }
+
+private:
+  struct BandwidthSample {
+    uint64_t round = 0;
+    double bytesPerSec = 0.0;
+  };
+
+  void onRoundEnd(const SteamNetConnectionRealTimeStatus_t &status,
+                  Clock::time_point now);
+  void addBandwidthSample(double bytesPerSec);
+  void resetBandwidth(double bytesPerSec);
+  void setRate(double bytesPerSec);
+
+  Config config_;
+  Mode mode_ = Mode::Startup;
+  int rate_;
+  int reportedRate_;
+
+  Clock::time_point roundStart_;
+  uint64_t round_ = 0;
+  bool started_ = false;
+  int lastPingMs_ = -1;
+
+  int minRttMs_ = -1;
+  Clock::time_point minRttStamp_;
+  std::deque<BandwidthSample> bandwidth_; // windowed max filter
+
+  double fullBandwidth_ = 0.0;
+  double probeBase_ = 0.0; // estimate when the current 1.25x probe began
+  int fullBandwidthRounds_ = 0;
+  int congestedRounds_ = 0;
+  int cycleIndex_ = 0;
+};
@@ -0,0 +1,175 @@
+#include "route_sync.h"
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+namespace {
+// A lost or reordered request is asked for again after this long.
+constexpr auto kSyncRetry = std::chrono::seconds(1);
+
+void putChange(std::vector<uint8_t> &out, uint64_t steamId,
+               uint32_t ipAddress, bool removed) {
+  RouteChange change{};
+  change.steamID = steamId;
+  change.ipAddress = htonl(ipAddress);
+  change.removed = removed ? 1 : 0;
+  const size_t offset = out.size();
+  out.resize(offset + sizeof(RouteChange));
+  std::memcpy(out.data() + offset, &change, sizeof(RouteChange));
+}
+
+void readChanges(const uint8_t *data, size_t length, bool allowRemoved,
+                 std::vector<RouteSync::Change> &changes) {
+  for (size_t offset = 0; offset + sizeof(RouteChange) <= length;
+       offset += sizeof(RouteChange)) {
+    RouteChange change{};
+    std::memcpy(&change, data + offset, sizeof(RouteChange));
+    changes.push_back({change.steamID, ntohl(change.ipAddress),
+                       allowRemoved && change.removed != 0});
+  }
+}
+} // namespace
+
+void RouteSync::reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  routes_.clear();
+  pending_.clear();
+  version_ = 0;
+  peers_.clear();
+}
+
+void RouteSync::add(uint64_t steamId, uint32_t ipAddress, bool share) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = routes_.find(ipAddress);
+  if (it != routes_.end() && it->second == steamId) {
+    return;
+  }
+  routes_[ipAddress] = steamId;
+  if (share) {
+    pending_[ipAddress] = {steamId, ipAddress, false};
+  }
+}
+
+void RouteSync::remove(uint32_t ipAddress, bool share) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = routes_.find(ipAddress);
+  if (it == routes_.end()) {
+    return;
+  }
+  if (share) {
+    pending_[ipAddress] = {it->second, ipAddress, true};
+  }
+  routes_.erase(it);
+}
+
+std::size_t RouteSync::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return routes_.size();
+}
+
+uint32_t RouteSync::version() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return version_;
+}
+
+std::vector<std::vector<uint8_t>> RouteSync::takeDeltas() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<std::vector<uint8_t>> deltas;
+  auto it = pending_.begin();
+  while (it != pending_.end()) {
+    RouteDeltaHeader header{};
+    header.base = htonl(version_);
+    header.version = htonl(++version_);
+    std::vector<uint8_t> payload(sizeof(header));
+    std::memcpy(payload.data(), &header, sizeof(header));
+    for (std::size_t n = 0; n < kMaxEntries && it != pending_.end(); ++n) {
+      putChange(payload, it->second.steamId, it->second.ipAddress,
+                it->second.removed);
+      ++it;
+    }
+    deltas.push_back(std::move(payload));
+  }
+  pending_.clear();
+  return deltas;
+}
+
+std::vector<std::vector<uint8_t>> RouteSync::buildSync() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<std::vector<uint8_t>> parts;
+  auto it = routes_.begin();
+  do {
+    std::vector<uint8_t> payload(sizeof(RouteSyncHeader));
+    for (std::size_t n = 0; n < kMaxEntries && it != routes_.end(); ++n) {
+      putChange(payload, it->second, it->first, false);
+      ++it;
+    }
+    RouteSyncHeader header{};
+    header.version = htonl(version_);
+    header.last = it == routes_.end() ? 1 : 0;
+    std::memcpy(payload.data(), &header, sizeof(header));
+    parts.push_back(std::move(payload));
+  } while (it != routes_.end());
+  return parts;
+}
+
+RouteSync::Result RouteSync::applyDelta(CSteamID sender,
+                                        const uint8_t *payload, size_t length,
+                                        std::vector<Change> &changes) {
+  if (length < sizeof(RouteDeltaHeader) ||
+      (length - sizeof(RouteDeltaHeader)) % sizeof(RouteChange) != 0) {
+    return Result::Ignored;
+  }
+  RouteDeltaHeader header{};
+  std::memcpy(&header, payload, sizeof(header));
+  const uint32_t base = ntohl(header.base);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  PeerState &peer = peers_[sender];
+  if (base != 0 && (!peer.synced || base != peer.version)) {
+    peer.synced = false;
+    const auto now = std::chrono::steady_clock::now();
+    if (peer.requested != std::chrono::steady_clock::time_point{} &&
+        now - peer.requested < kSyncRetry) {
+      return Result::Ignored;
+    }
+    peer.requested = now;
+    return Result::NeedSync;
+  }
+  readChanges(payload + sizeof(header), length - sizeof(header), true,
+              changes);
+  peer.version = ntohl(header.version);
+  peer.synced = true;
+  peer.requested = {};
+  return Result::Applied;
+}
+
+RouteSync::Result RouteSync::applySync(CSteamID sender, const uint8_t *payload,
+                                       size_t length,
+                                       std::vector<Change> &changes) {
+  if (length < sizeof(RouteSyncHeader) ||
+      (length - sizeof(RouteSyncHeader)) % sizeof(RouteChange) != 0) {
+    return Result::Ignored;
+  }
+  RouteSyncHeader header{};
+  std::memcpy(&header, payload, sizeof(header));
+  readChanges(payload + sizeof(header), length - sizeof(header), false,
+              changes);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (header.last) {
+    PeerState &peer = peers_[sender];
+    peer.version = ntohl(header.version);
+    peer.synced = true;
+    peer.requested = {};
+  }
+  return Result::Applied;
+}
+
+void RouteSync::removePeer(CSteamID sender) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  peers_.erase(sender);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "vpn_protocol.h"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <steam_api.h>
+#include <vector>
+
+// Versioned copy of the routing table as TUN peers exchange it. Every change
+// we share bumps our version; changes made between two flushes go out
+// together as one ROUTE_DELTA from the previous version to the new one. A
+// peer applies a delta only on top of the version it last saw from us (or
+// from version 0, which is our whole history); on a gap it asks for a
+// ROUTE_SYNC, our whole table in parts of at most kMaxEntries routes, and
+// resumes from the version in it. Routes learned from a peer's delta or sync
+// are kept for our own syncs but not shared again.
+class RouteSync {
+public:
+  struct Change {
+    uint64_t steamId;
+    uint32_t ipAddress;
+    bool removed;
+  };
+
+  enum class Result { Applied, Ignored, NeedSync };
+
+  static constexpr std::size_t kMaxEntries = 1024;
+
+  void reset();
+
+  void add(uint64_t steamId, uint32_t ipAddress, bool share);
+  void remove(uint32_t ipAddress, bool share);
+  std::size_t size() const;
+  uint32_t version() const;
+
+  // ROUTE_DELTA payloads for the changes shared since the last call.
+  std::vector<std::vector<uint8_t>> takeDeltas();
+  // ROUTE_SYNC payloads for the whole table.
+  std::vector<std::vector<uint8_t>> buildSync() const;
+
+  // Both append what the sender changed to changes. NeedSync asks the caller
+  // to send ROUTE_SYNC_REQUEST; while one is outstanding, deltas are Ignored.
+  Result applyDelta(CSteamID sender, const uint8_t *payload, size_t length,
+                    std::vector<Change> &changes);
+  Result applySync(CSteamID sender, const uint8_t *payload, size_t length,
+                   std::vector<Change> &changes);
+  void removePeer(CSteamID sender);
+
+private:
+  struct PeerState {
+    uint32_t version = 0;
+    bool synced = false;
+    std::chrono::steady_clock::time_point requested;
+  };
+
+  std::map<uint32_t, uint64_t> routes_; // IP -> Steam ID
+  std::map<uint32_t, Change> pending_;  // by IP, latest change wins
+  uint32_t version_ = 0;
+  std::map<CSteamID, PeerState> peers_;
+  mutable std::mutex mutex_;
+};
@@ -4,7 +4,12 @@
 #include <iostream>
 #include <algorithm>
 
-TCPServer::TCPServer(int port, SteamNetworkingManager* manager) : port_(port), running_(false), acceptor_(io_context_), work_(boost::asio::make_work_guard(io_context_)), manager_(manager) {}
+TCPServer::TCPServer(int port, SteamNetworkingManager* manager)
+    : TCPServer(port,
+                [manager]() { return manager->getMessageHandler()->getMultiplexManager(manager->getConnection()); },
+                [manager]() { return manager->isConnected(); }) {}
+
+TCPServer::TCPServer(int port, MultiplexerProvider multiplexer, ConnectedCheck connected) : port_(port), running_(false), work_(boost::asio::make_work_guard(io_context_)), acceptor_(io_context_), multiplexer_(std::move(multiplexer)), connected_(std::move(connected)) {}
 
 TCPServer::~TCPServer() { stop(); }
 
@@ -86,7 +91,7 @@ void TCPServer::start_accept() {
             // Low latency between local TCP and Steam tunnel
             boost::system::error_code ec;
             socket->set_option(tcp::no_delay(true), ec);
-            auto multiplexManager = manager_->getMessageHandler()->getMultiplexManager(manager_->getConnection());
+            auto multiplexManager = multiplexer_();
             std::string id = multiplexManager->addClient(socket);
             int currentCount = 0;
             {
@@ -107,8 +112,8 @@ void TCPServer::start_read(std::shared_ptr<tcp::socket> socket, std::string id)
     auto buffer = std::make_shared<std::vector<char>>(1048576);
     socket->async_read_some(boost::asio::buffer(*buffer), [this, socket, buffer, id](const boost::system::error_code& error, std::size_t bytes_transferred) {
         if (!error) {
-            if (manager_->isConnected()) {
-                auto multiplexManager = manager_->getMessageHandler()->getMultiplexManager(manager_->getConnection());
+            if (!connected_ || connected_()) {
+                auto multiplexManager = multiplexer_();
                 multiplexManager->sendTunnelPacket(id, buffer->data(), bytes_transferred, 0);
             } else {
                 std::cout << "Not connected to Steam, skipping forward" << std::endl;
@@ -118,8 +123,8 @@ void TCPServer::start_read(std::shared_ptr<tcp::socket> socket, std::string id)
         } else {
             std::cout << "TCP client " << id << " disconnected or error: " << error.message() << std::endl;
             // Send disconnect packet
-            if (manager_->isConnected()) {
-                auto multiplexManager = manager_->getMessageHandler()->getMultiplexManager(manager_->getConnection());
+            if (!connected_ || connected_()) {
+                auto multiplexManager = multiplexer_();
                 multiplexManager->sendTunnelPacket(id, nullptr, 0, 1);
                 // Remove client
                 multiplexManager->removeClient(id);
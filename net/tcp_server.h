@@ -20,7 +20,13 @@ using boost::asio::ip::tcp;
 // TCP Server class
 class TCPServer {
 public:
+    // Returns the multiplexer for the current tunnel connection.
+    using MultiplexerProvider = std::function<std::shared_ptr<MultiplexManager>()>;
+    // Whether the tunnel is up; data read while it is down is not forwarded.
+    using ConnectedCheck = std::function<bool()>;
+
     TCPServer(int port, SteamNetworkingManager* manager);
+    TCPServer(int port, MultiplexerProvider multiplexer, ConnectedCheck connected = nullptr);
     ~TCPServer();
 
     bool start();
@@ -43,6 +49,7 @@ private:
     std::vector<std::shared_ptr<tcp::socket>> clients_;
     std::mutex clientsMutex_;
     std::thread serverThread_;
-    SteamNetworkingManager* manager_;
+    MultiplexerProvider multiplexer_;
+    ConnectedCheck connected_;
     std::function<void(int)> clientCountCallback_;
 };
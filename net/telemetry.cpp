@@ -0,0 +1,335 @@
+#include "telemetry.h"
+#include <algorithm>
+
+namespace telemetry {
+namespace {
+constexpr uint8_t kVersion = 1;
+constexpr uint8_t kFlagKeyframe = 0x01;
+
+constexpr uint8_t kFieldPing = 0x01;
+constexpr uint8_t kFieldQuality = 0x02;
+constexpr uint8_t kFieldTransport = 0x04;
+constexpr uint8_t kFieldTx = 0x08;
+constexpr uint8_t kFieldRx = 0x10;
+constexpr uint8_t kRemoved = 0x80;
+
+constexpr int kRateShift = 10; // rates travel in KiB/s
+constexpr uint8_t kUnknownQuality = 0xFF;
+constexpr uint64_t kMaxEntries = 4096;
+
+void putVarint(std::vector<uint8_t> &out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+void putSigned(std::vector<uint8_t> &out, int64_t value) {
+  putVarint(out, (static_cast<uint64_t>(value) << 1) ^
+                     static_cast<uint64_t>(value >> 63));
+}
+
+class Reader {
+public:
+  Reader(const uint8_t *data, size_t length)
+      : data_(data), end_(data + length) {}
+
+  bool atEnd() const { return data_ == end_; }
+
+  bool byte(uint8_t &value) {
+    if (data_ == end_) {
+      return false;
+    }
+    value = *data_++;
+    return true;
+  }
+
+  bool varint(uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      uint8_t next = 0;
+      if (!byte(next)) {
+        return false;
+      }
+      value |= static_cast<uint64_t>(next & 0x7F) << shift;
+      if ((next & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool signedVarint(int64_t &value) {
+    uint64_t raw = 0;
+    if (!varint(raw)) {
+      return false;
+    }
+    value = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+    return true;
+  }
+
+private:
+  const uint8_t *data_;
+  const uint8_t *end_;
+};
+
+uint64_t quantizeRate(uint64_t bytesPerSecond) {
+  return (bytesPerSecond >> kRateShift) << kRateShift;
+}
+
+uint8_t changedFields(const Member &before, const Member &after) {
+  uint8_t mask = 0;
+  if (before.pingMs != after.pingMs) {
+    mask |= kFieldPing;
+  }
+  if (before.quality != after.quality) {
+    mask |= kFieldQuality;
+  }
+  if (before.transport != after.transport) {
+    mask |= kFieldTransport;
+  }
+  if (before.txRate != after.txRate) {
+    mask |= kFieldTx;
+  }
+  if (before.rxRate != after.rxRate) {
+    mask |= kFieldRx;
+  }
+  return mask;
+}
+
+void putEntry(std::vector<uint8_t> &out, uint64_t &lastId,
+              const Member &before, const Member &after, uint8_t mask) {
+  putVarint(out, after.steamId - lastId);
+  lastId = after.steamId;
+  out.push_back(mask);
+  if (mask & kFieldPing) {
+    putSigned(out, static_cast<int64_t>(after.pingMs) - before.pingMs);
+  }
+  if (mask & kFieldQuality) {
+    out.push_back(after.quality >= 0 && after.quality <= 100
+                      ? static_cast<uint8_t>(after.quality)
+                      : kUnknownQuality);
+  }
+  if (mask & kFieldTransport) {
+    out.push_back(static_cast<uint8_t>(after.transport));
+  }
+  if (mask & kFieldTx) {
+    putSigned(out, static_cast<int64_t>(after.txRate >> kRateShift) -
+                       static_cast<int64_t>(before.txRate >> kRateShift));
+  }
+  if (mask & kFieldRx) {
+    putSigned(out, static_cast<int64_t>(after.rxRate >> kRateShift) -
+                       static_cast<int64_t>(before.rxRate >> kRateShift));
+  }
+}
+
+bool readRate(Reader &in, uint64_t &rate) {
+  int64_t delta = 0;
+  if (!in.signedVarint(delta)) {
+    return false;
+  }
+  const int64_t next = static_cast<int64_t>(rate >> kRateShift) + delta;
+  if (next < 0) {
+    return false;
+  }
+  rate = static_cast<uint64_t>(next) << kRateShift;
+  return true;
+}
+
+bool readFields(Reader &in, uint8_t mask, Member &member) {
+  if (mask & kFieldPing) {
+    int64_t delta = 0;
+    if (!in.signedVarint(delta)) {
+      return false;
+    }
+    member.pingMs = static_cast<int>(member.pingMs + delta);
+  }
+  if (mask & kFieldQuality) {
+    uint8_t quality = 0;
+    if (!in.byte(quality)) {
+      return false;
+    }
+    member.quality = quality <= 100 ? quality : -1;
+  }
+  if (mask & kFieldTransport) {
+    uint8_t transport = 0;
+    if (!in.byte(transport) ||
+        transport > static_cast<uint8_t>(Transport::Relayed)) {
+      return false;
+    }
+    member.transport = static_cast<Transport>(transport);
+  }
+  if ((mask & kFieldTx) && !readRate(in, member.txRate)) {
+    return false;
+  }
+  if ((mask & kFieldRx) && !readRate(in, member.rxRate)) {
+    return false;
+  }
+  return true;
+}
+
+bool bySteamId(const Member &a, const Member &b) {
+  return a.steamId < b.steamId;
+}
+} // namespace
+
+bool Member::operator==(const Member &other) const {
+  return steamId == other.steamId && pingMs == other.pingMs &&
+         quality == other.quality && transport == other.transport &&
+         txRate == other.txRate && rxRate == other.rxRate;
+}
+
+std::vector<uint8_t> Encoder::encode(Snapshot members) {
+  for (auto &member : members) {
+    member.txRate = quantizeRate(member.txRate);
+    member.rxRate = quantizeRate(member.rxRate);
+    if (member.quality < 0 || member.quality > 100) {
+      member.quality = -1;
+    }
+  }
+  std::sort(members.begin(), members.end(), bySteamId);
+  members.erase(std::unique(members.begin(), members.end(),
+                            [](const Member &a, const Member &b) {
+                              return a.steamId == b.steamId;
+                            }),
+                members.end());
+
+  const bool keyframe = sequence_ == 0 || sinceKeyframe_ >= kKeyframeInterval;
+  std::vector<uint8_t> entries;
+  uint64_t count = 0;
+  uint64_t lastId = 0;
+  const auto putAgainstDefaults = [&](const Member &member) {
+    Member blank;
+    blank.steamId = member.steamId;
+    putEntry(entries, lastId, blank, member, changedFields(blank, member));
+    ++count;
+  };
+
+  if (keyframe) {
+    for (const auto &member : members) {
+      putAgainstDefaults(member);
+    }
+  } else {
+    auto before = previous_.begin();
+    auto after = members.begin();
+    while (before != previous_.end() || after != members.end()) {
+      if (after == members.end() ||
+          (before != previous_.end() && before->steamId < after->steamId)) {
+        putEntry(entries, lastId, *before, *before, kRemoved);
+        ++count;
+        ++before;
+      } else if (before == previous_.end() ||
+                 after->steamId < before->steamId) {
+        putAgainstDefaults(*after);
+        ++after;
+      } else {
+        const uint8_t mask = changedFields(*before, *after);
+        if (mask != 0) {
+          putEntry(entries, lastId, *before, *after, mask);
+          ++count;
+        }
+        ++before;
+        ++after;
+      }
+    }
+  }
+
+  std::vector<uint8_t> frame;
+  frame.reserve(entries.size() + 12);
+  frame.push_back(kVersion);
+  frame.push_back(keyframe ? kFlagKeyframe : 0);
+  putVarint(frame, sequence_);
+  putVarint(frame, count);
+  frame.insert(frame.end(), entries.begin(), entries.end());
+
+  previous_ = std::move(members);
+  ++sequence_;
+  sinceKeyframe_ = keyframe ? 1 : sinceKeyframe_ + 1;
+  return frame;
+}
+
+bool Decoder::apply(const uint8_t *data, size_t length) {
+  Reader in(data, length);
+  uint8_t version = 0;
+  uint8_t flags = 0;
+  uint64_t sequence = 0;
+  uint64_t count = 0;
+  if (!in.byte(version) || version != kVersion || !in.byte(flags) ||
+      !in.varint(sequence) || !in.varint(count) || count > kMaxEntries) {
+    return false;
+  }
+  const bool keyframe = (flags & kFlagKeyframe) != 0;
+  if (!keyframe &&
+      (!synced_ || static_cast<uint32_t>(sequence) != sequence_ + 1)) {
+    synced_ = false;
+    return false;
+  }
+
+  Snapshot next = keyframe ? Snapshot{} : members_;
+  uint64_t steamId = 0;
+  for (uint64_t i = 0; i < count; ++i) {
+    uint64_t delta = 0;
+    uint8_t mask = 0;
+    if (!in.varint(delta) || (i > 0 && delta == 0) || !in.byte(mask)) {
+      return false;
+    }
+    steamId += delta;
+    Member key;
+    key.steamId = steamId;
+    auto it = std::lower_bound(next.begin(), next.end(), key, bySteamId);
+    const bool known = it != next.end() && it->steamId == steamId;
+    if (mask & kRemoved) {
+      if (known) {
+        next.erase(it);
+      }
+      continue;
+    }
+    if (!known) {
+      it = next.insert(it, key);
+    }
+    if (!readFields(in, mask, *it)) {
+      return false;
+    }
+  }
+  if (!in.atEnd()) {
+    return false;
+  }
+
+  members_ = std::move(next);
+  sequence_ = static_cast<uint32_t>(sequence);
+  synced_ = true;
+  return true;
+}
+
+void Decoder::reset() {
+  members_.clear();
+  sequence_ = 0;
+  synced_ = false;
+}
+
+void Inbox::publish(Snapshot members) {
+  Pointer next = std::make_shared<const Snapshot>(std::move(members));
+  // A reader that has not caught up only needs the newest snapshot.
+  Pointer stale;
+  while (!ring_.tryPush(next)) {
+    ring_.tryPop(stale);
+  }
+}
+
+std::shared_ptr<const Snapshot> Inbox::latest() {
+  Pointer next;
+  while (ring_.tryPop(next)) {
+    latest_ = std::move(next);
+  }
+  return latest_;
+}
+
+const Member *find(const Snapshot &members, uint64_t steamId) {
+  Member key;
+  key.steamId = steamId;
+  auto it = std::lower_bound(members.begin(), members.end(), key, bySteamId);
+  return it != members.end() && it->steamId == steamId ? &*it : nullptr;
+}
+
+} // namespace telemetry
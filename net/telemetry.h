@@ -0,0 +1,86 @@
+#pragma once
+
+#include "mpmc_ring.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Member telemetry the host sends its TCP-mode clients over their tunnel
+// connection: ping, connection quality and transport of each of its own
+// connections, plus the throughput it sees on them, so every client can show
+// the whole lobby without asking each member.
+//
+// A frame is a version byte, a flags byte (bit 0: keyframe), a varint
+// sequence number and a varint entry count. Entries are sorted by Steam ID,
+// which is written as a varint delta from the previous entry, and carry a
+// mask of the fields that follow. Ping and rates are zigzag varint deltas
+// from the value the receiver already has; rates travel in KiB/s. Keyframes
+// list every member against default values. Other frames only list members
+// that changed, joined or left (mask kRemoved) since the previous frame.
+// Frames ride the reliable tunnel channel, so a receiver only loses sync
+// when it joins mid-stream; it then waits for the next keyframe.
+namespace telemetry {
+
+enum class Transport : uint8_t { Unknown = 0, Direct, Relayed };
+
+struct Member {
+  uint64_t steamId = 0;
+  int pingMs = -1;
+  int quality = -1; // 0-100, -1 when unknown
+  Transport transport = Transport::Unknown;
+  uint64_t txRate = 0; // bytes/s from the host to the member
+  uint64_t rxRate = 0; // bytes/s from the member to the host
+
+  bool operator==(const Member &other) const;
+  bool operator!=(const Member &other) const { return !(*this == other); }
+};
+
+// Sorted by steamId.
+using Snapshot = std::vector<Member>;
+
+class Encoder {
+public:
+  static constexpr uint32_t kKeyframeInterval = 8;
+
+  // The next frame for this receiver; members need not be sorted.
+  std::vector<uint8_t> encode(Snapshot members);
+
+private:
+  Snapshot previous_;
+  uint32_t sequence_ = 0;
+  uint32_t sinceKeyframe_ = 0;
+};
+
+class Decoder {
+public:
+  // False, leaving members() as it was, for a malformed frame or a delta
+  // that does not follow the last frame applied.
+  bool apply(const uint8_t *data, size_t length);
+  const Snapshot &members() const { return members_; }
+  void reset();
+
+private:
+  Snapshot members_;
+  uint32_t sequence_ = 0;
+  bool synced_ = false;
+};
+
+// Hands decoded snapshots from the network thread to a single reader without
+// either side taking a lock. The reader keeps the newest one it has seen.
+class Inbox {
+public:
+  void publish(Snapshot members);
+  // Reader side only.
+  std::shared_ptr<const Snapshot> latest();
+
+private:
+  using Pointer = std::shared_ptr<const Snapshot>;
+  MpmcRing<Pointer> ring_{4};
+  Pointer latest_ = std::make_shared<const Snapshot>();
+};
+
+// The member in a sorted snapshot, or nullptr.
+const Member *find(const Snapshot &members, uint64_t steamId);
+
+} // namespace telemetry
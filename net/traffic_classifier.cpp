@@ -0,0 +1,178 @@
+#include "traffic_classifier.h"
+#include "ip_packet.h"
+#include <cstdlib>
+#include <sstream>
+
+namespace {
+constexpr uint8_t kProtocolIcmp = 1;
+
+TrafficClass classForDscp(uint8_t dscp) {
+  switch (dscp) {
+  case 46: // EF
+  case 32: // CS4
+  case 34: // AF41
+  case 36: // AF42
+  case 38: // AF43
+  case 40: // CS5
+  case 48: // CS6
+  case 56: // CS7
+    return TrafficClass::Interactive;
+  case 1:  // LE (RFC 8622)
+  case 8:  // CS1
+  case 10: // AF11
+  case 12: // AF12
+  case 14: // AF13
+    return TrafficClass::Bulk;
+  default:
+    return TrafficClass::Default;
+  }
+}
+
+bool parsePort(const std::string &text, uint16_t &port) {
+  char *end = nullptr;
+  const unsigned long value = std::strtoul(text.c_str(), &end, 10);
+  if (text.empty() || *end != '\0' || value > 65535) {
+    return false;
+  }
+  port = static_cast<uint16_t>(value);
+  return true;
+}
+
+bool parsePortRule(const std::string &text, TrafficClassifier::PortRule &rule) {
+  const std::size_t slash = text.find('/');
+  const std::size_t equals = text.find('=');
+  if (slash == std::string::npos || equals == std::string::npos ||
+      equals < slash) {
+    return false;
+  }
+  const std::string protocol = text.substr(0, slash);
+  if (protocol == "tcp") {
+    rule.protocol = ippacket::kProtocolTcp;
+  } else if (protocol == "udp") {
+    rule.protocol = ippacket::kProtocolUdp;
+  } else {
+    return false;
+  }
+  const std::string ports = text.substr(slash + 1, equals - slash - 1);
+  const std::size_t dash = ports.find('-');
+  if (!parsePort(ports.substr(0, dash), rule.first)) {
+    return false;
+  }
+  rule.last = rule.first;
+  if (dash != std::string::npos &&
+      (!parsePort(ports.substr(dash + 1), rule.last) ||
+       rule.last < rule.first)) {
+    return false;
+  }
+  return parseTrafficClass(text.substr(equals + 1), rule.trafficClass);
+}
+} // namespace
+
+const char *trafficClassName(TrafficClass trafficClass) {
+  switch (trafficClass) {
+  case TrafficClass::Interactive:
+    return "interactive";
+  case TrafficClass::Default:
+    return "default";
+  case TrafficClass::Bulk:
+    return "bulk";
+  default:
+    return "unknown";
+  }
+}
+
+bool parseTrafficClass(const std::string &name, TrafficClass &trafficClass) {
+  for (std::size_t i = 0; i < kTrafficClassCount; ++i) {
+    const auto candidate = static_cast<TrafficClass>(i);
+    if (name == trafficClassName(candidate)) {
+      trafficClass = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+TrafficClassifier::TrafficClassifier() {
+  config(TrafficClass::Interactive) = ClassConfig{0, 1, false};
+  config(TrafficClass::Default) = ClassConfig{1, 3, false};
+  config(TrafficClass::Bulk) = ClassConfig{1, 1, false};
+}
+
+bool TrafficClassifier::addPortRules(const std::string &spec) {
+  std::vector<PortRule> parsed;
+  std::stringstream list(spec);
+  std::string item;
+  while (std::getline(list, item, ',')) {
+    if (item.empty()) {
+      continue;
+    }
+    PortRule rule{};
+    if (!parsePortRule(item, rule)) {
+      return false;
+    }
+    parsed.push_back(rule);
+  }
+  rules_.insert(rules_.end(), parsed.begin(), parsed.end());
+  return true;
+}
+
+bool TrafficClassifier::setReliableClasses(const std::string &list) {
+  std::array<bool, kTrafficClassCount> reliable{};
+  std::stringstream names(list);
+  std::string item;
+  while (std::getline(names, item, ',')) {
+    if (item.empty()) {
+      continue;
+    }
+    TrafficClass trafficClass;
+    if (!parseTrafficClass(item, trafficClass)) {
+      return false;
+    }
+    reliable[static_cast<std::size_t>(trafficClass)] = true;
+  }
+  for (std::size_t i = 0; i < kTrafficClassCount; ++i) {
+    classes_[i].reliable = reliable[i];
+  }
+  return true;
+}
+
+TrafficClass TrafficClassifier::classify(const uint8_t *packet,
+                                         std::size_t length) const {
+  const ippacket::Layout &layout = ippacket::kLayouts[packet[0] >> 4];
+  const bool ipv4 = layout.addressBytes == 4;
+  const uint8_t protocol = packet[layout.protocolOffset];
+
+  if (!rules_.empty() && (protocol == ippacket::kProtocolTcp ||
+                          protocol == ippacket::kProtocolUdp)) {
+    const std::size_t transport =
+        ipv4 ? static_cast<std::size_t>(packet[0] & 0x0F) * 4
+             : layout.minLength;
+    const bool fragment = ipv4 && ((packet[6] & 0x1F) | packet[7]) != 0;
+    if (!fragment && length >= transport + 4) {
+      const uint16_t source = static_cast<uint16_t>(
+          (packet[transport] << 8) | packet[transport + 1]);
+      const uint16_t destination = static_cast<uint16_t>(
+          (packet[transport + 2] << 8) | packet[transport + 3]);
+      for (const auto &rule : rules_) {
+        if (rule.protocol == protocol &&
+            ((destination >= rule.first && destination <= rule.last) ||
+             (source >= rule.first && source <= rule.last))) {
+          return rule.trafficClass;
+        }
+      }
+    }
+  }
+
+  // IPv4 TOS byte, or the IPv6 traffic class straddling bytes 0 and 1.
+  const uint8_t tos = ipv4 ? packet[1]
+                           : static_cast<uint8_t>((packet[0] << 4) |
+                                                  (packet[1] >> 4));
+  const TrafficClass marked = classForDscp(tos >> 2);
+  if (marked != TrafficClass::Default) {
+    return marked;
+  }
+  if (protocol == (ipv4 ? kProtocolIcmp : ippacket::kNextHeaderIcmpv6)) {
+    return TrafficClass::Interactive;
+  }
+  return TrafficClass::Default;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class TrafficClass : uint8_t { Interactive = 0, Default, Bulk, Count };
+
+constexpr std::size_t kTrafficClassCount =
+    static_cast<std::size_t>(TrafficClass::Count);
+
+const char *trafficClassName(TrafficClass trafficClass);
+bool parseTrafficClass(const std::string &name, TrafficClass &trafficClass);
+
+// Sorts TUN packets into traffic classes, each with its own egress lane (see
+// EgressQueue) and reliability. Configured port rules win; then DSCP, with
+// EF, CS4-CS7 and AF4x interactive and LE, CS1 and AF1x bulk; then ICMP,
+// which is interactive so pings measure the path a game sees. The rest is
+// Default. By default interactive traffic is served before everything else
+// and bulk gets a quarter of what is left.
+class TrafficClassifier {
+public:
+  struct ClassConfig {
+    int priority = 1; // lower is served first
+    int weight = 1;   // share among classes of the same priority
+    bool reliable = false;
+  };
+
+  struct PortRule {
+    uint8_t protocol; // ippacket::kProtocolTcp or kProtocolUdp
+    uint16_t first;
+    uint16_t last;
+    TrafficClass trafficClass;
+  };
+
+  TrafficClassifier();
+
+  // Adds rules like "udp/27015-27030=interactive,tcp/80=bulk"; a rule matches
+  // either port of a packet. False, with nothing added, on a malformed spec.
+  bool addPortRules(const std::string &spec);
+  // Marks the listed classes ("interactive,bulk") reliable.
+  bool setReliableClasses(const std::string &list);
+
+  ClassConfig &config(TrafficClass trafficClass) {
+    return classes_[static_cast<std::size_t>(trafficClass)];
+  }
+  const ClassConfig &config(TrafficClass trafficClass) const {
+    return classes_[static_cast<std::size_t>(trafficClass)];
+  }
+
+  // For a packet ippacket::version() accepted.
+  TrafficClass classify(const uint8_t *packet, std::size_t length) const;
+
+private:
+  std::array<ClassConfig, kTrafficClassCount> classes_;
+  std::vector<PortRule> rules_;
+};
@@ -0,0 +1,89 @@
+#include "transport.h"
+
+#include <chrono>
+#include <new>
+
+namespace {
+struct OwnedMessage : SteamNetworkingMessage_t {
+  std::vector<uint8_t> payload;
+};
+
+// Lives in a pool buffer of its own, so a pooled message costs no heap
+// allocation at all.
+struct PooledMessage : SteamNetworkingMessage_t {
+  PacketBuffer payload;
+  PacketBuffer block; // the storage this object was constructed in
+};
+
+void releaseOwnedMessage(SteamNetworkingMessage_t *message) {
+  delete static_cast<OwnedMessage *>(message);
+}
+
+void releasePooledMessage(SteamNetworkingMessage_t *message) {
+  auto *pooled = static_cast<PooledMessage *>(message);
+  PacketBuffer block = std::move(pooled->block);
+  pooled->~PooledMessage();
+}
+
+void fillMessage(SteamNetworkingMessage_t *message, uint8_t *data,
+                 std::size_t size, CSteamID sender, HSteamNetConnection conn,
+                 int channel, int flags, int64 messageNumber) {
+  message->m_pData = data;
+  message->m_cbSize = static_cast<int>(size);
+  message->m_conn = conn;
+  message->m_identityPeer.SetSteamID(sender);
+  message->m_nConnUserData = 0;
+  message->m_usecTimeReceived =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+  message->m_nMessageNumber = messageNumber;
+  message->m_pfnFreeData = nullptr;
+  message->m_nChannel = channel;
+  message->m_nFlags = flags;
+  message->m_nUserData = 0;
+  message->m_idxLane = 0;
+}
+} // namespace
+
+void Transport::sendMessageToUsers(const SteamNetworkingIdentity *peers,
+                                   int count, const void *data, uint32 size,
+                                   int flags, int channel, EResult *results) {
+  for (int i = 0; i < count; ++i) {
+    results[i] = sendMessageToUser(peers[i], data, size, flags, channel);
+  }
+}
+
+SteamNetworkingMicroseconds Transport::localTimestamp() const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+SteamNetworkingMessage_t *makeTransportMessage(std::vector<uint8_t> payload,
+                                               CSteamID sender,
+                                               HSteamNetConnection conn,
+                                               int channel, int flags,
+                                               int64 messageNumber) {
+  auto *message = new OwnedMessage();
+  message->payload = std::move(payload);
+  fillMessage(message, message->payload.data(), message->payload.size(),
+              sender, conn, channel, flags, messageNumber);
+  message->m_pfnRelease = &releaseOwnedMessage;
+  return message;
+}
+
+SteamNetworkingMessage_t *makeTransportMessage(PacketBuffer payload,
+                                               CSteamID sender,
+                                               HSteamNetConnection conn,
+                                               int channel, int flags,
+                                               int64 messageNumber) {
+  PacketBuffer block(sizeof(PooledMessage));
+  auto *message = new (block.data()) PooledMessage();
+  message->block = std::move(block);
+  message->payload = std::move(payload);
+  fillMessage(message, message->payload.data(), message->payload.size(),
+              sender, conn, channel, flags, messageNumber);
+  message->m_pfnRelease = &releasePooledMessage;
+  return message;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "packet_pool.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <steam_api.h>
+#include <steamnetworkingtypes.h>
+#include <utility>
+#include <vector>
+
+// Carrier underneath the tunnel (TCP mode) and VPN (TUN mode) data paths.
+// The surface mirrors the parts of ISteamNetworkingSockets and
+// ISteamNetworkingMessages we depend on, so send flags, EResult codes
+// (k_EResultLimitExceeded backpressure in particular) and message objects mean
+// the same thing whichever backend is plugged in: Steam, the in-process
+// loopback used for simulations, or raw UDP between LAN peers.
+class Transport {
+public:
+  using SessionRequestCallback =
+      std::function<void(const SteamNetworkingIdentity &peer)>;
+  using SessionFailedCallback =
+      std::function<void(const SteamNetConnectionInfo_t &info)>;
+
+  virtual ~Transport() = default;
+
+  virtual CSteamID localSteamID() const = 0;
+  // Dispatches queued session/connection events on the calling thread.
+  virtual void runCallbacks() = 0;
+
+  // Connection-oriented API (TCP tunnel mode).
+  virtual EResult sendMessageToConnection(HSteamNetConnection conn,
+                                          const void *data, uint32 size,
+                                          int flags,
+                                          int64 *outMessageNumber = nullptr) = 0;
+  virtual int receiveMessagesOnConnection(HSteamNetConnection conn,
+                                          SteamNetworkingMessage_t **messages,
+                                          int maxMessages) = 0;
+  virtual EResult
+  getConnectionRealTimeStatus(HSteamNetConnection conn,
+                              SteamNetConnectionRealTimeStatus_t *status) = 0;
+  virtual bool getConnectionInfo(HSteamNetConnection conn,
+                                 SteamNetConnectionInfo_t *info) = 0;
+
+  // Session-oriented API (TUN mode).
+  virtual EResult sendMessageToUser(const SteamNetworkingIdentity &peer,
+                                    const void *data, uint32 size, int flags,
+                                    int channel) = 0;
+  // The same message to several peers; results[i] is the outcome for
+  // peers[i]. Backends that can submit the batch in one go override this.
+  virtual void sendMessageToUsers(const SteamNetworkingIdentity *peers,
+                                  int count, const void *data, uint32 size,
+                                  int flags, int channel, EResult *results);
+  virtual int receiveMessagesOnChannel(int channel,
+                                       SteamNetworkingMessage_t **messages,
+                                       int maxMessages) = 0;
+  virtual bool acceptSessionWithUser(const SteamNetworkingIdentity &peer) = 0;
+  virtual bool closeSessionWithUser(const SteamNetworkingIdentity &peer) = 0;
+  virtual ESteamNetworkingConnectionState
+  getSessionConnectionInfo(const SteamNetworkingIdentity &peer,
+                           SteamNetConnectionInfo_t *info,
+                           SteamNetConnectionRealTimeStatus_t *status) = 0;
+
+  // Pacing for one connection or session (SendRateMin/Max on Steam), driven by
+  // RateController. Backends without a pacer keep the default and ignore it.
+  virtual bool setConnectionSendRate(HSteamNetConnection conn,
+                                     int bytesPerSec) {
+    (void)conn;
+    (void)bytesPerSec;
+    return false;
+  }
+  virtual bool setSessionSendRate(const SteamNetworkingIdentity &peer,
+                                  int bytesPerSec) {
+    (void)peer;
+    (void)bytesPerSec;
+    return false;
+  }
+
+  // Lets a receiver sleep until traffic arrives instead of polling. Backends
+  // that can wait return true from canWaitForMessages(); waitForMessages()
+  // then blocks for at most timeout and returns whether something may be
+  // ready on the channel (a spurious true only costs an empty receive).
+  virtual bool canWaitForMessages() const { return false; }
+  virtual bool waitForMessages(int channel, std::chrono::microseconds timeout) {
+    (void)channel;
+    (void)timeout;
+    return false;
+  }
+  // Clock behind m_usecTimeReceived on the messages this backend returns.
+  virtual SteamNetworkingMicroseconds localTimestamp() const;
+
+  // Callbacks fire from runCallbacks() (or the backend's own callback pump)
+  // and must be installed before traffic starts flowing.
+  void setSessionCallbacks(SessionRequestCallback onRequest,
+                           SessionFailedCallback onFailed) {
+    sessionRequestCallback_ = std::move(onRequest);
+    sessionFailedCallback_ = std::move(onFailed);
+  }
+
+protected:
+  void notifySessionRequest(const SteamNetworkingIdentity &peer) {
+    if (sessionRequestCallback_) {
+      sessionRequestCallback_(peer);
+    }
+  }
+  void notifySessionFailed(const SteamNetConnectionInfo_t &info) {
+    if (sessionFailedCallback_) {
+      sessionFailedCallback_(info);
+    }
+  }
+
+private:
+  SessionRequestCallback sessionRequestCallback_;
+  SessionFailedCallback sessionFailedCallback_;
+};
+
+// Builds a heap-backed SteamNetworkingMessage_t for the non-Steam backends.
+// Release() frees it, so consumers treat it exactly like a Steam message.
+SteamNetworkingMessage_t *makeTransportMessage(std::vector<uint8_t> payload,
+                                               CSteamID sender,
+                                               HSteamNetConnection conn,
+                                               int channel, int flags,
+                                               int64 messageNumber);
+// Same, with the payload (and the message itself) taken from PacketPool.
+SteamNetworkingMessage_t *makeTransportMessage(PacketBuffer payload,
+                                               CSteamID sender,
+                                               HSteamNetConnection conn,
+                                               int channel, int flags,
+                                               int64 messageNumber);
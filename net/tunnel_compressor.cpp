@@ -0,0 +1,87 @@
+#include "tunnel_compressor.h"
+#include "lz4.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+constexpr std::size_t kHeaderBytes = sizeof(uint32_t);
+// Larger than any block MultiplexManager hands us; guards decode allocations.
+constexpr std::size_t kMaxBlockBytes = 64 * 1024;
+constexpr uint64_t kWindowBytes = 256 * 1024;
+constexpr uint64_t kBackoffBytes = 16 * 1024 * 1024;
+// Keep compressing while a window saves at least 1/8 of its bytes.
+constexpr uint64_t kMinSavingsDivisor = 8;
+
+uint64_t nanosSince(std::chrono::steady_clock::time_point start) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+}
+} // namespace
+
+bool TunnelCompressor::encode(const char *data, std::size_t len,
+                              bool linkBottleneck, std::vector<char> &out,
+                              metrics::StreamMetrics *stats) {
+  if (skipBytes_ > 0) {
+    skipBytes_ -= std::min<uint64_t>(skipBytes_, len);
+    return false;
+  }
+  if (!linkBottleneck || len == 0 || len > kMaxBlockBytes) {
+    return false;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const int bound = lz4::compressBound(static_cast<int>(len));
+  out.resize(kHeaderBytes + static_cast<std::size_t>(bound));
+  const auto rawLength = static_cast<uint32_t>(len);
+  std::memcpy(out.data(), &rawLength, kHeaderBytes);
+  const int compressed = lz4::compress(data, static_cast<int>(len),
+                                       out.data() + kHeaderBytes, bound);
+  out.resize(kHeaderBytes + static_cast<std::size_t>(compressed));
+  if (stats) {
+    stats->compressionNanos.add(nanosSince(start));
+  }
+
+  windowIn_ += len;
+  windowOut_ += std::min(out.size(), len);
+  if (windowIn_ >= kWindowBytes) {
+    if (windowIn_ - windowOut_ < windowIn_ / kMinSavingsDivisor) {
+      skipBytes_ = kBackoffBytes;
+    }
+    windowIn_ = 0;
+    windowOut_ = 0;
+  }
+
+  if (compressed <= 0 || out.size() >= len) {
+    return false;
+  }
+  if (stats) {
+    stats->compressedBytes.add(len);
+    stats->compressionSavedBytes.add(len - out.size());
+  }
+  return true;
+}
+
+bool TunnelCompressor::decode(const char *data, std::size_t len,
+                              std::vector<char> &out,
+                              metrics::StreamMetrics *stats) {
+  if (len <= kHeaderBytes) {
+    return false;
+  }
+  uint32_t rawLength = 0;
+  std::memcpy(&rawLength, data, kHeaderBytes);
+  if (rawLength == 0 || rawLength > kMaxBlockBytes) {
+    return false;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  out.resize(rawLength);
+  const int decoded =
+      lz4::decompress(data + kHeaderBytes, static_cast<int>(len - kHeaderBytes),
+                      out.data(), static_cast<int>(rawLength));
+  if (stats) {
+    stats->compressionNanos.add(nanosSince(start));
+  }
+  return decoded == static_cast<int>(rawLength);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "metrics.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// LZ4 stage for one multiplexed TCP stream. Blocks are only compressed while
+// the link is the bottleneck (data is queueing behind the pacer); when it is
+// not, compression would only add CPU time and latency. Each window of
+// compressed traffic is checked against a minimum saving, and a stream that
+// does not reach it (media, archives, TLS) skips compression for a while
+// before probing again.
+//
+// Encoded payload (tunnel packet type 2): uint32 raw length, then the block.
+class TunnelCompressor {
+public:
+  // MultiplexManager compresses reads in blocks of this size: a few tunnel
+  // chunks, so LZ4 has history to match and a 4:1 block fits in one chunk.
+  static constexpr std::size_t kBlockBytes = 4 * 1100;
+
+  // Encodes data into out when that saves enough. Returns false when the
+  // caller should send data as a plain type 0 packet instead.
+  bool encode(const char *data, std::size_t len, bool linkBottleneck,
+              std::vector<char> &out, metrics::StreamMetrics *stats);
+  static bool decode(const char *data, std::size_t len, std::vector<char> &out,
+                     metrics::StreamMetrics *stats);
+
+  // False while a poor ratio has compression switched off.
+  bool active() const { return skipBytes_ == 0; }
+
+private:
+  uint64_t windowIn_ = 0;
+  uint64_t windowOut_ = 0;
+  uint64_t skipBytes_ = 0;
+};
@@ -0,0 +1,689 @@
+#include "udp_transport.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <poll.h>
+#endif
+
+namespace {
+// magic, kind, flags, reserved, channel, sender, session, seq, aux
+constexpr std::size_t kHeaderBytes = 28;
+constexpr std::size_t kMaxDatagramBytes = 65507;
+constexpr std::size_t kSendBufferBytes = 2 * 1024 * 1024;
+constexpr std::chrono::milliseconds kMinRetransmit{30};
+// Every retransmission of a frame doubles its timeout, up to this.
+constexpr std::chrono::milliseconds kMaxRetransmit{2000};
+constexpr int kMaxBackoff = 6;
+// Frames past the first gap an ack can report as received.
+constexpr std::size_t kMaxSackBytes = 256;
+// Reliable frames accepted ahead of the next expected one; keeps the reorder
+// buffer well inside the half of the sequence space SeqLess can order.
+constexpr uint32_t kReceiveWindow = 1u << 24;
+constexpr int kSocketBufferBytes = 4 * 1024 * 1024;
+constexpr std::chrono::seconds kPeerTimeout{10};
+constexpr std::chrono::milliseconds kMeterWindow{250};
+
+constexpr uint8_t kFrameMagic = 0xC7;
+constexpr uint8_t kFrameUnreliable = 1;
+constexpr uint8_t kFrameReliable = 2;
+constexpr uint8_t kFrameAck = 3;
+constexpr uint8_t kFlagConnection = 0x01;
+
+void put32(uint8_t *out, uint32_t value) {
+  out[0] = static_cast<uint8_t>(value >> 24);
+  out[1] = static_cast<uint8_t>(value >> 16);
+  out[2] = static_cast<uint8_t>(value >> 8);
+  out[3] = static_cast<uint8_t>(value);
+}
+
+uint32_t get32(const uint8_t *in) {
+  return (static_cast<uint32_t>(in[0]) << 24) |
+         (static_cast<uint32_t>(in[1]) << 16) |
+         (static_cast<uint32_t>(in[2]) << 8) | static_cast<uint32_t>(in[3]);
+}
+
+void put64(uint8_t *out, uint64_t value) {
+  put32(out, static_cast<uint32_t>(value >> 32));
+  put32(out + 4, static_cast<uint32_t>(value));
+}
+
+uint64_t get64(const uint8_t *in) {
+  return (static_cast<uint64_t>(get32(in)) << 32) | get32(in + 4);
+}
+
+// Sequence comparison that survives wrap-around.
+bool seqBefore(uint32_t a, uint32_t b) {
+  return static_cast<int32_t>(a - b) < 0;
+}
+
+std::vector<uint8_t> buildFrame(uint8_t kind, uint8_t flags, int channel,
+                                uint64_t sender, uint32_t session,
+                                uint32_t seq, uint32_t aux, const void *data,
+                                std::size_t size) {
+  std::vector<uint8_t> frame(kHeaderBytes + size);
+  frame[0] = kFrameMagic;
+  frame[1] = kind;
+  frame[2] = flags;
+  frame[3] = 0;
+  put32(frame.data() + 4, static_cast<uint32_t>(channel));
+  put64(frame.data() + 8, sender);
+  put32(frame.data() + 16, session);
+  put32(frame.data() + 20, seq);
+  put32(frame.data() + 24, aux);
+  if (size > 0) {
+    std::memcpy(frame.data() + kHeaderBytes, data, size);
+  }
+  return frame;
+}
+} // namespace
+
+UdpTransport::UdpTransport(CSteamID localSteamID)
+    : steamID_(localSteamID), session_(std::random_device{}()),
+      socket_(ioContext_), receiveBuffer_(kMaxDatagramBytes) {}
+
+UdpTransport::~UdpTransport() { close(); }
+
+bool UdpTransport::open(uint16_t port, const std::string &bindAddress) {
+  using boost::asio::ip::udp;
+  std::lock_guard<std::mutex> lock(mutex_);
+  boost::system::error_code ec;
+  const auto address = boost::asio::ip::make_address(bindAddress, ec);
+  if (ec) {
+    std::cerr << "[UdpTransport] Invalid bind address " << bindAddress << ": "
+              << ec.message() << std::endl;
+    return false;
+  }
+  const udp::endpoint endpoint(address, port);
+  socket_.open(endpoint.protocol(), ec);
+  if (!ec) {
+    socket_.bind(endpoint, ec);
+  }
+  if (!ec) {
+    socket_.non_blocking(true, ec);
+  }
+  if (!ec) {
+    // Best effort: the OS may cap these, and a window of reliable frames
+    // sent back to back should not overflow the defaults.
+    boost::system::error_code ignored;
+    socket_.set_option(udp::socket::receive_buffer_size(kSocketBufferBytes),
+                       ignored);
+    socket_.set_option(udp::socket::send_buffer_size(kSocketBufferBytes),
+                       ignored);
+  }
+  if (ec) {
+    std::cerr << "[UdpTransport] Failed to open UDP port " << port << ": "
+              << ec.message() << std::endl;
+    socket_.close(ec);
+    return false;
+  }
+  return true;
+}
+
+void UdpTransport::close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  boost::system::error_code ec;
+  socket_.close(ec);
+}
+
+uint64_t UdpTransport::retransmits() const { return retransmits_.load(); }
+
+uint16_t UdpTransport::localPort() const {
+  boost::system::error_code ec;
+  const auto endpoint = socket_.local_endpoint(ec);
+  return ec ? 0 : endpoint.port();
+}
+
+HSteamNetConnection UdpTransport::addPeer(CSteamID steamID,
+                                          const std::string &address,
+                                          uint16_t port) {
+  boost::system::error_code ec;
+  const auto peerAddress = boost::asio::ip::make_address(address, ec);
+  if (ec) {
+    std::cerr << "[UdpTransport] Invalid peer address " << address << ": "
+              << ec.message() << std::endl;
+    return k_HSteamNetConnection_Invalid;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  Peer &peer = peers_[steamID.ConvertToUint64()];
+  peer.steamID = steamID;
+  peer.endpoint = boost::asio::ip::udp::endpoint(peerAddress, port);
+  if (peer.conn == k_HSteamNetConnection_Invalid) {
+    peer.conn = nextConnection_++;
+  }
+  return peer.conn;
+}
+
+void UdpTransport::removePeer(CSteamID steamID) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const uint64_t id = steamID.ConvertToUint64();
+  peers_.erase(id);
+  for (auto &entry : channelInbox_) {
+    auto &queue = entry.second;
+    queue.erase(std::remove_if(queue.begin(), queue.end(),
+                               [id](const auto &item) {
+                                 return item.first == id;
+                               }),
+                queue.end());
+  }
+}
+
+void UdpTransport::runCallbacks() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pump();
+  }
+  dispatchEvents();
+}
+
+void UdpTransport::dispatchEvents() {
+  std::vector<SteamNetworkingIdentity> requests;
+  std::vector<SteamNetConnectionInfo_t> failures;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    requests.swap(pendingRequests_);
+    failures.swap(pendingFailures_);
+  }
+  for (const auto &peer : requests) {
+    notifySessionRequest(peer);
+  }
+  for (const auto &info : failures) {
+    notifySessionFailed(info);
+  }
+}
+
+void UdpTransport::pump() {
+  if (!socket_.is_open()) {
+    return;
+  }
+  boost::asio::ip::udp::endpoint from;
+  for (;;) {
+    boost::system::error_code ec;
+    const std::size_t received = socket_.receive_from(
+        boost::asio::buffer(receiveBuffer_), from, 0, ec);
+    if (ec == boost::asio::error::connection_refused ||
+        ec == boost::asio::error::connection_reset) {
+      continue; // ICMP unreachable from an earlier send (Windows reports it)
+    }
+    if (ec) {
+      if (ec != boost::asio::error::would_block &&
+          ec != boost::asio::error::try_again) {
+        std::cerr << "[UdpTransport] receive failed: " << ec.message()
+                  << std::endl;
+      }
+      break;
+    }
+    handleDatagram(receiveBuffer_.data(), received, from);
+  }
+  const auto now = Clock::now();
+  for (auto &entry : peers_) {
+    retransmit(entry.second, now);
+  }
+}
+
+void UdpTransport::handleDatagram(const uint8_t *data, std::size_t size,
+                                  const boost::asio::ip::udp::endpoint &from) {
+  if (size < kHeaderBytes || data[0] != kFrameMagic) {
+    return;
+  }
+  const uint8_t kind = data[1];
+  const uint8_t flags = data[2];
+  const int channel = static_cast<int>(get32(data + 4));
+  const uint64_t sender = get64(data + 8);
+  const uint32_t session = get32(data + 16);
+  const uint32_t seq = get32(data + 20);
+  const uint32_t aux = get32(data + 24);
+  // The sender ID is only a claim; frames must come from where the peer was
+  // registered.
+  Peer *peer = findPeer(sender);
+  if (!peer || from != peer->endpoint) {
+    return;
+  }
+
+  if (kind == kFrameAck) {
+    // seq carries the session being acknowledged, aux the next expected seq;
+    // bit i of the payload is set when frame aux + 1 + i has arrived too.
+    if (seq != session_) {
+      return;
+    }
+    const auto now = Clock::now();
+    while (!peer->unacked.empty() &&
+           seqBefore(peer->unacked.begin()->first, aux)) {
+      acknowledge(*peer, peer->unacked.begin(), now);
+    }
+    const uint8_t *sack = data + kHeaderBytes;
+    const std::size_t sackBits = (size - kHeaderBytes) * 8;
+    for (std::size_t i = 0; i < sackBits; ++i) {
+      if (sack[i / 8] & (1u << (i % 8))) {
+        auto it = peer->unacked.find(aux + 1 + static_cast<uint32_t>(i));
+        if (it != peer->unacked.end()) {
+          acknowledge(*peer, it, now);
+        }
+      }
+    }
+    return;
+  }
+
+  Delivery delivery;
+  delivery.onConnection = (flags & kFlagConnection) != 0;
+  delivery.channel = channel;
+  delivery.data = PacketBuffer(data + kHeaderBytes, size - kHeaderBytes);
+
+  if (kind == kFrameUnreliable) {
+    delivery.flags = 0;
+    delivery.messageNumber = seq;
+    deliver(*peer, std::move(delivery));
+    return;
+  }
+  if (kind != kFrameReliable) {
+    return;
+  }
+
+  // A new remote session (peer restarted) resets the receive window; aux is
+  // the sender's oldest unacknowledged sequence, so anything older is gone.
+  if (!peer->remoteSessionKnown || peer->remoteSession != session) {
+    peer->remoteSessionKnown = true;
+    peer->remoteSession = session;
+    peer->nextRecvSeq = aux;
+    peer->reorder.clear();
+  } else if (seqBefore(peer->nextRecvSeq, aux)) {
+    peer->nextRecvSeq = aux;
+    peer->reorder.erase(peer->reorder.begin(),
+                        peer->reorder.lower_bound(aux));
+  }
+  if (!seqBefore(seq, peer->nextRecvSeq) &&
+      seq - peer->nextRecvSeq < kReceiveWindow) {
+    delivery.flags = k_nSteamNetworkingSend_Reliable;
+    delivery.messageNumber = seq;
+    peer->reorder.emplace(seq, std::move(delivery));
+    for (auto it = peer->reorder.find(peer->nextRecvSeq);
+         it != peer->reorder.end();
+         it = peer->reorder.find(peer->nextRecvSeq)) {
+      Delivery ready = std::move(it->second);
+      peer->reorder.erase(it);
+      ++peer->nextRecvSeq;
+      deliver(*peer, std::move(ready));
+    }
+  }
+  std::vector<uint8_t> sack;
+  for (const auto &held : peer->reorder) {
+    const uint32_t bit = held.first - peer->nextRecvSeq - 1;
+    if (bit >= kMaxSackBytes * 8) {
+      continue;
+    }
+    if (sack.size() <= bit / 8) {
+      sack.resize(bit / 8 + 1);
+    }
+    sack[bit / 8] |= static_cast<uint8_t>(1u << (bit % 8));
+  }
+  const auto ack = buildFrame(kFrameAck, 0, 0, steamID_.ConvertToUint64(),
+                              session_, session, peer->nextRecvSeq,
+                              sack.data(), sack.size());
+  sendDatagram(*peer, ack);
+}
+
+UdpTransport::SeqMap<UdpTransport::Outstanding>::iterator
+UdpTransport::acknowledge(Peer &peer, SeqMap<Outstanding>::iterator it,
+                          Clock::time_point now) {
+  if (it->second.retries == 0) {
+    const double sample =
+        std::chrono::duration<double, std::milli>(now - it->second.lastSent)
+            .count();
+    peer.srttMs =
+        peer.srttMs <= 0.0 ? sample : peer.srttMs * 0.875 + sample * 0.125;
+    peer.lossEstimate *= 0.99;
+  }
+  peer.unackedBytes -= it->second.payloadSize;
+  return peer.unacked.erase(it);
+}
+
+void UdpTransport::deliver(Peer &peer, Delivery delivery) {
+  if (delivery.onConnection) {
+    peer.connectionInbox.push_back(std::move(delivery));
+    return;
+  }
+  if (peer.sessionAccepted) {
+    channelInbox_[delivery.channel].emplace_back(
+        peer.steamID.ConvertToUint64(), std::move(delivery));
+    return;
+  }
+  peer.held.push_back(std::move(delivery));
+  if (!peer.requestPending) {
+    peer.requestPending = true;
+    SteamNetworkingIdentity identity;
+    identity.Clear();
+    identity.SetSteamID(peer.steamID);
+    pendingRequests_.push_back(identity);
+  }
+}
+
+void UdpTransport::retransmit(Peer &peer, Clock::time_point now) {
+  if (peer.unacked.empty()) {
+    return;
+  }
+  const auto rto = std::max<Clock::duration>(
+      kMinRetransmit,
+      std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<double, std::milli>(peer.srttMs * 2.0)));
+  for (auto &entry : peer.unacked) {
+    Outstanding &outstanding = entry.second;
+    if (now - outstanding.firstSent > kPeerTimeout) {
+      failPeer(peer, "UDP peer timed out");
+      return;
+    }
+    const Clock::duration timeout = std::min<Clock::duration>(
+        rto * (1 << std::min(outstanding.retries, kMaxBackoff)),
+        kMaxRetransmit);
+    if (now - outstanding.lastSent >= timeout) {
+      outstanding.lastSent = now;
+      outstanding.retries++;
+      peer.lossEstimate = peer.lossEstimate * 0.99 + 0.01;
+      retransmits_++;
+      sendDatagram(peer, outstanding.frame);
+    }
+  }
+}
+
+bool UdpTransport::sendDatagram(Peer &peer, const std::vector<uint8_t> &frame) {
+  if (!socket_.is_open()) {
+    return false;
+  }
+  boost::system::error_code ec;
+  socket_.send_to(boost::asio::buffer(frame), peer.endpoint, 0, ec);
+  if (ec) {
+    return false;
+  }
+  peer.meterBytes += frame.size();
+  peer.meterPackets++;
+  return true;
+}
+
+EResult UdpTransport::send(Peer &peer, bool onConnection, int channel,
+                           const void *data, uint32 size, int flags,
+                           int64 *outMessageNumber) {
+  if (!socket_.is_open()) {
+    return k_EResultNoConnection;
+  }
+  if ((size > 0 && !data) || size > kMaxDatagramBytes - kHeaderBytes) {
+    return k_EResultInvalidParam;
+  }
+  pump();
+  const uint8_t frameFlags = onConnection ? kFlagConnection : 0;
+  const uint64_t self = steamID_.ConvertToUint64();
+  const int64 messageNumber = peer.nextMessageNumber++;
+  if (outMessageNumber) {
+    *outMessageNumber = messageNumber;
+  }
+
+  if ((flags & k_nSteamNetworkingSend_Reliable) == 0) {
+    const auto frame =
+        buildFrame(kFrameUnreliable, frameFlags, channel, self, session_,
+                   static_cast<uint32_t>(messageNumber), 0, data, size);
+    return sendDatagram(peer, frame) ? k_EResultOK : k_EResultLimitExceeded;
+  }
+
+  if (peer.unackedBytes + size > kSendBufferBytes) {
+    return k_EResultLimitExceeded;
+  }
+  const uint32_t seq = peer.nextSendSeq++;
+  const uint32_t base = peer.unacked.empty() ? seq : peer.unacked.begin()->first;
+  Outstanding outstanding;
+  outstanding.frame = buildFrame(kFrameReliable, frameFlags, channel, self,
+                                 session_, seq, base, data, size);
+  outstanding.firstSent = Clock::now();
+  outstanding.lastSent = outstanding.firstSent;
+  outstanding.payloadSize = size;
+  sendDatagram(peer, outstanding.frame);
+  peer.unackedBytes += size;
+  peer.unacked.emplace(seq, std::move(outstanding));
+  return k_EResultOK;
+}
+
+void UdpTransport::failPeer(Peer &peer, const char *reason) {
+  peer.unacked.clear();
+  peer.unackedBytes = 0;
+  peer.held.clear();
+  peer.sessionAccepted = false;
+  peer.requestPending = false;
+  SteamNetConnectionInfo_t info{};
+  fillInfo(peer, &info);
+  info.m_eState = k_ESteamNetworkingConnectionState_ProblemDetectedLocally;
+  std::strncpy(info.m_szEndDebug, reason, sizeof(info.m_szEndDebug) - 1);
+  pendingFailures_.push_back(info);
+}
+
+void UdpTransport::fillStatus(Peer &peer,
+                              SteamNetConnectionRealTimeStatus_t *status) {
+  const auto now = Clock::now();
+  const auto elapsed = now - peer.meterStart;
+  if (elapsed >= kMeterWindow) {
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+    peer.outBytesPerSec = static_cast<float>(peer.meterBytes / seconds);
+    peer.outPacketsPerSec = static_cast<float>(peer.meterPackets / seconds);
+    peer.meterBytes = 0;
+    peer.meterPackets = 0;
+    peer.meterStart = now;
+  }
+  const float quality = static_cast<float>(1.0 - peer.lossEstimate);
+  std::memset(status, 0, sizeof(*status));
+  status->m_eState = k_ESteamNetworkingConnectionState_Connected;
+  status->m_nPing = static_cast<int>(peer.srttMs + 0.5);
+  status->m_flConnectionQualityLocal = quality;
+  status->m_flConnectionQualityRemote = quality;
+  status->m_flOutPacketsPerSec = peer.outPacketsPerSec;
+  status->m_flOutBytesPerSec = peer.outBytesPerSec;
+  // No pacing: everything unacknowledged counts as pending so reliable
+  // backpressure (high/low water marks) behaves as it does on Steam.
+  status->m_cbPendingReliable = static_cast<int>(peer.unackedBytes);
+  status->m_cbSentUnackedReliable = static_cast<int>(peer.unackedBytes);
+}
+
+void UdpTransport::fillInfo(const Peer &peer,
+                            SteamNetConnectionInfo_t *info) const {
+  std::memset(info, 0, sizeof(*info));
+  info->m_identityRemote.Clear();
+  info->m_identityRemote.SetSteamID(peer.steamID);
+  info->m_eState = k_ESteamNetworkingConnectionState_Connected;
+}
+
+UdpTransport::Peer *UdpTransport::findPeer(uint64_t steamID) {
+  auto it = peers_.find(steamID);
+  return it == peers_.end() ? nullptr : &it->second;
+}
+
+UdpTransport::Peer *
+UdpTransport::findPeerByConnection(HSteamNetConnection conn) {
+  for (auto &entry : peers_) {
+    if (entry.second.conn == conn) {
+      return &entry.second;
+    }
+  }
+  return nullptr;
+}
+
+EResult UdpTransport::sendMessageToConnection(HSteamNetConnection conn,
+                                              const void *data, uint32 size,
+                                              int flags,
+                                              int64 *outMessageNumber) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Peer *peer = findPeerByConnection(conn);
+  if (!peer) {
+    return k_EResultNoConnection;
+  }
+  return send(*peer, true, 0, data, size, flags, outMessageNumber);
+}
+
+int UdpTransport::receiveMessagesOnConnection(
+    HSteamNetConnection conn, SteamNetworkingMessage_t **messages,
+    int maxMessages) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  pump();
+  Peer *peer = findPeerByConnection(conn);
+  if (!peer) {
+    return 0;
+  }
+  int count = 0;
+  while (count < maxMessages && !peer->connectionInbox.empty()) {
+    Delivery &delivery = peer->connectionInbox.front();
+    messages[count++] = makeTransportMessage(
+        std::move(delivery.data), peer->steamID, conn, 0, delivery.flags,
+        delivery.messageNumber);
+    peer->connectionInbox.pop_front();
+  }
+  return count;
+}
+
+EResult UdpTransport::getConnectionRealTimeStatus(
+    HSteamNetConnection conn, SteamNetConnectionRealTimeStatus_t *status) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  pump();
+  Peer *peer = findPeerByConnection(conn);
+  if (!peer) {
+    return k_EResultNoConnection;
+  }
+  if (status) {
+    fillStatus(*peer, status);
+  }
+  return k_EResultOK;
+}
+
+bool UdpTransport::getConnectionInfo(HSteamNetConnection conn,
+                                     SteamNetConnectionInfo_t *info) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Peer *peer = findPeerByConnection(conn);
+  if (!peer) {
+    return false;
+  }
+  if (info) {
+    fillInfo(*peer, info);
+  }
+  return true;
+}
+
+EResult UdpTransport::sendMessageToUser(const SteamNetworkingIdentity &peer,
+                                        const void *data, uint32 size,
+                                        int flags, int channel) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Peer *target = findPeer(peer.GetSteamID64());
+  if (!target) {
+    return k_EResultNoConnection;
+  }
+  target->sessionAccepted = true;
+  return send(*target, false, channel, data, size, flags, nullptr);
+}
+
+bool UdpTransport::waitForMessages(int channel,
+                                   std::chrono::microseconds timeout) {
+  boost::asio::ip::udp::socket::native_handle_type handle;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!socket_.is_open()) {
+      return false;
+    }
+    auto it = channelInbox_.find(channel);
+    if ((it != channelInbox_.end() && !it->second.empty()) ||
+        !pendingRequests_.empty() || !pendingFailures_.empty()) {
+      return true;
+    }
+    handle = socket_.native_handle();
+  }
+  // poll() counts in milliseconds; round up so a short wait still sleeps.
+  const int timeoutMs = static_cast<int>((timeout.count() + 999) / 1000);
+#ifdef _WIN32
+  WSAPOLLFD fd{};
+  fd.fd = handle;
+  fd.events = POLLRDNORM;
+  return WSAPoll(&fd, 1, timeoutMs) > 0;
+#else
+  pollfd fd{};
+  fd.fd = handle;
+  fd.events = POLLIN;
+  return ::poll(&fd, 1, timeoutMs) > 0;
+#endif
+}
+
+int UdpTransport::receiveMessagesOnChannel(int channel,
+                                           SteamNetworkingMessage_t **messages,
+                                           int maxMessages) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pump();
+  }
+  dispatchEvents();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = channelInbox_.find(channel);
+  if (it == channelInbox_.end()) {
+    return 0;
+  }
+  auto &queue = it->second;
+  int count = 0;
+  while (count < maxMessages && !queue.empty()) {
+    auto &item = queue.front();
+    messages[count++] = makeTransportMessage(
+        std::move(item.second.data), CSteamID(static_cast<uint64>(item.first)),
+        k_HSteamNetConnection_Invalid, channel, item.second.flags,
+        item.second.messageNumber);
+    queue.pop_front();
+  }
+  return count;
+}
+
+bool UdpTransport::acceptSessionWithUser(const SteamNetworkingIdentity &peer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Peer *target = findPeer(peer.GetSteamID64());
+  if (!target) {
+    return false;
+  }
+  target->sessionAccepted = true;
+  target->requestPending = false;
+  const uint64_t id = target->steamID.ConvertToUint64();
+  for (auto &delivery : target->held) {
+    channelInbox_[delivery.channel].emplace_back(id, std::move(delivery));
+  }
+  target->held.clear();
+  return true;
+}
+
+bool UdpTransport::closeSessionWithUser(const SteamNetworkingIdentity &peer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Peer *target = findPeer(peer.GetSteamID64());
+  if (!target) {
+    return false;
+  }
+  target->sessionAccepted = false;
+  target->requestPending = false;
+  target->held.clear();
+  const uint64_t id = target->steamID.ConvertToUint64();
+  for (auto &entry : channelInbox_) {
+    auto &queue = entry.second;
+    queue.erase(std::remove_if(queue.begin(), queue.end(),
+                               [id](const auto &item) {
+                                 return item.first == id;
+                               }),
+                queue.end());
+  }
+  return true;
+}
+
+ESteamNetworkingConnectionState UdpTransport::getSessionConnectionInfo(
+    const SteamNetworkingIdentity &peer, SteamNetConnectionInfo_t *info,
+    SteamNetConnectionRealTimeStatus_t *status) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Peer *target = findPeer(peer.GetSteamID64());
+  if (!target || !target->sessionAccepted) {
+    return k_ESteamNetworkingConnectionState_None;
+  }
+  if (info) {
+    fillInfo(*target, info);
+  }
+  if (status) {
+    fillStatus(*target, status);
+  }
+  return k_ESteamNetworkingConnectionState_Connected;
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "transport.h"
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Raw UDP carrier for peers on the same LAN, or for driving the data path
+// without a Steam client. Peers are registered explicitly. Unreliable sends
+// map to one datagram each; reliable sends are sequenced, acknowledged
+// cumulatively, with a bitmap of the frames that arrived past the first gap,
+// and delivered in order. Only frames neither acked nor reported are resent,
+// and each resend of a frame doubles its timeout, so a lossy link is not
+// flooded with retransmissions.
+// The socket is serviced whenever the transport is called, so the data path's
+// own polling (or waiting, which is bounded) keeps retransmissions going.
+class UdpTransport : public Transport {
+public:
+  explicit UdpTransport(CSteamID localSteamID);
+  ~UdpTransport() override;
+
+  bool open(uint16_t port, const std::string &bindAddress = "0.0.0.0");
+  void close();
+  uint16_t localPort() const;
+  // Reliable frames sent again since the transport was created.
+  uint64_t retransmits() const;
+
+  // Returns the handle used with the connection-oriented API for this peer.
+  HSteamNetConnection addPeer(CSteamID steamID, const std::string &address,
+                              uint16_t port);
+  void removePeer(CSteamID steamID);
+
+  CSteamID localSteamID() const override { return steamID_; }
+  void runCallbacks() override;
+
+  EResult sendMessageToConnection(HSteamNetConnection conn, const void *data,
+                                  uint32 size, int flags,
+                                  int64 *outMessageNumber) override;
+  int receiveMessagesOnConnection(HSteamNetConnection conn,
+                                  SteamNetworkingMessage_t **messages,
+                                  int maxMessages) override;
+  EResult
+  getConnectionRealTimeStatus(HSteamNetConnection conn,
+                              SteamNetConnectionRealTimeStatus_t *status) override;
+  bool getConnectionInfo(HSteamNetConnection conn,
+                         SteamNetConnectionInfo_t *info) override;
+
+  EResult sendMessageToUser(const SteamNetworkingIdentity &peer,
+                            const void *data, uint32 size, int flags,
+                            int channel) override;
+  int receiveMessagesOnChannel(int channel, SteamNetworkingMessage_t **messages,
+                               int maxMessages) override;
+  bool acceptSessionWithUser(const SteamNetworkingIdentity &peer) override;
+  bool closeSessionWithUser(const SteamNetworkingIdentity &peer) override;
+  ESteamNetworkingConnectionState
+  getSessionConnectionInfo(const SteamNetworkingIdentity &peer,
+                           SteamNetConnectionInfo_t *info,
+                           SteamNetConnectionRealTimeStatus_t *status) override;
+
+  // Sleeps in poll() on the socket. A datagram of any kind (an ack, another
+  // channel) wakes it, which only costs the caller one empty receive.
+  bool canWaitForMessages() const override { return true; }
+  bool waitForMessages(int channel,
+                       std::chrono::microseconds timeout) override;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  // Orders sequence numbers across wrap-around; the frames a peer holds at
+  // once always span far less than half the sequence space.
+  struct SeqLess {
+    bool operator()(uint32_t a, uint32_t b) const {
+      return static_cast<int32_t>(a - b) < 0;
+    }
+  };
+  template <class T> using SeqMap = std::map<uint32_t, T, SeqLess>;
+
+  struct Outstanding {
+    std::vector<uint8_t> frame;
+    Clock::time_point firstSent;
+    Clock::time_point lastSent;
+    int retries = 0;
+    std::size_t payloadSize = 0;
+  };
+
+  struct Delivery {
+    bool onConnection = false;
+    int channel = 0;
+    int flags = 0;
+    int64 messageNumber = 0;
+    PacketBuffer data;
+  };
+
+  struct Peer {
+    CSteamID steamID;
+    boost::asio::ip::udp::endpoint endpoint;
+    HSteamNetConnection conn = k_HSteamNetConnection_Invalid;
+    bool sessionAccepted = false;
+    bool requestPending = false;
+
+    uint32_t nextSendSeq = 0;
+    SeqMap<Outstanding> unacked;
+    std::size_t unackedBytes = 0;
+    int64 nextMessageNumber = 1;
+
+    uint32_t remoteSession = 0;
+    bool remoteSessionKnown = false;
+    uint32_t nextRecvSeq = 0;
+    SeqMap<Delivery> reorder;
+    std::deque<Delivery> connectionInbox;
+    std::deque<Delivery> held; // session traffic waiting for accept
+
+    double srttMs = 0.0;
+    double lossEstimate = 0.0;
+    Clock::time_point meterStart;
+    uint64_t meterBytes = 0;
+    uint64_t meterPackets = 0;
+    float outBytesPerSec = 0.0f;
+    float outPacketsPerSec = 0.0f;
+  };
+
+  void pump();
+  void handleDatagram(const uint8_t *data, std::size_t size,
+                      const boost::asio::ip::udp::endpoint &from);
+  void deliver(Peer &peer, Delivery delivery);
+  SeqMap<Outstanding>::iterator acknowledge(Peer &peer,
+                                            SeqMap<Outstanding>::iterator it,
+                                            Clock::time_point now);
+  void retransmit(Peer &peer, Clock::time_point now);
+  bool sendDatagram(Peer &peer, const std::vector<uint8_t> &frame);
+  EResult send(Peer &peer, bool onConnection, int channel, const void *data,
+               uint32 size, int flags, int64 *outMessageNumber);
+  void failPeer(Peer &peer, const char *reason);
+  void fillStatus(Peer &peer, SteamNetConnectionRealTimeStatus_t *status);
+  void fillInfo(const Peer &peer, SteamNetConnectionInfo_t *info) const;
+  Peer *findPeer(uint64_t steamID);
+  Peer *findPeerByConnection(HSteamNetConnection conn);
+  void dispatchEvents();
+
+  CSteamID steamID_;
+  uint32_t session_;
+  boost::asio::io_context ioContext_;
+  boost::asio::ip::udp::socket socket_;
+  std::mutex mutex_;
+  std::map<uint64_t, Peer> peers_;
+  std::map<int, std::deque<std::pair<uint64_t, Delivery>>> channelInbox_;
+  HSteamNetConnection nextConnection_ = 1;
+  std::vector<SteamNetworkingIdentity> pendingRequests_;
+  std::vector<SteamNetConnectionInfo_t> pendingFailures_;
+  std::vector<uint8_t> receiveBuffer_;
+  std::atomic<uint64_t> retransmits_{0};
+};
@@ -11,14 +11,17 @@ constexpr const char *APP_SECRET_SALT = "ConnectTool_VPN_Salt_v1";
 
 // Protocol timing (milliseconds)
 constexpr int64_t PROBE_TIMEOUT_MS = 500;
+constexpr int64_t LEASE_OFFER_HOLD_MS = 5000;
 constexpr int64_t HEARTBEAT_INTERVAL_MS = 60000;
 constexpr int64_t LEASE_TIME_MS = 120000;
 constexpr int64_t LEASE_EXPIRY_MS = 360000;
 constexpr int64_t HEARTBEAT_EXPIRY_MS = 180000;
+constexpr int64_t PATH_REPORT_INTERVAL_MS = 2000;
 
 // Node ID
 constexpr size_t NODE_ID_SIZE = 32;
 using NodeID = std::array<uint8_t, NODE_ID_SIZE>;
+using Ipv6Address = std::array<uint8_t, 16>; // network byte order
 
 enum class VpnMessageType : uint8_t {
   IP_PACKET = 1,
@@ -29,7 +32,14 @@ enum class VpnMessageType : uint8_t {
   FORCED_RELEASE = 13,
   HEARTBEAT = 14,
   HEARTBEAT_ACK = 15,
-  SESSION_HELLO = 20
+  PATH_REPORT = 16,
+  FEC_DATA = 17,
+  FEC_PARITY = 18,
+  SESSION_HELLO = 20,
+  LEASE_OFFER = 21,
+  ROUTE_DELTA = 22,
+  ROUTE_SYNC_REQUEST = 23,
+  ROUTE_SYNC = 24
 };
 
 #pragma pack(push, 1)
@@ -64,13 +74,65 @@ struct ForcedReleasePayload {
   NodeID winnerNodeId;
 };
 
+// An address a stable peer set aside for the node it names; the joiner may
+// claim it without waiting out a probe.
+struct LeaseOfferPayload {
+  uint32_t ipAddress;
+  NodeID nodeId;
+};
+
+// Prefix of ROUTE_DELTA, followed by RouteChange entries: the changes that
+// take the sender's routing table from version base to version.
+struct RouteDeltaHeader {
+  uint32_t base;    // network byte order
+  uint32_t version; // network byte order
+};
+
+// Prefix of ROUTE_SYNC, followed by RouteChange entries (none removed): part
+// of the sender's whole table at version. The last part has last = 1.
+struct RouteSyncHeader {
+  uint32_t version; // network byte order
+  uint8_t last;
+};
+
+struct RouteChange {
+  uint64_t steamID;
+  uint32_t ipAddress; // network byte order
+  uint8_t removed;
+};
+
 struct HeartbeatPayload {
   uint32_t ipAddress;
   NodeID nodeId;
   int64_t timestampMs;
 };
+
+// One entry per peer the reporter has a direct session with; a PATH_REPORT
+// payload is a packed array of these.
+struct PathReportEntry {
+  uint64_t steamID;
+  uint16_t pingMs;  // network byte order
+  uint8_t quality;  // delivered fraction scaled to 0..255
+  uint8_t relayed;  // 1 when the session goes through a Steam relay
+};
+
+// Prefix of FEC_DATA (followed by an IP_PACKET payload) and FEC_PARITY
+// (followed by the uint16 XOR of the group's payload lengths, network byte
+// order, and the XOR of the payloads zero-padded to the longest one).
+struct FecHeader {
+  uint16_t group; // network byte order, wraps
+  uint8_t index;  // position in the group; equals count on the parity
+  uint8_t count;  // data packets in the group (final on the parity)
+};
 #pragma pack(pop)
 
+// One message of a receive batch; data stays valid until the batch is done.
+struct VpnIncomingMessage {
+  const uint8_t *data;
+  size_t size;
+  CSteamID sender;
+};
+
 struct NodeInfo {
   NodeID nodeId;
   CSteamID steamId;
@@ -104,4 +166,6 @@ struct RouteEntry {
   std::string name;
   bool isLocal;
   NodeID nodeId;
+  CSteamID nextHop; // peer we hand packets to; steamID itself when direct
+  int pathCostMs = -1;
 };
@@ -44,6 +44,19 @@ ApplicationWindow {
         }
     }
 
+    function formatRate(bytesPerSecond) {
+        if (bytesPerSecond === undefined || bytesPerSecond === null || bytesPerSecond < 0) {
+            return "-";
+        }
+        if (bytesPerSecond >= 1024 * 1024) {
+            return qsTr("%1 MB/s").arg((bytesPerSecond / (1024 * 1024)).toFixed(1));
+        }
+        if (bytesPerSecond >= 1024) {
+            return qsTr("%1 KB/s").arg((bytesPerSecond / 1024).toFixed(1));
+        }
+        return qsTr("%1 B/s").arg(bytesPerSecond);
+    }
+
     function copyBadge(label, value) {
         if (!value || value.length === 0) {
             return;
@@ -1041,6 +1054,9 @@ ApplicationWindow {
                                                             required property string relay
                                                             required property bool isFriend
                                                             required property bool isSelf
+                                                            required property var txRate
+                                                            required property var rxRate
+                                                            required property var drops
 
                                                             radius: 10
                                                             // 修改颜色逻辑：增加鼠标悬停变色效果，提示用户可交互
@@ -1204,6 +1220,15 @@ ApplicationWindow {
                                                                         horizontalAlignment: Text.AlignRight
                                                                         Layout.alignment: Qt.AlignRight
                                                                     }
+                                                                    Label {
+                                                                        visible: !isSelf && txRate !== undefined && txRate >= 0
+                                                                        text: qsTr("↑ %1  ↓ %2").arg(win.formatRate(txRate)).arg(win.formatRate(rxRate))
+                                                                              + (drops > 0 ? qsTr("  丢包 %1").arg(drops) : "")
+                                                                        color: drops > 0 ? "#f9c74f" : "#62708f"
+                                                                        font.pixelSize: 11
+                                                                        horizontalAlignment: Text.AlignRight
+                                                                        Layout.alignment: Qt.AlignRight
+                                                                    }
                                                                 }
                                                             }
                                                         }
@@ -0,0 +1,348 @@
+#include "avatar_image_provider.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QFile>
+#include <QQuickImageResponse>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QSet>
+#include <QTextStream>
+#include <algorithm>
+#include <steam_api.h>
+#include <utility>
+
+namespace {
+constexpr int kWorkerThreads = 2;
+constexpr const char *kIndexFile = "index.txt";
+
+class AvatarResponse : public QQuickImageResponse, public QRunnable {
+public:
+  AvatarResponse(std::shared_ptr<AvatarCache> cache, uint64_t steamId,
+                 int handle, const QSize &requestedSize)
+      : cache_(std::move(cache)), steamId_(steamId), handle_(handle),
+        requestedSize_(requestedSize) {
+    setAutoDelete(false);
+  }
+
+  QQuickTextureFactory *textureFactory() const override {
+    return QQuickTextureFactory::textureFactoryForImage(image_);
+  }
+
+  void run() override {
+    image_ = cache_->image(steamId_, handle_);
+    if (!image_.isNull() && requestedSize_.isValid() &&
+        image_.size() != requestedSize_) {
+      image_ = image_.scaled(requestedSize_, Qt::KeepAspectRatio,
+                             Qt::SmoothTransformation);
+    }
+    emit finished();
+  }
+
+private:
+  std::shared_ptr<AvatarCache> cache_;
+  uint64_t steamId_;
+  int handle_;
+  QSize requestedSize_;
+  QImage image_;
+};
+} // namespace
+
+AvatarCache::AvatarCache(const QString &directory) : directory_(directory) {
+  if (!directory_.mkpath(QStringLiteral("."))) {
+    qWarning() << "Avatar cache directory unavailable:" << directory;
+  }
+  loadIndex();
+}
+
+QString AvatarCache::urlFor(uint64_t steamId, int handle) const {
+  if (handle <= 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (index_.find(steamId) == index_.end()) {
+      return {};
+    }
+    handle = 0;
+  }
+  return QStringLiteral("image://avatar/%1/%2").arg(steamId).arg(handle);
+}
+
+QImage AvatarCache::image(uint64_t steamId, int handle) {
+  if (handle > 0) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = handles_.find(handle);
+      if (it != handles_.end()) {
+        const QImage image = cached(it->second);
+        if (!image.isNull()) {
+          return image;
+        }
+      }
+    }
+    QByteArray hash;
+    const QImage image = fromSteam(handle, hash);
+    if (!image.isNull()) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        handles_[handle] = hash;
+        remember(hash, image);
+      }
+      store(steamId, hash, image);
+      return image;
+    }
+  }
+
+  QByteArray hash;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(steamId);
+    if (it == index_.end()) {
+      return {};
+    }
+    hash = it->second.hash;
+    const QImage image = cached(hash);
+    if (!image.isNull()) {
+      return image;
+    }
+  }
+  const QImage image(pngPath(hash));
+  if (!image.isNull()) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    remember(hash, image);
+  }
+  return image;
+}
+
+// ISteamUtils image calls are safe off the main thread; only callbacks are
+// tied to SteamAPI_RunCallbacks().
+QImage AvatarCache::fromSteam(int handle, QByteArray &hash) {
+  if (::SteamUtils() == nullptr) {
+    return {};
+  }
+  uint32 width = 0;
+  uint32 height = 0;
+  if (!::SteamUtils()->GetImageSize(handle, &width, &height) || width == 0 ||
+      height == 0) {
+    return {};
+  }
+  QImage image(static_cast<int>(width), static_cast<int>(height),
+               QImage::Format_RGBA8888);
+  if (image.sizeInBytes() != static_cast<qsizetype>(width) * height * 4 ||
+      !::SteamUtils()->GetImageRGBA(handle, image.bits(),
+                                    static_cast<int>(image.sizeInBytes()))) {
+    return {};
+  }
+  QCryptographicHash digest(QCryptographicHash::Sha1);
+  digest.addData(QByteArrayView(reinterpret_cast<const char *>(image.bits()),
+                                image.sizeInBytes()));
+  hash = digest.result().toHex();
+  return image;
+}
+
+// Caller holds mutex_.
+QImage AvatarCache::cached(const QByteArray &hash) {
+  auto it = lru_.find(hash);
+  if (it == lru_.end()) {
+    return {};
+  }
+  images_.splice(images_.begin(), images_, it.value());
+  return it.value()->second;
+}
+
+// Caller holds mutex_.
+void AvatarCache::remember(const QByteArray &hash, const QImage &image) {
+  auto it = lru_.find(hash);
+  if (it != lru_.end()) {
+    images_.splice(images_.begin(), images_, it.value());
+    return;
+  }
+  images_.emplace_front(hash, image);
+  lru_.insert(hash, images_.begin());
+  if (images_.size() > kMemoryImages) {
+    lru_.remove(images_.back().first);
+    images_.pop_back();
+  }
+}
+
+void AvatarCache::store(uint64_t steamId, const QByteArray &hash,
+                        const QImage &image) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(steamId);
+    if (it != index_.end() && it->second.hash == hash) {
+      return;
+    }
+  }
+  std::lock_guard<std::mutex> files(fileMutex_);
+  // Only a picture we have not seen before is encoded; the write is atomic,
+  // so a crash cannot leave a torn file behind.
+  const QString path = pngPath(hash);
+  if (!QFile::exists(path)) {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || !image.save(&file, "PNG") ||
+        !file.commit()) {
+      return;
+    }
+  }
+  std::vector<QByteArray> orphans;
+  std::vector<std::pair<uint64_t, QByteArray>> compacted;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stored &stored = index_[steamId];
+    if (stored.hash == hash) {
+      return; // another worker stored it meanwhile
+    }
+    const QByteArray replaced = stored.hash;
+    stored = {hash, ++indexOrder_};
+    orphans = pruneIndex(replaced);
+    // Appended lines pile up as avatars change; rewrite once they are
+    // mostly superseded.
+    if (++indexLines_ > 2 * kMemoryImages) {
+      compacted = indexSnapshot();
+    }
+  }
+  for (const QByteArray &orphan : orphans) {
+    QFile::remove(pngPath(orphan));
+  }
+  if (compacted.empty()) {
+    appendIndex(steamId, hash);
+  } else {
+    writeIndex(compacted);
+  }
+}
+
+// Caller holds mutex_. Drops the least recently stored Steam IDs past
+// kMemoryImages and returns the hashes, replaced included, that no
+// remaining entry refers to.
+std::vector<QByteArray> AvatarCache::pruneIndex(const QByteArray &replaced) {
+  std::vector<QByteArray> dropped;
+  if (!replaced.isEmpty()) {
+    dropped.push_back(replaced);
+  }
+  while (index_.size() > kMemoryImages) {
+    auto oldest = std::min_element(
+        index_.begin(), index_.end(), [](const auto &a, const auto &b) {
+          return a.second.order < b.second.order;
+        });
+    dropped.push_back(oldest->second.hash);
+    index_.erase(oldest);
+  }
+  std::vector<QByteArray> orphans;
+  for (const QByteArray &hash : dropped) {
+    const bool shared = std::any_of(
+        index_.begin(), index_.end(),
+        [&hash](const auto &kv) { return kv.second.hash == hash; });
+    if (!shared &&
+        std::find(orphans.begin(), orphans.end(), hash) == orphans.end()) {
+      orphans.push_back(hash);
+    }
+  }
+  return orphans;
+}
+
+// Caller holds mutex_. Oldest first, the order loadIndex() reads them in.
+std::vector<std::pair<uint64_t, QByteArray>>
+AvatarCache::indexSnapshot() const {
+  std::vector<std::pair<uint64_t, const Stored *>> sorted;
+  sorted.reserve(index_.size());
+  for (const auto &kv : index_) {
+    sorted.emplace_back(kv.first, &kv.second);
+  }
+  std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) {
+    return a.second->order < b.second->order;
+  });
+  std::vector<std::pair<uint64_t, QByteArray>> entries;
+  entries.reserve(sorted.size());
+  for (const auto &item : sorted) {
+    entries.emplace_back(item.first, item.second->hash);
+  }
+  return entries;
+}
+
+QString AvatarCache::pngPath(const QByteArray &hash) const {
+  return directory_.filePath(QString::fromLatin1(hash) +
+                             QStringLiteral(".png"));
+}
+
+// Runs before any worker exists: later lines override earlier ones, entries
+// whose PNG is gone are dropped, and the file is rewritten compacted.
+void AvatarCache::loadIndex() {
+  QFile file(directory_.filePath(QString::fromLatin1(kIndexFile)));
+  if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+      const QStringList fields = in.readLine().split(QLatin1Char(' '));
+      bool ok = false;
+      const uint64_t steamId = fields.value(0).toULongLong(&ok);
+      if (ok && fields.size() == 2 && !fields[1].isEmpty()) {
+        index_[steamId] = {fields[1].toLatin1(), ++indexOrder_};
+      }
+    }
+    file.close();
+  }
+  for (auto it = index_.begin(); it != index_.end();) {
+    if (QFile::exists(pngPath(it->second.hash))) {
+      ++it;
+    } else {
+      it = index_.erase(it);
+    }
+  }
+  pruneIndex({});
+
+  QSet<QString> referenced;
+  for (const auto &kv : index_) {
+    referenced.insert(QString::fromLatin1(kv.second.hash) +
+                      QStringLiteral(".png"));
+  }
+  const QStringList pngs =
+      directory_.entryList({QStringLiteral("*.png")}, QDir::Files);
+  for (const QString &name : pngs) {
+    if (!referenced.contains(name)) {
+      directory_.remove(name);
+    }
+  }
+  writeIndex(indexSnapshot());
+}
+
+// Caller holds fileMutex_.
+void AvatarCache::appendIndex(uint64_t steamId, const QByteArray &hash) {
+  QFile file(directory_.filePath(QString::fromLatin1(kIndexFile)));
+  if (!file.open(QIODevice::Append | QIODevice::Text)) {
+    return;
+  }
+  QTextStream out(&file);
+  out << steamId << ' ' << hash << '\n';
+}
+
+// Caller holds fileMutex_, or is the constructor.
+void AvatarCache::writeIndex(
+    const std::vector<std::pair<uint64_t, QByteArray>> &entries) {
+  QSaveFile file(directory_.filePath(QString::fromLatin1(kIndexFile)));
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    return;
+  }
+  QTextStream out(&file);
+  for (const auto &entry : entries) {
+    out << entry.first << ' ' << entry.second << '\n';
+  }
+  out.flush();
+  if (file.commit()) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    indexLines_ = entries.size();
+  }
+}
+
+AvatarImageProvider::AvatarImageProvider(std::shared_ptr<AvatarCache> cache)
+    : cache_(std::move(cache)) {
+  pool_.setMaxThreadCount(kWorkerThreads);
+}
+
+QQuickImageResponse *
+AvatarImageProvider::requestImageResponse(const QString &id,
+                                          const QSize &requestedSize) {
+  const QStringList parts = id.split(QLatin1Char('/'));
+  const uint64_t steamId = parts.value(0).toULongLong();
+  const int handle = parts.value(1).toInt();
+  auto *response = new AvatarResponse(cache_, steamId, handle, requestedSize);
+  pool_.start(response);
+  return response;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QDir>
+#include <QHash>
+#include <QImage>
+#include <QQuickAsyncImageProvider>
+#include <QString>
+#include <QThreadPool>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Steam avatars decoded once per image handle and shared by every model. An
+// in-memory LRU holds recent images by content hash; PNGs are also written to
+// a content-addressed directory along with the last hash seen per Steam ID,
+// so an avatar Steam has not downloaded yet this session can still be shown.
+// The index keeps the most recently stored kMemoryImages Steam IDs, and PNGs
+// none of them refers to are deleted.
+// Thread-safe: the image provider's workers fill it, the GUI thread asks it
+// what it has.
+class AvatarCache {
+public:
+  static constexpr std::size_t kMemoryImages = 256;
+
+  explicit AvatarCache(const QString &directory);
+
+  // image://avatar URL for the avatar with the given handle, falling back to
+  // the stored one when Steam has no handle yet; empty when neither exists.
+  QString urlFor(uint64_t steamId, int handle) const;
+
+  // Worker side: the decoded avatar, from memory, Steam or disk.
+  QImage image(uint64_t steamId, int handle);
+
+private:
+  QImage fromSteam(int handle, QByteArray &hash);
+  QImage cached(const QByteArray &hash);
+  void remember(const QByteArray &hash, const QImage &image);
+  void store(uint64_t steamId, const QByteArray &hash, const QImage &image);
+  std::vector<QByteArray> pruneIndex(const QByteArray &replaced);
+  std::vector<std::pair<uint64_t, QByteArray>> indexSnapshot() const;
+  QString pngPath(const QByteArray &hash) const;
+  void loadIndex();
+  void appendIndex(uint64_t steamId, const QByteArray &hash);
+  void writeIndex(const std::vector<std::pair<uint64_t, QByteArray>> &entries);
+
+  struct Stored {
+    QByteArray hash;
+    uint64_t order = 0; // larger is more recently stored
+  };
+
+  QDir directory_;
+  mutable std::mutex mutex_;
+  // Content hash -> image, most recently used first.
+  std::list<std::pair<QByteArray, QImage>> images_;
+  QHash<QByteArray, std::list<std::pair<QByteArray, QImage>>::iterator> lru_;
+  std::unordered_map<int, QByteArray> handles_; // this session's handles
+  std::unordered_map<uint64_t, Stored> index_;  // persisted
+  uint64_t indexOrder_ = 0;
+  std::size_t indexLines_ = 0; // in index.txt, appended lines included
+  // Held by one storing worker at a time, around index.txt and the PNGs, so
+  // lookups under mutex_ never wait for the disk.
+  std::mutex fileMutex_;
+};
+
+// Serves image://avatar/<steamId>/<handle> off the GUI thread.
+class AvatarImageProvider : public QQuickAsyncImageProvider {
+public:
+  explicit AvatarImageProvider(std::shared_ptr<AvatarCache> cache);
+
+  QQuickImageResponse *requestImageResponse(const QString &id,
+                                            const QSize &requestedSize) override;
+
+private:
+  std::shared_ptr<AvatarCache> cache_;
+  QThreadPool pool_;
+};
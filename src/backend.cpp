@@ -1,11 +1,17 @@
 #include "backend.h"
+#include "avatar_image_provider.h"
 
+#include "../net/metrics.h"
+#include "../net/metrics_server.h"
+#include "../net/multiplex_manager.h"
 #include "../net/tcp_server.h"
+#include "../net/telemetry.h"
 #include "../steam/steam_networking_manager.h"
 #include "../steam/steam_room_manager.h"
 #include "../steam/steam_utils.h"
 #include "../steam/steam_vpn_bridge.h"
 #include "../steam/steam_vpn_networking_manager.h"
+#include "../steam/vpn_message_handler.h"
 #include "firewall_windows.h"
 #ifdef Q_OS_MACOS
 #include "tun_privileged_helper.h"
@@ -67,6 +73,13 @@
 #endif
 
 namespace {
+// Persona changes are batched this long before reaching the friends model.
+constexpr int kFriendsUpdateDelayMs = 250;
+constexpr std::chrono::minutes kFriendsResyncInterval{10};
+// Ping, relay and traffic figures per member are polled this often from the
+// frame tick; joins, leaves and host changes rebuild the list right away.
+constexpr std::chrono::milliseconds kMembersUpdateInterval{500};
+
 struct PersonaDisplay {
   QString label;
   bool online;
@@ -129,6 +142,26 @@ bool currentUserHasTunPrivileges() {
 #endif
 }
 
+// What the host reports to its clients about one of its connections; the
+// rates are filled in once sampled.
+telemetry::Member
+telemetryMember(uint64_t steamId,
+                const SteamNetConnectionRealTimeStatus_t &status,
+                const SteamNetConnectionInfo_t &info) {
+  telemetry::Member member;
+  member.steamId = steamId;
+  member.pingMs = status.m_nPing;
+  if (status.m_flConnectionQualityLocal >= 0.0f) {
+    member.quality =
+        static_cast<int>(status.m_flConnectionQualityLocal * 100.0f + 0.5f);
+  }
+  const bool relayed =
+      (info.m_nFlags & k_nSteamNetworkConnectionInfoFlags_Relayed) != 0;
+  member.transport =
+      relayed ? telemetry::Transport::Relayed : telemetry::Transport::Direct;
+  return member;
+}
+
 PersonaDisplay personaStateDisplay(EPersonaState state) {
   switch (state) {
   case k_EPersonaStateOnline:
@@ -498,6 +531,9 @@ Backend::Backend(QObject *parent)
   qputenv("SteamAppId", QByteArray("480"));
   qputenv("SteamGameId", QByteArray("480"));
   updateStatusText_.clear();
+  avatarCache_ = std::make_shared<AvatarCache>(
+      QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+      QStringLiteral("/avatars"));
 
 #ifdef Q_OS_WIN
   fixSteamEnvForWindows();
@@ -512,11 +548,38 @@ Backend::Backend(QObject *parent)
       boost::asio::make_work_guard(ioContext_));
   ioThread_ = std::thread([this]() { ioContext_.run(); });
 
+  // Opt-in Prometheus endpoint for data-path metrics (127.0.0.1 only).
+  const int metricsPort =
+      qEnvironmentVariableIntValue("CONNECTTOOL_METRICS_PORT");
+  if (metricsPort > 0) {
+    metricsServer_ = std::make_unique<MetricsServer>(ioContext_, metricsPort);
+    if (!metricsServer_->start()) {
+      metricsServer_.reset();
+    }
+  }
+
+  // Tunnel compression is negotiated per stream; "0" stops offering it.
+  MultiplexManager::setCompressionEnabled(
+      qEnvironmentVariable("CONNECTTOOL_TUNNEL_COMPRESSION") !=
+      QLatin1String("0"));
+
+  // Busy-poll window (microseconds) of the Steam VPN receiver after traffic.
+  bool spinSet = false;
+  const int spinMicros =
+      qEnvironmentVariableIntValue("CONNECTTOOL_VPN_SPIN_US", &spinSet);
+  if (spinSet) {
+    VpnMessageHandler::setSpinTime(std::chrono::microseconds(spinMicros));
+  }
+
   lobbiesModel_.setFilter(lobbyFilter_);
   lobbiesModel_.setSortMode(lobbySortMode_);
 
   connect(&callbackTimer_, &QTimer::timeout, this, &Backend::tick);
-  connect(&slowTimer_, &QTimer::timeout, this, &Backend::refreshFriends);
+  connect(&slowTimer_, &QTimer::timeout, this,
+          &Backend::resyncFriendsIfStale);
+  friendsUpdateTimer_.setSingleShot(true);
+  connect(&friendsUpdateTimer_, &QTimer::timeout, this,
+          &Backend::applyFriendUpdates);
   friendsRefreshResetTimer_.setSingleShot(true);
   connect(&friendsRefreshResetTimer_, &QTimer::timeout, this,
           [this]() { setFriendsRefreshing(false); });
@@ -596,10 +659,14 @@ Backend::~Backend() {
     workGuard_->reset();
   }
 
+  if (metricsServer_) {
+    metricsServer_->stop();
+  }
   ioContext_.stop();
   if (ioThread_.joinable()) {
     ioThread_.join();
   }
+  metricsServer_.reset();
 
   // Let the Steam manager handle shutdown/SteamAPI cleanup in its destructor
   steamManager_.reset();
@@ -777,6 +844,14 @@ bool Backend::tryInitializeSteam() {
         },
         Qt::QueuedConnection);
   });
+  // Runs inside SteamAPI_RunCallbacks() on the GUI thread. Steam reports a
+  // burst of changes when it connects, so they are applied in batches.
+  roomManager_->setFriendChangedCallback([this](const CSteamID &user) {
+    dirtyFriends_.insert(user.ConvertToUint64());
+    if (!friendsUpdateTimer_.isActive()) {
+      friendsUpdateTimer_.start(kFriendsUpdateDelayMs);
+    }
+  });
   roomManager_->setLobbyModeChangedCallback([this](bool wantsTun,
                                                    const CSteamID &lobby) {
     QMetaObject::invokeMethod(
@@ -788,6 +863,10 @@ bool Backend::tryInitializeSteam() {
     QMetaObject::invokeMethod(
         this, [this]() { disconnect(); }, Qt::QueuedConnection);
   });
+  roomManager_->setMembersChangedCallback([this]() {
+    QMetaObject::invokeMethod(
+        this, [this]() { updateMembersList(); }, Qt::QueuedConnection);
+  });
   roomManager_->setChatMessageCallback([this](const CSteamID &sender,
                                               const std::string &payload) {
     const uint64_t senderId = sender.ConvertToUint64();
@@ -1009,9 +1088,37 @@ void Backend::ensureVpnSetup() {
       vpnManager_.reset();
       return;
     }
+    // FQ-CoDel by default; "codel" shares one queue between all flows to a
+    // peer, "taildrop" only bounds its size.
+    EgressQueue::Config egress;
+    const QString queuePolicy = qEnvironmentVariable("CONNECTTOOL_VPN_QUEUE");
+    if (queuePolicy == QLatin1String("codel")) {
+      egress.policy = EgressQueue::Policy::CoDel;
+    } else if (queuePolicy == QLatin1String("taildrop")) {
+      egress.policy = EgressQueue::Policy::TailDrop;
+    }
+    vpnManager_->setEgressQueueConfig(egress);
   }
   if (!vpnBridge_) {
     vpnBridge_ = std::make_unique<SteamVpnBridge>(vpnManager_.get());
+    // Opt-in parity for lossy (relayed) paths; peers always decode it.
+    vpnBridge_->setFecEnabled(qEnvironmentVariableIntValue(
+                                  "CONNECTTOOL_VPN_FEC") > 0);
+    // Port rules on top of the DSCP/ICMP defaults, e.g.
+    // "udp/27015-27030=interactive", and classes to send reliably.
+    TrafficClassifier classifier;
+    const QString classRules = qEnvironmentVariable("CONNECTTOOL_VPN_CLASSES");
+    if (!classifier.addPortRules(classRules.toStdString())) {
+      qWarning() << "Ignoring malformed CONNECTTOOL_VPN_CLASSES:"
+                 << classRules;
+    }
+    const QString reliableClasses =
+        qEnvironmentVariable("CONNECTTOOL_VPN_RELIABLE_CLASSES");
+    if (!classifier.setReliableClasses(reliableClasses.toStdString())) {
+      qWarning() << "Ignoring malformed CONNECTTOOL_VPN_RELIABLE_CLASSES:"
+                 << reliableClasses;
+    }
+    vpnBridge_->setTrafficClassifier(classifier);
     vpnManager_->setVpnBridge(vpnBridge_.get());
   }
   if (roomManager_) {
@@ -1316,41 +1423,99 @@ void Backend::refreshFriends() {
     return;
   }
   setFriendsRefreshing(true);
-  QVariantList updated;
+  const auto started = std::chrono::steady_clock::now();
   std::vector<FriendsModel::Entry> modelData;
-  int idx = 0;
   for (const auto &friendInfo : SteamUtils::getFriendsList()) {
-    const QString steamId = QString::number(friendInfo.id.ConvertToUint64());
-    const QString displayName = QString::fromStdString(friendInfo.name);
-    const QString avatar = QString::fromStdString(friendInfo.avatarDataUrl);
-    const PersonaDisplay persona = personaStateDisplay(friendInfo.personaState);
-    const auto cooldownIt =
-        inviteCooldowns_.find(friendInfo.id.ConvertToUint64());
-    const int friendCooldown =
-        cooldownIt != inviteCooldowns_.end() ? cooldownIt->second : 0;
-
-    QVariantMap entry;
-    entry.insert(QStringLiteral("id"), steamId);
-    entry.insert(QStringLiteral("name"), displayName);
-    entry.insert(QStringLiteral("status"), persona.label);
-    entry.insert(QStringLiteral("online"), persona.online);
-    entry.insert(QStringLiteral("cooldown"), friendCooldown);
-    if (!avatar.isEmpty()) {
-      entry.insert(QStringLiteral("avatar"), avatar);
-    }
-    updated.push_back(entry);
-    modelData.push_back({steamId, displayName, avatar, persona.online,
-                         persona.label, persona.priority, friendCooldown});
-    ++idx;
+    modelData.push_back(friendEntry(friendInfo));
   }
+  const int previousCount = friendsModel_.count();
   friendsModel_.setFriends(std::move(modelData));
-  if (updated != friends_) {
-    friends_ = updated;
+  // Pending changes are already part of this snapshot.
+  dirtyFriends_.clear();
+  friendsUpdateTimer_.stop();
+  lastFriendsResync_ = started;
+  if (friendsModel_.count() != previousCount) {
     emit friendsChanged();
   }
+  recordGuiTime(friendsGuiTime_, "Friends", "friends", friendsModel_.count(),
+                started);
   friendsRefreshResetTimer_.start(1500);
 }
 
+FriendsModel::Entry
+Backend::friendEntry(const SteamUtils::FriendInfo &info) const {
+  const uint64_t id = info.id.ConvertToUint64();
+  const PersonaDisplay persona = personaStateDisplay(info.personaState);
+  const auto cooldownIt = inviteCooldowns_.find(id);
+  const int cooldown =
+      cooldownIt != inviteCooldowns_.end() ? cooldownIt->second : 0;
+  return {QString::number(id),
+          QString::fromStdString(info.name),
+          avatarCache_->urlFor(id, info.avatarHandle),
+          persona.online,
+          persona.label,
+          persona.priority,
+          cooldown};
+}
+
+void Backend::applyFriendUpdates() {
+  if (!steamReady_ || dirtyFriends_.empty()) {
+    dirtyFriends_.clear();
+    return;
+  }
+  const auto started = std::chrono::steady_clock::now();
+  bool countChanged = false;
+  for (const uint64_t id : dirtyFriends_) {
+    SteamUtils::FriendInfo info;
+    if (SteamUtils::getFriendInfo(CSteamID(static_cast<uint64>(id)), info)) {
+      const int before = friendsModel_.count();
+      friendsModel_.updateFriend(friendEntry(info));
+      countChanged = countChanged || friendsModel_.count() != before;
+    } else if (friendsModel_.removeFriend(QString::number(id))) {
+      countChanged = true;
+    }
+  }
+  dirtyFriends_.clear();
+  if (countChanged) {
+    emit friendsChanged();
+  }
+  recordGuiTime(friendsGuiTime_, "Friends", "friends", friendsModel_.count(),
+                started);
+}
+
+void Backend::resyncFriendsIfStale() {
+  // The callbacks keep the list current; a full pass only catches what they
+  // could have missed, e.g. while Steam was reconnecting.
+  if (std::chrono::steady_clock::now() - lastFriendsResync_ >=
+      kFriendsResyncInterval) {
+    refreshFriends();
+  }
+}
+
+void Backend::recordGuiTime(GuiTime &stats, const char *tag,
+                            const char *noun, int items,
+                            std::chrono::steady_clock::time_point started) {
+  const auto now = std::chrono::steady_clock::now();
+  stats.spent += now - started;
+  ++stats.updates;
+  if (stats.since.time_since_epoch().count() == 0) {
+    stats.since = started;
+  }
+  if (now - stats.since < std::chrono::minutes(1)) {
+    return;
+  }
+  qInfo().nospace()
+      << "[" << tag << "] " << items << " " << noun << ", " << stats.updates
+      << " updates, "
+      << std::chrono::duration<double, std::milli>(stats.spent).count()
+      << " ms on the GUI thread in the last "
+      << std::chrono::duration_cast<std::chrono::seconds>(now - stats.since)
+             .count()
+      << " s";
+  stats = GuiTime{};
+  stats.since = now;
+}
+
 void Backend::refreshLobbies() {
   if (!ensureSteamReady(tr("刷新大厅列表"))) {
     return;
@@ -1659,22 +1824,7 @@ void Backend::addFriend(const QString &steamId) {
 }
 
 void Backend::updateFriendCooldown(const QString &steamId, int seconds) {
-  const bool modelChanged = friendsModel_.setInviteCooldown(steamId, seconds);
-  bool listChanged = false;
-  for (auto &entry : friends_) {
-    QVariantMap map = entry.toMap();
-    if (map.value(QStringLiteral("id")).toString() == steamId) {
-      if (map.value(QStringLiteral("cooldown")).toInt() != seconds) {
-        map.insert(QStringLiteral("cooldown"), seconds);
-        entry = map;
-        listChanged = true;
-      }
-      break;
-    }
-  }
-  if (listChanged) {
-    emit friendsChanged();
-  }
+  friendsModel_.setInviteCooldown(steamId, seconds);
 }
 
 void Backend::setFriendsRefreshing(bool refreshing) {
@@ -2054,7 +2204,9 @@ void Backend::tick() {
   }
 
   refreshHostId();
-  updateMembersList();
+  if (now - lastMembersUpdate_ >= kMembersUpdateInterval) {
+    updateMembersList();
+  }
   updateStatus();
   updateLobbyInfoSignals();
 }
@@ -2206,16 +2358,60 @@ QString Backend::avatarForSteamId(const CSteamID &memberId) {
     return cached->second;
   }
 
-  const std::string avatarData = SteamUtils::getAvatarDataUrl(memberId);
-  if (avatarData.empty()) {
-    return {};
+  // Without a handle this is at best last session's picture; ask again next
+  // time so the current one replaces it once Steam has it.
+  const int handle = SteamUtils::getAvatarHandle(memberId);
+  QString avatar = avatarCache_->urlFor(key, handle);
+  if (handle > 0) {
+    memberAvatars_.emplace(key, avatar);
   }
-  QString avatar = QString::fromStdString(avatarData);
-  memberAvatars_.emplace(key, avatar);
   return avatar;
 }
 
+void Backend::sampleTraffic() {
+  const auto now = std::chrono::steady_clock::now();
+  const auto elapsed = now - lastTrafficSample_;
+  const bool haveBaseline = lastTrafficSample_.time_since_epoch().count() != 0;
+  if (haveBaseline && elapsed < std::chrono::seconds(1)) {
+    return;
+  }
+  const double seconds = std::chrono::duration<double>(elapsed).count();
+  lastTrafficSample_ = now;
+
+  for (const auto &totals : metrics::registry().peerTotals()) {
+    PeerTraffic &traffic = peerTraffic_[totals.steamId];
+    if (haveBaseline && seconds > 0.0) {
+      traffic.txRate = static_cast<qint64>(
+          static_cast<double>(totals.txBytes - traffic.txBytes) / seconds);
+      traffic.rxRate = static_cast<qint64>(
+          static_cast<double>(totals.rxBytes - traffic.rxBytes) / seconds);
+    }
+    traffic.txBytes = totals.txBytes;
+    traffic.rxBytes = totals.rxBytes;
+    traffic.drops = static_cast<qint64>(totals.drops);
+  }
+}
+
+void Backend::applyTraffic(MembersModel::Entry &entry,
+                           uint64_t steamId) const {
+  auto it = peerTraffic_.find(steamId);
+  if (it == peerTraffic_.end()) {
+    return;
+  }
+  entry.txRate = it->second.txRate;
+  entry.rxRate = it->second.rxRate;
+  entry.drops = it->second.drops;
+}
+
 void Backend::updateMembersList() {
+  const auto started = std::chrono::steady_clock::now();
+  lastMembersUpdate_ = started;
+  updateMembersModel();
+  recordGuiTime(membersGuiTime_, "Members", "members", membersModel_.count(),
+                started);
+}
+
+void Backend::updateMembersModel() {
   if (!steamReady_) {
     membersModel_.setMembers({});
     memberAvatars_.clear();
@@ -2223,6 +2419,7 @@ void Backend::updateMembersList() {
     return;
   }
 
+  sampleTraffic();
   if (inTunMode()) {
     std::vector<CSteamID> lobbyMembers;
     if (roomManager_) {
@@ -2233,11 +2430,16 @@ void Backend::updateMembersList() {
     }
 
     std::unordered_map<uint64_t, uint32_t> ipBySteam;
+    std::unordered_map<uint64_t, CSteamID> nextHopBySteam;
     if (vpnBridge_) {
       const auto routes = vpnBridge_->getRoutingTable();
       for (const auto &kv : routes) {
         const uint64_t sid = kv.second.steamID.ConvertToUint64();
         ipBySteam[sid] = kv.second.ipAddress;
+        if (kv.second.nextHop.IsValid() &&
+            kv.second.nextHop != kv.second.steamID) {
+          nextHopBySteam[sid] = kv.second.nextHop;
+        }
       }
     }
 
@@ -2270,6 +2472,12 @@ void Backend::updateMembersList() {
         entry.ping = vpnManager_->getPeerPing(memberId);
         entry.relay = QString::fromStdString(
             vpnManager_->getPeerConnectionType(memberId));
+        auto itHop = nextHopBySteam.find(memberValue);
+        if (itHop != nextHopBySteam.end()) {
+          entry.relay = tr("经 %1").arg(QString::fromUtf8(
+              SteamFriends()->GetFriendPersonaName(itHop->second)));
+        }
+        applyTraffic(entry, memberValue);
       }
       auto itIp = ipBySteam.find(memberValue);
       if (itIp != ipBySteam.end()) {
@@ -2311,7 +2519,33 @@ void Backend::updateMembersList() {
 
   std::vector<MembersModel::Entry> entries;
   entries.reserve(lobbyMembers.size());
-  std::vector<std::tuple<uint64_t, int, std::string>> pingBroadcast;
+  // Host: what it reports to clients. Client: the host's latest report.
+  telemetry::Snapshot telemetryReport;
+  // Host: the same in the lobby chat form older clients read.
+  std::vector<std::tuple<uint64_t, int, std::string>> legacyPings;
+  std::shared_ptr<const telemetry::Snapshot> hostTelemetry;
+  if (!isHost() && steamManager_->getMessageHandler()) {
+    hostTelemetry = steamManager_->getMessageHandler()->latestTelemetry();
+  }
+  const auto reported = [&](uint64_t steamId) -> const telemetry::Member * {
+    return hostTelemetry ? telemetry::find(*hostTelemetry, steamId) : nullptr;
+  };
+  const auto addReport = [&](telemetry::Member report,
+                             const MembersModel::Entry &entry) {
+    report.txRate = static_cast<uint64_t>(std::max<qint64>(entry.txRate, 0));
+    report.rxRate = static_cast<uint64_t>(std::max<qint64>(entry.rxRate, 0));
+    telemetryReport.push_back(report);
+  };
+  const auto transportLabel = [this](telemetry::Transport transport) {
+    switch (transport) {
+    case telemetry::Transport::Direct:
+      return tr("P2P");
+    case telemetry::Transport::Relayed:
+      return tr("中继");
+    default:
+      return QString();
+    }
+  };
 
   CSteamID myId = SteamUser()->GetSteamID();
   CSteamID hostId = steamManager_->getHostSteamID();
@@ -2340,6 +2574,7 @@ void Backend::updateMembersList() {
     entry.relay = QStringLiteral("-");
     entry.ping = -1;
     const bool memberIsHost = isMemberHost(memberId);
+    telemetry::Member report;
 
     if (memberId == myId) {
       entry.ping = 0;
@@ -2347,15 +2582,13 @@ void Backend::updateMembersList() {
     } else {
       if (memberIsHost) {
         entry.relay = tr("房主");
-        int rp = -1;
-        std::string relayInfo;
-        const bool hasBroadcast =
-            roomManager_ && roomManager_->getRemotePing(myId, rp, relayInfo) &&
-            rp >= 0;
-        if (hasBroadcast && rp > 1) {
-          entry.ping = rp;
-          if (!relayInfo.empty()) {
-            entry.relay = QString::fromStdString(relayInfo);
+        // The host's view of our connection to it.
+        const telemetry::Member *mine = reported(myId.ConvertToUint64());
+        if (mine && mine->pingMs > 1) {
+          entry.ping = mine->pingMs;
+          const QString label = transportLabel(mine->transport);
+          if (!label.isEmpty()) {
+            entry.relay = label;
           }
         } else {
           const int fallbackPing =
@@ -2366,39 +2599,51 @@ void Backend::updateMembersList() {
           entry.ping = -1;
         }
       } else if (!isHost()) {
-        int rp = -1;
-        std::string relayInfo;
-        if (roomManager_ &&
-            roomManager_->getRemotePing(memberId, rp, relayInfo) && rp >= 0) {
-          entry.ping = rp;
-          entry.relay = QString::fromStdString(relayInfo);
+        if (const telemetry::Member *member = reported(memberValue)) {
+          if (member->pingMs >= 0) {
+            entry.ping = member->pingMs;
+          }
+          const QString label = transportLabel(member->transport);
+          if (!label.isEmpty()) {
+            entry.relay = label;
+          }
         }
       } else if (isHost()) {
         std::lock_guard<std::mutex> lock(steamManager_->getConnectionsMutex());
         for (const auto &conn : steamManager_->getConnections()) {
           SteamNetConnectionRealTimeStatus_t status{};
-          if (steamManager_->getInterface()->GetConnectionRealTimeStatus(
-                  conn, &status, 0, nullptr) != k_EResultOK ||
+          if (steamManager_->getTransport()->getConnectionRealTimeStatus(
+                  conn, &status) != k_EResultOK ||
               status.m_eState != k_ESteamNetworkingConnectionState_Connected) {
             continue; // Transport not ready; skip to avoid ICE asserts.
           }
 
           SteamNetConnectionInfo_t info;
-          if (steamManager_->getInterface()->GetConnectionInfo(conn, &info) &&
+          if (steamManager_->getTransport()->getConnectionInfo(conn, &info) &&
               info.m_identityRemote.GetSteamID() == memberId) {
             entry.ping = steamManager_->getConnectionPing(conn);
             entry.relay = QString::fromStdString(
                 steamManager_->getConnectionRelayInfo(conn));
-            if (entry.ping >= 0) {
-              pingBroadcast.emplace_back(memberValue, entry.ping,
-                                         entry.relay.toStdString());
-            }
+            report = telemetryMember(memberValue, status, info);
+            legacyPings.emplace_back(memberValue, entry.ping,
+                                     entry.relay.toStdString());
             break;
           }
         }
       }
     }
 
+    if (!entry.isSelf) {
+      applyTraffic(entry, memberValue);
+      if (report.steamId != 0) {
+        addReport(report, entry);
+      } else if (const telemetry::Member *member = reported(memberValue);
+                 member && entry.txRate < 0) {
+        // No direct link to this member; show what the host moves for it.
+        entry.txRate = static_cast<qint64>(member->txRate);
+        entry.rxRate = static_cast<qint64>(member->rxRate);
+      }
+    }
     entries.push_back(std::move(entry));
   }
 
@@ -2406,14 +2651,14 @@ void Backend::updateMembersList() {
     std::lock_guard<std::mutex> lock(steamManager_->getConnectionsMutex());
     for (const auto &conn : steamManager_->getConnections()) {
       SteamNetConnectionRealTimeStatus_t status{};
-      if (steamManager_->getInterface()->GetConnectionRealTimeStatus(
-              conn, &status, 0, nullptr) != k_EResultOK ||
+      if (steamManager_->getTransport()->getConnectionRealTimeStatus(
+              conn, &status) != k_EResultOK ||
           status.m_eState != k_ESteamNetworkingConnectionState_Connected) {
         continue; // Still negotiating; skip to avoid noisy asserts.
       }
 
       SteamNetConnectionInfo_t info;
-      if (!steamManager_->getInterface()->GetConnectionInfo(conn, &info)) {
+      if (!steamManager_->getTransport()->getConnectionInfo(conn, &info)) {
         continue;
       }
       CSteamID remoteId = info.m_identityRemote.GetSteamID();
@@ -2439,19 +2684,23 @@ void Backend::updateMembersList() {
       const std::string relayInfo = steamManager_->getConnectionRelayInfo(conn);
       entry.relay =
           relayInfo.empty() ? tr("P2P") : QString::fromStdString(relayInfo);
-      if (entry.ping >= 0) {
-        pingBroadcast.emplace_back(remoteValue, entry.ping, relayInfo);
-      }
+      applyTraffic(entry, remoteValue);
+      addReport(telemetryMember(remoteValue, status, info), entry);
+      legacyPings.emplace_back(remoteValue, entry.ping, relayInfo);
 
       entries.push_back(std::move(entry));
     }
   }
 
-  if (isHost() && roomManager_) {
+  if (isHost() && steamManager_->getMessageHandler()) {
     const auto now = std::chrono::steady_clock::now();
     if (lastPingBroadcast_.time_since_epoch().count() == 0 ||
         now - lastPingBroadcast_ > std::chrono::seconds(2)) {
-      roomManager_->broadcastPings(pingBroadcast);
+      auto *handler = steamManager_->getMessageHandler();
+      handler->broadcastTelemetry(std::move(telemetryReport));
+      if (handler->legacyTelemetryPeers() > 0 && roomManager_) {
+        roomManager_->broadcastLegacyPings(legacyPings);
+      }
       lastPingBroadcast_ = now;
     }
   }
@@ -2497,6 +2746,7 @@ void Backend::refreshHostId() {
   if (next != hostSteamId_) {
     hostSteamId_ = next;
     emit hostSteamIdChanged();
+    updateMembersList();
   }
 }
 
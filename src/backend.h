@@ -13,6 +13,7 @@
 #include <QPointer>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <QSaveFile>
 
 #include "friends_model.h"
@@ -20,12 +21,15 @@
 #include "lobbies_model.h"
 #include "members_model.h"
 #include "steam_room_manager.h"
+#include "steam_utils.h"
 #include "sound_notifier.h"
 
+class AvatarCache;
 class SteamNetworkingManager;
 class TCPServer;
 class SteamVpnNetworkingManager;
 class SteamVpnBridge;
+class MetricsServer;
 class QWindow;
 
 class Backend : public QObject {
@@ -110,11 +114,13 @@ public:
   int tcpClients() const;
   int localPort() const { return localPort_; }
   int localBindPort() const { return localBindPort_; }
-  QVariantList friends() const { return friends_; }
+  QVariantList friends() const { return friendsModel_.toVariantList(); }
   FriendsModel *friendsModel() { return &friendsModel_; }
   LobbiesModel *lobbiesModel() { return &lobbiesModel_; }
   MembersModel *membersModel() { return &membersModel_; }
   ChatModel *chatModel() { return &chatModel_; }
+  // Backs the "avatar" image provider the models' avatar URLs point at.
+  std::shared_ptr<AvatarCache> avatarCache() const { return avatarCache_; }
   bool chatReminderEnabled() const { return chatReminderEnabled_; }
   int relayPing() const { return relayPingMs_; }
   QVariantList relayPops() const { return relayPops_; }
@@ -200,7 +206,21 @@ private:
   void tick();
   void updateStatus();
   void updateMembersList();
+  void updateMembersModel();
+  void sampleTraffic();
+  void applyTraffic(MembersModel::Entry &entry, uint64_t steamId) const;
   void updateFriendsList();
+  FriendsModel::Entry friendEntry(const SteamUtils::FriendInfo &info) const;
+  void applyFriendUpdates();
+  void resyncFriendsIfStale();
+  // GUI thread time spent keeping a model current, logged once a minute.
+  struct GuiTime {
+    std::chrono::steady_clock::duration spent{};
+    int updates = 0;
+    std::chrono::steady_clock::time_point since;
+  };
+  void recordGuiTime(GuiTime &stats, const char *tag, const char *noun,
+                     int items, std::chrono::steady_clock::time_point started);
   void
   updateLobbiesList(const std::vector<SteamRoomManager::LobbyInfo> &lobbies);
   QString avatarForSteamId(const CSteamID &memberId);
@@ -251,6 +271,7 @@ private:
   std::unique_ptr<SteamVpnBridge> vpnBridge_;
   std::unique_ptr<SteamRoomManager> roomManager_;
   std::unique_ptr<TCPServer> server_;
+  std::unique_ptr<MetricsServer> metricsServer_;
   boost::asio::io_context ioContext_;
   std::unique_ptr<
       boost::asio::executor_work_guard<boost::asio::io_context::executor_type>>
@@ -261,6 +282,13 @@ private:
   QTimer slowTimer_;
   QTimer cooldownTimer_;
   QTimer friendsRefreshResetTimer_;
+  // Persona and rich presence changes waiting to reach friendsModel_.
+  QTimer friendsUpdateTimer_;
+  std::unordered_set<uint64_t> dirtyFriends_;
+  std::chrono::steady_clock::time_point lastFriendsResync_;
+  GuiTime friendsGuiTime_;
+  std::chrono::steady_clock::time_point lastMembersUpdate_;
+  GuiTime membersGuiTime_;
 #ifdef Q_OS_MACOS
   bool tunHelperInstallAttempted_ = false;
 #endif
@@ -276,7 +304,6 @@ private:
   int localBindPort_;
   int lastTcpClients_;
   int lastMemberLogCount_;
-  QVariantList friends_;
   FriendsModel friendsModel_;
   LobbiesModel lobbiesModel_;
   MembersModel membersModel_;
@@ -285,6 +312,7 @@ private:
   QPointer<QWindow> mainWindow_;
   QString friendFilter_;
   QString selfSteamId_;
+  std::shared_ptr<AvatarCache> avatarCache_;
   std::unordered_map<uint64_t, QString> memberAvatars_;
   std::unordered_map<uint64_t, int> inviteCooldowns_;
   int inviteCooldownSeconds_ = 0;
@@ -298,6 +326,15 @@ private:
   bool lobbyRefreshing_ = false;
   std::chrono::steady_clock::time_point lastPingBroadcast_;
   std::chrono::steady_clock::time_point lastRelayPingSample_;
+  struct PeerTraffic {
+    uint64_t txBytes = 0;
+    uint64_t rxBytes = 0;
+    qint64 txRate = -1;
+    qint64 rxRate = -1;
+    qint64 drops = 0;
+  };
+  std::unordered_map<uint64_t, PeerTraffic> peerTraffic_;
+  std::chrono::steady_clock::time_point lastTrafficSample_;
   ConnectionMode connectionMode_ = ConnectionMode::Tun;
   bool vpnHosting_ = false;
   bool vpnConnected_ = false;
@@ -1,14 +1,17 @@
 #include "chat_model.h"
 
+#include <algorithm>
 #include <cstdlib>
 
-ChatModel::ChatModel(QObject *parent) : QAbstractListModel(parent) {}
+ChatModel::ChatModel(QObject *parent)
+    : QAbstractListModel(parent),
+      ring_(static_cast<std::size_t>(maxMessages_)) {}
 
 int ChatModel::rowCount(const QModelIndex &parent) const {
   if (parent.isValid()) {
     return 0;
   }
-  return static_cast<int>(entries_.size());
+  return static_cast<int>(size_);
 }
 
 QVariant ChatModel::data(const QModelIndex &index, int role) const {
@@ -16,10 +19,10 @@ QVariant ChatModel::data(const QModelIndex &index, int role) const {
     return {};
   }
   const auto row = static_cast<size_t>(index.row());
-  if (row >= entries_.size()) {
+  if (row >= size_) {
     return {};
   }
-  const auto &entry = entries_[row];
+  const auto &entry = at(row);
   switch (role) {
   case SteamIdRole:
     return entry.steamId;
@@ -34,7 +37,7 @@ QVariant ChatModel::data(const QModelIndex &index, int role) const {
   case TimestampRole:
     return entry.timestamp;
   case IsPinnedRole:
-    return entry.pinned;
+    return pinnedSeq_.has_value() && *pinnedSeq_ == firstSeq_ + row;
   default:
     return {};
   }
@@ -48,36 +51,59 @@ QHash<int, QByteArray> ChatModel::roleNames() const {
 }
 
 void ChatModel::appendMessage(Entry entry) {
-  if (pinnedEntry_ && sameMessage(entry, *pinnedEntry_)) {
-    entry.pinned = true;
+  const std::size_t capacity = ring_.size();
+  const bool full = size_ == capacity;
+  bool pinEvicted = false;
+  if (full) {
+    beginRemoveRows(QModelIndex(), 0, 0);
+    pinEvicted = pinnedSeq_.has_value() && *pinnedSeq_ == firstSeq_;
+    ring_[head_] = Entry{};
+    head_ = (head_ + 1) % capacity;
+    --size_;
+    ++firstSeq_;
+    endRemoveRows();
+    if (pinEvicted) {
+      pinnedSeq_.reset();
+    }
   }
-  const int insertRow = static_cast<int>(entries_.size());
+
+  const int insertRow = static_cast<int>(size_);
   beginInsertRows(QModelIndex(), insertRow, insertRow);
-  entries_.push_back(std::move(entry));
+  Entry &slot = at(size_);
+  slot = std::move(entry);
+  slot.pinned = false;
+  ++size_;
   endInsertRows();
-  emit countChanged();
-
-  const int overflow = static_cast<int>(entries_.size()) - maxMessages_;
-  if (overflow > 0) {
-    beginRemoveRows(QModelIndex(), 0, overflow - 1);
-    entries_.erase(entries_.begin(), entries_.begin() + overflow);
-    endRemoveRows();
+  if (!full) {
     emit countChanged();
   }
-  updatePinnedFlags();
+
+  if (pinEvicted) {
+    // Rare: the message showing the pin scrolled out, so look for another.
+    recomputePinned();
+    return;
+  }
+  const qint64 distance = pinDistance(slot);
+  if (distance >= 0 && (!pinnedSeq_ || distance < pinnedDistance_)) {
+    movePin(firstSeq_ + size_ - 1, distance);
+  }
 }
 
 void ChatModel::clear() {
   const bool hadPinned = pinnedEntry_.has_value();
   pinnedEntry_.reset();
-  if (entries_.empty()) {
+  pinnedSeq_.reset();
+  if (size_ == 0) {
     if (hadPinned) {
       emit pinnedChanged();
     }
     return;
   }
   beginResetModel();
-  entries_.clear();
+  std::fill(ring_.begin(), ring_.end(), Entry{});
+  firstSeq_ += size_;
+  head_ = 0;
+  size_ = 0;
   endResetModel();
   emit countChanged();
   if (hadPinned) {
@@ -91,7 +117,7 @@ void ChatModel::setPinnedMessage(const Entry &entry) {
   const bool changed =
       !pinnedEntry_.has_value() || !sameMessage(*pinnedEntry_, pinned);
   pinnedEntry_ = std::move(pinned);
-  updatePinnedFlags();
+  recomputePinned();
   if (changed) {
     emit pinnedChanged();
   }
@@ -102,7 +128,7 @@ void ChatModel::clearPinnedMessage() {
     return;
   }
   pinnedEntry_.reset();
-  updatePinnedFlags();
+  movePin(std::nullopt, 0);
   emit pinnedChanged();
 }
 
@@ -121,70 +147,55 @@ QVariantMap ChatModel::pinnedMessage() const {
   return map;
 }
 
-std::optional<int> ChatModel::findPinnedEntryIndex() const {
-  if (!pinnedEntry_ || entries_.empty()) {
-    return std::nullopt;
+// How well a message matches the pinned one: -1 for a different message,
+// 0 when either lacks a timestamp, else 1 + the gap in milliseconds. The
+// closest match shows the pin; on ties the older message keeps it.
+qint64 ChatModel::pinDistance(const Entry &entry) const {
+  if (!pinnedEntry_ || entry.steamId != pinnedEntry_->steamId ||
+      entry.message != pinnedEntry_->message) {
+    return -1;
   }
+  if (!entry.timestamp.isValid() || !pinnedEntry_->timestamp.isValid()) {
+    return 0;
+  }
+  return std::llabs(pinnedEntry_->timestamp.msecsTo(entry.timestamp)) + 1;
+}
 
-  const Entry &pinned = *pinnedEntry_;
-  std::optional<int> bestIndex;
-  qint64 bestDelta = 0;
-
-  for (size_t i = 0; i < entries_.size(); ++i) {
-    const Entry &entry = entries_[i];
-    if (entry.steamId != pinned.steamId || entry.message != pinned.message) {
-      continue;
-    }
-    if (!entry.timestamp.isValid() || !pinned.timestamp.isValid()) {
-      return static_cast<int>(i);
-    }
-    const qint64 delta =
-        std::llabs(pinned.timestamp.msecsTo(entry.timestamp));
-    if (!bestIndex || delta < bestDelta) {
-      bestDelta = delta;
-      bestIndex = static_cast<int>(i);
+void ChatModel::recomputePinned() {
+  std::optional<uint64_t> best;
+  qint64 bestDistance = 0;
+  for (std::size_t row = 0; row < size_; ++row) {
+    const qint64 distance = pinDistance(at(row));
+    if (distance >= 0 && (!best || distance < bestDistance)) {
+      best = firstSeq_ + row;
+      bestDistance = distance;
     }
   }
-
-  return bestIndex;
+  movePin(best, bestDistance);
 }
 
-void ChatModel::updatePinnedFlags() {
-  if (entries_.empty()) {
+// Moves the pin flag, touching only the rows that gain or lose it.
+void ChatModel::movePin(std::optional<uint64_t> seq, qint64 distance) {
+  const std::optional<uint64_t> previous = pinnedSeq_;
+  pinnedSeq_ = seq;
+  pinnedDistance_ = distance;
+  if (previous == seq) {
     return;
   }
-  const std::optional<int> pinnedRow = findPinnedEntryIndex();
-  std::vector<int> changedRows;
-  changedRows.reserve(entries_.size());
-  for (size_t i = 0; i < entries_.size(); ++i) {
-    bool shouldPin =
-        pinnedRow.has_value() && static_cast<int>(i) == pinnedRow.value();
-    if (entries_[i].pinned != shouldPin) {
-      entries_[i].pinned = shouldPin;
-      changedRows.push_back(static_cast<int>(i));
-    }
+  if (previous) {
+    emitPinnedRow(*previous);
   }
-  if (changedRows.empty()) {
-    return;
+  if (seq) {
+    emitPinnedRow(*seq);
   }
+}
 
-  // Coalesce contiguous ranges for efficiency
-  int start = changedRows.front();
-  int end = changedRows.front();
-  for (size_t idx = 1; idx < changedRows.size(); ++idx) {
-    const int row = changedRows[idx];
-    if (row == end + 1) {
-      end = row;
-      continue;
-    }
-    const QModelIndex top = index(start, 0);
-    const QModelIndex bottom = index(end, 0);
-    emit dataChanged(top, bottom, {IsPinnedRole});
-    start = end = row;
-  }
-  const QModelIndex top = index(start, 0);
-  const QModelIndex bottom = index(end, 0);
-  emit dataChanged(top, bottom, {IsPinnedRole});
+void ChatModel::emitPinnedRow(uint64_t seq) {
+  if (seq < firstSeq_ || seq - firstSeq_ >= size_) {
+    return;
+  }
+  const int row = static_cast<int>(seq - firstSeq_);
+  emit dataChanged(index(row, 0), index(row, 0), {IsPinnedRole});
 }
 
 bool ChatModel::sameMessage(const Entry &a, const Entry &b) {
@@ -4,6 +4,7 @@
 #include <QDateTime>
 #include <QString>
 #include <QVariantMap>
+#include <cstdint>
 #include <optional>
 #include <vector>
 
@@ -46,7 +47,7 @@ public:
   void setPinnedMessage(const Entry &entry);
   void clearPinnedMessage();
 
-  int count() const { return static_cast<int>(entries_.size()); }
+  int count() const { return static_cast<int>(size_); }
   bool hasPinned() const { return pinnedEntry_.has_value(); }
   QVariantMap pinnedMessage() const;
 
@@ -55,12 +56,28 @@ signals:
   void pinnedChanged();
 
 private:
-  std::optional<int> findPinnedEntryIndex() const;
-  void updatePinnedFlags();
+  Entry &at(std::size_t row) { return ring_[(head_ + row) % ring_.size()]; }
+  const Entry &at(std::size_t row) const {
+    return ring_[(head_ + row) % ring_.size()];
+  }
+  qint64 pinDistance(const Entry &entry) const;
+  void recomputePinned();
+  void movePin(std::optional<uint64_t> seq, qint64 distance);
+  void emitPinnedRow(uint64_t seq);
 
   static bool sameMessage(const Entry &a, const Entry &b);
 
-  std::vector<Entry> entries_;
-  std::optional<Entry> pinnedEntry_;
+  // The last maxMessages_ messages in a circular buffer. Every message gets
+  // a sequence number; row r holds firstSeq_ + r at ring_[(head_ + r) % n],
+  // so trimming the oldest message only advances head_.
   int maxMessages_ = 200;
+  std::vector<Entry> ring_;
+  std::size_t head_ = 0;
+  std::size_t size_ = 0;
+  uint64_t firstSeq_ = 0;
+  std::optional<Entry> pinnedEntry_;
+  // The loaded message that shows the pin and how close it is to
+  // pinnedEntry_ (see pinDistance); empty when none is loaded.
+  std::optional<uint64_t> pinnedSeq_;
+  qint64 pinnedDistance_ = 0;
 };
@@ -1,4 +1,5 @@
 #include "friends_model.h"
+#include <QVariantMap>
 
 FriendsModel::FriendsModel(QObject *parent) : QAbstractListModel(parent) {}
 
@@ -24,7 +25,7 @@ QVariant FriendsModel::data(const QModelIndex &index, int role) const {
   case DisplayNameRole:
     return entry.displayName;
   case AvatarRole:
-    return entry.avatarData;
+    return entry.avatar;
   case OnlineRole:
     return entry.online;
   case StatusRole:
@@ -67,6 +68,135 @@ void FriendsModel::setFriends(std::vector<Entry> list) {
   }
 }
 
+bool FriendsModel::updateFriend(const Entry &entry) {
+  auto it = std::find_if(
+      entries_.begin(), entries_.end(),
+      [&entry](const Entry &e) { return e.steamId == entry.steamId; });
+  const bool added = it == entries_.end();
+  if (added) {
+    entries_.push_back(entry);
+  } else {
+    *it = entry;
+  }
+
+  const int row = filteredRow(entry.steamId);
+  if (!matchesFilter(entry.displayName)) {
+    if (row >= 0) {
+      beginRemoveRows(QModelIndex(), row, row);
+      filtered_.erase(filtered_.begin() + row);
+      endRemoveRows();
+    }
+  } else if (row < 0) {
+    const auto pos = std::upper_bound(
+        filtered_.begin(), filtered_.end(), entry,
+        [this](const Entry &a, const Entry &b) { return lessThan(a, b); });
+    const int target = static_cast<int>(pos - filtered_.begin());
+    beginInsertRows(QModelIndex(), target, target);
+    filtered_.insert(pos, entry);
+    endInsertRows();
+  } else {
+    const Entry &old = filtered_[static_cast<size_t>(row)];
+    QVector<int> roles;
+    if (old.displayName != entry.displayName) {
+      roles.push_back(DisplayNameRole);
+    }
+    if (old.avatar != entry.avatar) {
+      roles.push_back(AvatarRole);
+    }
+    if (old.online != entry.online) {
+      roles.push_back(OnlineRole);
+    }
+    if (old.status != entry.status) {
+      roles.push_back(StatusRole);
+    }
+    if (old.inviteCooldown != entry.inviteCooldown) {
+      roles.push_back(InviteCooldownRole);
+    }
+    if (roles.isEmpty() && old.presenceRank == entry.presenceRank) {
+      return added;
+    }
+
+    // Where the entry belongs among the others, as an index once it is
+    // taken out of its current row.
+    const auto less = [this](const Entry &a, const Entry &b) {
+      return lessThan(a, b);
+    };
+    const auto rowIt = filtered_.begin() + row;
+    int target = static_cast<int>(
+        std::upper_bound(filtered_.begin(), rowIt, entry, less) -
+        filtered_.begin());
+    if (target == row) {
+      target = static_cast<int>(
+                   std::upper_bound(rowIt + 1, filtered_.end(), entry, less) -
+                   filtered_.begin()) -
+               1;
+    }
+    if (target != row) {
+      beginMoveRows(QModelIndex(), row, row, QModelIndex(),
+                    target > row ? target + 1 : target);
+      if (target > row) {
+        std::rotate(rowIt, rowIt + 1, filtered_.begin() + target + 1);
+      } else {
+        std::rotate(filtered_.begin() + target, rowIt, rowIt + 1);
+      }
+      endMoveRows();
+    }
+    filtered_[static_cast<size_t>(target)] = entry;
+    if (!roles.isEmpty()) {
+      emit dataChanged(index(target, 0), index(target, 0), roles);
+    }
+  }
+  if (added) {
+    emit countChanged();
+  }
+  return true;
+}
+
+bool FriendsModel::removeFriend(const QString &steamId) {
+  auto it = std::find_if(
+      entries_.begin(), entries_.end(),
+      [&steamId](const Entry &e) { return e.steamId == steamId; });
+  if (it == entries_.end()) {
+    return false;
+  }
+  entries_.erase(it);
+  const int row = filteredRow(steamId);
+  if (row >= 0) {
+    beginRemoveRows(QModelIndex(), row, row);
+    filtered_.erase(filtered_.begin() + row);
+    endRemoveRows();
+  }
+  emit countChanged();
+  return true;
+}
+
+QVariantList FriendsModel::toVariantList() const {
+  QVariantList list;
+  list.reserve(static_cast<int>(entries_.size()));
+  for (const auto &entry : entries_) {
+    QVariantMap map;
+    map.insert(QStringLiteral("id"), entry.steamId);
+    map.insert(QStringLiteral("name"), entry.displayName);
+    map.insert(QStringLiteral("status"), entry.status);
+    map.insert(QStringLiteral("online"), entry.online);
+    map.insert(QStringLiteral("cooldown"), entry.inviteCooldown);
+    if (!entry.avatar.isEmpty()) {
+      map.insert(QStringLiteral("avatar"), entry.avatar);
+    }
+    list.push_back(map);
+  }
+  return list;
+}
+
+int FriendsModel::filteredRow(const QString &steamId) const {
+  for (size_t i = 0; i < filtered_.size(); ++i) {
+    if (filtered_[i].steamId == steamId) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
 bool FriendsModel::setInviteCooldown(const QString &steamId, int seconds) {
   int changedRow = -1;
   for (auto &entry : entries_) {
@@ -124,20 +254,23 @@ FriendsModel::filterEntries(const std::vector<Entry> &source) const {
       result.push_back(entry);
     }
   }
-  std::stable_sort(result.begin(), result.end(),
-                   [this](const Entry &a, const Entry &b) {
-                     if (a.presenceRank != b.presenceRank) {
-                       return a.presenceRank < b.presenceRank;
-                     }
-                     const int sa = scoreFor(a.displayName);
-                     const int sb = scoreFor(b.displayName);
-                     if (sa != sb)
-                       return sa < sb;
-                     return a.displayName.toLower() < b.displayName.toLower();
-                   });
+  std::stable_sort(
+      result.begin(), result.end(),
+      [this](const Entry &a, const Entry &b) { return lessThan(a, b); });
   return result;
 }
 
+bool FriendsModel::lessThan(const Entry &a, const Entry &b) const {
+  if (a.presenceRank != b.presenceRank) {
+    return a.presenceRank < b.presenceRank;
+  }
+  const int sa = scoreFor(a.displayName);
+  const int sb = scoreFor(b.displayName);
+  if (sa != sb)
+    return sa < sb;
+  return a.displayName.toLower() < b.displayName.toLower();
+}
+
 bool FriendsModel::matchesFilter(const QString &name) const {
   if (filterLower_.isEmpty()) {
     return true;
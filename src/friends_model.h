@@ -2,6 +2,7 @@
 
 #include <QAbstractListModel>
 #include <QString>
+#include <QVariantList>
 #include <algorithm>
 #include <vector>
 
@@ -22,7 +23,7 @@ public:
   struct Entry {
     QString steamId;
     QString displayName;
-    QString avatarData;
+    QString avatar; // image://avatar URL
     bool online = false;
     QString status;
     int presenceRank = 0;
@@ -36,7 +37,13 @@ public:
                 int role = Qt::DisplayRole) const override;
   QHash<int, QByteArray> roleNames() const override;
 
+  // Full resync; resets the view unless only row contents changed.
   void setFriends(std::vector<Entry> list);
+  // Adds or updates one friend with row inserts, moves and dataChanged for
+  // just the roles that differ; false when nothing changed.
+  bool updateFriend(const Entry &entry);
+  bool removeFriend(const QString &steamId);
+  QVariantList toVariantList() const;
   bool setInviteCooldown(const QString &steamId, int seconds);
   int count() const { return static_cast<int>(entries_.size()); }
   QString filter() const { return filter_; }
@@ -48,6 +55,8 @@ signals:
 
 private:
   std::vector<Entry> filterEntries(const std::vector<Entry> &source) const;
+  bool lessThan(const Entry &a, const Entry &b) const;
+  int filteredRow(const QString &steamId) const;
   bool matchesFilter(const QString &name) const;
   int scoreFor(const QString &name) const;
 
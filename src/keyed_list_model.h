@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QSet>
+#include <QVector>
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A list model whose rows are brought to a new list by key, so views keep
+// their delegates and scroll position while entries come, go and reorder.
+class KeyedListModel : public QAbstractListModel {
+public:
+  using QAbstractListModel::QAbstractListModel;
+
+protected:
+  // Turns rows into next with row-level removes, inserts and moves.
+  // key(entry) identifies an entry; changedRoles(before, after) names the
+  // roles a dataChanged for a kept row carries, none meaning no signal.
+  template <class Entry, class Key, class ChangedRoles>
+  void applyKeyedRows(std::vector<Entry> &rows, std::vector<Entry> next,
+                      Key key, ChangedRoles changedRoles) {
+    QSet<std::decay_t<decltype(key(next.front()))>> wanted;
+    wanted.reserve(static_cast<qsizetype>(next.size()));
+    for (const auto &entry : next) {
+      wanted.insert(key(entry));
+    }
+    auto stays = [&](int row) {
+      return wanted.contains(key(rows[static_cast<std::size_t>(row)]));
+    };
+
+    // Drop entries that are gone, one contiguous run of rows at a time.
+    for (int row = static_cast<int>(rows.size()) - 1; row >= 0;) {
+      if (stays(row)) {
+        --row;
+        continue;
+      }
+      int first = row;
+      while (first > 0 && !stays(first - 1)) {
+        --first;
+      }
+      beginRemoveRows(QModelIndex(), first, row);
+      rows.erase(rows.begin() + first, rows.begin() + row + 1);
+      endRemoveRows();
+      row = first - 1;
+    }
+
+    // Walk the new order: entries already in place only get dataChanged,
+    // ones further down move up, new ones are inserted.
+    for (std::size_t i = 0; i < next.size(); ++i) {
+      Entry &entry = next[i];
+      const int row = static_cast<int>(i);
+      const auto found = std::find_if(
+          rows.begin() + static_cast<std::ptrdiff_t>(i), rows.end(),
+          [&](const Entry &e) { return key(e) == key(entry); });
+      if (found == rows.end()) {
+        beginInsertRows(QModelIndex(), row, row);
+        rows.insert(rows.begin() + row, std::move(entry));
+        endInsertRows();
+        continue;
+      }
+      const int from = static_cast<int>(found - rows.begin());
+      if (from != row) {
+        beginMoveRows(QModelIndex(), from, from, QModelIndex(), row);
+        std::rotate(rows.begin() + row, found, found + 1);
+        endMoveRows();
+      }
+      const QVector<int> roles = changedRoles(rows[i], entry);
+      if (!roles.isEmpty()) {
+        rows[i] = std::move(entry);
+        emit dataChanged(index(row, 0), index(row, 0), roles);
+      }
+    }
+
+    // Only left over when a key was listed twice.
+    if (rows.size() > next.size()) {
+      beginRemoveRows(QModelIndex(), static_cast<int>(next.size()),
+                      static_cast<int>(rows.size()) - 1);
+      rows.resize(next.size());
+      endRemoveRows();
+    }
+  }
+};
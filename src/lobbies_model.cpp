@@ -1,6 +1,15 @@
 #include "lobbies_model.h"
 
-LobbiesModel::LobbiesModel(QObject *parent) : QAbstractListModel(parent) {}
+#include <QMetaObject>
+#include <utility>
+
+LobbiesModel::LobbiesModel(QObject *parent)
+    : KeyedListModel(parent),
+      snapshot_(std::make_shared<const std::vector<Item>>()) {
+  worker_.setMaxThreadCount(1);
+}
+
+LobbiesModel::~LobbiesModel() { worker_.waitForDone(); }
 
 int LobbiesModel::rowCount(const QModelIndex &parent) const {
   if (parent.isValid()) {
@@ -41,23 +50,28 @@ QHash<int, QByteArray> LobbiesModel::roleNames() const {
 }
 
 void LobbiesModel::setLobbies(std::vector<Entry> list) {
-  applyReset(std::move(list));
+  std::vector<Item> items;
+  items.reserve(list.size());
+  for (auto &entry : list) {
+    items.push_back(makeItem(std::move(entry)));
+  }
+  publish(std::move(items));
 }
 
 bool LobbiesModel::removeByHostId(const QString &hostId) {
   if (hostId.isEmpty()) {
     return false;
   }
-  std::vector<Entry> next = entries_;
+  std::vector<Item> next = *snapshot_;
   next.erase(std::remove_if(next.begin(), next.end(),
-                            [&hostId](const Entry &entry) {
-                              return entry.hostId == hostId;
+                            [&hostId](const Item &item) {
+                              return item.entry.hostId == hostId;
                             }),
              next.end());
-  if (next.size() == entries_.size()) {
+  if (next.size() == snapshot_->size()) {
     return false;
   }
-  applyReset(std::move(next));
+  publish(std::move(next));
   return true;
 }
 
@@ -65,48 +79,42 @@ bool LobbiesModel::setMemberCount(const QString &lobbyId, int count) {
   if (count < 0) {
     return false;
   }
-  bool any = false;
-  for (auto &entry : entries_) {
-    if (entry.lobbyId == lobbyId && entry.memberCount != count) {
-      entry.memberCount = count;
-      any = true;
-    }
+  const auto stale = [&](const Item &item) {
+    return item.entry.lobbyId == lobbyId && item.entry.memberCount != count;
+  };
+  if (std::none_of(snapshot_->begin(), snapshot_->end(), stale)) {
+    return false;
   }
-  if (any) {
-    filtered_ = filterEntries(entries_);
-    if (!filtered_.empty()) {
-      emit dataChanged(index(0, 0),
-                       index(static_cast<int>(filtered_.size()) - 1, 0),
-                       {MemberCountRole});
+  std::vector<Item> next = *snapshot_;
+  for (auto &item : next) {
+    if (stale(item)) {
+      item.entry.memberCount = count;
     }
   }
-  return any;
+  publish(std::move(next));
+  return true;
 }
 
 bool LobbiesModel::adjustMemberCount(const QString &lobbyId, int delta) {
   if (delta == 0) {
     return false;
   }
-  bool any = false;
-  for (auto &entry : entries_) {
-    if (entry.lobbyId == lobbyId) {
-      const int next = std::max(0, entry.memberCount + delta);
-      if (next != entry.memberCount) {
-        entry.memberCount = next;
-        any = true;
-      }
-      break;
-    }
+  const auto it = std::find_if(snapshot_->begin(), snapshot_->end(),
+                               [&lobbyId](const Item &item) {
+                                 return item.entry.lobbyId == lobbyId;
+                               });
+  if (it == snapshot_->end()) {
+    return false;
   }
-  if (any) {
-    filtered_ = filterEntries(entries_);
-    if (!filtered_.empty()) {
-      emit dataChanged(index(0, 0),
-                       index(static_cast<int>(filtered_.size()) - 1, 0),
-                       {MemberCountRole});
-    }
+  const int count = std::max(0, it->entry.memberCount + delta);
+  if (count == it->entry.memberCount) {
+    return false;
   }
-  return any;
+  std::vector<Item> next = *snapshot_;
+  next[static_cast<std::size_t>(it - snapshot_->begin())].entry.memberCount =
+      count;
+  publish(std::move(next));
+  return true;
 }
 
 void LobbiesModel::setFilter(const QString &text) {
@@ -115,18 +123,8 @@ void LobbiesModel::setFilter(const QString &text) {
   }
   filter_ = text;
   filterLower_ = filter_.toLower();
-  auto next = filterEntries(entries_);
-  const bool sizeChanged = next.size() != filtered_.size();
-  filtered_ = std::move(next);
   emit filterChanged();
-  if (sizeChanged) {
-    beginResetModel();
-    endResetModel();
-    emit countChanged();
-  } else if (!filtered_.empty()) {
-    emit dataChanged(index(0, 0),
-                     index(static_cast<int>(filtered_.size()) - 1, 0));
-  }
+  schedule();
 }
 
 void LobbiesModel::setSortMode(int mode) {
@@ -137,63 +135,121 @@ void LobbiesModel::setSortMode(int mode) {
     mode = SortByMembers;
   }
   sortMode_ = mode;
-  filtered_ = filterEntries(entries_);
   emit sortModeChanged();
-  if (!filtered_.empty()) {
-    emit dataChanged(index(0, 0),
-                     index(static_cast<int>(filtered_.size()) - 1, 0));
+  schedule();
+}
+
+LobbiesModel::Item LobbiesModel::makeItem(Entry entry) {
+  Item item;
+  item.nameKey = entry.name.toLower();
+  item.hostKey = entry.hostName.toLower();
+  item.idKey = entry.lobbyId.toLower();
+  item.entry = std::move(entry);
+  return item;
+}
+
+void LobbiesModel::publish(std::vector<Item> items) {
+  snapshot_ = std::make_shared<const std::vector<Item>>(std::move(items));
+  schedule();
+}
+
+void LobbiesModel::schedule() {
+  ++generation_;
+  if (!passRunning_) {
+    startPass();
   }
 }
 
+// At most one pass runs at a time. Changes arriving meanwhile (a user typing
+// into the filter) only bump generation_, and the pass that finishes next
+// restarts with the latest state instead of queueing one per keystroke.
+void LobbiesModel::startPass() {
+  passRunning_ = true;
+  const uint64_t generation = generation_;
+  worker_.start([this, generation, snapshot = snapshot_,
+                 filterLower = filterLower_, sortMode = sortMode_]() {
+    std::vector<Entry> rows = filterSnapshot(snapshot, filterLower, sortMode);
+    QMetaObject::invokeMethod(
+        this,
+        [this, generation, rows = std::move(rows)]() mutable {
+          finishPass(generation, std::move(rows));
+        },
+        Qt::QueuedConnection);
+  });
+}
+
+void LobbiesModel::finishPass(uint64_t generation, std::vector<Entry> rows) {
+  passRunning_ = false;
+  if (generation != generation_) {
+    startPass();
+    return;
+  }
+  applyRows(std::move(rows));
+}
+
 std::vector<LobbiesModel::Entry>
-LobbiesModel::filterEntries(const std::vector<Entry> &source) const {
-  std::vector<Entry> result;
-  result.reserve(source.size());
-  for (const auto &entry : source) {
-    if (matchesFilter(entry)) {
-      result.push_back(entry);
+LobbiesModel::filterSnapshot(const Snapshot &snapshot,
+                             const QString &filterLower, int sortMode) {
+  std::vector<const Item *> matched;
+  matched.reserve(snapshot->size());
+  for (const auto &item : *snapshot) {
+    if (filterLower.isEmpty() || item.nameKey.contains(filterLower) ||
+        item.hostKey.contains(filterLower) ||
+        item.idKey.contains(filterLower)) {
+      matched.push_back(&item);
     }
   }
-  std::stable_sort(result.begin(), result.end(),
-                   [this](const Entry &a, const Entry &b) {
-                     if (sortMode_ == SortByName) {
-                       const int cmp =
-                           a.name.toLower().compare(b.name.toLower());
+  std::stable_sort(matched.begin(), matched.end(),
+                   [sortMode](const Item *a, const Item *b) {
+                     if (sortMode == SortByName) {
+                       const int cmp = a->nameKey.compare(b->nameKey);
                        if (cmp != 0)
                          return cmp < 0;
-                       return a.memberCount > b.memberCount;
+                       return a->entry.memberCount > b->entry.memberCount;
                      }
-                     if (a.memberCount != b.memberCount) {
-                       return a.memberCount > b.memberCount;
+                     if (a->entry.memberCount != b->entry.memberCount) {
+                       return a->entry.memberCount > b->entry.memberCount;
                      }
-                     return a.name.toLower() < b.name.toLower();
+                     return a->nameKey < b->nameKey;
                    });
-  return result;
+  std::vector<Entry> rows;
+  rows.reserve(matched.size());
+  for (const Item *item : matched) {
+    rows.push_back(item->entry);
+  }
+  return rows;
 }
 
-bool LobbiesModel::matchesFilter(const Entry &entry) const {
-  if (filterLower_.isEmpty()) {
-    return true;
-  }
-  const auto contains = [&](const QString &value) {
-    return value.toLower().contains(filterLower_);
-  };
-  return contains(entry.name) || contains(entry.hostName) ||
-         contains(entry.lobbyId);
-}
-
-void LobbiesModel::applyReset(std::vector<Entry> list) {
-  const bool sizeChanged = list.size() != entries_.size();
-  entries_ = std::move(list);
-  auto nextFiltered = filterEntries(entries_);
-  const bool viewChanged = nextFiltered.size() != filtered_.size();
-  filtered_ = std::move(nextFiltered);
-  if (sizeChanged || viewChanged) {
-    beginResetModel();
-    endResetModel();
+// Brings filtered_ to rows by lobby ID, so views keep their delegates and
+// scroll position while results come and go underneath.
+void LobbiesModel::applyRows(std::vector<Entry> rows) {
+  const std::size_t previousCount = filtered_.size();
+  applyKeyedRows(
+      filtered_, std::move(rows),
+      [](const Entry &entry) -> const QString & { return entry.lobbyId; },
+      &LobbiesModel::changedRoles);
+  if (filtered_.size() != previousCount) {
     emit countChanged();
-  } else if (!filtered_.empty()) {
-    emit dataChanged(index(0, 0),
-                     index(static_cast<int>(filtered_.size()) - 1, 0));
   }
 }
+
+QVector<int> LobbiesModel::changedRoles(const Entry &before,
+                                        const Entry &after) {
+  QVector<int> roles;
+  if (before.name != after.name) {
+    roles.push_back(NameRole);
+  }
+  if (before.hostName != after.hostName) {
+    roles.push_back(HostNameRole);
+  }
+  if (before.hostId != after.hostId) {
+    roles.push_back(HostIdRole);
+  }
+  if (before.memberCount != after.memberCount) {
+    roles.push_back(MemberCountRole);
+  }
+  if (before.ping != after.ping) {
+    roles.push_back(PingRole);
+  }
+  return roles;
+}
@@ -1,11 +1,15 @@
 #pragma once
 
-#include <QAbstractListModel>
+#include "keyed_list_model.h"
 #include <QString>
-#include <vector>
+#include <QThreadPool>
+#include <QVector>
 #include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
 
-class LobbiesModel : public QAbstractListModel {
+class LobbiesModel : public KeyedListModel {
   Q_OBJECT
   Q_PROPERTY(int count READ count NOTIFY countChanged)
   Q_PROPERTY(QString filter READ filter WRITE setFilter NOTIFY filterChanged)
@@ -34,12 +38,15 @@ public:
   };
 
   explicit LobbiesModel(QObject *parent = nullptr);
+  ~LobbiesModel() override;
 
   int rowCount(const QModelIndex &parent = QModelIndex()) const override;
   QVariant data(const QModelIndex &index,
                 int role = Qt::DisplayRole) const override;
   QHash<int, QByteArray> roleNames() const override;
 
+  // Filtering and sorting run on a worker thread; the visible rows follow
+  // once it is done, updated with row-level inserts, removes and moves.
   void setLobbies(std::vector<Entry> list);
   bool setMemberCount(const QString &lobbyId, int count);
   bool adjustMemberCount(const QString &lobbyId, int delta);
@@ -56,13 +63,34 @@ signals:
   void sortModeChanged();
 
 private:
-  std::vector<Entry> filterEntries(const std::vector<Entry> &source) const;
-  bool matchesFilter(const Entry &entry) const;
-  void applyReset(std::vector<Entry> list);
+  // Immutable once published, so a worker can read it while the GUI thread
+  // builds the next one.
+  struct Item {
+    Entry entry;
+    QString nameKey; // lowercase, for sorting and matching
+    QString hostKey;
+    QString idKey;
+  };
+  using Snapshot = std::shared_ptr<const std::vector<Item>>;
+
+  static Item makeItem(Entry entry);
+  static std::vector<Entry> filterSnapshot(const Snapshot &snapshot,
+                                           const QString &filterLower,
+                                           int sortMode);
+  static QVector<int> changedRoles(const Entry &before, const Entry &after);
+  void publish(std::vector<Item> items);
+  void schedule();
+  void startPass();
+  void finishPass(uint64_t generation, std::vector<Entry> rows);
+  void applyRows(std::vector<Entry> rows);
 
-  std::vector<Entry> entries_;
+  Snapshot snapshot_;
   std::vector<Entry> filtered_;
   QString filter_;
   QString filterLower_;
   int sortMode_ = SortByMembers;
+  // Bumped by every change; a pass started for an older one is redone.
+  uint64_t generation_ = 0;
+  bool passRunning_ = false;
+  QThreadPool worker_;
 };
@@ -1,3 +1,4 @@
+#include "avatar_image_provider.h"
 #include "backend.h"
 #include "chat_model.h"
 #include "lobbies_model.h"
@@ -43,6 +44,8 @@ int main(int argc, char *argv[]) {
 
   QQmlApplicationEngine engine;
   engine.rootContext()->setContextProperty(QStringLiteral("backend"), &backend);
+  engine.addImageProvider(QStringLiteral("avatar"),
+                          new AvatarImageProvider(backend.avatarCache()));
 
   QObject::connect(
       &engine, &QQmlApplicationEngine::objectCreationFailed, &app,
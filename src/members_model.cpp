@@ -1,6 +1,6 @@
 #include "members_model.h"
 
-MembersModel::MembersModel(QObject *parent) : QAbstractListModel(parent) {}
+MembersModel::MembersModel(QObject *parent) : KeyedListModel(parent) {}
 
 int MembersModel::rowCount(const QModelIndex &parent) const {
   if (parent.isValid()) {
@@ -34,6 +34,12 @@ QVariant MembersModel::data(const QModelIndex &index, int role) const {
     return entry.isFriend;
   case IsSelfRole:
     return entry.isSelf;
+  case TxRateRole:
+    return entry.txRate;
+  case RxRateRole:
+    return entry.rxRate;
+  case DropsRole:
+    return entry.drops;
   default:
     return {};
   }
@@ -49,40 +55,56 @@ QHash<int, QByteArray> MembersModel::roleNames() const {
   roles[RelayRole] = "relay";
   roles[IsFriendRole] = "isFriend";
   roles[IsSelfRole] = "isSelf";
+  roles[TxRateRole] = "txRate";
+  roles[RxRateRole] = "rxRate";
+  roles[DropsRole] = "drops";
   return roles;
 }
 
 void MembersModel::setMembers(std::vector<Entry> entries) {
-  if (entries.size() != entries_.size()) {
-    beginResetModel();
-    entries_ = std::move(entries);
-    endResetModel();
+  const std::size_t previousCount = entries_.size();
+  applyKeyedRows(
+      entries_, std::move(entries),
+      [](const Entry &entry) -> const QString & { return entry.steamId; },
+      &MembersModel::changedRoles);
+  if (entries_.size() != previousCount) {
     emit countChanged();
-    return;
   }
+}
 
-  bool changed = false;
-  for (std::size_t i = 0; i < entries.size(); ++i) {
-    if (entries[i].steamId != entries_[i].steamId ||
-        entries[i].displayName != entries_[i].displayName ||
-        entries[i].avatar != entries_[i].avatar ||
-        entries[i].ping != entries_[i].ping ||
-        entries[i].relay != entries_[i].relay ||
-        entries[i].isFriend != entries_[i].isFriend ||
-        entries[i].isSelf != entries_[i].isSelf ||
-        entries[i].ip != entries_[i].ip) {
-      changed = true;
-      break;
-    }
+QVector<int> MembersModel::changedRoles(const Entry &before,
+                                        const Entry &after) {
+  QVector<int> roles;
+  if (before.displayName != after.displayName) {
+    roles.push_back(DisplayNameRole);
+    roles.push_back(Qt::DisplayRole);
   }
-
-  if (!changed) {
-    return;
+  if (before.avatar != after.avatar) {
+    roles.push_back(AvatarRole);
   }
-
-  entries_ = std::move(entries);
-  if (!entries_.empty()) {
-    emit dataChanged(index(0, 0),
-                     index(static_cast<int>(entries_.size()) - 1, 0));
+  if (before.ping != after.ping) {
+    roles.push_back(PingRole);
+  }
+  if (before.relay != after.relay) {
+    roles.push_back(RelayRole);
+  }
+  if (before.isFriend != after.isFriend) {
+    roles.push_back(IsFriendRole);
+  }
+  if (before.isSelf != after.isSelf) {
+    roles.push_back(IsSelfRole);
   }
+  if (before.ip != after.ip) {
+    roles.push_back(IpRole);
+  }
+  if (before.txRate != after.txRate) {
+    roles.push_back(TxRateRole);
+  }
+  if (before.rxRate != after.rxRate) {
+    roles.push_back(RxRateRole);
+  }
+  if (before.drops != after.drops) {
+    roles.push_back(DropsRole);
+  }
+  return roles;
 }
@@ -1,10 +1,11 @@
 #pragma once
 
-#include <QAbstractListModel>
+#include "keyed_list_model.h"
 #include <QString>
+#include <QVector>
 #include <vector>
 
-class MembersModel : public QAbstractListModel {
+class MembersModel : public KeyedListModel {
   Q_OBJECT
   Q_PROPERTY(int count READ count NOTIFY countChanged)
 
@@ -17,7 +18,10 @@ public:
     RelayRole,
     IsFriendRole,
     IsSelfRole,
-    IpRole
+    IpRole,
+    TxRateRole,
+    RxRateRole,
+    DropsRole
   };
 
   struct Entry {
@@ -29,6 +33,9 @@ public:
     bool isFriend = false;
     bool isSelf = false;
     QString ip;
+    qint64 txRate = -1; // bytes/s, -1 when not sampled yet
+    qint64 rxRate = -1;
+    qint64 drops = 0;
   };
 
   explicit MembersModel(QObject *parent = nullptr);
@@ -38,6 +45,8 @@ public:
                 int role = Qt::DisplayRole) const override;
   QHash<int, QByteArray> roleNames() const override;
 
+  // Diffs against the current rows by steamId: rows are inserted, removed
+  // or moved as needed and dataChanged names only the roles that differ.
   void setMembers(std::vector<Entry> entries);
   int count() const { return static_cast<int>(entries_.size()); }
 
@@ -45,5 +54,7 @@ signals:
   void countChanged();
 
 private:
+  static QVector<int> changedRoles(const Entry &before, const Entry &after);
+
   std::vector<Entry> entries_;
 };
@@ -1,15 +1,25 @@
 #include "steam_message_handler.h"
+#include "../net/metrics.h"
+#include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <iostream>
 #include <isteamnetworkingsockets.h>
 #include <steam_api.h>
+#include <utility>
+
+namespace {
+constexpr std::chrono::milliseconds kRateUpdateInterval{20};
+// A client that has not advertised telemetry this long after its tunnel came
+// up is taken for an older build.
+constexpr std::chrono::seconds kTelemetryHelloWait{5};
+} // namespace
 
 SteamMessageHandler::SteamMessageHandler(
-    boost::asio::io_context &io_context, ISteamNetworkingSockets *interface,
+    boost::asio::io_context &io_context, Transport *transport,
     std::vector<HSteamNetConnection> &connections, std::mutex &connectionsMutex,
     bool &g_isHost, int &localPort)
-    : io_context_(io_context), m_pInterface_(interface),
+    : io_context_(io_context), transport_(transport),
       connections_(connections), connectionsMutex_(connectionsMutex),
       g_isHost_(g_isHost), localPort_(localPort), running_(false),
       currentPollInterval_(0) {}
@@ -35,11 +45,63 @@ void SteamMessageHandler::stop() {
 
 std::shared_ptr<MultiplexManager>
 SteamMessageHandler::getMultiplexManager(HSteamNetConnection conn) {
-  if (multiplexManagers_.find(conn) == multiplexManagers_.end()) {
-    multiplexManagers_[conn] = std::make_shared<MultiplexManager>(
-        m_pInterface_, conn, io_context_, g_isHost_, localPort_);
+  auto &manager = multiplexManagers_[conn];
+  if (!manager) {
+    manager = std::make_shared<MultiplexManager>(transport_, conn, io_context_,
+                                                 g_isHost_, localPort_);
+    manager->setTelemetryHandler([this](const uint8_t *data, size_t length) {
+      handleTelemetry(data, length);
+    });
+  }
+  return manager;
+}
+
+void SteamMessageHandler::broadcastTelemetry(telemetry::Snapshot members) {
+  boost::asio::post(io_context_, [this, members = std::move(members)]() {
+    std::vector<HSteamNetConnection> current;
+    {
+      std::lock_guard<std::mutex> lock(connectionsMutex_);
+      current = connections_;
+    }
+    for (auto it = telemetryEncoders_.begin();
+         it != telemetryEncoders_.end();) {
+      if (std::find(current.begin(), current.end(), it->first) ==
+          current.end()) {
+        it = telemetryEncoders_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    const auto now = std::chrono::steady_clock::now();
+    int legacyPeers = 0;
+    for (auto conn : current) {
+      // Frames build on each other, so a client only starts receiving them
+      // once it can take every one.
+      SteamNetConnectionRealTimeStatus_t status{};
+      if (transport_->getConnectionRealTimeStatus(conn, &status) !=
+              k_EResultOK ||
+          status.m_eState != k_ESteamNetworkingConnectionState_Connected) {
+        continue;
+      }
+      auto manager = getMultiplexManager(conn);
+      if (manager->peerTakesTelemetry()) {
+        manager->sendTelemetry(telemetryEncoders_[conn].encode(members));
+      } else if (now - manager->createdAt() >= kTelemetryHelloWait) {
+        ++legacyPeers;
+      }
+    }
+    legacyTelemetryPeers_.store(legacyPeers, std::memory_order_relaxed);
+  });
+}
+
+void SteamMessageHandler::handleTelemetry(const uint8_t *data,
+                                          size_t length) {
+  if (g_isHost_) {
+    return; // only the host reports on its connections
+  }
+  if (telemetryDecoder_.apply(data, length)) {
+    telemetryInbox_.publish(telemetryDecoder_.members());
   }
-  return multiplexManagers_[conn];
 }
 
 void SteamMessageHandler::startAsyncPoll() {
@@ -47,7 +109,7 @@ void SteamMessageHandler::startAsyncPoll() {
     return;
 
   // Poll networking callbacks
-  m_pInterface_->RunCallbacks();
+  transport_->runCallbacks();
 
   // Receive messages and check if any were received
   int totalMessages = 0;
@@ -59,20 +121,25 @@ void SteamMessageHandler::startAsyncPoll() {
   for (auto conn : currentConnections) {
     ISteamNetworkingMessage *pIncomingMsgs[256]; // larger batch for throughput
     int numMsgs =
-        m_pInterface_->ReceiveMessagesOnConnection(conn, pIncomingMsgs, 256);
+        transport_->receiveMessagesOnConnection(conn, pIncomingMsgs, 256);
     totalMessages += numMsgs;
     for (int i = 0; i < numMsgs; ++i) {
       ISteamNetworkingMessage *pIncomingMsg = pIncomingMsgs[i];
       const char *data = (const char *)pIncomingMsg->m_pData;
       size_t size = pIncomingMsg->m_cbSize;
       // Handle tunnel packets with multiplexing
-      if (multiplexManagers_.find(conn) == multiplexManagers_.end()) {
-        multiplexManagers_[conn] = std::make_shared<MultiplexManager>(
-            m_pInterface_, conn, io_context_, g_isHost_, localPort_);
-      }
-      multiplexManagers_[conn]->handleTunnelPacket(data, size);
+      getMultiplexManager(conn)->handleTunnelPacket(data, size);
       pIncomingMsg->Release();
     }
+    if (!g_isHost_) {
+      getMultiplexManager(conn)->advertiseTelemetry();
+    }
+  }
+  updateSendRates(currentConnections);
+  if (currentConnections.empty() && !telemetryDecoder_.members().empty()) {
+    // Left the host; its figures no longer describe anyone.
+    telemetryDecoder_.reset();
+    telemetryInbox_.publish({});
   }
 
   // Adaptive polling: if messages received, poll immediately; otherwise
@@ -86,9 +153,44 @@ void SteamMessageHandler::startAsyncPoll() {
 
   // Schedule next poll
   timer_->expires_after(std::chrono::milliseconds(currentPollInterval_));
+  pollDeadline_ = timer_->expiry();
   timer_->async_wait([this](const boost::system::error_code &error) {
     if (!error && running_) {
+      metrics::registry().pollLag.recordSince(pollDeadline_);
       startAsyncPoll();
     }
   });
 }
+
+void SteamMessageHandler::updateSendRates(
+    const std::vector<HSteamNetConnection> &connections) {
+  const auto now = std::chrono::steady_clock::now();
+  if (now < nextRateUpdate_) {
+    return;
+  }
+  nextRateUpdate_ = now + kRateUpdateInterval;
+
+  for (auto it = rateControllers_.begin(); it != rateControllers_.end();) {
+    if (std::find(connections.begin(), connections.end(), it->first) ==
+        connections.end()) {
+      it = rateControllers_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (auto conn : connections) {
+    auto it = rateControllers_.find(conn);
+    if (it == rateControllers_.end()) {
+      it = rateControllers_.emplace(conn, RateController()).first;
+      transport_->setConnectionSendRate(conn, it->second.rate());
+    }
+    SteamNetConnectionRealTimeStatus_t status{};
+    if (transport_->getConnectionRealTimeStatus(conn, &status) !=
+        k_EResultOK) {
+      continue;
+    }
+    if (it->second.update(status, now)) {
+      transport_->setConnectionSendRate(conn, it->second.rate());
+    }
+  }
+}
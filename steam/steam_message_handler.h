@@ -2,8 +2,12 @@
 #define STEAM_MESSAGE_HANDLER_H
 
 #include "../net/multiplex_manager.h"
+#include "../net/rate_controller.h"
 #include "../net/tcp_server.h"
+#include "../net/telemetry.h"
+#include <atomic>
 #include <boost/asio.hpp>
+#include <chrono>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -14,7 +18,7 @@
 class SteamMessageHandler {
 public:
   SteamMessageHandler(boost::asio::io_context &io_context,
-                      ISteamNetworkingSockets *interface,
+                      Transport *transport,
                       std::vector<HSteamNetConnection> &connections,
                       std::mutex &connectionsMutex, bool &g_isHost,
                       int &localPort);
@@ -26,11 +30,27 @@ public:
   std::shared_ptr<MultiplexManager>
   getMultiplexManager(HSteamNetConnection conn);
 
+  // Host: sends each connected client that advertised telemetry the next
+  // frame for it.
+  void broadcastTelemetry(telemetry::Snapshot members);
+  // Host: clients seen by the last broadcast that never advertised
+  // telemetry; they still expect the lobby chat ping report.
+  int legacyTelemetryPeers() const {
+    return legacyTelemetryPeers_.load(std::memory_order_relaxed);
+  }
+  // Client: the host's telemetry as last received. Drains the inbox, so only
+  // one thread may call it.
+  std::shared_ptr<const telemetry::Snapshot> latestTelemetry() {
+    return telemetryInbox_.latest();
+  }
+
 private:
   void startAsyncPoll();
+  void handleTelemetry(const uint8_t *data, size_t length);
+  void updateSendRates(const std::vector<HSteamNetConnection> &connections);
 
   boost::asio::io_context &io_context_;
-  ISteamNetworkingSockets *m_pInterface_;
+  Transport *transport_;
   std::vector<HSteamNetConnection> &connections_;
   std::mutex &connectionsMutex_;
   bool &g_isHost_;
@@ -38,10 +58,18 @@ private:
 
   std::map<HSteamNetConnection, std::shared_ptr<MultiplexManager>>
       multiplexManagers_;
+  std::map<HSteamNetConnection, RateController> rateControllers_;
+  std::chrono::steady_clock::time_point nextRateUpdate_;
+  // Telemetry state lives on the io thread; the inbox hands it to the GUI.
+  std::map<HSteamNetConnection, telemetry::Encoder> telemetryEncoders_;
+  telemetry::Decoder telemetryDecoder_;
+  telemetry::Inbox telemetryInbox_;
+  std::atomic<int> legacyTelemetryPeers_{0};
 
   std::unique_ptr<boost::asio::steady_timer> timer_;
   bool running_;
   int currentPollInterval_; // 当前轮询间隔（毫秒）
+  std::chrono::steady_clock::time_point pollDeadline_;
 };
 
 #endif // STEAM_MESSAGE_HANDLER_H
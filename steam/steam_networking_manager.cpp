@@ -1,5 +1,6 @@
 #include "steam_networking_manager.h"
 #include "steam_room_manager.h"
+#include "steam_transport.h"
 #include <algorithm>
 #include <chrono>
 #include <cstring>
@@ -71,8 +72,9 @@ bool SteamNetworkingManager::initialize() {
       k_ESteamNetworkingConfig_Global, 0, k_ESteamNetworkingConfig_Int32,
       &recvBufferMsgs);
 
-  // Cap send rate to a conservative value to keep reliable window stable
-  int32 sendRate = 1024 * 1024; // ~1000 KB/s
+  // Start conservative; SteamMessageHandler's per-connection RateController
+  // probes upward from here once traffic flows.
+  int32 sendRate = kInitialSendRate;
   SteamNetworkingUtils()->SetConfigValue(
       k_ESteamNetworkingConfig_SendRateMin, k_ESteamNetworkingConfig_Global, 0,
       k_ESteamNetworkingConfig_Int32, &sendRate);
@@ -137,6 +139,7 @@ bool SteamNetworkingManager::initialize() {
       OnSteamNetConnectionStatusChanged);
 
   m_pInterface = SteamNetworkingSockets();
+  transport_ = std::make_unique<SteamTransport>();
 
   // Check if callbacks are registered
   std::cout << "Steam Networking Manager initialized successfully" << std::endl;
@@ -306,7 +309,7 @@ void SteamNetworkingManager::setMessageHandlerDependencies(
   localPort_ = &localPort;
   localBindPort_ = &localBindPort;
   messageHandler_ =
-      new SteamMessageHandler(io_context, m_pInterface, connections,
+      new SteamMessageHandler(io_context, transport_.get(), connections,
                               connectionsMutex, g_isHost, localPort);
 }
 
@@ -444,7 +447,8 @@ void SteamNetworkingManager::update() {
 
 int SteamNetworkingManager::getConnectionPing(HSteamNetConnection conn) const {
   SteamNetConnectionRealTimeStatus_t status;
-  if (m_pInterface->GetConnectionRealTimeStatus(conn, &status, 0, nullptr)) {
+  if (transport_ &&
+      transport_->getConnectionRealTimeStatus(conn, &status) == k_EResultOK) {
     return status.m_nPing;
   }
   return 0;
@@ -453,7 +457,7 @@ int SteamNetworkingManager::getConnectionPing(HSteamNetConnection conn) const {
 std::string
 SteamNetworkingManager::getConnectionRelayInfo(HSteamNetConnection conn) const {
   SteamNetConnectionInfo_t info;
-  if (m_pInterface->GetConnectionInfo(conn, &info)) {
+  if (transport_ && transport_->getConnectionInfo(conn, &info)) {
     // Check if connection is using relay
     if (info.m_nFlags & k_nSteamNetworkConnectionInfoFlags_Relayed) {
       return "中继";
@@ -2,6 +2,7 @@
 #define STEAM_NETWORKING_MANAGER_H
 
 #include "steam_message_handler.h"
+#include "../net/transport.h"
 #include <isteamnetworkingsockets.h>
 #include <isteamnetworkingutils.h>
 #include <map>
@@ -51,6 +52,7 @@ public:
   int getConnectionPing(HSteamNetConnection conn) const;
   HSteamNetConnection getConnection() const { return g_hConnection; }
   ISteamNetworkingSockets *getInterface() const { return m_pInterface; }
+  Transport *getTransport() const { return transport_.get(); }
   std::string getConnectionRelayInfo(HSteamNetConnection conn) const;
   int estimateRelayPingMs() const;
   void applyTransportPreference(int directPingMs, int relayPingMs);
@@ -86,6 +88,8 @@ private:
 
   // Steam API
   ISteamNetworkingSockets *m_pInterface;
+  // Data path carrier; connection setup/teardown stays on m_pInterface
+  std::unique_ptr<Transport> transport_;
 
   // Hosting
   HSteamListenSocket hListenSock;
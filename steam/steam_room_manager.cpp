@@ -15,7 +15,8 @@ constexpr const char *kLobbyKeyPingLocation = "ct_ping_loc";
 constexpr const char *kLobbyKeyTag = "ct_tag";
 constexpr const char *kLobbyKeyPinned = "ct_pin";
 constexpr const char *kLobbyTagValue = "1";
-constexpr const char *kPingPrefix = "PING|";
+// Ping reports for clients without tunnel telemetry; not for display.
+constexpr const char *kLegacyPingPrefix = "PING|";
 constexpr const char *kLobbyModeTun = "tun";
 constexpr const char *kLobbyModeTcp = "tcp";
 constexpr int kLobbyMaxMembers = 250; // Allow more than the default 4 slots
@@ -48,6 +49,20 @@ void SteamFriendsCallbacks::OnGameLobbyJoinRequested(
   }
 }
 
+void SteamFriendsCallbacks::OnPersonaStateChange(
+    PersonaStateChange_t *pCallback) {
+  if (roomManager_ && roomManager_->friendChangedCallback_) {
+    roomManager_->friendChangedCallback_(CSteamID(pCallback->m_ulSteamID));
+  }
+}
+
+void SteamFriendsCallbacks::OnFriendRichPresenceUpdate(
+    FriendRichPresenceUpdate_t *pCallback) {
+  if (roomManager_ && roomManager_->friendChangedCallback_) {
+    roomManager_->friendChangedCallback_(pCallback->m_steamIDFriend);
+  }
+}
+
 SteamMatchmakingCallbacks::SteamMatchmakingCallbacks(
     SteamNetworkingManager *manager, SteamRoomManager *roomManager)
     : manager_(manager), roomManager_(roomManager) {}
@@ -73,14 +88,12 @@ void SteamMatchmakingCallbacks::OnLobbyChatMsg(LobbyChatMsg_t *pCallback) {
   }
   data[std::min<int>(read, sizeof(data) - 1)] = '\0';
   const std::string payload(data);
-  if (payload.rfind(kPingPrefix, 0) == 0) {
+  if (payload.rfind(kLegacyPingPrefix, 0) == 0) {
     CSteamID owner =
         SteamMatchmaking()->GetLobbyOwner(pCallback->m_ulSteamIDLobby);
-    if (owner.IsValid() && sender.IsValid() && sender != owner) {
-      return; // only trust host broadcast for ping payloads
+    if (!owner.IsValid() || !sender.IsValid() || sender == owner) {
+      return;
     }
-    roomManager_->handlePingMessage(payload);
-    return;
   }
   roomManager_->handleChatMessage(sender, payload);
 }
@@ -348,6 +361,9 @@ void SteamMatchmakingCallbacks::OnLobbyChatUpdate(
       (changeFlags & k_EChatMemberStateChangeKicked) ||
       (changeFlags & k_EChatMemberStateChangeBanned);
   CSteamID changedUser = CSteamID(pCallback->m_ulSteamIDUserChanged);
+  if (roomManager_->membersChangedCallback_) {
+    roomManager_->membersChangedCallback_();
+  }
 
   if (roomManager_->vpnMode_) {
     const CSteamID mySteamId = SteamUser()->GetSteamID();
@@ -404,6 +420,11 @@ void SteamRoomManager::setLobbyInviteCallback(
   lobbyInviteCallback_ = std::move(callback);
 }
 
+void SteamRoomManager::setFriendChangedCallback(
+    std::function<void(const CSteamID &user)> callback) {
+  friendChangedCallback_ = std::move(callback);
+}
+
 void SteamRoomManager::setPinnedMessageChangedCallback(
     std::function<void(const std::string &)> callback) {
   pinnedMessageChangedCallback_ = std::move(callback);
@@ -453,7 +474,6 @@ void SteamRoomManager::leaveLobby() {
     if (vpnMode_ && vpnNetworkingManager_) {
       vpnNetworkingManager_->clearPeers();
     }
-    remotePings_.clear();
 
     // Clear Rich Presence when leaving lobby
     SteamFriends()->ClearRichPresence();
@@ -568,6 +588,11 @@ void SteamRoomManager::setHostLeftCallback(std::function<void()> callback) {
   hostLeftCallback_ = std::move(callback);
 }
 
+void SteamRoomManager::setMembersChangedCallback(
+    std::function<void()> callback) {
+  membersChangedCallback_ = std::move(callback);
+}
+
 void SteamRoomManager::setChatMessageCallback(
     std::function<void(const CSteamID &, const std::string &)> callback) {
   chatMessageCallback_ = std::move(callback);
@@ -582,6 +607,31 @@ bool SteamRoomManager::sendChatMessage(const std::string &message) {
                                               length);
 }
 
+void SteamRoomManager::broadcastLegacyPings(
+    const std::vector<std::tuple<uint64_t, int, std::string>> &pings) {
+  if (!networkingManager_ || !networkingManager_->isHost()) {
+    return;
+  }
+  std::string payload(kLegacyPingPrefix);
+  const std::size_t prefixLength = payload.size();
+  for (const auto &[id, ping, relay] : pings) {
+    if (ping < 0) {
+      continue;
+    }
+    if (payload.size() > prefixLength) {
+      payload.push_back(';');
+    }
+    payload += std::to_string(id);
+    payload.push_back(':');
+    payload += std::to_string(ping);
+    payload.push_back(':');
+    payload += relay;
+  }
+  if (payload.size() > prefixLength) {
+    sendChatMessage(payload);
+  }
+}
+
 void SteamRoomManager::refreshLobbyMetadata() {
   if (currentLobby == k_steamIDNil || !SteamMatchmaking()) {
     return;
@@ -679,82 +729,6 @@ void SteamRoomManager::notifyLobbyListUpdated() {
   }
 }
 
-void SteamRoomManager::broadcastPings(
-    const std::vector<std::tuple<uint64_t, int, std::string>> &pings) {
-  if (!networkingManager_ || !networkingManager_->isHost() ||
-      currentLobby == k_steamIDNil) {
-    return;
-  }
-  if (!SteamMatchmaking()) {
-    return;
-  }
-  std::string payload(kPingPrefix);
-  bool first = true;
-  for (const auto &entry : pings) {
-    const uint64_t id = std::get<0>(entry);
-    const int ping = std::get<1>(entry);
-    if (ping < 0) {
-      continue;
-    }
-    if (!first) {
-      payload.push_back(';');
-    }
-    first = false;
-    payload += std::to_string(id);
-    payload.push_back(':');
-    payload += std::to_string(ping);
-    payload.push_back(':');
-    payload += std::get<2>(entry);
-  }
-  if (payload.size() <= strlen(kPingPrefix)) {
-    return;
-  }
-  SteamMatchmaking()->SendLobbyChatMsg(
-      currentLobby, payload.c_str(), static_cast<int>(payload.size()));
-}
-
-void SteamRoomManager::handlePingMessage(const std::string &payload) {
-  if (payload.rfind(kPingPrefix, 0) != 0) {
-    return;
-  }
-  const std::string data = payload.substr(strlen(kPingPrefix));
-  size_t start = 0;
-  const auto now = std::chrono::steady_clock::now();
-  while (start < data.size()) {
-    const size_t next = data.find(';', start);
-    const std::string_view part(
-        data.c_str() + start,
-        (next == std::string::npos ? data.size() : next) - start);
-    if (!part.empty()) {
-      const size_t first = part.find(':');
-      const size_t second = part.find(':', first == std::string::npos
-                                             ? std::string::npos
-                                             : first + 1);
-      if (first != std::string::npos && second != std::string::npos &&
-          second > first) {
-        const std::string idStr(part.substr(0, first));
-        const std::string pingStr(part.substr(first + 1, second - first - 1));
-        const std::string relayStr(part.substr(second + 1));
-        try {
-          const uint64_t id = std::stoull(idStr);
-          const int ping = std::stoi(pingStr);
-          if (id > 0 && ping >= 0) {
-            PingInfo &info = remotePings_[id];
-            info.ping = ping;
-            info.relay = relayStr;
-            info.updatedAt = now;
-          }
-        } catch (...) {
-        }
-      }
-    }
-    if (next == std::string::npos) {
-      break;
-    }
-    start = next + 1;
-  }
-}
-
 void SteamRoomManager::handleChatMessage(const CSteamID &sender,
                                          const std::string &payload) {
   if (!chatMessageCallback_ || payload.empty() || !sender.IsValid()) {
@@ -763,18 +737,6 @@ void SteamRoomManager::handleChatMessage(const CSteamID &sender,
   chatMessageCallback_(sender, payload);
 }
 
-bool SteamRoomManager::getRemotePing(const CSteamID &id, int &ping,
-                                     std::string &relay) const {
-  const uint64_t key = id.ConvertToUint64();
-  auto it = remotePings_.find(key);
-  if (it == remotePings_.end()) {
-    return false;
-  }
-  ping = it->second.ping;
-  relay = it->second.relay;
-  return ping >= 0;
-}
-
 bool SteamRoomManager::lobbyWantsTun(CSteamID lobby) const {
   if (!SteamMatchmaking()) {
     return false;
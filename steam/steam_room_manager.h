@@ -26,6 +26,10 @@ private:
 
   STEAM_CALLBACK(SteamFriendsCallbacks, OnGameLobbyJoinRequested,
                  GameLobbyJoinRequested_t);
+  STEAM_CALLBACK(SteamFriendsCallbacks, OnPersonaStateChange,
+                 PersonaStateChange_t);
+  STEAM_CALLBACK(SteamFriendsCallbacks, OnFriendRichPresenceUpdate,
+                 FriendRichPresenceUpdate_t);
 };
 
 class SteamMatchmakingCallbacks {
@@ -80,12 +84,15 @@ public:
   void setLobbyListCallback(
       std::function<void(const std::vector<LobbyInfo> &)> callback);
   void setHostLeftCallback(std::function<void()> callback);
+  // Someone entered or left the current lobby.
+  void setMembersChangedCallback(std::function<void()> callback);
   void setChatMessageCallback(
       std::function<void(const CSteamID &, const std::string &)> callback);
   bool sendChatMessage(const std::string &message);
-  void broadcastPings(
+  // Host: the "PING|id:ping:relay;..." lobby chat report clients from before
+  // tunnel telemetry read.
+  void broadcastLegacyPings(
       const std::vector<std::tuple<uint64_t, int, std::string>> &pings);
-  bool getRemotePing(const CSteamID &id, int &ping, std::string &relay) const;
 
   CSteamID getCurrentLobby() const { return currentLobby; }
   const std::vector<CSteamID> &getLobbies() const { return lobbies; }
@@ -101,6 +108,9 @@ public:
       std::function<void(bool wantsTun, const CSteamID &lobby)> callback);
   void setLobbyInviteCallback(
       std::function<void(const CSteamID &lobby)> callback);
+  // A user's name, state, avatar, rich presence or relationship changed.
+  void setFriendChangedCallback(
+      std::function<void(const CSteamID &user)> callback);
   void setPinnedMessageChangedCallback(
       std::function<void(const std::string &)> callback);
   void setPinnedMessageData(const std::string &data);
@@ -113,7 +123,6 @@ private:
   void refreshLobbyMetadata();
   void decideTransportForCurrentLobby();
   void notifyLobbyListUpdated();
-  void handlePingMessage(const std::string &payload);
   void handleChatMessage(const CSteamID &sender, const std::string &payload);
   bool lobbyWantsTun(CSteamID lobby) const;
   void notifyPinnedMessageChanged(const CSteamID &lobby);
@@ -130,17 +139,13 @@ private:
   std::string lobbyName_;
   bool publishLobby_ = true;
   bool advertisedWantsTun_ = false;
-  struct PingInfo {
-    int ping = -1;
-    std::string relay;
-    std::chrono::steady_clock::time_point updatedAt;
-  };
-  std::unordered_map<uint64_t, PingInfo> remotePings_;
   bool vpnMode_ = false;
   std::function<void(bool wantsTun, const CSteamID &lobby)>
       lobbyModeChangedCallback_;
   std::function<void(const CSteamID &)> lobbyInviteCallback_;
+  std::function<void(const CSteamID &)> friendChangedCallback_;
   std::function<void()> hostLeftCallback_;
+  std::function<void()> membersChangedCallback_;
   std::function<void(const CSteamID &, const std::string &)>
       chatMessageCallback_;
   std::function<void(const std::string &)> pinnedMessageChangedCallback_;
@@ -0,0 +1,156 @@
+#include "steam_transport.h"
+#include <algorithm>
+#include <isteamnetworkingutils.h>
+
+SteamTransport::SteamTransport()
+    : sockets_(SteamNetworkingSockets()),
+      messages_(SteamNetworkingMessages()) {}
+
+CSteamID SteamTransport::localSteamID() const {
+  return SteamUser() ? SteamUser()->GetSteamID() : CSteamID();
+}
+
+void SteamTransport::runCallbacks() {
+  if (sockets_) {
+    sockets_->RunCallbacks();
+  }
+}
+
+EResult SteamTransport::sendMessageToConnection(HSteamNetConnection conn,
+                                                const void *data, uint32 size,
+                                                int flags,
+                                                int64 *outMessageNumber) {
+  if (!sockets_) {
+    return k_EResultNoConnection;
+  }
+  return sockets_->SendMessageToConnection(conn, data, size, flags,
+                                           outMessageNumber);
+}
+
+int SteamTransport::receiveMessagesOnConnection(
+    HSteamNetConnection conn, SteamNetworkingMessage_t **messages,
+    int maxMessages) {
+  if (!sockets_) {
+    return 0;
+  }
+  return sockets_->ReceiveMessagesOnConnection(conn, messages, maxMessages);
+}
+
+EResult SteamTransport::getConnectionRealTimeStatus(
+    HSteamNetConnection conn, SteamNetConnectionRealTimeStatus_t *status) {
+  if (!sockets_) {
+    return k_EResultNoConnection;
+  }
+  return sockets_->GetConnectionRealTimeStatus(conn, status, 0, nullptr);
+}
+
+bool SteamTransport::getConnectionInfo(HSteamNetConnection conn,
+                                       SteamNetConnectionInfo_t *info) {
+  return sockets_ && sockets_->GetConnectionInfo(conn, info);
+}
+
+EResult SteamTransport::sendMessageToUser(const SteamNetworkingIdentity &peer,
+                                          const void *data, uint32 size,
+                                          int flags, int channel) {
+  if (!messages_) {
+    return k_EResultNoConnection;
+  }
+  return messages_->SendMessageToUser(peer, data, size, flags, channel);
+}
+
+int SteamTransport::receiveMessagesOnChannel(
+    int channel, SteamNetworkingMessage_t **messages, int maxMessages) {
+  if (!messages_) {
+    return 0;
+  }
+  return messages_->ReceiveMessagesOnChannel(channel, messages, maxMessages);
+}
+
+bool SteamTransport::acceptSessionWithUser(
+    const SteamNetworkingIdentity &peer) {
+  return messages_ && messages_->AcceptSessionWithUser(peer);
+}
+
+bool SteamTransport::closeSessionWithUser(const SteamNetworkingIdentity &peer) {
+  {
+    std::lock_guard<std::mutex> lock(sessionSendRatesMutex_);
+    sessionSendRates_.erase(peer.GetSteamID64());
+  }
+  return messages_ && messages_->CloseSessionWithUser(peer);
+}
+
+ESteamNetworkingConnectionState SteamTransport::getSessionConnectionInfo(
+    const SteamNetworkingIdentity &peer, SteamNetConnectionInfo_t *info,
+    SteamNetConnectionRealTimeStatus_t *status) {
+  if (!messages_) {
+    return k_ESteamNetworkingConnectionState_None;
+  }
+  return messages_->GetSessionConnectionInfo(peer, info, status);
+}
+
+SteamNetworkingMicroseconds SteamTransport::localTimestamp() const {
+  ISteamNetworkingUtils *utils = SteamNetworkingUtils();
+  return utils ? utils->GetLocalTimestamp() : Transport::localTimestamp();
+}
+
+bool SteamTransport::setConnectionSendRate(HSteamNetConnection conn,
+                                           int bytesPerSec) {
+  ISteamNetworkingUtils *utils = SteamNetworkingUtils();
+  if (!utils || conn == k_HSteamNetConnection_Invalid) {
+    return false;
+  }
+  // Pinning min and max makes the controller's rate authoritative.
+  return utils->SetConnectionConfigValueInt32(
+             conn, k_ESteamNetworkingConfig_SendRateMin, bytesPerSec) &&
+         utils->SetConnectionConfigValueInt32(
+             conn, k_ESteamNetworkingConfig_SendRateMax, bytesPerSec);
+}
+
+bool SteamTransport::setSessionSendRate(const SteamNetworkingIdentity &peer,
+                                        int bytesPerSec) {
+  {
+    std::lock_guard<std::mutex> lock(sessionSendRatesMutex_);
+    sessionSendRates_[peer.GetSteamID64()] = bytesPerSec;
+  }
+  applySessionSendRates();
+  return true;
+}
+
+// ISteamNetworkingMessages hides its connection handles, so sessions can only
+// be paced through the global config. With several peers the slowest one sets
+// the floor and the fastest the ceiling; Steam's own estimator picks the rate
+// per session in between.
+void SteamTransport::applySessionSendRates() {
+  ISteamNetworkingUtils *utils = SteamNetworkingUtils();
+  if (!utils) {
+    return;
+  }
+  int minRate = 0;
+  int maxRate = 0;
+  {
+    std::lock_guard<std::mutex> lock(sessionSendRatesMutex_);
+    if (sessionSendRates_.empty()) {
+      return;
+    }
+    minRate = sessionSendRates_.begin()->second;
+    maxRate = minRate;
+    for (const auto &entry : sessionSendRates_) {
+      minRate = std::min(minRate, entry.second);
+      maxRate = std::max(maxRate, entry.second);
+    }
+  }
+  utils->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_SendRateMin,
+                                   minRate);
+  utils->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_SendRateMax,
+                                   maxRate);
+}
+
+void SteamTransport::OnSessionRequest(
+    SteamNetworkingMessagesSessionRequest_t *pCallback) {
+  notifySessionRequest(pCallback->m_identityRemote);
+}
+
+void SteamTransport::OnSessionFailed(
+    SteamNetworkingMessagesSessionFailed_t *pCallback) {
+  notifySessionFailed(pCallback->m_info);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../net/transport.h"
+#include <isteamnetworkingmessages.h>
+#include <isteamnetworkingsockets.h>
+#include <map>
+#include <mutex>
+#include <steam_api.h>
+
+// Transport backed by the Steam client (SDR relays + ICE).
+class SteamTransport : public Transport {
+public:
+  SteamTransport();
+
+  bool isValid() const { return sockets_ && messages_; }
+
+  CSteamID localSteamID() const override;
+  void runCallbacks() override;
+
+  EResult sendMessageToConnection(HSteamNetConnection conn, const void *data,
+                                  uint32 size, int flags,
+                                  int64 *outMessageNumber) override;
+  int receiveMessagesOnConnection(HSteamNetConnection conn,
+                                  SteamNetworkingMessage_t **messages,
+                                  int maxMessages) override;
+  EResult
+  getConnectionRealTimeStatus(HSteamNetConnection conn,
+                              SteamNetConnectionRealTimeStatus_t *status) override;
+  bool getConnectionInfo(HSteamNetConnection conn,
+                         SteamNetConnectionInfo_t *info) override;
+
+  EResult sendMessageToUser(const SteamNetworkingIdentity &peer,
+                            const void *data, uint32 size, int flags,
+                            int channel) override;
+  int receiveMessagesOnChannel(int channel, SteamNetworkingMessage_t **messages,
+                               int maxMessages) override;
+  bool acceptSessionWithUser(const SteamNetworkingIdentity &peer) override;
+  bool closeSessionWithUser(const SteamNetworkingIdentity &peer) override;
+  ESteamNetworkingConnectionState
+  getSessionConnectionInfo(const SteamNetworkingIdentity &peer,
+                           SteamNetConnectionInfo_t *info,
+                           SteamNetConnectionRealTimeStatus_t *status) override;
+
+  bool setConnectionSendRate(HSteamNetConnection conn,
+                             int bytesPerSec) override;
+  bool setSessionSendRate(const SteamNetworkingIdentity &peer,
+                          int bytesPerSec) override;
+
+  // ISteamNetworkingMessages has no blocking receive, so canWaitForMessages()
+  // stays false and the VPN receiver polls.
+  SteamNetworkingMicroseconds localTimestamp() const override;
+
+private:
+  void applySessionSendRates();
+
+  ISteamNetworkingSockets *sockets_;
+  ISteamNetworkingMessages *messages_;
+  std::map<uint64, int> sessionSendRates_;
+  std::mutex sessionSendRatesMutex_;
+
+  STEAM_CALLBACK(SteamTransport, OnSessionRequest,
+                 SteamNetworkingMessagesSessionRequest_t);
+  STEAM_CALLBACK(SteamTransport, OnSessionFailed,
+                 SteamNetworkingMessagesSessionFailed_t);
+};
@@ -1,43 +1,19 @@
 #include "steam_utils.h"
-#include <QBuffer>
-#include <QByteArray>
-#include <QIODevice>
-#include <QImage>
-#include <cstring>
-#include <iostream>
+#include <algorithm>
 
 namespace {
-std::string buildAvatarDataUrl(int imageHandle) {
-  if (imageHandle <= 0 || ::SteamUtils() == nullptr) {
-    return {};
-  }
-  uint32 width = 0;
-  uint32 height = 0;
-  if (!::SteamUtils()->GetImageSize(imageHandle, &width, &height) ||
-      width == 0 || height == 0) {
-    return {};
-  }
-  const size_t bytes =
-      static_cast<size_t>(width) * static_cast<size_t>(height) * 4;
-  std::vector<uint8_t> rgba(bytes);
-  if (!::SteamUtils()->GetImageRGBA(imageHandle, rgba.data(),
-                                    static_cast<int>(rgba.size()))) {
-    return {};
-  }
-
-  QImage image(width, height, QImage::Format_RGBA8888);
-  std::memcpy(image.bits(), rgba.data(), rgba.size());
-
-  QByteArray pngData;
-  QBuffer buffer(&pngData);
-  buffer.open(QIODevice::WriteOnly);
-  if (!image.save(&buffer, "PNG")) {
-    return {};
-  }
-
-  QByteArray dataUrl("data:image/png;base64,");
-  dataUrl.append(pngData.toBase64());
-  return dataUrl.toStdString();
+// The list and single-friend lookups must agree, or an incremental update
+// drops entries the full list shows (pending requests, for one).
+constexpr int kFriendFlags = k_EFriendFlagAll;
+
+SteamUtils::FriendInfo describeFriend(const CSteamID &friendID) {
+  const char *name = SteamFriends()->GetFriendPersonaName(friendID);
+  const int avatar =
+      std::max(0, SteamFriends()->GetSmallFriendAvatar(friendID));
+  EPersonaState persona = SteamFriends()->GetFriendPersonaState(friendID);
+  const bool isOnline = persona != k_EPersonaStateOffline &&
+                        persona != k_EPersonaStateInvisible;
+  return {friendID, name ? name : "", avatar, persona, isOnline};
 }
 } // namespace
 
@@ -46,32 +22,32 @@ std::vector<SteamUtils::FriendInfo> SteamUtils::getFriendsList() {
   if (!SteamFriends()) {
     return friendsList;
   }
-  int friendCount = SteamFriends()->GetFriendCount(k_EFriendFlagAll);
+  int friendCount = SteamFriends()->GetFriendCount(kFriendFlags);
   friendsList.reserve(friendCount);
   for (int i = 0; i < friendCount; ++i) {
-    CSteamID friendID = SteamFriends()->GetFriendByIndex(i, k_EFriendFlagAll);
-    const char *name = SteamFriends()->GetFriendPersonaName(friendID);
-    std::string avatar =
-        buildAvatarDataUrl(SteamFriends()->GetSmallFriendAvatar(friendID));
-    EPersonaState persona = SteamFriends()->GetFriendPersonaState(friendID);
-    const bool isOnline = persona != k_EPersonaStateOffline &&
-                          persona != k_EPersonaStateInvisible;
-    friendsList.push_back(
-        {friendID, name ? name : "", std::move(avatar), persona, isOnline});
+    friendsList.push_back(describeFriend(
+        SteamFriends()->GetFriendByIndex(i, kFriendFlags)));
   }
   return friendsList;
 }
 
-std::string SteamUtils::getAvatarDataUrl(const CSteamID &id) {
+bool SteamUtils::getFriendInfo(const CSteamID &id, FriendInfo &info) {
+  if (!SteamFriends() || !SteamFriends()->HasFriend(id, kFriendFlags)) {
+    return false;
+  }
+  info = describeFriend(id);
+  return true;
+}
+
+int SteamUtils::getAvatarHandle(const CSteamID &id) {
   if (!SteamFriends()) {
-    return {};
+    return 0;
   }
 
   const int handle = SteamFriends()->GetSmallFriendAvatar(id);
   if (handle <= 0) {
     SteamFriends()->RequestUserInformation(id, true);
-    return {};
+    return 0;
   }
-
-  return buildAvatarDataUrl(handle);
+  return handle;
 }
@@ -8,11 +8,14 @@ public:
   struct FriendInfo {
     CSteamID id;
     std::string name;
-    std::string avatarDataUrl;
+    int avatarHandle; // 0 until Steam has the small avatar
     EPersonaState personaState;
     bool online;
   };
 
   static std::vector<FriendInfo> getFriendsList();
-  static std::string getAvatarDataUrl(const CSteamID &id);
+  // False when the user is not (or no longer) a friend.
+  static bool getFriendInfo(const CSteamID &id, FriendInfo &info);
+  // Small avatar image handle, or 0 after asking Steam to fetch it.
+  static int getAvatarHandle(const CSteamID &id);
 };
@@ -1,9 +1,12 @@
 #include "steam_vpn_bridge.h"
 #include "steam_vpn_networking_manager.h"
+#include "../net/ip_packet.h"
+#include "../net/packet_pool.h"
 #include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <iostream>
+#include <iterator>
 #include <thread>
 #include <steam_api.h>
 
@@ -19,13 +22,18 @@ constexpr const char *kDefaultTunName = "SteamVPN";
 constexpr const char *kDefaultSubnet = "10.0.0.0";
 constexpr const char *kDefaultSubnetMask = "255.0.0.0";
 constexpr int kDefaultMtu = 1400;
+constexpr int kUnreliableFlags =
+    k_nSteamNetworkingSend_UnreliableNoNagle | k_nSteamNetworkingSend_NoDelay;
+constexpr int kReliableIpFlags = k_nSteamNetworkingSend_ReliableNoNagle;
+constexpr int64_t kFecFlushIntervalMs = 2;
+constexpr size_t kTunReadBytes = 2048;
+constexpr std::chrono::seconds kFanOutLogInterval{10};
+constexpr int kIpv6PrefixLength = 64;
 } // namespace
 
 SteamVpnBridge::SteamVpnBridge(SteamVpnNetworkingManager *steamManager)
     : steamManager_(steamManager), running_(false), baseIP_(0), subnetMask_(0),
-      localIP_(0) {
-  std::memset(&stats_, 0, sizeof(stats_));
-}
+      localIP_(0) {}
 
 SteamVpnBridge::~SteamVpnBridge() { stop(); }
 
@@ -38,6 +46,9 @@ bool SteamVpnBridge::start(const std::string &tunDeviceName,
   }
   ipNegotiator_.reset();
   heartbeatManager_.reset();
+  pathSelector_.reset();
+  multicastSnooper_.reset();
+  routeSync_.reset();
   if (!steamManager_) {
     std::cerr << "Steam manager missing, cannot start VPN bridge" << std::endl;
     return false;
@@ -45,7 +56,7 @@ bool SteamVpnBridge::start(const std::string &tunDeviceName,
 
   const int mtuToUse = mtu > 0 ? mtu : kDefaultMtu;
 
-  tunDevice_ = tun::create_tun();
+  tunDevice_ = tunFactory_ ? tunFactory_() : tun::create_tun();
   if (!tunDevice_) {
     std::cerr << "Failed to create TUN device" << std::endl;
     return false;
@@ -65,8 +76,9 @@ bool SteamVpnBridge::start(const std::string &tunDeviceName,
   subnetMask_ =
       stringToIp(subnetMask.empty() ? kDefaultSubnetMask : subnetMask);
 
-  const CSteamID mySteamID = SteamUser()->GetSteamID();
+  const CSteamID mySteamID = steamManager_->getLocalSteamID();
   ipNegotiator_.initialize(mySteamID, baseIP_, subnetMask_);
+  pathSelector_.setLocalSteamID(mySteamID);
   ipNegotiator_.setSendCallback(
       [this](VpnMessageType type, const uint8_t *payload, size_t len,
              CSteamID targetSteamID, bool reliable) {
@@ -114,13 +126,50 @@ void SteamVpnBridge::stop() {
   {
     std::lock_guard<std::mutex> lock(routingMutex_);
     routingTable_.clear();
+    ipv6Routes_.clear();
+    linkLocalPeers_.clear();
   }
   ipNegotiator_.reset();
   heartbeatManager_.reset();
+  pathSelector_.reset();
+  multicastSnooper_.reset();
+  routeSync_.reset();
+  {
+    std::lock_guard<std::mutex> lock(fecSendMutex_);
+    fecEncoders_.clear();
+  }
+  {
+    std::lock_guard<std::mutex> lock(fecReceiveMutex_);
+    fecDecoders_.clear();
+  }
   localIP_ = 0;
   std::cout << "Steam VPN bridge stopped" << std::endl;
 }
 
+void SteamVpnBridge::setTrafficClassifier(
+    const TrafficClassifier &classifier) {
+  classifier_ = classifier;
+  if (steamManager_) {
+    steamManager_->setTrafficClasses(classifier);
+  }
+}
+
+void SteamVpnBridge::setFecEnabled(bool enabled) {
+  fecEnabled_ = enabled;
+  if (enabled && steamManager_) {
+    for (const auto &peer : steamManager_->getPeers()) {
+      startFec(peer);
+    }
+  }
+  if (!enabled) {
+    // Open groups still get their parity from flushFecParity().
+    std::lock_guard<std::mutex> lock(fecSendMutex_);
+    for (auto &kv : fecEncoders_) {
+      kv.second.setGroupSize(0);
+    }
+  }
+}
+
 std::string SteamVpnBridge::getLocalIP() const {
   if (localIP_ == 0) {
     return {};
@@ -142,87 +191,91 @@ std::map<uint32_t, RouteEntry> SteamVpnBridge::getRoutingTable() const {
 
 void SteamVpnBridge::tunReadThread() {
   std::cout << "TUN read thread started" << std::endl;
-  uint8_t buffer[2048];
+  // Packets are read straight behind the headers they are sent with.
+  alignas(64) uint8_t
+      vpnPacket[sizeof(VpnMessageHeader) + sizeof(VpnPacketWrapper) +
+                kTunReadBytes];
+  uint8_t *const buffer =
+      vpnPacket + sizeof(VpnMessageHeader) + sizeof(VpnPacketWrapper);
   auto lastTimeoutCheck = std::chrono::steady_clock::now();
+  auto lastPathUpdate = lastTimeoutCheck;
+  auto lastFecFlush = lastTimeoutCheck;
 
   while (running_) {
     const int bytesRead =
-        tunDevice_ ? tunDevice_->read(buffer, sizeof(buffer)) : -1;
+        tunDevice_ ? tunDevice_->read(buffer, kTunReadBytes) : -1;
     if (bytesRead > 0 && steamManager_) {
+      const int ipVersion = ippacket::version(buffer, bytesRead);
       const uint32_t destIP = extractDestIP(buffer, bytesRead);
       const uint32_t srcIP = extractSourceIP(buffer, bytesRead);
-      uint8_t
-          vpnPacket[2048 + sizeof(VpnMessageHeader) + sizeof(VpnPacketWrapper)];
       auto *header = reinterpret_cast<VpnMessageHeader *>(vpnPacket);
       header->type = VpnMessageType::IP_PACKET;
 
       auto *wrapper = reinterpret_cast<VpnPacketWrapper *>(
           vpnPacket + sizeof(VpnMessageHeader));
       wrapper->senderNodeId = ipNegotiator_.getLocalNodeID();
-      wrapper->sourceIP = htonl(srcIP);
+      // IPv6 packets carry our IPv4 address so receivers can still map the
+      // sender to a route.
+      wrapper->sourceIP = htonl(ipVersion == 6 ? localIP_ : srcIP);
 
       const size_t totalPayloadSize =
           sizeof(VpnPacketWrapper) + static_cast<size_t>(bytesRead);
       header->length = htons(static_cast<uint16_t>(totalPayloadSize));
-      std::memcpy(vpnPacket + sizeof(VpnMessageHeader) +
-                      sizeof(VpnPacketWrapper),
-                  buffer, static_cast<size_t>(bytesRead));
       const uint32_t vpnPacketSize =
           static_cast<uint32_t>(sizeof(VpnMessageHeader) + totalPayloadSize);
 
-      if (destIP == localIP_) {
+      if (ipVersion == 6) {
+        routeIpv6Packet(vpnPacket, vpnPacketSize, buffer,
+                        static_cast<size_t>(bytesRead));
+      } else if (destIP == localIP_) {
         // Loopback traffic destined to our own TUN IP back into the stack.
-        tunDevice_->write(buffer, static_cast<size_t>(bytesRead));
-        std::lock_guard<std::mutex> lock(statsMutex_);
-        stats_.packetsReceived++;
-        stats_.bytesReceived += static_cast<uint64_t>(bytesRead);
+        if (writeToTun(buffer, static_cast<size_t>(bytesRead))) {
+          stats_.packetsReceived.add();
+          stats_.bytesReceived.add(static_cast<uint64_t>(bytesRead));
+        }
         std::cout << "[SteamVPN] Local loopback " << ipToString(srcIP) << " -> "
                   << ipToString(destIP) << " (" << bytesRead << " bytes)"
                   << std::endl;
       } else if (isBroadcastAddress(destIP)) {
-        steamManager_->broadcastMessage(
-            vpnPacket, vpnPacketSize,
-            k_nSteamNetworkingSend_UnreliableNoNagle |
-                k_nSteamNetworkingSend_NoDelay);
-        const auto peers = steamManager_->getPeers();
-        std::lock_guard<std::mutex> lock(statsMutex_);
-        stats_.packetsSent += peers.size();
-        stats_.bytesSent += static_cast<uint64_t>(bytesRead) * peers.size();
-        std::cout << "[SteamVPN] Broadcast " << ipToString(srcIP) << " -> "
-                  << ipToString(destIP) << " to " << peers.size() << " peers ("
-                  << bytesRead << " bytes)" << std::endl;
+        fanOutPacket(vpnPacket, vpnPacketSize, buffer,
+                     static_cast<size_t>(bytesRead), destIP);
       } else {
         CSteamID targetSteamID;
         bool found = false;
+        bool routedLocally = false;
         {
           std::lock_guard<std::mutex> lock(routingMutex_);
           auto it = routingTable_.find(destIP);
           if (it != routingTable_.end() && !it->second.isLocal) {
-            targetSteamID = it->second.steamID;
+            targetSteamID = it->second.nextHop.IsValid()
+                                ? it->second.nextHop
+                                : it->second.steamID;
             found = true;
           } else if (it != routingTable_.end() && it->second.isLocal) {
+            routedLocally = true;
             // Target is ourselves; loop back.
-            tunDevice_->write(buffer, static_cast<size_t>(bytesRead));
-            std::lock_guard<std::mutex> lock2(statsMutex_);
-            stats_.packetsReceived++;
-            stats_.bytesReceived += static_cast<uint64_t>(bytesRead);
+            if (writeToTun(buffer, static_cast<size_t>(bytesRead))) {
+              stats_.packetsReceived.add();
+              stats_.bytesReceived.add(static_cast<uint64_t>(bytesRead));
+            }
             std::cout << "[SteamVPN] Route loopback " << ipToString(srcIP)
                       << " -> " << ipToString(destIP) << " (" << bytesRead
                       << " bytes)" << std::endl;
           }
         }
         if (found) {
-          steamManager_->sendMessageToUser(
-              targetSteamID, vpnPacket, vpnPacketSize,
-              k_nSteamNetworkingSend_UnreliableNoNagle |
-                  k_nSteamNetworkingSend_NoDelay);
-          std::lock_guard<std::mutex> lock(statsMutex_);
-          stats_.packetsSent++;
-          stats_.bytesSent += static_cast<uint64_t>(bytesRead);
+          if (sendIpPacket(targetSteamID, vpnPacket, vpnPacketSize)) {
+            stats_.packetsSent.add();
+            stats_.bytesSent.add(static_cast<uint64_t>(bytesRead));
+          } else {
+            stats_.packetsDropped.add();
+          }
           // std::cout << "[SteamVPN] Sent " << ipToString(srcIP) << " -> "
           //           << ipToString(destIP) << " (" << bytesRead
           //           << " bytes) to " << targetSteamID.ConvertToUint64()
           //           << std::endl;
+        } else if (!routedLocally) {
+          dropPacket(metrics::DropReason::NoRoute);
         }
       }
     }
@@ -231,12 +284,29 @@ void SteamVpnBridge::tunReadThread() {
       std::this_thread::sleep_for(std::chrono::milliseconds(2));
     }
 
+    if (steamManager_) {
+      steamManager_->flushEgressQueues();
+    }
+
     const auto now = std::chrono::steady_clock::now();
     if (std::chrono::duration_cast<std::chrono::milliseconds>(now -
                                                               lastTimeoutCheck)
             .count() >= 50) {
       lastTimeoutCheck = now;
       ipNegotiator_.checkTimeout();
+      flushRouteDeltas();
+    }
+    if (std::chrono::duration_cast<std::chrono::milliseconds>(now -
+                                                              lastPathUpdate)
+            .count() >= PATH_REPORT_INTERVAL_MS) {
+      lastPathUpdate = now;
+      updatePaths();
+    }
+    if (std::chrono::duration_cast<std::chrono::milliseconds>(now -
+                                                              lastFecFlush)
+            .count() >= kFecFlushIntervalMs) {
+      lastFecFlush = now;
+      flushFecParity(now);
     }
   }
   std::cout << "TUN read thread stopped" << std::endl;
@@ -254,54 +324,22 @@ void SteamVpnBridge::handleVpnMessage(const uint8_t *data, size_t length,
     return;
   }
   const uint8_t *payload = data + sizeof(VpnMessageHeader);
-  const std::string peerName =
-      SteamFriends() ? SteamFriends()->GetFriendPersonaName(senderSteamID) : "";
 
   if (header.type == VpnMessageType::IP_PACKET) {
-    if (tunDevice_ && payloadLength > sizeof(VpnPacketWrapper)) {
-      VpnPacketWrapper wrapper{};
-      std::memcpy(&wrapper, payload, sizeof(VpnPacketWrapper));
-      const uint8_t *ipPacket = payload + sizeof(VpnPacketWrapper);
-      const size_t ipPacketLen = payloadLength - sizeof(VpnPacketWrapper);
-      const uint32_t destIP = extractDestIP(ipPacket, ipPacketLen);
-      const uint32_t senderIP = ntohl(wrapper.sourceIP);
-
-      CSteamID conflicting;
-      const uint32_t conflictIP = senderIP != 0 ? senderIP : destIP;
-      if (heartbeatManager_.detectConflict(conflictIP, wrapper.senderNodeId,
-                                           conflicting) &&
-          conflicting != senderSteamID) {
-        sendVpnMessage(VpnMessageType::FORCED_RELEASE, payload, payloadLength,
-                       conflicting, true);
-      }
-
-      if (destIP == localIP_ || isBroadcastAddress(destIP)) {
-        tunDevice_->write(ipPacket, ipPacketLen);
-        std::lock_guard<std::mutex> lock(statsMutex_);
-        stats_.packetsReceived++;
-        stats_.bytesReceived += ipPacketLen;
-      } else {
-        CSteamID targetSteamID;
-        bool found = false;
-        {
-          std::lock_guard<std::mutex> lock(routingMutex_);
-          auto it = routingTable_.find(destIP);
-          if (it != routingTable_.end() && !it->second.isLocal) {
-            targetSteamID = it->second.steamID;
-            found = true;
-          }
-        }
-        if (found && targetSteamID != senderSteamID) {
-          sendVpnMessage(VpnMessageType::IP_PACKET, payload, payloadLength,
-                         targetSteamID, false);
-        }
-      }
-    }
+    handleIpPacket(payload, payloadLength, senderSteamID);
     return;
   }
+  if (header.type == VpnMessageType::FEC_DATA ||
+      header.type == VpnMessageType::FEC_PARITY) {
+    handleFecMessage(header.type, payload, payloadLength, senderSteamID);
+    return;
+  }
+  const std::string peerName =
+      SteamFriends() ? SteamFriends()->GetFriendPersonaName(senderSteamID) : "";
 
   switch (header.type) {
   case VpnMessageType::ROUTE_UPDATE: {
+    // Whole tables from builds that predate ROUTE_DELTA.
     size_t offset = 0;
     while (offset + 12 <= payloadLength) {
       uint64_t steamID = 0;
@@ -312,7 +350,7 @@ void SteamVpnBridge::handleVpnMessage(const uint8_t *data, size_t length,
       offset += 12;
 
       CSteamID csteamID(static_cast<uint64>(steamID));
-      if (SteamUser() && csteamID == SteamUser()->GetSteamID()) {
+      if (csteamID == steamManager_->getLocalSteamID()) {
         continue;
       }
       {
@@ -347,21 +385,33 @@ void SteamVpnBridge::handleVpnMessage(const uint8_t *data, size_t length,
     }
     break;
   }
+  case VpnMessageType::ROUTE_DELTA: {
+    std::vector<RouteSync::Change> changes;
+    const RouteSync::Result result = routeSync_.applyDelta(
+        senderSteamID, payload, payloadLength, changes);
+    if (result == RouteSync::Result::NeedSync) {
+      sendVpnMessage(VpnMessageType::ROUTE_SYNC_REQUEST, nullptr, 0,
+                     senderSteamID, true);
+    }
+    applyRouteChanges(changes);
+    break;
+  }
+  case VpnMessageType::ROUTE_SYNC_REQUEST:
+    sendRouteSyncTo(senderSteamID);
+    break;
+  case VpnMessageType::ROUTE_SYNC: {
+    std::vector<RouteSync::Change> changes;
+    routeSync_.applySync(senderSteamID, payload, payloadLength, changes);
+    applyRouteChanges(changes);
+    break;
+  }
   case VpnMessageType::ADDRESS_ANNOUNCE: {
     if (payloadLength >= sizeof(AddressAnnouncePayload)) {
       AddressAnnouncePayload announce{};
       std::memcpy(&announce, payload, sizeof(AddressAnnouncePayload));
-      const uint32_t announcedIP = ntohl(announce.ipAddress);
-      bool isNewRoute = false;
-      {
-        std::lock_guard<std::mutex> lock(routingMutex_);
-        isNewRoute = routingTable_.find(announcedIP) == routingTable_.end();
-      }
       ipNegotiator_.handleAddressAnnounce(announce, senderSteamID, peerName);
-      updateRoute(announce.nodeId, senderSteamID, announcedIP, peerName);
-      if (isNewRoute) {
-        broadcastRouteUpdate();
-      }
+      updateRoute(announce.nodeId, senderSteamID, ntohl(announce.ipAddress),
+                  peerName, true);
     }
     break;
   }
@@ -373,6 +423,14 @@ void SteamVpnBridge::handleVpnMessage(const uint8_t *data, size_t length,
     }
     break;
   }
+  case VpnMessageType::LEASE_OFFER: {
+    if (payloadLength >= sizeof(LeaseOfferPayload)) {
+      LeaseOfferPayload offer{};
+      std::memcpy(&offer, payload, sizeof(LeaseOfferPayload));
+      ipNegotiator_.handleLeaseOffer(offer, senderSteamID);
+    }
+    break;
+  }
   case VpnMessageType::HEARTBEAT: {
     if (payloadLength >= sizeof(HeartbeatPayload)) {
       HeartbeatPayload heartbeat{};
@@ -381,32 +439,418 @@ void SteamVpnBridge::handleVpnMessage(const uint8_t *data, size_t length,
     }
     break;
   }
+  case VpnMessageType::PATH_REPORT:
+    pathSelector_.handleReport(senderSteamID, payload, payloadLength);
+    break;
   default:
     break;
   }
 }
 
+void SteamVpnBridge::handleVpnMessages(const VpnIncomingMessage *messages,
+                                       size_t count) {
+  rxBatching_ = true;
+  for (size_t i = 0; i < count; ++i) {
+    handleVpnMessage(messages[i].data, messages[i].size, messages[i].sender);
+  }
+  rxBatching_ = false;
+  flushRxBatch();
+}
+
+void SteamVpnBridge::deliverToTun(const uint8_t *data, size_t length) {
+  if (rxBatching_) {
+    rxBatch_.push_back(tun::PacketView{data, length});
+    return;
+  }
+  if (writeToTun(data, length)) {
+    stats_.packetsReceived.add();
+    stats_.bytesReceived.add(length);
+  }
+}
+
+void SteamVpnBridge::flushRxBatch() {
+  size_t offset = 0;
+  while (offset < rxBatch_.size()) {
+    const auto start = std::chrono::steady_clock::now();
+    const size_t written =
+        tunDevice_ ? tunDevice_->write_batch(rxBatch_.data() + offset,
+                                             rxBatch_.size() - offset)
+                   : 0;
+    metrics::registry().tunWrite.recordSince(start);
+    uint64_t bytes = 0;
+    for (size_t i = offset; i < offset + written; ++i) {
+      bytes += rxBatch_[i].size;
+    }
+    stats_.packetsReceived.add(written);
+    stats_.bytesReceived.add(bytes);
+    offset += written;
+    if (offset < rxBatch_.size()) {
+      dropPacket(metrics::DropReason::TunWriteFailed);
+      ++offset; // skip the packet the device refused and carry on
+    }
+  }
+  rxBatch_.clear();
+  rxOwned_.clear();
+}
+
+void SteamVpnBridge::handleIpPacket(const uint8_t *payload,
+                                    size_t payloadLength,
+                                    CSteamID senderSteamID) {
+  if (!tunDevice_ || payloadLength <= sizeof(VpnPacketWrapper)) {
+    return;
+  }
+  VpnPacketWrapper wrapper{};
+  std::memcpy(&wrapper, payload, sizeof(VpnPacketWrapper));
+  const uint8_t *ipPacket = payload + sizeof(VpnPacketWrapper);
+  const size_t ipPacketLen = payloadLength - sizeof(VpnPacketWrapper);
+  const uint32_t destIP = extractDestIP(ipPacket, ipPacketLen);
+  const uint32_t senderIP = ntohl(wrapper.sourceIP);
+
+  CSteamID conflicting;
+  const uint32_t conflictIP = senderIP != 0 ? senderIP : destIP;
+  if (heartbeatManager_.detectConflict(conflictIP, wrapper.senderNodeId,
+                                       conflicting) &&
+      conflicting != senderSteamID) {
+    sendVpnMessage(VpnMessageType::FORCED_RELEASE, payload, payloadLength,
+                   conflicting, true);
+  }
+
+  if (ippacket::version(ipPacket, ipPacketLen) == 6) {
+    handleIpv6Packet(payload, payloadLength, senderIP, senderSteamID);
+    return;
+  }
+  if (destIP == localIP_ || isBroadcastAddress(destIP)) {
+    if (multicastSnooper_.observe(senderSteamID, ipPacket, ipPacketLen)) {
+      queryMulticastGroups(senderSteamID);
+    }
+    deliverToTun(ipPacket, ipPacketLen);
+    return;
+  }
+  // Forwarded packets always take our direct session, so no path is longer
+  // than one intermediate hop.
+  CSteamID targetSteamID;
+  bool found = false;
+  {
+    std::lock_guard<std::mutex> lock(routingMutex_);
+    auto it = routingTable_.find(destIP);
+    if (it != routingTable_.end() && !it->second.isLocal) {
+      targetSteamID = it->second.steamID;
+      found = true;
+    }
+  }
+  if (found && targetSteamID != senderSteamID) {
+    forwardIpPacket(targetSteamID, payload, payloadLength);
+  } else if (!found) {
+    dropPacket(metrics::DropReason::NoRoute, senderSteamID);
+  }
+}
+
+void SteamVpnBridge::handleIpv6Packet(const uint8_t *payload,
+                                      size_t payloadLength, uint32_t senderIP,
+                                      CSteamID senderSteamID) {
+  const uint8_t *ipPacket = payload + sizeof(VpnPacketWrapper);
+  const size_t ipPacketLen = payloadLength - sizeof(VpnPacketWrapper);
+  const Ipv6Address source = ippacket::source(ipPacket);
+  const Ipv6Address destination = ippacket::destination(ipPacket);
+
+  // Link-local addresses are picked by each host's stack, so they are learned
+  // from the traffic instead of negotiated.
+  if (ippacket::isIpv6LinkLocal(source)) {
+    std::lock_guard<std::mutex> lock(routingMutex_);
+    auto it = routingTable_.find(senderIP);
+    if (it != routingTable_.end() && !it->second.isLocal) {
+      linkLocalPeers_[ippacket::interfaceId(source)] = it->second.steamID;
+    }
+  }
+
+  if (ippacket::isIpv6Multicast(destination)) {
+    if (!ippacket::isIpv6LinkControl(ipPacket, ipPacketLen)) {
+      deliverToTun(ipPacket, ipPacketLen);
+    }
+    return;
+  }
+  if (ippacket::isIpv6LinkLocal(destination) ||
+      destination == ipNegotiator_.getLocalIPv6()) {
+    deliverToTun(ipPacket, ipPacketLen);
+    return;
+  }
+  CSteamID targetSteamID;
+  bool isLocal = false;
+  if (!findIpv6Route(destination, true, targetSteamID, isLocal)) {
+    dropPacket(metrics::DropReason::NoRoute, senderSteamID);
+  } else if (isLocal) {
+    deliverToTun(ipPacket, ipPacketLen);
+  } else if (targetSteamID != senderSteamID) {
+    forwardIpPacket(targetSteamID, payload, payloadLength);
+  }
+}
+
+void SteamVpnBridge::forwardIpPacket(CSteamID targetSteamID,
+                                     const uint8_t *payload,
+                                     size_t payloadLength) {
+  PacketBuffer message(sizeof(VpnMessageHeader) + payloadLength);
+  VpnMessageHeader header{};
+  header.type = VpnMessageType::IP_PACKET;
+  header.length = htons(static_cast<uint16_t>(payloadLength));
+  std::memcpy(message.data(), &header, sizeof(VpnMessageHeader));
+  std::memcpy(message.data() + sizeof(VpnMessageHeader), payload,
+              payloadLength);
+  sendIpPacket(targetSteamID, message.data(), message.size());
+}
+
+void SteamVpnBridge::routeIpv6Packet(const uint8_t *message, uint32_t length,
+                                     const uint8_t *ipPacket,
+                                     size_t ipPacketLength) {
+  const Ipv6Address destination = ippacket::destination(ipPacket);
+  if (ippacket::isIpv6Multicast(destination)) {
+    // Neighbor discovery stays on our side of the TUN: every peer is
+    // reachable through the mesh without it.
+    if (!ippacket::isIpv6LinkControl(ipPacket, ipPacketLength)) {
+      fanOutPacket(message, length, ipPacket, ipPacketLength, 0);
+    }
+    return;
+  }
+  CSteamID targetSteamID;
+  bool isLocal = false;
+  if (!findIpv6Route(destination, false, targetSteamID, isLocal)) {
+    dropPacket(metrics::DropReason::NoRoute);
+    return;
+  }
+  if (isLocal) {
+    if (writeToTun(ipPacket, ipPacketLength)) {
+      stats_.packetsReceived.add();
+      stats_.bytesReceived.add(static_cast<uint64_t>(ipPacketLength));
+    }
+    return;
+  }
+  if (sendIpPacket(targetSteamID, message, length)) {
+    stats_.packetsSent.add();
+    stats_.bytesSent.add(static_cast<uint64_t>(ipPacketLength));
+  } else {
+    stats_.packetsDropped.add();
+  }
+}
+
+bool SteamVpnBridge::findIpv6Route(const Ipv6Address &destination,
+                                   bool direct, CSteamID &target,
+                                   bool &isLocal) const {
+  const uint64_t interfaceId = ippacket::interfaceId(destination);
+  std::lock_guard<std::mutex> lock(routingMutex_);
+  if (ippacket::isIpv6LinkLocal(destination)) {
+    auto it = linkLocalPeers_.find(interfaceId);
+    if (it == linkLocalPeers_.end()) {
+      return false;
+    }
+    target = it->second;
+    isLocal = false;
+    return true;
+  }
+  const Ipv6Address &prefix = ipNegotiator_.getIpv6Prefix();
+  if (!std::equal(prefix.begin(), prefix.begin() + 8, destination.begin())) {
+    return false;
+  }
+  auto index = ipv6Routes_.find(interfaceId);
+  if (index == ipv6Routes_.end()) {
+    return false;
+  }
+  auto it = routingTable_.find(index->second);
+  if (it == routingTable_.end()) {
+    return false;
+  }
+  isLocal = it->second.isLocal;
+  target = direct || !it->second.nextHop.IsValid() ? it->second.steamID
+                                                   : it->second.nextHop;
+  return true;
+}
+
+void SteamVpnBridge::fanOutPacket(const uint8_t *message, uint32_t length,
+                                  const uint8_t *ipPacket,
+                                  size_t ipPacketLength, uint32_t destIP) {
+  size_t copies = 0;
+  if (MulticastSnooper::isMulticast(destIP) &&
+      !MulticastSnooper::isFlooded(ipPacket, ipPacketLength)) {
+    copies = steamManager_->broadcastMessage(
+        message, length, kUnreliableFlags, [this, destIP](CSteamID peer) {
+          return multicastSnooper_.wants(peer, destIP);
+        });
+  } else {
+    copies = steamManager_->broadcastMessage(message, length, kUnreliableFlags);
+  }
+  stats_.packetsSent.add(copies);
+  stats_.bytesSent.add(static_cast<uint64_t>(ipPacketLength) * copies);
+
+  // LAN discovery can send these many times a second; summarise instead.
+  ++fanOutPackets_;
+  fanOutCopies_ += copies;
+  const auto now = std::chrono::steady_clock::now();
+  if (now - lastFanOutLog_ >= kFanOutLogInterval) {
+    std::cout << "[SteamVPN] Broadcast/multicast: " << fanOutPackets_
+              << " packets, " << fanOutCopies_ << " copies sent (last -> "
+              << (destIP != 0 ? ipToString(destIP) : "IPv6") << ")"
+              << std::endl;
+    fanOutPackets_ = 0;
+    fanOutCopies_ = 0;
+    lastFanOutLog_ = now;
+  }
+}
+
+void SteamVpnBridge::handleFecMessage(VpnMessageType type,
+                                      const uint8_t *payload,
+                                      size_t payloadLength,
+                                      CSteamID senderSteamID) {
+  if (payloadLength <= sizeof(FecHeader)) {
+    return;
+  }
+  FecHeader fec{};
+  std::memcpy(&fec, payload, sizeof(FecHeader));
+  const uint8_t *body = payload + sizeof(FecHeader);
+  const size_t bodyLength = payloadLength - sizeof(FecHeader);
+  std::vector<uint8_t> recovered;
+  bool deliver = false;
+  {
+    std::lock_guard<std::mutex> lock(fecReceiveMutex_);
+    FecDecoder &decoder = fecDecoders_[senderSteamID];
+    if (type == VpnMessageType::FEC_DATA) {
+      deliver = decoder.onData(fec, body, bodyLength, recovered);
+    } else {
+      decoder.onParity(fec, body, bodyLength, recovered);
+    }
+  }
+  if (deliver) {
+    handleIpPacket(body, bodyLength, senderSteamID);
+  }
+  if (!recovered.empty()) {
+    stats_.packetsRecovered.add();
+    metrics::registry().fecRecoveredPackets.add();
+    if (rxBatching_) {
+      // Queued packets are written after the batch, so keep this one alive.
+      rxOwned_.push_back(std::move(recovered));
+      handleIpPacket(rxOwned_.back().data(), rxOwned_.back().size(),
+                     senderSteamID);
+    } else {
+      handleIpPacket(recovered.data(), recovered.size(), senderSteamID);
+    }
+  }
+}
+
+bool SteamVpnBridge::sendIpPacket(CSteamID targetSteamID,
+                                  const uint8_t *message, size_t length) {
+  const size_t headerBytes =
+      sizeof(VpnMessageHeader) + sizeof(VpnPacketWrapper);
+  const uint8_t *ipPacket = message + headerBytes;
+  const size_t ipPacketLength = length > headerBytes ? length - headerBytes : 0;
+  uint32_t flowHash = 0;
+  TrafficClass trafficClass = TrafficClass::Default;
+  if (ippacket::version(ipPacket, ipPacketLength) != 0) {
+    flowHash = ippacket::flowHash(ipPacket, ipPacketLength);
+    trafficClass = classifier_.classify(ipPacket, ipPacketLength);
+  }
+  if (classifier_.config(trafficClass).reliable) {
+    // Retransmitted by Steam instead, so parity would only add overhead.
+    const bool sent = steamManager_->sendMessageToUser(
+        targetSteamID, message, static_cast<uint32_t>(length),
+        kReliableIpFlags, flowHash, trafficClass);
+    if (sent) {
+      metrics::ClassMetrics &classMetrics =
+          metrics::registry().trafficClass(trafficClass);
+      classMetrics.txPackets.add();
+      classMetrics.txBytes.add(length);
+    }
+    return sent;
+  }
+  if (fecEnabled_) {
+    std::lock_guard<std::mutex> lock(fecSendMutex_);
+    auto it = fecEncoders_.find(targetSteamID);
+    if (it != fecEncoders_.end() && it->second.groupSize() > 0) {
+      const uint8_t *payload = message + sizeof(VpnMessageHeader);
+      const size_t payloadLength = length - sizeof(VpnMessageHeader);
+      const FecHeader fec = it->second.addData(payload, payloadLength);
+      VpnMessageHeader header{};
+      header.type = VpnMessageType::FEC_DATA;
+      header.length =
+          htons(static_cast<uint16_t>(sizeof(FecHeader) + payloadLength));
+      fecScratch_.resize(sizeof(VpnMessageHeader) + sizeof(FecHeader) +
+                         payloadLength);
+      std::memcpy(fecScratch_.data(), &header, sizeof(VpnMessageHeader));
+      std::memcpy(fecScratch_.data() + sizeof(VpnMessageHeader), &fec,
+                  sizeof(FecHeader));
+      std::memcpy(fecScratch_.data() + sizeof(VpnMessageHeader) +
+                      sizeof(FecHeader),
+                  payload, payloadLength);
+      const bool sent = steamManager_->sendMessageToUser(
+          targetSteamID, fecScratch_.data(),
+          static_cast<uint32_t>(fecScratch_.size()), kUnreliableFlags,
+          flowHash, trafficClass);
+      while (it->second.takeParity(std::chrono::steady_clock::now(),
+                                   fecParity_)) {
+        sendVpnMessage(VpnMessageType::FEC_PARITY, fecParity_.data(),
+                       fecParity_.size(), targetSteamID, false);
+        metrics::registry().fecParityPackets.add();
+      }
+      return sent;
+    }
+  }
+  return steamManager_->sendMessageToUser(targetSteamID, message,
+                                          static_cast<uint32_t>(length),
+                                          kUnreliableFlags, flowHash,
+                                          trafficClass);
+}
+
+void SteamVpnBridge::flushFecParity(std::chrono::steady_clock::time_point now) {
+  std::lock_guard<std::mutex> lock(fecSendMutex_);
+  for (auto &kv : fecEncoders_) {
+    while (kv.second.takeParity(now, fecParity_)) {
+      sendVpnMessage(VpnMessageType::FEC_PARITY, fecParity_.data(),
+                     fecParity_.size(), kv.first, false);
+      metrics::registry().fecParityPackets.add();
+    }
+  }
+}
+
 void SteamVpnBridge::onUserJoined(CSteamID steamID) {
+  if (fecEnabled_) {
+    startFec(steamID);
+  }
   if (ipNegotiator_.getState() == NegotiationState::STABLE) {
     std::cout << "[SteamVPN] New peer joined, sending address/route: "
               << steamID.ConvertToUint64() << std::endl;
     ipNegotiator_.sendAddressAnnounceTo(steamID);
-    sendRouteUpdateTo(steamID);
+    sendRouteSyncTo(steamID);
+    ipNegotiator_.offerLeaseTo(steamID);
+    queryMulticastGroups(steamID);
   }
 }
 
 void SteamVpnBridge::onUserLeft(CSteamID steamID) {
+  pathSelector_.removePeer(steamID);
+  multicastSnooper_.removePeer(steamID);
+  routeSync_.removePeer(steamID);
+  {
+    std::lock_guard<std::mutex> lock(fecSendMutex_);
+    fecEncoders_.erase(steamID);
+  }
+  {
+    std::lock_guard<std::mutex> lock(fecReceiveMutex_);
+    fecDecoders_.erase(steamID);
+  }
   std::lock_guard<std::mutex> lock(routingMutex_);
+  for (auto it = linkLocalPeers_.begin(); it != linkLocalPeers_.end();) {
+    it = it->second == steamID ? linkLocalPeers_.erase(it) : std::next(it);
+  }
   for (auto it = routingTable_.begin(); it != routingTable_.end();) {
     if (it->second.steamID == steamID) {
       heartbeatManager_.unregisterNode(it->second.nodeId);
       ipNegotiator_.markIPUnused(it->first);
-      it = routingTable_.erase(it);
+      routeSync_.remove(it->first, true);
+      it = eraseRoute(it);
     } else {
+      if (it->second.nextHop == steamID) {
+        it->second.nextHop = it->second.steamID;
+      }
       ++it;
     }
   }
-  if (SteamUser() && steamID == SteamUser()->GetSteamID()) {
+  if (steamID == steamManager_->getLocalSteamID()) {
     running_ = false;
     heartbeatManager_.stop();
     if (tunDevice_) {
@@ -417,8 +861,32 @@ void SteamVpnBridge::onUserLeft(CSteamID steamID) {
 }
 
 SteamVpnBridge::Statistics SteamVpnBridge::getStatistics() const {
-  std::lock_guard<std::mutex> lock(statsMutex_);
-  return stats_;
+  Statistics stats;
+  stats.packetsSent = stats_.packetsSent.value();
+  stats.packetsReceived = stats_.packetsReceived.value();
+  stats.bytesSent = stats_.bytesSent.value();
+  stats.bytesReceived = stats_.bytesReceived.value();
+  stats.packetsDropped = stats_.packetsDropped.value();
+  stats.packetsRecovered = stats_.packetsRecovered.value();
+  return stats;
+}
+
+bool SteamVpnBridge::writeToTun(const uint8_t *data, size_t length) {
+  const auto start = std::chrono::steady_clock::now();
+  const int written = tunDevice_ ? tunDevice_->write(data, length) : -1;
+  metrics::registry().tunWrite.recordSince(start);
+  if (written < 0) {
+    dropPacket(metrics::DropReason::TunWriteFailed);
+    return false;
+  }
+  return true;
+}
+
+void SteamVpnBridge::dropPacket(metrics::DropReason reason, CSteamID peer) {
+  stats_.packetsDropped.add();
+  metrics::registry().recordDrop(reason, peer.IsValid()
+                                             ? peer.ConvertToUint64()
+                                             : 0);
 }
 
 void SteamVpnBridge::rebroadcastState() {
@@ -427,7 +895,7 @@ void SteamVpnBridge::rebroadcastState() {
   }
   std::cout << "[SteamVPN] Rebroadcasting address and routes" << std::endl;
   ipNegotiator_.sendAddressAnnounce();
-  broadcastRouteUpdate();
+  broadcastRouteSync();
 }
 
 void SteamVpnBridge::onNegotiationSuccess(uint32_t ipAddress,
@@ -446,16 +914,25 @@ void SteamVpnBridge::onNegotiationSuccess(uint32_t ipAddress,
                 << subnetMaskStr << " via " << tunDevice_->get_device_name()
                 << std::endl;
     }
+    const std::string localIPv6Str = ipv6ToString(ipNegotiator_.getLocalIPv6());
+    if (!tunDevice_->set_ipv6(localIPv6Str, kIpv6PrefixLength)) {
+      std::cerr << "Failed to set IPv6 address " << localIPv6Str << "/"
+                << kIpv6PrefixLength << ": " << tunDevice_->get_last_error()
+                << std::endl;
+    }
 
-    const CSteamID mySteamID = SteamUser()->GetSteamID();
+    const CSteamID mySteamID = steamManager_->getLocalSteamID();
     updateRoute(nodeId, mySteamID, localIP_,
-                SteamFriends() ? SteamFriends()->GetPersonaName() : "");
+                SteamFriends() ? SteamFriends()->GetPersonaName() : "", true);
     heartbeatManager_.initialize(nodeId, localIP_);
     heartbeatManager_.registerNode(
         nodeId, mySteamID, localIP_,
         SteamFriends() ? SteamFriends()->GetPersonaName() : "");
     heartbeatManager_.start();
-    broadcastRouteUpdate();
+    // Groups the peers joined before we could see their reports.
+    for (const auto &peer : steamManager_->getPeers()) {
+      queryMulticastGroups(peer);
+    }
   } else {
     std::cerr << "Failed to configure TUN device IP." << std::endl;
     stop();
@@ -468,24 +945,35 @@ void SteamVpnBridge::onNodeExpired(const NodeID &nodeId, uint32_t ipAddress) {
 }
 
 void SteamVpnBridge::updateRoute(const NodeID &nodeId, CSteamID steamId,
-                                 uint32_t ipAddress, const std::string &name) {
+                                 uint32_t ipAddress, const std::string &name,
+                                 bool share) {
   RouteEntry entry;
   entry.steamID = steamId;
   entry.ipAddress = ipAddress;
   entry.name = name;
-  entry.isLocal = (SteamUser() && steamId == SteamUser()->GetSteamID());
+  entry.isLocal = (steamId == steamManager_->getLocalSteamID());
   entry.nodeId = nodeId;
+  const PathChoice path = pathSelector_.choice(steamId);
+  entry.nextHop = entry.isLocal ? steamId : path.nextHop;
+  entry.pathCostMs = entry.isLocal ? 0 : path.costMs;
 
   {
     std::lock_guard<std::mutex> lock(routingMutex_);
     for (auto it = routingTable_.begin(); it != routingTable_.end();) {
       if (it->second.steamID == steamId && it->first != ipAddress) {
-        it = routingTable_.erase(it);
+        routeSync_.remove(it->first, share);
+        it = eraseRoute(it);
       } else {
         ++it;
       }
     }
+    auto previous = routingTable_.find(ipAddress);
+    if (previous != routingTable_.end() && previous->second.nodeId != nodeId) {
+      eraseRoute(previous);
+    }
     routingTable_[ipAddress] = entry;
+    ipv6Routes_[IpNegotiator::interfaceIdFor(nodeId)] = ipAddress;
+    routeSync_.add(steamId.ConvertToUint64(), ipAddress, share);
   }
   ipNegotiator_.markIPUsed(ipAddress);
   std::cout << "Route updated: " << ipToString(ipAddress) << " -> " << name
@@ -494,73 +982,179 @@ void SteamVpnBridge::updateRoute(const NodeID &nodeId, CSteamID steamId,
 
 void SteamVpnBridge::removeRoute(uint32_t ipAddress) {
   std::lock_guard<std::mutex> lock(routingMutex_);
-  routingTable_.erase(ipAddress);
+  auto it = routingTable_.find(ipAddress);
+  if (it != routingTable_.end()) {
+    eraseRoute(it);
+  }
+  routeSync_.remove(ipAddress, true);
 }
 
-void SteamVpnBridge::broadcastRouteUpdate() {
-  std::vector<uint8_t> message;
-  std::vector<uint8_t> routeData;
+std::map<uint32_t, RouteEntry>::iterator
+SteamVpnBridge::eraseRoute(std::map<uint32_t, RouteEntry>::iterator it) {
+  auto index =
+      ipv6Routes_.find(IpNegotiator::interfaceIdFor(it->second.nodeId));
+  if (index != ipv6Routes_.end() && index->second == it->first) {
+    ipv6Routes_.erase(index);
+  }
+  return routingTable_.erase(it);
+}
 
-  {
-    std::lock_guard<std::mutex> lock(routingMutex_);
-    for (const auto &entry : routingTable_) {
-      const uint64_t steamID = entry.second.steamID.ConvertToUint64();
-      const uint32_t ipAddress = htonl(entry.second.ipAddress);
-      const size_t offset = routeData.size();
-      routeData.resize(offset + 12);
-      std::memcpy(routeData.data() + offset, &steamID, 8);
-      std::memcpy(routeData.data() + offset + 8, &ipAddress, 4);
+void SteamVpnBridge::applyRouteChanges(
+    const std::vector<RouteSync::Change> &changes) {
+  if (changes.empty()) {
+    return;
+  }
+  const CSteamID mySteamID = steamManager_->getLocalSteamID();
+  const std::set<CSteamID> peers = steamManager_->getPeers();
+  for (const auto &change : changes) {
+    const CSteamID steamID(static_cast<uint64>(change.steamId));
+    if (steamID == mySteamID ||
+        (change.ipAddress & subnetMask_) != (baseIP_ & subnetMask_)) {
+      continue;
+    }
+    if (change.removed) {
+      // A peer we still have a session with speaks for itself.
+      if (peers.count(steamID)) {
+        continue;
+      }
+      {
+        std::lock_guard<std::mutex> lock(routingMutex_);
+        auto it = routingTable_.find(change.ipAddress);
+        if (it == routingTable_.end() || it->second.steamID != steamID ||
+            it->second.isLocal) {
+          continue;
+        }
+        eraseRoute(it);
+        routeSync_.remove(change.ipAddress, false);
+      }
+      ipNegotiator_.markIPUnused(change.ipAddress);
+      continue;
     }
+    {
+      std::lock_guard<std::mutex> lock(routingMutex_);
+      if (routingTable_.find(change.ipAddress) != routingTable_.end()) {
+        continue;
+      }
+    }
+    updateRoute(NodeIdentity::generate(steamID), steamID, change.ipAddress,
+                SteamFriends() ? SteamFriends()->GetFriendPersonaName(steamID)
+                               : "");
   }
+}
 
-  VpnMessageHeader header{};
-  header.type = VpnMessageType::ROUTE_UPDATE;
-  header.length = htons(static_cast<uint16_t>(routeData.size()));
+void SteamVpnBridge::updatePaths() {
+  for (const auto &peer : steamManager_->getPeers()) {
+    PathSample sample;
+    if (!steamManager_->getPeerPath(peer, sample)) {
+      sample.updated = std::chrono::steady_clock::now();
+    }
+    pathSelector_.updateDirect(peer, sample);
+    if (fecEnabled_) {
+      updateFec(peer, sample);
+    }
+  }
+  const std::vector<uint8_t> report = pathSelector_.buildReport();
+  if (!report.empty()) {
+    broadcastVpnMessage(VpnMessageType::PATH_REPORT, report.data(),
+                        report.size(), false);
+  }
+  pathSelector_.recompute(std::chrono::steady_clock::now());
+  applyPathChoices();
+}
 
-  message.resize(sizeof(VpnMessageHeader) + routeData.size());
-  std::memcpy(message.data(), &header, sizeof(VpnMessageHeader));
-  if (!routeData.empty()) {
-    std::memcpy(message.data() + sizeof(VpnMessageHeader), routeData.data(),
-                routeData.size());
+void SteamVpnBridge::updateFec(CSteamID peer, const PathSample &sample) {
+  if (sample.pingMs < 0) {
+    return; // not measured yet; keep what startFec() chose
   }
-  std::cout << "[SteamVPN] Broadcasting route update with "
-            << (routeData.size() / 12) << " entries" << std::endl;
-  steamManager_->broadcastMessage(message.data(),
-                                  static_cast<uint32_t>(message.size()),
-                                  k_nSteamNetworkingSend_Reliable);
+  // Steam's quality figure is measured below us, so our own parity does not
+  // hide the loss it is compensating for.
+  const int groupSize = FecEncoder::groupSizeForLoss(1.0 - sample.quality);
+  std::lock_guard<std::mutex> lock(fecSendMutex_);
+  auto it = fecEncoders_.find(peer);
+  const int current = it != fecEncoders_.end() ? it->second.groupSize() : 0;
+  if (groupSize == current) {
+    return;
+  }
+  if (it == fecEncoders_.end()) {
+    it = fecEncoders_.emplace(peer, FecEncoder()).first;
+  }
+  it->second.setGroupSize(groupSize);
+  std::cout << "[SteamVPN] FEC to " << peer.ConvertToUint64();
+  if (groupSize > 0) {
+    std::cout << ": 1 parity per " << groupSize << " packets";
+  } else {
+    std::cout << " off";
+  }
+  std::cout << " (" << (1.0f - sample.quality) * 100.0f << "% loss)"
+            << std::endl;
 }
 
-void SteamVpnBridge::sendRouteUpdateTo(CSteamID targetSteamID) {
-  std::vector<uint8_t> message;
-  std::vector<uint8_t> routeData;
-  {
-    std::lock_guard<std::mutex> lock(routingMutex_);
-    for (const auto &entry : routingTable_) {
-      const uint64_t steamID = entry.second.steamID.ConvertToUint64();
-      const uint32_t ipAddress = htonl(entry.second.ipAddress);
-      const size_t offset = routeData.size();
-      routeData.resize(offset + 12);
-      std::memcpy(routeData.data() + offset, &steamID, 8);
-      std::memcpy(routeData.data() + offset + 8, &ipAddress, 4);
-    }
+void SteamVpnBridge::startFec(CSteamID peer) {
+  std::lock_guard<std::mutex> lock(fecSendMutex_);
+  FecEncoder &encoder = fecEncoders_[peer];
+  if (encoder.groupSize() == 0) {
+    encoder.setGroupSize(FecEncoder::kInitialGroupSize);
   }
+}
 
-  VpnMessageHeader header{};
-  header.type = VpnMessageType::ROUTE_UPDATE;
-  header.length = htons(static_cast<uint16_t>(routeData.size()));
+void SteamVpnBridge::queryMulticastGroups(CSteamID peer) {
+  multicastSnooper_.startQuery(peer);
+  if (localIP_ == 0) {
+    return; // the round still floods; the peer is queried once we have an IP
+  }
+  const std::vector<uint8_t> query = MulticastSnooper::buildQuery(localIP_);
+  std::vector<uint8_t> payload(sizeof(VpnPacketWrapper) + query.size());
+  VpnPacketWrapper wrapper{};
+  wrapper.senderNodeId = ipNegotiator_.getLocalNodeID();
+  wrapper.sourceIP = htonl(localIP_);
+  std::memcpy(payload.data(), &wrapper, sizeof(VpnPacketWrapper));
+  std::memcpy(payload.data() + sizeof(VpnPacketWrapper), query.data(),
+              query.size());
+  sendVpnMessage(VpnMessageType::IP_PACKET, payload.data(), payload.size(),
+                 peer);
+}
 
-  message.resize(sizeof(VpnMessageHeader) + routeData.size());
-  std::memcpy(message.data(), &header, sizeof(VpnMessageHeader));
-  if (!routeData.empty()) {
-    std::memcpy(message.data() + sizeof(VpnMessageHeader), routeData.data(),
-                routeData.size());
+void SteamVpnBridge::applyPathChoices() {
+  std::lock_guard<std::mutex> lock(routingMutex_);
+  for (auto &kv : routingTable_) {
+    RouteEntry &entry = kv.second;
+    if (entry.isLocal) {
+      continue;
+    }
+    const PathChoice path = pathSelector_.choice(entry.steamID);
+    entry.nextHop = path.nextHop;
+    entry.pathCostMs = path.costMs;
+  }
+}
+
+void SteamVpnBridge::flushRouteDeltas() {
+  for (const auto &delta : routeSync_.takeDeltas()) {
+    std::cout << "[SteamVPN] Broadcasting route delta with "
+              << (delta.size() - sizeof(RouteDeltaHeader)) /
+                     sizeof(RouteChange)
+              << " changes" << std::endl;
+    broadcastVpnMessage(VpnMessageType::ROUTE_DELTA, delta.data(),
+                        delta.size(), true);
   }
-  std::cout << "[SteamVPN] Sending route update to "
+}
+
+void SteamVpnBridge::sendRouteSyncTo(CSteamID targetSteamID) {
+  std::cout << "[SteamVPN] Sending route sync to "
             << targetSteamID.ConvertToUint64() << " with "
-            << (routeData.size() / 12) << " entries" << std::endl;
-  steamManager_->sendMessageToUser(targetSteamID, message.data(),
-                                   static_cast<uint32_t>(message.size()),
-                                   k_nSteamNetworkingSend_Reliable);
+            << routeSync_.size() << " entries" << std::endl;
+  for (const auto &part : routeSync_.buildSync()) {
+    sendVpnMessage(VpnMessageType::ROUTE_SYNC, part.data(), part.size(),
+                   targetSteamID, true);
+  }
+}
+
+void SteamVpnBridge::broadcastRouteSync() {
+  std::cout << "[SteamVPN] Broadcasting route sync with "
+            << routeSync_.size() << " entries" << std::endl;
+  for (const auto &part : routeSync_.buildSync()) {
+    broadcastVpnMessage(VpnMessageType::ROUTE_SYNC, part.data(), part.size(),
+                        true);
+  }
 }
 
 void SteamVpnBridge::sendVpnMessage(VpnMessageType type, const uint8_t *payload,
@@ -569,11 +1163,10 @@ void SteamVpnBridge::sendVpnMessage(VpnMessageType type, const uint8_t *payload,
   if (!steamManager_) {
     return;
   }
-  std::vector<uint8_t> message;
+  PacketBuffer message(sizeof(VpnMessageHeader) + payloadLength);
   VpnMessageHeader header{};
   header.type = type;
   header.length = htons(static_cast<uint16_t>(payloadLength));
-  message.resize(sizeof(VpnMessageHeader) + payloadLength);
   std::memcpy(message.data(), &header, sizeof(VpnMessageHeader));
   if (payloadLength > 0 && payload) {
     std::memcpy(message.data() + sizeof(VpnMessageHeader), payload,
@@ -593,11 +1186,10 @@ void SteamVpnBridge::broadcastVpnMessage(VpnMessageType type,
   if (!steamManager_) {
     return;
   }
-  std::vector<uint8_t> message;
+  PacketBuffer message(sizeof(VpnMessageHeader) + payloadLength);
   VpnMessageHeader header{};
   header.type = type;
   header.length = htons(static_cast<uint16_t>(payloadLength));
-  message.resize(sizeof(VpnMessageHeader) + payloadLength);
   std::memcpy(message.data(), &header, sizeof(VpnMessageHeader));
   if (payloadLength > 0 && payload) {
     std::memcpy(message.data() + sizeof(VpnMessageHeader), payload,
@@ -618,6 +1210,14 @@ std::string SteamVpnBridge::ipToString(uint32_t ip) {
   return std::string(buffer);
 }
 
+std::string SteamVpnBridge::ipv6ToString(const Ipv6Address &ip) {
+  char buffer[INET6_ADDRSTRLEN];
+  in6_addr addr{};
+  std::memcpy(&addr, ip.data(), ip.size());
+  inet_ntop(AF_INET6, &addr, buffer, INET6_ADDRSTRLEN);
+  return std::string(buffer);
+}
+
 uint32_t SteamVpnBridge::stringToIp(const std::string &ipStr) {
   in_addr addr{};
   if (inet_pton(AF_INET, ipStr.c_str(), &addr) == 1) {
@@ -627,11 +1227,7 @@ uint32_t SteamVpnBridge::stringToIp(const std::string &ipStr) {
 }
 
 uint32_t SteamVpnBridge::extractDestIP(const uint8_t *packet, size_t length) {
-  if (length < 20) {
-    return 0;
-  }
-  const uint8_t version = (packet[0] >> 4) & 0x0F;
-  if (version != 4) {
+  if (ippacket::version(packet, length) != 4) {
     return 0;
   }
   uint32_t destIP = 0;
@@ -640,11 +1236,7 @@ uint32_t SteamVpnBridge::extractDestIP(const uint8_t *packet, size_t length) {
 }
 
 uint32_t SteamVpnBridge::extractSourceIP(const uint8_t *packet, size_t length) {
-  if (length < 20) {
-    return 0;
-  }
-  const uint8_t version = (packet[0] >> 4) & 0x0F;
-  if (version != 4) {
+  if (ippacket::version(packet, length) != 4) {
     return 0;
   }
   uint32_t srcIP = 0;
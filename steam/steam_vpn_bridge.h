@@ -1,24 +1,41 @@
 #pragma once
 
+#include "../net/fec.h"
 #include "../net/heartbeat_manager.h"
 #include "../net/ip_negotiator.h"
+#include "../net/metrics.h"
+#include "../net/multicast_snooper.h"
+#include "../net/path_selector.h"
+#include "../net/route_sync.h"
+#include "../net/traffic_classifier.h"
 #include "../net/vpn_protocol.h"
 #include "../tun/tun_interface.h"
 #include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 class SteamVpnNetworkingManager;
 
 class SteamVpnBridge {
 public:
+  using TunFactory = std::function<std::unique_ptr<tun::TunInterface>()>;
+
   SteamVpnBridge(SteamVpnNetworkingManager *steamManager);
   ~SteamVpnBridge();
 
+  // Overrides tun::create_tun() for the next start(); used by the benchmark
+  // to run the bridge against an in-memory device.
+  void setTunFactory(TunFactory factory) { tunFactory_ = std::move(factory); }
+
   bool start(const std::string &tunDeviceName = "",
              const std::string &virtualSubnet = "10.0.0.0",
              const std::string &subnetMask = "255.0.0.0", int mtu = 1400);
@@ -26,17 +43,30 @@ public:
 
   bool isRunning() const { return running_; }
 
+  // Protects unreliable IP traffic with XOR parity sized to each peer's
+  // measured loss. Off by default; received FEC traffic is always decoded.
+  void setFecEnabled(bool enabled);
+  bool isFecEnabled() const { return fecEnabled_; }
+
+  // Classes TUN packets into egress lanes and passes the lane priorities and
+  // weights on to the networking manager. Set before start().
+  void setTrafficClassifier(const TrafficClassifier &classifier);
+
   std::string getLocalIP() const;
   std::string getTunDeviceName() const;
   std::map<uint32_t, RouteEntry> getRoutingTable() const;
 
   void handleVpnMessage(const uint8_t *data, size_t length,
                         CSteamID senderSteamID);
+  // Handles a receive batch; the IP packets it carries for us reach the TUN
+  // device in one write_batch() after the last message.
+  void handleVpnMessages(const VpnIncomingMessage *messages, size_t count);
   void onUserJoined(CSteamID steamID);
   void onUserLeft(CSteamID steamID);
   // Force-send our current address/route to all peers (used after reconnect).
   void rebroadcastState();
   static std::string ipToString(uint32_t ip);
+  static std::string ipv6ToString(const Ipv6Address &ip);
 
   struct Statistics {
     uint64_t packetsSent = 0;
@@ -44,11 +74,47 @@ public:
     uint64_t bytesSent = 0;
     uint64_t bytesReceived = 0;
     uint64_t packetsDropped = 0;
+    uint64_t packetsRecovered = 0; // rebuilt from FEC parity
   };
   Statistics getStatistics() const;
 
 private:
   void tunReadThread();
+  // Writes one IP packet to the TUN device, recording latency and failures.
+  bool writeToTun(const uint8_t *data, size_t length);
+  void dropPacket(metrics::DropReason reason, CSteamID peer = CSteamID());
+  // Queues a received packet for the TUN device while a receive batch is
+  // being handled, or writes it straight away otherwise.
+  void deliverToTun(const uint8_t *data, size_t length);
+  void flushRxBatch();
+  // Delivers or forwards an IP_PACKET payload received from a peer.
+  void handleIpPacket(const uint8_t *payload, size_t payloadLength,
+                      CSteamID senderSteamID);
+  void handleIpv6Packet(const uint8_t *payload, size_t payloadLength,
+                        uint32_t senderIP, CSteamID senderSteamID);
+  // Re-sends a received IP_PACKET payload on our direct session to target.
+  void forwardIpPacket(CSteamID targetSteamID, const uint8_t *payload,
+                       size_t payloadLength);
+  // Sends an IPv6 packet read from the TUN to the peer owning its address.
+  void routeIpv6Packet(const uint8_t *message, uint32_t length,
+                       const uint8_t *ipPacket, size_t ipPacketLength);
+  // Resolves a ULA or learned link-local address; direct skips the relay
+  // picked by the path selector, as forwarding does for IPv4.
+  bool findIpv6Route(const Ipv6Address &destination, bool direct,
+                     CSteamID &target, bool &isLocal) const;
+  // Sends a complete IP_PACKET message in its traffic class's lane, keyed to
+  // the packet's flow for the egress queue: unreliably, as FEC_DATA plus
+  // parity when FEC is on for that peer, or reliably when the class says so.
+  bool sendIpPacket(CSteamID targetSteamID, const uint8_t *message,
+                    size_t length);
+  void flushFecParity(std::chrono::steady_clock::time_point now);
+  // Sends a broadcast or multicast packet read from the TUN to every peer
+  // that should see it, as one batch.
+  void fanOutPacket(const uint8_t *message, uint32_t length,
+                    const uint8_t *ipPacket, size_t ipPacketLength,
+                    uint32_t destIP);
+  void handleFecMessage(VpnMessageType type, const uint8_t *payload,
+                        size_t payloadLength, CSteamID senderSteamID);
 
   static uint32_t stringToIp(const std::string &ipStr);
   static uint32_t extractDestIP(const uint8_t *packet, size_t length);
@@ -63,27 +129,80 @@ private:
 
   void onNegotiationSuccess(uint32_t ipAddress, const NodeID &nodeId);
   void onNodeExpired(const NodeID &nodeId, uint32_t ipAddress);
+  // share puts the change in our next ROUTE_DELTA; routes learned from
+  // another peer's delta or sync are not passed on.
   void updateRoute(const NodeID &nodeId, CSteamID steamId, uint32_t ipAddress,
-                   const std::string &name);
+                   const std::string &name, bool share = false);
   void removeRoute(uint32_t ipAddress);
-  void broadcastRouteUpdate();
-  void sendRouteUpdateTo(CSteamID targetSteamID);
+  // Erases a routing table entry and its ipv6Routes_ index together; caller
+  // holds routingMutex_.
+  std::map<uint32_t, RouteEntry>::iterator
+  eraseRoute(std::map<uint32_t, RouteEntry>::iterator it);
+  void applyRouteChanges(const std::vector<RouteSync::Change> &changes);
+  void flushRouteDeltas();
+  void sendRouteSyncTo(CSteamID targetSteamID);
+  void broadcastRouteSync();
+  // Measures our sessions, shares them with peers and re-picks next hops.
+  void updatePaths();
+  void applyPathChoices();
+  // Sizes the FEC groups for a peer from the loss seen on its session.
+  void updateFec(CSteamID peer, const PathSample &sample);
+  // Protects a new peer at FecEncoder::kInitialGroupSize until updateFec()
+  // has a measurement for it.
+  void startFec(CSteamID peer);
+  // Sends peer an IGMP general query and floods it every group until the
+  // answers are in (see MulticastSnooper).
+  void queryMulticastGroups(CSteamID peer);
 
   SteamVpnNetworkingManager *steamManager_;
   std::unique_ptr<tun::TunInterface> tunDevice_;
+  TunFactory tunFactory_;
   std::atomic<bool> running_;
   std::unique_ptr<std::thread> tunReadThread_;
 
   std::map<uint32_t, RouteEntry> routingTable_;
+  // IPv6 interface ID -> routingTable_ key, and link-local interface IDs seen
+  // on received traffic -> the peer that sent them. Both under routingMutex_.
+  std::unordered_map<uint64_t, uint32_t> ipv6Routes_;
+  std::unordered_map<uint64_t, CSteamID> linkLocalPeers_;
   mutable std::mutex routingMutex_;
 
   uint32_t baseIP_;
   uint32_t subnetMask_;
   uint32_t localIP_;
 
-  Statistics stats_;
-  mutable std::mutex statsMutex_;
+  struct StatCounters {
+    metrics::Counter packetsSent;
+    metrics::Counter packetsReceived;
+    metrics::Counter bytesSent;
+    metrics::Counter bytesReceived;
+    metrics::Counter packetsDropped;
+    metrics::Counter packetsRecovered;
+  };
+  StatCounters stats_;
 
   IpNegotiator ipNegotiator_;
   HeartbeatManager heartbeatManager_;
+  PathSelector pathSelector_;
+  MulticastSnooper multicastSnooper_;
+  TrafficClassifier classifier_;
+  RouteSync routeSync_;
+
+  // Fan-out log summary, only touched by the TUN read thread.
+  uint64_t fanOutPackets_ = 0;
+  uint64_t fanOutCopies_ = 0;
+  std::chrono::steady_clock::time_point lastFanOutLog_;
+
+  std::atomic<bool> fecEnabled_{false};
+  std::map<CSteamID, FecEncoder> fecEncoders_;
+  std::vector<uint8_t> fecScratch_; // FEC_DATA being sent, under fecSendMutex_
+  std::vector<uint8_t> fecParity_;
+  std::mutex fecSendMutex_;
+  std::map<CSteamID, FecDecoder> fecDecoders_;
+  std::mutex fecReceiveMutex_;
+
+  // Receive batch state, only touched by the message handler thread.
+  bool rxBatching_ = false;
+  std::vector<tun::PacketView> rxBatch_;
+  std::deque<std::vector<uint8_t>> rxOwned_; // FEC-rebuilt packets in rxBatch_
 };
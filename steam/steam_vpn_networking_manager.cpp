@@ -1,16 +1,93 @@
 #include "steam_vpn_networking_manager.h"
+#include "steam_transport.h"
 #include "steam_vpn_bridge.h"
 #include "vpn_message_handler.h"
+#include "../net/metrics.h"
 #include "../net/vpn_protocol.h"
 
 #include <algorithm>
+#include <array>
 #include <iostream>
 #include <steam_api.h>
 #include <isteamnetworkingutils.h>
 
+namespace {
+constexpr std::chrono::milliseconds kRateUpdateInterval{20};
+// Data we let the transport queue for a peer, in time at its send rate; the
+// floor keeps the rate controller from mistaking a managed backlog for an
+// application-limited sender.
+constexpr std::chrono::milliseconds kTransportQueueTarget{10};
+constexpr std::size_t kMinTransportBudget = 32 * 1024;
+// How stale a transport backlog estimate may get before a blocked peer
+// refreshes it from the session status.
+constexpr std::chrono::milliseconds kBacklogSampleInterval{1};
+
+void recordSend(CSteamID peerID, uint32_t size, EResult result) {
+  const uint64_t peer = peerID.ConvertToUint64();
+  if (result == k_EResultOK) {
+    auto peerMetrics = metrics::registry().peer(peer);
+    peerMetrics->txPackets.add();
+    peerMetrics->txBytes.add(size);
+  } else if (result == k_EResultLimitExceeded) {
+    metrics::registry().recordDrop(metrics::DropReason::SendLimitExceeded,
+                                   peer);
+  }
+}
+
+void recordClassSend(TrafficClass trafficClass, uint32_t size,
+                     std::chrono::steady_clock::duration sojourn) {
+  metrics::ClassMetrics &classMetrics =
+      metrics::registry().trafficClass(trafficClass);
+  classMetrics.txPackets.add();
+  classMetrics.txBytes.add(size);
+  classMetrics.egressSojourn.record(sojourn);
+}
+
+// Per-lane drop counters of an egress queue, lanes being traffic classes.
+using LaneDrops = std::array<uint64_t, kTrafficClassCount>;
+
+LaneDrops laneDrops(const EgressQueue &queue, bool aqm) {
+  LaneDrops drops{};
+  for (std::size_t i = 0; i < std::min(queue.laneCount(), drops.size());
+       ++i) {
+    drops[i] = aqm ? queue.aqmDrops(i) : queue.tailDrops(i);
+  }
+  return drops;
+}
+
+void recordQueueDrops(CSteamID peerID, const EgressQueue &queue, bool aqm,
+                      const LaneDrops &before) {
+  const LaneDrops after = laneDrops(queue, aqm);
+  const auto reason =
+      aqm ? metrics::DropReason::QueueDelay : metrics::DropReason::QueueFull;
+  for (std::size_t i = 0; i < after.size(); ++i) {
+    if (after[i] == before[i]) {
+      continue;
+    }
+    for (uint64_t n = before[i]; n < after[i]; ++n) {
+      metrics::registry().recordDrop(reason, peerID.ConvertToUint64());
+    }
+    metrics::registry()
+        .trafficClass(static_cast<TrafficClass>(i))
+        .drops.add(after[i] - before[i]);
+  }
+}
+
+std::vector<EgressQueue::LaneConfig>
+laneConfigs(const TrafficClassifier &classifier) {
+  std::vector<EgressQueue::LaneConfig> lanes;
+  for (std::size_t i = 0; i < kTrafficClassCount; ++i) {
+    const auto &config = classifier.config(static_cast<TrafficClass>(i));
+    lanes.push_back(EgressQueue::LaneConfig{config.priority, config.weight});
+  }
+  return lanes;
+}
+} // namespace
+
 SteamVpnNetworkingManager::SteamVpnNetworkingManager()
-    : messagesInterface_(nullptr), messageHandler_(nullptr),
-      vpnBridge_(nullptr) {}
+    : messageHandler_(nullptr), vpnBridge_(nullptr) {
+  egressConfig_.lanes = laneConfigs(TrafficClassifier());
+}
 
 SteamVpnNetworkingManager::~SteamVpnNetworkingManager() {
   stopMessageHandler();
@@ -40,7 +117,8 @@ bool SteamVpnNetworkingManager::initialize() {
       k_ESteamNetworkingConfig_Global, 0, k_ESteamNetworkingConfig_Int32,
       &recvBufferMsgs);
 
-  int32 sendRate = 1024 * 1024;
+  // Sessions start conservative; updateSendRates() probes upward from here.
+  int32 sendRate = kInitialSendRate;
   SteamNetworkingUtils()->SetConfigValue(
       k_ESteamNetworkingConfig_SendRateMin, k_ESteamNetworkingConfig_Global, 0,
       k_ESteamNetworkingConfig_Int32, &sendRate);
@@ -68,64 +146,332 @@ bool SteamVpnNetworkingManager::initialize() {
 
   SteamNetworkingUtils()->InitRelayNetworkAccess();
 
-  messagesInterface_ = SteamNetworkingMessages();
-  if (!messagesInterface_) {
+  auto transport = std::make_unique<SteamTransport>();
+  if (!transport->isValid()) {
     std::cerr << "Failed to get ISteamNetworkingMessages interface"
               << std::endl;
     return false;
   }
+  return initialize(std::move(transport));
+}
 
-  messageHandler_ = new VpnMessageHandler(messagesInterface_, this);
+bool SteamVpnNetworkingManager::initialize(
+    std::unique_ptr<Transport> transport) {
+  if (!transport) {
+    return false;
+  }
+  stopMessageHandler();
+  delete messageHandler_;
+  transport_ = std::move(transport);
+  transport_->setSessionCallbacks(
+      [this](const SteamNetworkingIdentity &peer) { onSessionRequest(peer); },
+      [this](const SteamNetConnectionInfo_t &info) { onSessionFailed(info); });
+  messageHandler_ = new VpnMessageHandler(transport_.get(), this);
   return true;
 }
 
+CSteamID SteamVpnNetworkingManager::getLocalSteamID() const {
+  return transport_ ? transport_->localSteamID() : CSteamID();
+}
+
 void SteamVpnNetworkingManager::shutdown() {
   {
     std::lock_guard<std::mutex> lock(peersMutex_);
     for (const auto &peer : peers_) {
       SteamNetworkingIdentity identity;
       identity.SetSteamID(peer);
-      if (messagesInterface_) {
-        messagesInterface_->CloseSessionWithUser(identity);
+      if (transport_) {
+        transport_->closeSessionWithUser(identity);
       }
     }
     peers_.clear();
   }
+  {
+    std::lock_guard<std::mutex> lock(egressMutex_);
+    for (auto &kv : egress_) {
+      kv.second.metrics->egressQueuePackets.store(0, std::memory_order_relaxed);
+      kv.second.metrics->egressQueueBytes.store(0, std::memory_order_relaxed);
+    }
+    egress_.clear();
+    egressQueued_ = 0;
+  }
   hostSteamID_ = CSteamID();
 }
 
 bool SteamVpnNetworkingManager::sendMessageToUser(CSteamID peerID,
                                                   const void *data,
-                                                  uint32_t size, int flags) {
-  if (!messagesInterface_) {
+                                                  uint32_t size, int flags,
+                                                  uint32_t flowHash,
+                                                  TrafficClass trafficClass) {
+  if (!transport_) {
     return false;
   }
+  if ((flags & k_nSteamNetworkingSend_Reliable) == 0) {
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(egressMutex_);
+    EgressPeer &peer = egressPeer(peerID);
+    if (!peer.queue.empty()) {
+      const bool queued = enqueueEgress(peerID, peer, data, size, flags,
+                                        flowHash, trafficClass, now);
+      drainEgress(peerID, peer, now);
+      return queued;
+    }
+    if (!transportHasRoom(peerID, peer, now)) {
+      return enqueueEgress(peerID, peer, data, size, flags, flowHash,
+                           trafficClass, now);
+    }
+    SteamNetworkingIdentity identity;
+    identity.SetSteamID(peerID);
+    const EResult result =
+        transport_->sendMessageToUser(identity, data, size, flags, VPN_CHANNEL);
+    if (result == k_EResultLimitExceeded) {
+      return enqueueEgress(peerID, peer, data, size, flags, flowHash,
+                           trafficClass, now);
+    }
+    recordSend(peerID, size, result);
+    if (result != k_EResultOK) {
+      return false;
+    }
+    peer.transportBacklog += size;
+    peer.metrics->egressSojourn.record(0);
+    recordClassSend(trafficClass, size, std::chrono::steady_clock::duration{});
+    return true;
+  }
   SteamNetworkingIdentity identity;
   identity.SetSteamID(peerID);
-  const EResult result = messagesInterface_->SendMessageToUser(
-      identity, data, size, flags, VPN_CHANNEL);
+  const EResult result =
+      transport_->sendMessageToUser(identity, data, size, flags, VPN_CHANNEL);
+  recordSend(peerID, size, result);
   return result == k_EResultOK;
 }
 
-void SteamVpnNetworkingManager::broadcastMessage(const void *data,
-                                                 uint32_t size, int flags) {
-  if (!messagesInterface_) {
+void SteamVpnNetworkingManager::flushEgressQueues() {
+  if (!transport_ || egressQueued_.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  const auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(egressMutex_);
+  for (auto &kv : egress_) {
+    if (!kv.second.queue.empty()) {
+      drainEgress(kv.first, kv.second, now);
+    }
+  }
+}
+
+void SteamVpnNetworkingManager::setEgressQueueConfig(
+    const EgressQueue::Config &config) {
+  std::lock_guard<std::mutex> lock(egressMutex_);
+  const std::vector<EgressQueue::LaneConfig> lanes = egressConfig_.lanes;
+  egressConfig_ = config;
+  if (egressConfig_.lanes.empty()) {
+    egressConfig_.lanes = lanes;
+  }
+}
+
+void SteamVpnNetworkingManager::setTrafficClasses(
+    const TrafficClassifier &classifier) {
+  std::lock_guard<std::mutex> lock(egressMutex_);
+  egressConfig_.lanes = laneConfigs(classifier);
+}
+
+SteamVpnNetworkingManager::EgressPeer &
+SteamVpnNetworkingManager::egressPeer(CSteamID peerID) {
+  auto it = egress_.find(peerID);
+  if (it == egress_.end()) {
+    it = egress_.emplace(peerID, EgressPeer(egressConfig_)).first;
+    it->second.metrics = metrics::registry().peer(peerID.ConvertToUint64());
+  }
+  return it->second;
+}
+
+bool SteamVpnNetworkingManager::transportHasRoom(
+    CSteamID peerID, EgressPeer &peer,
+    std::chrono::steady_clock::time_point now) {
+  const bool hasRoom = peer.transportBudget == 0 ||
+                       peer.transportBacklog < peer.transportBudget;
+  if ((hasRoom && peer.transportBudget > 0) ||
+      now - peer.sampled < kBacklogSampleInterval) {
+    return hasRoom;
+  }
+  SteamNetworkingIdentity identity;
+  identity.SetSteamID(peerID);
+  SteamNetConnectionRealTimeStatus_t status{};
+  peer.sampled = now;
+  if (transport_->getSessionConnectionInfo(identity, nullptr, &status) !=
+          k_ESteamNetworkingConnectionState_Connected ||
+      status.m_nSendRateBytesPerSecond <= 0) {
+    // Nothing to measure against (still connecting, or a transport without
+    // a pacer): let the transport take it and push back itself.
+    peer.transportBudget = 0;
+    return true;
+  }
+  peer.transportBacklog = static_cast<std::size_t>(
+      std::max(0, status.m_cbPendingUnreliable + status.m_cbPendingReliable));
+  peer.transportBudget = std::max(
+      kMinTransportBudget,
+      static_cast<std::size_t>(status.m_nSendRateBytesPerSecond) *
+          static_cast<std::size_t>(kTransportQueueTarget.count()) / 1000);
+  return peer.transportBacklog < peer.transportBudget;
+}
+
+void SteamVpnNetworkingManager::drainEgress(
+    CSteamID peerID, EgressPeer &peer,
+    std::chrono::steady_clock::time_point now) {
+  SteamNetworkingIdentity identity;
+  identity.SetSteamID(peerID);
+  const LaneDrops aqmDropsBefore = laneDrops(peer.queue, true);
+  const std::size_t queuedBefore = peer.queue.packets();
+  while (transportHasRoom(peerID, peer, now)) {
+    EgressQueue::Packet *packet = peer.queue.front(now);
+    if (!packet) {
+      break;
+    }
+    const auto size = static_cast<uint32_t>(packet->data.size());
+    const EResult result = transport_->sendMessageToUser(
+        identity, packet->data.data(), size, packet->flags, VPN_CHANNEL);
+    if (result == k_EResultLimitExceeded) {
+      break; // stays at the head for the next flush
+    }
+    recordSend(peerID, size, result);
+    if (result == k_EResultOK) {
+      peer.transportBacklog += size;
+      peer.metrics->egressSojourn.record(now - packet->enqueued);
+      const std::size_t lane = peer.queue.frontLane();
+      if (lane < kTrafficClassCount) {
+        recordClassSend(static_cast<TrafficClass>(lane), size,
+                        now - packet->enqueued);
+      }
+    }
+    peer.queue.pop();
+  }
+  recordQueueDrops(peerID, peer.queue, true, aqmDropsBefore);
+  egressQueued_.fetch_sub(queuedBefore - peer.queue.packets(),
+                          std::memory_order_relaxed);
+  publishEgress(peer);
+}
+
+bool SteamVpnNetworkingManager::enqueueEgress(
+    CSteamID peerID, EgressPeer &peer, const void *data, uint32_t size,
+    int flags, uint32_t flowHash, TrafficClass trafficClass,
+    std::chrono::steady_clock::time_point now) {
+  const std::size_t queuedBefore = peer.queue.packets();
+  const LaneDrops dropsBefore = laneDrops(peer.queue, false);
+  const bool queued =
+      peer.queue.push(data, size, flags, now, flowHash,
+                      static_cast<std::size_t>(trafficClass));
+  recordQueueDrops(peerID, peer.queue, false, dropsBefore);
+  // Older messages, here or in a less important lane, may have been dropped
+  // to make room for this one.
+  const std::size_t queuedAfter = peer.queue.packets();
+  if (queuedAfter >= queuedBefore) {
+    egressQueued_.fetch_add(queuedAfter - queuedBefore,
+                            std::memory_order_relaxed);
+  } else {
+    egressQueued_.fetch_sub(queuedBefore - queuedAfter,
+                            std::memory_order_relaxed);
+  }
+  publishEgress(peer);
+  return queued;
+}
+
+void SteamVpnNetworkingManager::publishEgress(EgressPeer &peer) {
+  peer.metrics->egressQueuePackets.store(peer.queue.packets(),
+                                         std::memory_order_relaxed);
+  peer.metrics->egressQueueBytes.store(peer.queue.bytes(),
+                                       std::memory_order_relaxed);
+}
+
+void SteamVpnNetworkingManager::removeEgress(CSteamID peerID) {
+  std::lock_guard<std::mutex> lock(egressMutex_);
+  auto it = egress_.find(peerID);
+  if (it == egress_.end()) {
     return;
   }
+  egressQueued_.fetch_sub(it->second.queue.packets(),
+                          std::memory_order_relaxed);
+  it->second.metrics->egressQueuePackets.store(0, std::memory_order_relaxed);
+  it->second.metrics->egressQueueBytes.store(0, std::memory_order_relaxed);
+  egress_.erase(it);
+}
+
+size_t SteamVpnNetworkingManager::broadcastMessage(
+    const void *data, uint32_t size, int flags,
+    const std::function<bool(CSteamID)> &accept) {
+  if (!transport_) {
+    return 0;
+  }
+  const bool unreliable = (flags & k_nSteamNetworkingSend_Reliable) == 0;
+  const auto now = std::chrono::steady_clock::now();
   std::lock_guard<std::mutex> lock(peersMutex_);
+  // Unreliable copies go through the egress queues as sendMessageToUser()
+  // sends them: behind whatever a peer's queue already holds, or into it
+  // when the transport has no room. Only the rest go out as one batch.
+  std::unique_lock<std::mutex> egressLock(egressMutex_, std::defer_lock);
+  if (unreliable) {
+    egressLock.lock();
+  }
+  size_t sent = 0;
+  fanOutPeers_.clear();
+  fanOutIdentities_.clear();
   for (const auto &peerID : peers_) {
-    SteamNetworkingIdentity identity;
-    identity.SetSteamID(peerID);
-    messagesInterface_->SendMessageToUser(identity, data, size, flags,
-                                          VPN_CHANNEL);
+    if (accept && !accept(peerID)) {
+      continue;
+    }
+    if (unreliable) {
+      EgressPeer &peer = egressPeer(peerID);
+      const bool backlogged = !peer.queue.empty();
+      if (backlogged || !transportHasRoom(peerID, peer, now)) {
+        if (enqueueEgress(peerID, peer, data, size, flags, 0,
+                          TrafficClass::Default, now)) {
+          ++sent;
+        }
+        if (backlogged) {
+          drainEgress(peerID, peer, now);
+        }
+        continue;
+      }
+    }
+    fanOutPeers_.push_back(peerID);
+    fanOutIdentities_.emplace_back();
+    fanOutIdentities_.back().SetSteamID(peerID);
   }
+  if (fanOutPeers_.empty()) {
+    return sent;
+  }
+  fanOutResults_.resize(fanOutPeers_.size());
+  transport_->sendMessageToUsers(fanOutIdentities_.data(),
+                                 static_cast<int>(fanOutIdentities_.size()),
+                                 data, size, flags, VPN_CHANNEL,
+                                 fanOutResults_.data());
+  for (size_t i = 0; i < fanOutPeers_.size(); ++i) {
+    if (unreliable && fanOutResults_[i] == k_EResultLimitExceeded) {
+      if (enqueueEgress(fanOutPeers_[i], egressPeer(fanOutPeers_[i]), data,
+                        size, flags, 0, TrafficClass::Default, now)) {
+        ++sent;
+      }
+      continue;
+    }
+    recordSend(fanOutPeers_[i], size, fanOutResults_[i]);
+    if (fanOutResults_[i] != k_EResultOK) {
+      continue;
+    }
+    ++sent;
+    if (unreliable) {
+      EgressPeer &peer = egressPeer(fanOutPeers_[i]);
+      peer.transportBacklog += size;
+      peer.metrics->egressSojourn.record(0);
+      recordClassSend(TrafficClass::Default, size,
+                      std::chrono::steady_clock::duration{});
+    }
+  }
+  return sent;
 }
 
 void SteamVpnNetworkingManager::addPeer(CSteamID peerID) {
-  if (!messagesInterface_) {
+  if (!transport_) {
     return;
   }
-  if (SteamUser() && peerID == SteamUser()->GetSteamID()) {
+  if (peerID == transport_->localSteamID()) {
     return;
   }
   bool isNew = false;
@@ -137,14 +483,14 @@ void SteamVpnNetworkingManager::addPeer(CSteamID peerID) {
   // after a leave/rejoin can renegotiate cleanly.
   SteamNetworkingIdentity identity;
   identity.SetSteamID(peerID);
-  messagesInterface_->CloseSessionWithUser(identity);
-  messagesInterface_->AcceptSessionWithUser(identity);
+  transport_->closeSessionWithUser(identity);
+  transport_->acceptSessionWithUser(identity);
   VpnMessageHeader hello{};
   hello.type = VpnMessageType::SESSION_HELLO;
   hello.length = 0;
   const int flags = k_nSteamNetworkingSend_Reliable |
                     k_nSteamNetworkingSend_AutoRestartBrokenSession;
-  const EResult result = messagesInterface_->SendMessageToUser(
+  const EResult result = transport_->sendMessageToUser(
       identity, &hello, sizeof(hello), flags, VPN_CHANNEL);
   if (result == k_EResultOK) {
     std::cout << "[SteamVPN] Sent SESSION_HELLO to "
@@ -166,10 +512,11 @@ void SteamVpnNetworkingManager::removePeer(CSteamID peerID) {
     removed = peers_.erase(peerID) > 0;
   }
   if (removed) {
+    removeEgress(peerID);
     SteamNetworkingIdentity identity;
     identity.SetSteamID(peerID);
-    if (messagesInterface_) {
-      messagesInterface_->CloseSessionWithUser(identity);
+    if (transport_) {
+      transport_->closeSessionWithUser(identity);
     }
     if (vpnBridge_) {
       vpnBridge_->onUserLeft(peerID);
@@ -180,10 +527,11 @@ void SteamVpnNetworkingManager::removePeer(CSteamID peerID) {
 void SteamVpnNetworkingManager::clearPeers() {
   std::lock_guard<std::mutex> lock(peersMutex_);
   for (const auto &peerID : peers_) {
+    removeEgress(peerID);
     SteamNetworkingIdentity identity;
     identity.SetSteamID(peerID);
-    if (messagesInterface_) {
-      messagesInterface_->CloseSessionWithUser(identity);
+    if (transport_) {
+      transport_->closeSessionWithUser(identity);
     }
     if (vpnBridge_) {
       vpnBridge_->onUserLeft(peerID);
@@ -217,14 +565,14 @@ std::set<CSteamID> SteamVpnNetworkingManager::getPeers() const {
 }
 
 int SteamVpnNetworkingManager::getPeerPing(CSteamID peerID) const {
-  if (!messagesInterface_) {
+  if (!transport_) {
     return -1;
   }
   SteamNetworkingIdentity identity;
   identity.SetSteamID(peerID);
   SteamNetConnectionRealTimeStatus_t status;
   const ESteamNetworkingConnectionState state =
-      messagesInterface_->GetSessionConnectionInfo(identity, nullptr, &status);
+      transport_->getSessionConnectionInfo(identity, nullptr, &status);
   if (state == k_ESteamNetworkingConnectionState_Connected) {
     return status.m_nPing;
   }
@@ -232,26 +580,26 @@ int SteamVpnNetworkingManager::getPeerPing(CSteamID peerID) const {
 }
 
 bool SteamVpnNetworkingManager::isPeerConnected(CSteamID peerID) const {
-  if (!messagesInterface_) {
+  if (!transport_) {
     return false;
   }
   SteamNetworkingIdentity identity;
   identity.SetSteamID(peerID);
   const ESteamNetworkingConnectionState state =
-      messagesInterface_->GetSessionConnectionInfo(identity, nullptr, nullptr);
+      transport_->getSessionConnectionInfo(identity, nullptr, nullptr);
   return state == k_ESteamNetworkingConnectionState_Connected;
 }
 
 std::string
 SteamVpnNetworkingManager::getPeerConnectionType(CSteamID peerID) const {
-  if (!messagesInterface_) {
+  if (!transport_) {
     return "N/A";
   }
   SteamNetworkingIdentity identity;
   identity.SetSteamID(peerID);
   SteamNetConnectionInfo_t info;
   const ESteamNetworkingConnectionState state =
-      messagesInterface_->GetSessionConnectionInfo(identity, &info, nullptr);
+      transport_->getSessionConnectionInfo(identity, &info, nullptr);
   if (state == k_ESteamNetworkingConnectionState_Connected) {
     if (info.m_nFlags & k_nSteamNetworkConnectionInfoFlags_Relayed) {
       return "中继";
@@ -261,6 +609,31 @@ SteamVpnNetworkingManager::getPeerConnectionType(CSteamID peerID) const {
   return "N/A";
 }
 
+bool SteamVpnNetworkingManager::getPeerPath(CSteamID peerID,
+                                            PathSample &sample) const {
+  if (!transport_) {
+    return false;
+  }
+  SteamNetworkingIdentity identity;
+  identity.SetSteamID(peerID);
+  SteamNetConnectionInfo_t info{};
+  SteamNetConnectionRealTimeStatus_t status{};
+  if (transport_->getSessionConnectionInfo(identity, &info, &status) !=
+      k_ESteamNetworkingConnectionState_Connected) {
+    return false;
+  }
+  float quality = status.m_flConnectionQualityRemote;
+  if (quality < 0.0f) {
+    quality = status.m_flConnectionQualityLocal;
+  }
+  sample.pingMs = status.m_nPing;
+  sample.quality = quality < 0.0f ? 1.0f : quality;
+  sample.relayed =
+      (info.m_nFlags & k_nSteamNetworkConnectionInfoFlags_Relayed) != 0;
+  sample.updated = std::chrono::steady_clock::now();
+  return true;
+}
+
 void SteamVpnNetworkingManager::startMessageHandler() {
   if (messageHandler_) {
     messageHandler_->start();
@@ -273,32 +646,81 @@ void SteamVpnNetworkingManager::stopMessageHandler() {
   }
 }
 
-void SteamVpnNetworkingManager::handleIncomingVpnMessage(
-    const uint8_t *data, size_t size, CSteamID senderSteamID) {
+void SteamVpnNetworkingManager::handleIncomingVpnMessages(
+    const VpnIncomingMessage *messages, size_t count) {
+  // A batch is mostly runs from one peer; count each run once.
+  size_t runStart = 0;
+  uint64_t runBytes = 0;
+  for (size_t i = 0; i < count; ++i) {
+    runBytes += messages[i].size;
+    if (i + 1 == count || messages[i + 1].sender != messages[runStart].sender) {
+      auto peerMetrics = metrics::registry().peer(
+          messages[runStart].sender.ConvertToUint64());
+      peerMetrics->rxPackets.add(i + 1 - runStart);
+      peerMetrics->rxBytes.add(runBytes);
+      runStart = i + 1;
+      runBytes = 0;
+    }
+  }
   if (!vpnBridge_) {
     return;
   }
-  vpnBridge_->handleVpnMessage(data, size, senderSteamID);
+  vpnBridge_->handleVpnMessages(messages, count);
+}
+
+void SteamVpnNetworkingManager::updateSendRates() {
+  if (!transport_) {
+    return;
+  }
+  const auto now = std::chrono::steady_clock::now();
+  if (now < nextRateUpdate_) {
+    return;
+  }
+  nextRateUpdate_ = now + kRateUpdateInterval;
+
+  const std::set<CSteamID> peers = getPeers();
+  for (auto it = rateControllers_.begin(); it != rateControllers_.end();) {
+    if (peers.count(it->first) == 0) {
+      it = rateControllers_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (const auto &peerID : peers) {
+    SteamNetworkingIdentity identity;
+    identity.SetSteamID(peerID);
+    SteamNetConnectionRealTimeStatus_t status{};
+    if (transport_->getSessionConnectionInfo(identity, nullptr, &status) !=
+        k_ESteamNetworkingConnectionState_Connected) {
+      continue;
+    }
+    auto it = rateControllers_.find(peerID);
+    if (it == rateControllers_.end()) {
+      it = rateControllers_.emplace(peerID, RateController()).first;
+      transport_->setSessionSendRate(identity, it->second.rate());
+    }
+    if (it->second.update(status, now)) {
+      transport_->setSessionSendRate(identity, it->second.rate());
+    }
+  }
 }
 
-void SteamVpnNetworkingManager::OnSessionRequest(
-    SteamNetworkingMessagesSessionRequest_t *pCallback) {
-  const CSteamID remoteSteamID = pCallback->m_identityRemote.GetSteamID();
+void SteamVpnNetworkingManager::onSessionRequest(
+    const SteamNetworkingIdentity &peer) {
+  const CSteamID remoteSteamID = peer.GetSteamID();
   std::cout << "[SteamVPN] Session request from "
             << remoteSteamID.ConvertToUint64() << std::endl;
-  bool accept = false;
-  accept = true;
-  if (messagesInterface_) {
-    messagesInterface_->AcceptSessionWithUser(pCallback->m_identityRemote);
+  if (transport_) {
+    transport_->acceptSessionWithUser(peer);
     std::cout << "[SteamVPN] Accepted session from known peer" << std::endl;
   }
 }
 
-void SteamVpnNetworkingManager::OnSessionFailed(
-    SteamNetworkingMessagesSessionFailed_t *pCallback) {
-  const CSteamID remoteSteamID = pCallback->m_info.m_identityRemote.GetSteamID();
+void SteamVpnNetworkingManager::onSessionFailed(
+    const SteamNetConnectionInfo_t &info) {
+  const CSteamID remoteSteamID = info.m_identityRemote.GetSteamID();
   std::cout << "[SteamVPN] Session failed with "
-            << remoteSteamID.ConvertToUint64() << ": "
-            << pCallback->m_info.m_szEndDebug << std::endl;
+            << remoteSteamID.ConvertToUint64() << ": " << info.m_szEndDebug
+            << std::endl;
   removePeer(remoteSteamID);
 }
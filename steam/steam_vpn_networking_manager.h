@@ -1,11 +1,23 @@
 #pragma once
 
+#include "../net/egress_queue.h"
+#include "../net/metrics.h"
+#include "../net/path_selector.h"
+#include "../net/rate_controller.h"
+#include "../net/traffic_classifier.h"
+#include "../net/transport.h"
+#include "../net/vpn_protocol.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <set>
 #include <steam_api.h>
-#include <isteamnetworkingmessages.h>
 #include <steamnetworkingtypes.h>
 #include <string>
+#include <vector>
 
 class VpnMessageHandler;
 class SteamVpnBridge;
@@ -18,11 +30,28 @@ public:
   ~SteamVpnNetworkingManager();
 
   bool initialize();
+  // Runs the VPN data path over an arbitrary carrier (loopback, LAN UDP).
+  bool initialize(std::unique_ptr<Transport> transport);
   void shutdown();
 
+  Transport *getTransport() const { return transport_.get(); }
+  CSteamID getLocalSteamID() const;
+
+  // Unreliable messages go through the peer's egress queue whenever the
+  // transport already holds about kTransportQueueTarget worth of data for it,
+  // so a backlog builds (and is managed) here rather than inside Steam; true
+  // when the message was sent or queued. flowHash keeps the messages of one
+  // connection inside the tunnel in one FQ-CoDel flow, trafficClass picks
+  // the queue's lane.
   bool sendMessageToUser(CSteamID peerID, const void *data, uint32_t size,
-                         int flags);
-  void broadcastMessage(const void *data, uint32_t size, int flags);
+                         int flags, uint32_t flowHash = 0,
+                         TrafficClass trafficClass = TrafficClass::Default);
+  // Hands one message for every peer (those accept returns true for, when
+  // given) to the transport as a single batch; returns how many took it or
+  // queued it.
+  size_t broadcastMessage(
+      const void *data, uint32_t size, int flags,
+      const std::function<bool(CSteamID)> &accept = nullptr);
 
   void addPeer(CSteamID peerID);
   void removePeer(CSteamID peerID);
@@ -33,6 +62,18 @@ public:
   int getPeerPing(CSteamID peerID) const;
   bool isPeerConnected(CSteamID peerID) const;
   std::string getPeerConnectionType(CSteamID peerID) const;
+  // Ping, quality and relay flag of our own session, for path selection.
+  bool getPeerPath(CSteamID peerID, PathSample &sample) const;
+
+  // Sends what the egress queues are holding as far as the transport takes
+  // it; called regularly from the TUN read thread.
+  void flushEgressQueues();
+  // Applies to queues created from now on (peers added afterwards). Lanes
+  // are indexed by TrafficClass; a config without lanes keeps the current
+  // ones.
+  void setEgressQueueConfig(const EgressQueue::Config &config);
+  // Gives every traffic class its lane priority and weight.
+  void setTrafficClasses(const TrafficClassifier &classifier);
 
   void startMessageHandler();
   void stopMessageHandler();
@@ -40,23 +81,59 @@ public:
   void setVpnBridge(SteamVpnBridge *vpnBridge) { vpnBridge_ = vpnBridge; }
   SteamVpnBridge *getVpnBridge() { return vpnBridge_; }
 
-  void handleIncomingVpnMessage(const uint8_t *data, size_t size,
-                                CSteamID senderSteamID);
+  void handleIncomingVpnMessages(const VpnIncomingMessage *messages,
+                                 size_t count);
+  // Feeds each peer's session status to its RateController; called from the
+  // message handler's poll loop, which is the only thread touching them.
+  void updateSendRates();
 
   void setHostSteamID(CSteamID id) { hostSteamID_ = id; }
   CSteamID getHostSteamID() const { return hostSteamID_; }
 
 private:
-  ISteamNetworkingMessages *messagesInterface_;
+  void onSessionRequest(const SteamNetworkingIdentity &peer);
+  void onSessionFailed(const SteamNetConnectionInfo_t &info);
+
+  struct EgressPeer {
+    explicit EgressPeer(const EgressQueue::Config &config) : queue(config) {}
+
+    EgressQueue queue;
+    std::shared_ptr<metrics::PeerMetrics> metrics;
+    // What the transport holds for the peer: its pending bytes at the last
+    // status sample plus everything handed to it since.
+    std::size_t transportBacklog = 0;
+    std::size_t transportBudget = 0; // 0 until a connected sample
+    std::chrono::steady_clock::time_point sampled;
+  };
+
+  EgressPeer &egressPeer(CSteamID peerID);
+  bool transportHasRoom(CSteamID peerID, EgressPeer &peer,
+                        std::chrono::steady_clock::time_point now);
+  // Caller holds egressMutex_.
+  void drainEgress(CSteamID peerID, EgressPeer &peer,
+                   std::chrono::steady_clock::time_point now);
+  bool enqueueEgress(CSteamID peerID, EgressPeer &peer, const void *data,
+                     uint32_t size, int flags, uint32_t flowHash,
+                     TrafficClass trafficClass,
+                     std::chrono::steady_clock::time_point now);
+  void publishEgress(EgressPeer &peer);
+  void removeEgress(CSteamID peerID);
+
+  std::unique_ptr<Transport> transport_;
   std::set<CSteamID> peers_;
   mutable std::mutex peersMutex_;
+  // broadcastMessage() scratch, guarded by peersMutex_.
+  std::vector<CSteamID> fanOutPeers_;
+  std::vector<SteamNetworkingIdentity> fanOutIdentities_;
+  std::vector<EResult> fanOutResults_;
+  std::map<CSteamID, RateController> rateControllers_;
+  std::map<CSteamID, EgressPeer> egress_;
+  EgressQueue::Config egressConfig_;
+  std::mutex egressMutex_;
+  std::atomic<std::size_t> egressQueued_{0}; // messages across all queues
+  std::chrono::steady_clock::time_point nextRateUpdate_;
 
   VpnMessageHandler *messageHandler_;
   SteamVpnBridge *vpnBridge_;
   CSteamID hostSteamID_;
-
-  STEAM_CALLBACK(SteamVpnNetworkingManager, OnSessionRequest,
-                 SteamNetworkingMessagesSessionRequest_t);
-  STEAM_CALLBACK(SteamVpnNetworkingManager, OnSessionFailed,
-                 SteamNetworkingMessagesSessionFailed_t);
 };
@@ -1,23 +1,28 @@
 #include "vpn_message_handler.h"
 #include "steam_vpn_networking_manager.h"
 #include "steam_vpn_bridge.h"
+#include "net/metrics.h"
 #include "net/vpn_protocol.h"
 #include <algorithm>
 #include <iostream>
 #include <steam_api.h>
-#include <isteamnetworkingmessages.h>
 
-VpnMessageHandler::VpnMessageHandler(ISteamNetworkingMessages *interface,
+std::atomic<int64_t> VpnMessageHandler::spinMicros_{200};
+
+void VpnMessageHandler::setSpinTime(std::chrono::microseconds spin) {
+  spinMicros_ = std::max<int64_t>(spin.count(), 0);
+}
+
+VpnMessageHandler::VpnMessageHandler(Transport *transport,
                                      SteamVpnNetworkingManager *manager)
-    : interface_(interface), manager_(manager),
-      internalIoContext_(std::make_unique<boost::asio::io_context>()),
-      ioContext_(internalIoContext_.get()), running_(false),
-      currentPollInterval_(MIN_POLL_INTERVAL) {}
+    : transport_(transport), manager_(manager), ioContext_(nullptr),
+      running_(false), currentPollInterval_(MIN_POLL_INTERVAL),
+      batchLimit_(MIN_BATCH) {}
 
 VpnMessageHandler::~VpnMessageHandler() { stop(); }
 
 void VpnMessageHandler::setIoContext(boost::asio::io_context *externalContext) {
-  if (!running_ && externalContext) {
+  if (!running_) {
     ioContext_ = externalContext;
   }
 }
@@ -27,14 +32,12 @@ void VpnMessageHandler::start() {
     return;
   }
   running_ = true;
-  if (ioContext_ == internalIoContext_.get() && internalIoContext_) {
-    internalIoContext_->restart();
-  }
-  pollTimer_ = std::make_unique<boost::asio::steady_timer>(*ioContext_);
-  schedulePoll();
-  if (ioContext_ == internalIoContext_.get()) {
-    ioThread_ =
-        std::make_unique<std::thread>(&VpnMessageHandler::runInternalLoop, this);
+  if (ioContext_) {
+    pollTimer_ = std::make_unique<boost::asio::steady_timer>(*ioContext_);
+    schedulePoll();
+  } else {
+    receiveThread_ =
+        std::make_unique<std::thread>(&VpnMessageHandler::runReceiveLoop, this);
   }
 }
 
@@ -45,36 +48,49 @@ void VpnMessageHandler::stop() {
   running_ = false;
   if (pollTimer_) {
     pollTimer_->cancel();
-    // If we're using an external io_context (shared with the app), drain the
-    // canceled handler now so it doesn't fire after this object is destroyed.
-    if (ioContext_ && ioContext_ != internalIoContext_.get()) {
-      ioContext_->poll();
-    }
+    // The io_context is shared with the app; drain the canceled handler now
+    // so it doesn't fire after this object is destroyed.
+    ioContext_->poll();
   }
-  if (ioContext_ == internalIoContext_.get() && internalIoContext_) {
-    internalIoContext_->stop();
-  }
-  if (ioThread_ && ioThread_->joinable()) {
-    ioThread_->join();
+  if (receiveThread_ && receiveThread_->joinable()) {
+    receiveThread_->join();
   }
   pollTimer_.reset();
-  ioThread_.reset();
+  receiveThread_.reset();
 }
 
-void VpnMessageHandler::runInternalLoop() {
-  auto workGuard =
-      boost::asio::make_work_guard(*internalIoContext_);
+void VpnMessageHandler::runReceiveLoop() {
+  using Clock = std::chrono::steady_clock;
+  const bool canWait = transport_ && transport_->canWaitForMessages();
+  const std::chrono::microseconds spin(spinMicros_.load());
+  auto lastTraffic = Clock::now();
+  auto parkInterval = MIN_POLL_INTERVAL;
   while (running_) {
+    int received = 0;
     try {
-      internalIoContext_->run();
-      break;
+      received = pollMessages();
     } catch (const std::exception &e) {
       std::cerr << "Exception in VPN message handler loop: " << e.what()
                 << std::endl;
-      if (running_) {
-        internalIoContext_->restart();
-      }
     }
+    if (received > 0) {
+      lastTraffic = Clock::now();
+      parkInterval = MIN_POLL_INTERVAL;
+      continue;
+    }
+    if (canWait) {
+      transport_->waitForMessages(VPN_CHANNEL, MAX_WAIT);
+      continue;
+    }
+    const auto now = Clock::now();
+    if (now - lastTraffic < spin) {
+      std::this_thread::yield();
+      continue;
+    }
+    const auto deadline = now + parkInterval;
+    std::this_thread::sleep_until(deadline);
+    metrics::registry().pollLag.recordSince(deadline);
+    parkInterval = std::min(parkInterval * 2, MAX_POLL_INTERVAL);
   }
 }
 
@@ -83,40 +99,65 @@ void VpnMessageHandler::schedulePoll() {
     return;
   }
   pollTimer_->expires_after(currentPollInterval_);
+  pollDeadline_ = pollTimer_->expiry();
   pollTimer_->async_wait([this](const boost::system::error_code &ec) {
     if (!ec && running_) {
-      pollMessages();
+      metrics::registry().pollLag.recordSince(pollDeadline_);
+      if (pollMessages() > 0) {
+        currentPollInterval_ = MIN_POLL_INTERVAL;
+      } else {
+        currentPollInterval_ =
+            std::min(currentPollInterval_ + POLL_INCREMENT, MAX_POLL_INTERVAL);
+      }
       schedulePoll();
     }
   });
 }
 
-void VpnMessageHandler::pollMessages() {
-  if (!interface_) {
-    return;
+int VpnMessageHandler::pollMessages() {
+  if (!transport_) {
+    return 0;
   }
-  ISteamNetworkingMessage *incoming[64];
+  ISteamNetworkingMessage *incoming[MAX_BATCH];
   const int numMsgs =
-      interface_->ReceiveMessagesOnChannel(VPN_CHANNEL, incoming, 64);
+      transport_->receiveMessagesOnChannel(VPN_CHANNEL, incoming, batchLimit_);
+  if (numMsgs > 0) {
+    // The oldest message of the batch shows how long traffic sat in the
+    // transport before we picked it up.
+    const SteamNetworkingMicroseconds waited = std::max<int64>(
+        transport_->localTimestamp() - incoming[0]->m_usecTimeReceived, 0);
+    metrics::registry().pickupDelay.record(static_cast<uint64_t>(waited));
+  }
+  // The whole batch goes to the bridge at once and is released afterwards,
+  // so the packets it carries can be written to the TUN device together.
+  VpnIncomingMessage batch[MAX_BATCH];
+  size_t batchSize = 0;
   for (int i = 0; i < numMsgs; ++i) {
     ISteamNetworkingMessage *msg = incoming[i];
     const uint8_t *data = static_cast<const uint8_t *>(msg->m_pData);
     const size_t size = msg->m_cbSize;
-    const CSteamID sender = msg->m_identityPeer.GetSteamID();
     if (size >= sizeof(VpnMessageHeader) &&
         static_cast<VpnMessageType>(data[0]) == VpnMessageType::SESSION_HELLO) {
-      msg->Release();
       continue;
     }
-    if (manager_) {
-      manager_->handleIncomingVpnMessage(data, size, sender);
-    }
-    msg->Release();
+    batch[batchSize++] =
+        VpnIncomingMessage{data, size, msg->m_identityPeer.GetSteamID()};
   }
-  if (numMsgs > 0) {
-    currentPollInterval_ = MIN_POLL_INTERVAL;
-  } else {
-    currentPollInterval_ =
-        std::min(currentPollInterval_ + POLL_INCREMENT, MAX_POLL_INTERVAL);
+  if (manager_ && batchSize > 0) {
+    manager_->handleIncomingVpnMessages(batch, batchSize);
+  }
+  for (int i = 0; i < numMsgs; ++i) {
+    incoming[i]->Release();
+  }
+  if (manager_) {
+    manager_->updateSendRates();
+  }
+  // A full batch means more is queued: take bigger bites until we catch up,
+  // then shrink back so light traffic is handed on promptly.
+  if (numMsgs == batchLimit_) {
+    batchLimit_ = std::min(batchLimit_ * 2, MAX_BATCH);
+  } else if (numMsgs < batchLimit_ / 4) {
+    batchLimit_ = std::max(batchLimit_ / 2, MIN_BATCH);
   }
+  return numMsgs;
 }
@@ -1,43 +1,61 @@
 #pragma once
 
+#include "../net/transport.h"
 #include <atomic>
 #include <boost/asio.hpp>
 #include <chrono>
-#include <isteamnetworkingmessages.h>
+#include <cstdint>
 #include <memory>
 #include <steamnetworkingtypes.h>
 #include <thread>
 
 class SteamVpnNetworkingManager;
 
+// Pulls TUN-mode traffic off the transport. On its own thread it sleeps in the
+// transport until messages arrive when the backend supports that (loopback,
+// UDP); Steam only offers a non-blocking receive, so there it busy-polls for
+// a short spin window after the last message and then parks in growing
+// sleeps. With an external io_context it falls back to a timer.
 class VpnMessageHandler {
 public:
-  VpnMessageHandler(ISteamNetworkingMessages *interface,
-                    SteamVpnNetworkingManager *manager);
+  VpnMessageHandler(Transport *transport, SteamVpnNetworkingManager *manager);
   ~VpnMessageHandler();
 
   void start();
   void stop();
   void setIoContext(boost::asio::io_context *externalContext);
 
+  // Busy-poll window after the last message when the transport cannot wait
+  // for traffic; longer cuts wake-up latency at the cost of CPU, 0 parks at
+  // once. Applies to handlers started afterwards.
+  static void setSpinTime(std::chrono::microseconds spin);
+
 private:
   void schedulePoll();
-  void pollMessages();
-  void runInternalLoop();
+  int pollMessages();
+  void runReceiveLoop();
 
-  ISteamNetworkingMessages *interface_;
+  Transport *transport_;
   SteamVpnNetworkingManager *manager_;
 
-  std::unique_ptr<boost::asio::io_context> internalIoContext_;
   boost::asio::io_context *ioContext_;
   std::unique_ptr<boost::asio::steady_timer> pollTimer_;
-  std::unique_ptr<std::thread> ioThread_;
+  std::unique_ptr<std::thread> receiveThread_;
 
   std::atomic<bool> running_;
   std::chrono::microseconds currentPollInterval_;
+  std::chrono::steady_clock::time_point pollDeadline_;
+  int batchLimit_;
+
+  static std::atomic<int64_t> spinMicros_;
 
   static constexpr int VPN_CHANNEL = 0;
+  static constexpr int MIN_BATCH = 32;
+  static constexpr int MAX_BATCH = 256;
   static constexpr std::chrono::microseconds MIN_POLL_INTERVAL{100};
   static constexpr std::chrono::microseconds MAX_POLL_INTERVAL{1000};
   static constexpr std::chrono::microseconds POLL_INCREMENT{100};
+  // Upper bound on one wait in the transport, so send rates keep updating and
+  // stop() is noticed while the link is idle.
+  static constexpr std::chrono::microseconds MAX_WAIT{5000};
 };
@@ -6,6 +6,11 @@
 
 namespace tun {
 
+struct PacketView {
+  const uint8_t *data;
+  size_t size;
+};
+
 class TunInterface {
 public:
   virtual ~TunInterface() = default;
@@ -16,6 +21,16 @@ public:
 
   virtual int read(uint8_t *buffer, size_t size) = 0;
   virtual int write(const uint8_t *buffer, size_t size) = 0;
+  // Writes packets in order and returns how many leading packets were
+  // accepted; the caller decides what to do with the one that failed.
+  virtual size_t write_batch(const PacketView *packets, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      if (write(packets[i].data, packets[i].size) < 0) {
+        return i;
+      }
+    }
+    return count;
+  }
 
   virtual std::string get_device_name() const = 0;
   virtual bool set_ip(const std::string &ip, const std::string &netmask) = 0;
@@ -23,6 +38,9 @@ public:
   // unsupported.
   virtual bool add_route(const std::string &network,
                          const std::string &netmask) = 0;
+  // Adds an IPv6 address alongside the IPv4 one, with the connected route for
+  // its prefix.
+  virtual bool set_ipv6(const std::string &ip, int prefixLength) = 0;
   virtual bool set_mtu(int mtu) = 0;
   virtual bool set_up(bool up) = 0;
   virtual bool set_non_blocking(bool nonBlocking) = 0;
@@ -200,6 +200,27 @@ public:
     return false;
   }
 
+  bool set_ipv6(const std::string &ip, int prefixLength) override {
+    if (fd_ < 0) {
+      lastError_ = "Interface not open";
+      return false;
+    }
+    in6_addr addr {};
+    if (inet_pton(AF_INET6, ip.c_str(), &addr) != 1) {
+      lastError_ = "Invalid IPv6 address";
+      return false;
+    }
+    // ip(8) installs the connected route for the prefix with the address.
+    const std::string cidr = ip + "/" + std::to_string(prefixLength);
+    const std::string cmd =
+        "ip -6 addr replace " + cidr + " dev " + name_ + " 2>/dev/null";
+    if (::system(cmd.c_str()) == 0) {
+      return true;
+    }
+    lastError_ = "Failed to set IPv6 address " + cidr;
+    return false;
+  }
+
   bool set_mtu(int mtu) override {
     if (fd_ < 0) {
       lastError_ = "Interface not open";
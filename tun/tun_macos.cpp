@@ -17,6 +17,7 @@
 #include <sys/kern_control.h>
 #include <sys/sys_domain.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 namespace tun {
@@ -46,6 +47,16 @@ bool validAddress(const std::string &text) {
   return true;
 }
 
+// utun frames start with the packet's address family in network order.
+uint32_t utunFamily(const uint8_t *packet, size_t size) {
+  return htonl(size > 0 && (packet[0] >> 4) == 6 ? AF_INET6 : AF_INET);
+}
+
+bool validAddress6(const std::string &text) {
+  in6_addr addr{};
+  return inet_pton(AF_INET6, text.c_str(), &addr) == 1;
+}
+
 int maskToPrefix(const std::string &mask) {
   in_addr addr{};
   if (inet_pton(AF_INET, mask.c_str(), &addr) != 1) {
@@ -179,7 +190,7 @@ public:
       lastError_ = "Packet too large";
       return -1;
     }
-    uint32_t family = htonl(AF_INET);
+    const uint32_t family = utunFamily(buffer, size);
     std::memcpy(frame, &family, sizeof(family));
     std::memcpy(frame + sizeof(family), buffer, size);
     const ssize_t n =
@@ -187,6 +198,23 @@ public:
     return n >= 0 ? static_cast<int>(n - sizeof(uint32_t)) : -1;
   }
 
+  // utun takes one packet per write; gathering the family header and the
+  // packet with writev at least saves the copy into a frame.
+  size_t write_batch(const PacketView *packets, size_t count) override {
+    for (size_t i = 0; i < count; ++i) {
+      uint32_t family = utunFamily(packets[i].data, packets[i].size);
+      iovec iov[2];
+      iov[0].iov_base = &family;
+      iov[0].iov_len = sizeof(family);
+      iov[1].iov_base = const_cast<uint8_t *>(packets[i].data);
+      iov[1].iov_len = packets[i].size;
+      if (fd_ < 0 || ::writev(fd_, iov, 2) < 0) {
+        return i;
+      }
+    }
+    return count;
+  }
+
   std::string get_device_name() const override { return name_; }
 
   bool set_ip(const std::string &ip, const std::string &netmask) override {
@@ -247,6 +275,48 @@ public:
     return false;
   }
 
+  bool set_ipv6(const std::string &ip, int prefixLength) override {
+    if (!is_open()) {
+      lastError_ = "Interface not open";
+      return false;
+    }
+    if (!validAddress6(ip) || prefixLength <= 0 || prefixLength > 128) {
+      lastError_ = "Invalid IPv6 address or prefix";
+      return false;
+    }
+    if (usingHelper_) {
+      std::string error;
+      if (!helperSetIpv6(name_, ip, prefixLength, &error)) {
+        lastError_ = error.empty() ? "Helper set_ipv6 failed" : error;
+        return false;
+      }
+      return true;
+    }
+    const std::string cidr = ip + "/" + std::to_string(prefixLength);
+    std::ostringstream cmd;
+    cmd << "/sbin/ifconfig " << name_ << " inet6 " << ip << " prefixlen "
+        << prefixLength << " alias";
+    if (::system(cmd.str().c_str()) != 0) {
+      lastError_ = "ifconfig inet6 failed";
+      return false;
+    }
+    // utun is point-to-point, so the prefix needs its own route.
+    std::ostringstream route;
+    route << "/sbin/route -n add -inet6 -net " << cidr << " -interface "
+          << name_;
+    if (::system(route.str().c_str()) == 0) {
+      return true;
+    }
+    std::ostringstream routeChange;
+    routeChange << "/sbin/route -n change -inet6 -net " << cidr
+                << " -interface " << name_;
+    if (::system(routeChange.str().c_str()) == 0) {
+      return true;
+    }
+    lastError_ = "route add/change failed for " + cidr;
+    return false;
+  }
+
   bool set_mtu(int mtu) override {
     if (!is_open()) {
       lastError_ = "Interface not open";
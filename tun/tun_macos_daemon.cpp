@@ -128,6 +128,11 @@ bool validAddress(const std::string &text) {
   return true;
 }
 
+bool validAddress6(const std::string &text) {
+  in6_addr addr{};
+  return ::inet_pton(AF_INET6, text.c_str(), &addr) == 1;
+}
+
 bool validIfName(const std::string &name) {
   if (name.size() <= 4) {
     return false;
@@ -384,6 +389,36 @@ void handleClient(int fd) {
     sendResponse(fd, "OK");
     return;
   }
+  if (verb == "SET_IP6") {
+    const std::string ifname = args.count("if") ? args.at("if") : "";
+    const std::string ip = args.count("ip") ? args.at("ip") : "";
+    const std::string prefixText =
+        args.count("prefix") ? args.at("prefix") : "";
+    int prefix = 0;
+    if (!validIfName(ifname) || !validAddress6(ip) ||
+        !parseInt(prefixText, &prefix) || prefix <= 0 || prefix > 128) {
+      sendResponse(fd, "ERR invalid SET_IP6 arguments");
+      return;
+    }
+    std::string error;
+    if (!runIfconfig({ifname, "inet6", ip, "prefixlen", std::to_string(prefix),
+                      "alias"},
+                     &error)) {
+      sendResponse(fd, "ERR " + error);
+      return;
+    }
+    const std::string cidr = ip + "/" + std::to_string(prefix);
+    if (!runRoute({"-n", "add", "-inet6", "-net", cidr, "-interface", ifname},
+                  &error) &&
+        !runRoute(
+            {"-n", "change", "-inet6", "-net", cidr, "-interface", ifname},
+            &error)) {
+      sendResponse(fd, "ERR " + error);
+      return;
+    }
+    sendResponse(fd, "OK");
+    return;
+  }
   if (verb == "SET_MTU") {
     const std::string ifname = args.count("if") ? args.at("if") : "";
     const std::string mtuText = args.count("mtu") ? args.at("mtu") : "";
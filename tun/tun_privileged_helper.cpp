@@ -303,6 +303,14 @@ bool helperSetIp(const std::string &ifname, const std::string &ip,
   return helperCommand(cmd.str(), error);
 }
 
+bool helperSetIpv6(const std::string &ifname, const std::string &ip,
+                   int prefixLength, std::string *error) {
+  std::ostringstream cmd;
+  cmd << "SET_IP6 if=" << ifname << " ip=" << ip
+      << " prefix=" << prefixLength;
+  return helperCommand(cmd.str(), error);
+}
+
 bool helperSetMtu(const std::string &ifname, int mtu, std::string *error) {
   std::ostringstream cmd;
   cmd << "SET_MTU if=" << ifname << " mtu=" << mtu;
@@ -16,6 +16,8 @@ bool helperOpen(const std::string &requestedName, int mtu,
                 HelperOpenResult *result);
 bool helperSetIp(const std::string &ifname, const std::string &ip,
                  const std::string &netmask, std::string *error);
+bool helperSetIpv6(const std::string &ifname, const std::string &ip,
+                   int prefixLength, std::string *error);
 bool helperSetMtu(const std::string &ifname, int mtu, std::string *error);
 bool helperSetUp(const std::string &ifname, bool up, std::string *error);
 bool helperAddRoute(const std::string &network, const std::string &netmask,
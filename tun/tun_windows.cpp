@@ -15,6 +15,7 @@
 #include <iphlpapi.h>
 #include <netioapi.h>
 #include <rpc.h>
+#include <algorithm>
 #include <cstdlib>
 #include <atomic>
 #include <iostream>
@@ -60,6 +61,7 @@ using WINTUN_ALLOCATE_SEND_PACKET_FUNC =
 using WINTUN_SEND_PACKET_FUNC = void(WINAPI *)(WINTUN_SESSION_HANDLE, BYTE *);
 
 static constexpr DWORD WINTUN_MAX_IP_PACKET_SIZE = 0xFFFF;
+static constexpr size_t kMaxSendBatch = 64;
 
 namespace tun {
 
@@ -273,6 +275,42 @@ public:
     return static_cast<int>(size);
   }
 
+  // Reserves ring space for a whole batch before committing any of it, so
+  // the driver picks the packets up (and is signalled) once per batch.
+  size_t write_batch(const PacketView *packets, size_t count) override {
+    if (!session_) {
+      return 0;
+    }
+    size_t written = 0;
+    while (written < count) {
+      BYTE *reserved[kMaxSendBatch];
+      const size_t chunk = std::min(count - written, kMaxSendBatch);
+      size_t allocated = 0;
+      for (; allocated < chunk; ++allocated) {
+        const PacketView &view = packets[written + allocated];
+        if (view.size > WINTUN_MAX_IP_PACKET_SIZE) {
+          setError("Packet too large");
+          break;
+        }
+        BYTE *packet = WintunAllocateSendPacket(session_,
+                                                static_cast<DWORD>(view.size));
+        if (!packet) {
+          break;
+        }
+        std::memcpy(packet, view.data, view.size);
+        reserved[allocated] = packet;
+      }
+      for (size_t i = 0; i < allocated; ++i) {
+        WintunSendPacket(session_, reserved[i]);
+      }
+      written += allocated;
+      if (allocated < chunk) {
+        break;
+      }
+    }
+    return written;
+  }
+
   std::string get_device_name() const override { return deviceName_; }
 
   bool set_ip(const std::string &ip, const std::string &netmask) override {
@@ -309,6 +347,38 @@ public:
     return true;
   }
 
+  bool set_ipv6(const std::string &ip, int prefixLength) override {
+    if (!adapter_) {
+      setError("Adapter not open");
+      return false;
+    }
+    in6_addr addr{};
+    if (inet_pton(AF_INET6, ip.c_str(), &addr) != 1) {
+      setError("Invalid IPv6 address: " + ip);
+      return false;
+    }
+    // The on-link prefix length makes Windows add the connected route too.
+    MIB_UNICASTIPADDRESS_ROW addressRow;
+    InitializeUnicastIpAddressEntry(&addressRow);
+    addressRow.InterfaceLuid = adapterLuid_;
+    addressRow.Address.Ipv6.sin6_family = AF_INET6;
+    addressRow.Address.Ipv6.sin6_addr = addr;
+    addressRow.OnLinkPrefixLength = static_cast<UINT8>(prefixLength);
+    addressRow.DadState = IpDadStatePreferred;
+    DeleteUnicastIpAddressEntry(&addressRow);
+
+    const DWORD result = CreateUnicastIpAddressEntry(&addressRow);
+    if (result != NO_ERROR && result != ERROR_OBJECT_ALREADY_EXISTS) {
+      std::ostringstream oss;
+      oss << "Failed to set IPv6 address (Error " << result << ")";
+      setError(oss.str());
+      return false;
+    }
+    std::cout << "Set IPv6 address: " << ip << "/" << prefixLength
+              << std::endl;
+    return true;
+  }
+
   bool add_route(const std::string &network,
                  const std::string &netmask) override {
     // Best effort using route.exe; requires admin.